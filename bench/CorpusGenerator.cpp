@@ -0,0 +1,164 @@
+#include "CorpusGenerator.h"
+#include <QDir>
+#include <QFile>
+#include <QByteArray>
+#include <QVector>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// The EICAR anti-malware test file; every engine reports it, none is harmed by it
+const char EICAR[] = "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*";
+
+const int WRITE_CHUNK = 64 * 1024;
+// Data at the start of a sparse file, as in a VM image with a written header
+const quint64 SPARSE_HEAD = 64 * 1024;
+
+// What a planted sample is called; the last one is executable and has no suffix
+const char* const PLANTED_SUFFIXES[] = {".exe", ".sh", ""};
+const int PLANTED_KINDS = 3;
+
+// std:: distributions are implementation defined; these are not, so a seed
+// yields the same corpus with every standard library
+double uniformDouble(std::mt19937_64& rng) {
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double standardNormal(std::mt19937_64& rng) {
+    double u1 = uniformDouble(rng);
+    double u2 = uniformDouble(rng);
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+}
+
+CorpusGenerator::CorpusGenerator(const Options& options)
+    : m_options(options)
+{
+}
+
+bool CorpusGenerator::parseDistribution(const QString& name, SizeDistribution* distribution) {
+    if (name == "fixed") {
+        *distribution = SizeDistribution::Fixed;
+    } else if (name == "uniform") {
+        *distribution = SizeDistribution::Uniform;
+    } else if (name == "lognormal") {
+        *distribution = SizeDistribution::LogNormal;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString CorpusGenerator::distributionName(SizeDistribution distribution) {
+    switch (distribution) {
+    case SizeDistribution::Fixed:
+        return "fixed";
+    case SizeDistribution::Uniform:
+        return "uniform";
+    default:
+        return "lognormal";
+    }
+}
+
+CorpusGenerator::Result CorpusGenerator::generate(const QString& root) {
+    Result result;
+    std::mt19937_64 rng(m_options.seed);
+
+    // Breadth-first list of every directory in the tree, the root included
+    QStringList directories;
+    directories.append(root);
+    int levelStart = 0;
+    for (int level = 0; level < m_options.depth; ++level) {
+        int levelEnd = directories.size();
+        for (int parent = levelStart; parent < levelEnd; ++parent) {
+            for (int child = 0; child < m_options.fanOut; ++child) {
+                directories.append(QString("%1/d%2").arg(directories[parent]).arg(child));
+            }
+        }
+        levelStart = levelEnd;
+    }
+
+    for (const QString& directory : directories) {
+        if (!QDir().mkpath(directory)) {
+            m_error = "Cannot create directory " + directory;
+            return result;
+        }
+    }
+    result.directories = directories.size();
+
+    // Infected files are spread evenly through the file sequence
+    QVector<bool> infected(m_options.fileCount, false);
+    int infectedCount = qMin(m_options.infectedCount, m_options.fileCount);
+    for (int i = 0; i < infectedCount; ++i) {
+        infected[int(qint64(i) * m_options.fileCount / infectedCount)] = true;
+    }
+
+    QByteArray chunk(WRITE_CHUNK, '\0');
+
+    for (int i = 0; i < m_options.fileCount; ++i) {
+        QString directory = directories[int(rng() % quint64(directories.size()))];
+        QString suffix = ".bin";
+        if (m_options.plantRisky) {
+            suffix = infected[i] ? PLANTED_SUFFIXES[result.infected % PLANTED_KINDS] : ".dat";
+        }
+        QFile file(QString("%1/f%2%3").arg(directory).arg(i, 7, 10, QChar('0')).arg(suffix));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            m_error = "Cannot write " + file.fileName();
+            return result;
+        }
+
+        quint64 size = 0;
+        switch (m_options.distribution) {
+        case SizeDistribution::Fixed:
+            size = m_options.minSize;
+            break;
+        case SizeDistribution::Uniform:
+            size = m_options.minSize + rng() % (m_options.maxSize - m_options.minSize + 1);
+            break;
+        case SizeDistribution::LogNormal:
+            size = quint64(std::exp(std::log(double(qMax<quint64>(m_options.medianSize, 1)))
+                                    + m_options.sigma * standardNormal(rng)));
+            size = qBound(m_options.minSize, size, m_options.maxSize);
+            break;
+        }
+
+        if (infected[i]) {
+            file.write(EICAR, sizeof(EICAR) - 1);
+            result.bytes += sizeof(EICAR) - 1;
+            result.infected++;
+            if (m_options.plantRisky && suffix.isEmpty()) {
+                file.setPermissions(file.permissions() | QFileDevice::ExeOwner | QFileDevice::ExeGroup
+                                    | QFileDevice::ExeOther);
+            }
+        } else {
+            // Random content, so neither clamd nor the page cache gets an easy ride.
+            // A sparse file gets its head written and the rest left as a hole.
+            bool sparse = m_options.sparsePercent > 0 && size > SPARSE_HEAD
+                && int(rng() % 100) < m_options.sparsePercent;
+            quint64 remaining = sparse ? SPARSE_HEAD : size;
+            while (remaining > 0) {
+                int length = int(qMin<quint64>(remaining, WRITE_CHUNK));
+                quint64* words = reinterpret_cast<quint64*>(chunk.data());
+                for (int w = 0; w < (length + 7) / 8; ++w) {
+                    words[w] = rng();
+                }
+                file.write(chunk.constData(), length);
+                remaining -= length;
+            }
+            if (sparse) {
+                file.resize(qint64(size));
+                result.sparse++;
+            }
+            result.bytes += size;
+        }
+
+        result.files++;
+    }
+
+    return result;
+}
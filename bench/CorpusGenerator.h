@@ -0,0 +1,60 @@
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+
+// Writes a reproducible tree of files for the benchmark. The same options and
+// seed always produce byte-identical files at identical paths.
+class CorpusGenerator {
+public:
+    enum class SizeDistribution {
+        Fixed,      // every file is minSize bytes
+        Uniform,    // uniform between minSize and maxSize
+        LogNormal   // median medianSize, clamped to [minSize, maxSize]
+    };
+
+    struct Options {
+        int fileCount;
+        int infectedCount;      // EICAR test files among fileCount
+        int depth;              // directory levels below the root
+        int fanOut;             // subdirectories per directory
+        SizeDistribution distribution;
+        quint64 minSize;
+        quint64 maxSize;
+        quint64 medianSize;
+        double sigma;           // log-normal shape
+        quint64 seed;
+        bool plantRisky;        // samples named like droppers among .dat files, for time to first detection
+        int sparsePercent;      // clean files with only their first 64 KiB written, the rest a hole
+
+        Options()
+            : fileCount(1000), infectedCount(10), depth(3), fanOut(4)
+            , distribution(SizeDistribution::LogNormal)
+            , minSize(0), maxSize(16 * 1024 * 1024), medianSize(16 * 1024), sigma(1.5)
+            , seed(1), plantRisky(false), sparsePercent(0) {}
+    };
+
+    struct Result {
+        quint64 files;
+        quint64 bytes;
+        quint64 infected;
+        quint64 sparse;
+        int directories;
+        Result() : files(0), bytes(0), infected(0), sparse(0), directories(0) {}
+    };
+
+    explicit CorpusGenerator(const Options& options);
+
+    Result generate(const QString& root);
+    QString errorString() const { return m_error; }
+
+    static bool parseDistribution(const QString& name, SizeDistribution* distribution);
+    static QString distributionName(SizeDistribution distribution);
+
+private:
+    Options m_options;
+    QString m_error;
+};
+
+#endif // CORPUSGENERATOR_H
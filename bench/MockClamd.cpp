@@ -0,0 +1,440 @@
+#include "MockClamd.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QFile>
+#include <QTimer>
+#include <QtEndian>
+#include <cmath>
+#include <random>
+
+namespace {
+
+const char EICAR[] = "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*";
+const int EICAR_LENGTH = sizeof(EICAR) - 1;
+const char EICAR_NAME[] = "Eicar-Test-Signature";
+
+// FILDES is left out: Qt sockets cannot receive descriptors
+const char COMMANDS[] = "SCAN QUIT RELOAD PING CONTSCAN VERSIONCOMMANDS VERSION END SHUTDOWN "
+                        "MULTISCAN STATS IDSESSION INSTREAM ALLMATCHSCAN";
+
+bool isEicar(const QByteArray& head) {
+    return head.startsWith(QByteArray::fromRawData(EICAR, EICAR_LENGTH));
+}
+
+void closeSocket(QIODevice* socket) {
+    if (QLocalSocket* local = qobject_cast<QLocalSocket*>(socket)) {
+        local->disconnectFromServer();
+    } else if (QTcpSocket* tcp = qobject_cast<QTcpSocket*>(socket)) {
+        tcp->disconnectFromHost();
+    }
+}
+
+// Per-connection protocol state, owned by its socket
+struct Connection : public QObject {
+    QIODevice* socket;
+    QByteArray buffer;
+    bool session;
+    int nextId;
+    bool closing;
+
+    bool streaming;
+    int streamId;
+    char streamTerminator;
+    quint64 streamLength;
+    QByteArray streamHead;
+
+    explicit Connection(QIODevice* device)
+        : QObject(device), socket(device), session(false), nextId(1), closing(false)
+        , streaming(false), streamId(0), streamTerminator('\0'), streamLength(0) {}
+};
+
+}
+
+// Lives on MockClamd's thread and does all the socket work there
+class MockClamdServer : public QObject {
+public:
+    explicit MockClamdServer(MockClamd* owner)
+        : m_owner(owner)
+        , m_options(owner->m_options)
+        , m_rng(owner->m_options.seed)
+        , m_nextFreeMs(0)
+    {
+        m_clock.start();
+    }
+
+    bool listenLocal(const QString& path, QString* error) {
+        QLocalServer::removeServer(path);
+        QLocalServer* server = new QLocalServer(this);
+        if (!server->listen(path)) {
+            *error = server->errorString();
+            delete server;
+            return false;
+        }
+        connect(server, &QLocalServer::newConnection, this, [this, server]() {
+            while (QLocalSocket* socket = server->nextPendingConnection()) {
+                accept(socket);
+            }
+        });
+        return true;
+    }
+
+    bool listenTcp(quint16 port, quint16* boundPort, QString* error) {
+        QTcpServer* server = new QTcpServer(this);
+        if (!server->listen(QHostAddress::LocalHost, port)) {
+            *error = server->errorString();
+            delete server;
+            return false;
+        }
+        *boundPort = server->serverPort();
+        connect(server, &QTcpServer::newConnection, this, [this, server]() {
+            while (QTcpSocket* socket = server->nextPendingConnection()) {
+                accept(socket);
+            }
+        });
+        return true;
+    }
+
+    void shutdown() {
+        // Servers and open sockets are children; deleting them closes everything
+        const QObjectList children = this->children();
+        for (QObject* child : children) {
+            delete child;
+        }
+    }
+
+private:
+    void accept(QIODevice* socket) {
+        socket->setParent(this);
+        Connection* connection = new Connection(socket);
+
+        connect(socket, &QIODevice::readyRead, connection, [this, connection]() {
+            connection->buffer += connection->socket->readAll();
+            process(connection);
+        });
+
+        if (QLocalSocket* local = qobject_cast<QLocalSocket*>(socket)) {
+            connect(local, &QLocalSocket::disconnected, local, &QObject::deleteLater);
+        } else if (QTcpSocket* tcp = qobject_cast<QTcpSocket*>(socket)) {
+            connect(tcp, &QTcpSocket::disconnected, tcp, &QObject::deleteLater);
+        }
+    }
+
+    void process(Connection* c) {
+        while (!c->closing) {
+            if (c->streaming) {
+                if (!processStream(c)) {
+                    return;
+                }
+                continue;
+            }
+
+            if (c->buffer.isEmpty()) {
+                return;
+            }
+
+            // 'z' commands end in NUL, 'n' and unprefixed ones in a newline
+            char terminator = c->buffer[0] == 'z' ? '\0' : '\n';
+            int end = c->buffer.indexOf(terminator);
+            if (end < 0) {
+                return;
+            }
+
+            int start = (c->buffer[0] == 'z' || c->buffer[0] == 'n') ? 1 : 0;
+            QByteArray command = c->buffer.mid(start, end - start);
+            c->buffer.remove(0, end + 1);
+            handleCommand(c, command.trimmed(), terminator);
+        }
+    }
+
+    // Consumes INSTREAM chunks; false when more data is needed
+    bool processStream(Connection* c) {
+        if (c->buffer.size() < 4) {
+            return false;
+        }
+
+        quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(c->buffer.constData()));
+        if (length == 0) {
+            c->buffer.remove(0, 4);
+            c->streaming = false;
+
+            bool infected = isEicar(c->streamHead);
+            QByteArray result = infected ? QByteArray("stream: ") + EICAR_NAME + " FOUND" : "stream: OK";
+            finishScan(c, c->streamId, result, c->streamTerminator, c->streamLength, infected);
+            return true;
+        }
+
+        if (quint64(c->buffer.size()) < 4 + quint64(length)) {
+            return false;
+        }
+
+        if (c->streamHead.size() < EICAR_LENGTH) {
+            c->streamHead += c->buffer.mid(4, EICAR_LENGTH - c->streamHead.size());
+        }
+        c->streamLength += length;
+        c->buffer.remove(0, 4 + int(length));
+
+        if (c->streamLength > m_options.streamMaxLength) {
+            c->streaming = false;
+            sendReply(c, c->streamId, "INSTREAM size limit exceeded. ERROR", c->streamTerminator, 0);
+            c->closing = true;
+            closeSocket(c->socket);
+            return false;
+        }
+        return true;
+    }
+
+    void handleCommand(Connection* c, const QByteArray& command, char terminator) {
+        m_owner->m_requests++;
+        int id = c->session ? c->nextId++ : 0;
+
+        int space = command.indexOf(' ');
+        QByteArray verb = space < 0 ? command : command.left(space);
+        QByteArray argument = space < 0 ? QByteArray() : command.mid(space + 1);
+
+        if (verb == "PING") {
+            sendReply(c, id, "PONG", terminator, sampleLatencyMs());
+        } else if (verb == "VERSION") {
+            sendReply(c, id, m_options.version.toUtf8(), terminator, sampleLatencyMs());
+        } else if (verb == "VERSIONCOMMANDS") {
+            sendReply(c, id, m_options.version.toUtf8() + "| COMMANDS: " + COMMANDS, terminator,
+                      sampleLatencyMs());
+        } else if (verb == "RELOAD") {
+            sendReply(c, id, "RELOADING", terminator, sampleLatencyMs());
+        } else if (verb == "STATS") {
+            sendReply(c, id, "POOLS: 1\n\nSTATE: VALID PRIMARY\nTHREADS: live 1  idle 0 max 1 "
+                             "idle-timeout 30\nQUEUE: 0 items\nEND", terminator, sampleLatencyMs());
+        } else if (verb == "IDSESSION") {
+            c->session = true;
+            c->nextId = 1;
+        } else if (verb == "END" || verb == "QUIT" || verb == "SHUTDOWN") {
+            c->closing = true;
+            closeSocket(c->socket);
+        } else if (verb == "INSTREAM") {
+            c->streaming = true;
+            c->streamId = id;
+            c->streamTerminator = terminator;
+            c->streamLength = 0;
+            c->streamHead.clear();
+        } else if (verb == "SCAN" || verb == "CONTSCAN" || verb == "MULTISCAN" || verb == "ALLMATCHSCAN") {
+            scanPath(c, id, argument, terminator);
+        } else {
+            sendReply(c, id, "UNKNOWN COMMAND", terminator, 0);
+        }
+    }
+
+    void scanPath(Connection* c, int id, const QByteArray& path, char terminator) {
+        QString filePath = QFile::decodeName(path);
+        QFileInfo info(filePath);
+        if (!info.exists()) {
+            sendReply(c, id, path + ": lstat() failed: No such file or directory. ERROR", terminator, 0);
+            return;
+        }
+
+        QStringList files;
+        if (info.isDir()) {
+            QDirIterator it(filePath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files.append(it.next());
+            }
+        } else {
+            files.append(filePath);
+        }
+
+        // One reply per detection, or a single OK for the whole request
+        QList<QByteArray> lines;
+        quint64 bytes = 0;
+        for (const QString& file : files) {
+            QFile input(file);
+            if (!input.open(QIODevice::ReadOnly)) {
+                lines.append(QFile::encodeName(file) + ": Can't open file or directory ERROR");
+                continue;
+            }
+            bytes += quint64(input.size());
+            if (isEicar(input.read(EICAR_LENGTH))) {
+                lines.append(QFile::encodeName(file) + ": " + EICAR_NAME + " FOUND");
+            }
+        }
+
+        bool infected = !lines.isEmpty();
+        if (lines.isEmpty()) {
+            lines.append(path + ": OK");
+        }
+        finishScan(c, id, lines.join(terminator), terminator, bytes, infected);
+    }
+
+    void finishScan(Connection* c, int id, const QByteArray& result, char terminator,
+                    quint64 bytes, bool infected) {
+        m_owner->m_bytes += bytes;
+        qint64 delayMs = sampleLatencyMs() + reserveThroughputMs(bytes);
+
+        if (chance(m_options.dropRate)) {
+            m_owner->m_connectionsDropped++;
+            c->closing = true;
+            QTimer::singleShot(delayMs, c, [c]() { closeSocket(c->socket); });
+            return;
+        }
+
+        if (chance(m_options.errorRate)) {
+            m_owner->m_errorsInjected++;
+            sendReply(c, id, "Injected failure. ERROR", terminator, delayMs);
+            return;
+        }
+
+        if (infected) {
+            m_owner->m_detections++;
+        }
+        sendReply(c, id, result, terminator, delayMs);
+    }
+
+    void sendReply(Connection* c, int id, const QByteArray& text, char terminator, qint64 delayMs) {
+        QByteArray reply = id > 0 ? QByteArray::number(id) + ": " + text : text;
+        reply += terminator;
+        bool closeAfter = !c->session;
+
+        QTimer::singleShot(qMax<qint64>(delayMs, 0), c, [c, reply, closeAfter]() {
+            c->socket->write(reply);
+            // Outside a session clamd answers one command and hangs up
+            if (closeAfter) {
+                c->closing = true;
+                closeSocket(c->socket);
+            }
+        });
+    }
+
+    qint64 sampleLatencyMs() {
+        double latency = m_options.latencyMs;
+        switch (m_options.latencyModel) {
+        case MockClamd::LatencyModel::Fixed:
+            break;
+        case MockClamd::LatencyModel::Uniform:
+            latency += uniform() * qMax(0.0, m_options.latencyMaxMs - m_options.latencyMs);
+            break;
+        case MockClamd::LatencyModel::LogNormal: {
+            double u1 = qMax(uniform(), 1e-300);
+            double normal = std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * uniform());
+            latency = m_options.latencyMs * std::exp(m_options.sigma * normal);
+            break;
+        }
+        }
+        return qint64(latency + 0.5);
+    }
+
+    // All connections share one pipe of throughputBytesPerSec, like one engine
+    // reading from one disk: a scan finishes when its bytes have been through it
+    qint64 reserveThroughputMs(quint64 bytes) {
+        if (m_options.throughputBytesPerSec == 0) {
+            return 0;
+        }
+        double now = m_clock.nsecsElapsed() / 1e6;
+        double start = qMax(now, m_nextFreeMs);
+        m_nextFreeMs = start + bytes * 1000.0 / m_options.throughputBytesPerSec;
+        return qint64(m_nextFreeMs - now + 0.5);
+    }
+
+    double uniform() {
+        return (m_rng() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    bool chance(double rate) {
+        return rate > 0 && uniform() < rate;
+    }
+
+    MockClamd* m_owner;
+    MockClamd::Options m_options;
+    std::mt19937_64 m_rng;
+    QElapsedTimer m_clock;
+    double m_nextFreeMs;
+};
+
+MockClamd::MockClamd(const Options& options)
+    : m_options(options)
+    , m_server(nullptr)
+    , m_requests(0)
+    , m_bytes(0)
+    , m_detections(0)
+    , m_errorsInjected(0)
+    , m_connectionsDropped(0)
+{
+    m_server = new MockClamdServer(this);
+    m_server->moveToThread(&m_thread);
+    m_thread.setObjectName("MockClamd");
+    m_thread.start();
+}
+
+MockClamd::~MockClamd() {
+    stop();
+}
+
+bool MockClamd::listenLocal(const QString& socketPath) {
+    bool ok = false;
+    QMetaObject::invokeMethod(m_server, [this, socketPath, &ok]() {
+        ok = m_server->listenLocal(socketPath, &m_error);
+    }, Qt::BlockingQueuedConnection);
+
+    if (ok) {
+        m_endpoints.append("unix:" + socketPath);
+    }
+    return ok;
+}
+
+bool MockClamd::listenTcp(quint16 port) {
+    bool ok = false;
+    quint16 boundPort = 0;
+    QMetaObject::invokeMethod(m_server, [this, port, &ok, &boundPort]() {
+        ok = m_server->listenTcp(port, &boundPort, &m_error);
+    }, Qt::BlockingQueuedConnection);
+
+    if (ok) {
+        m_endpoints.append(QString("tcp:127.0.0.1:%1").arg(boundPort));
+    }
+    return ok;
+}
+
+void MockClamd::stop() {
+    if (!m_server) {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_server, [this]() {
+        m_server->shutdown();
+    }, Qt::BlockingQueuedConnection);
+
+    m_thread.quit();
+    m_thread.wait();
+    delete m_server;
+    m_server = nullptr;
+    m_endpoints.clear();
+}
+
+MockClamd::Stats MockClamd::stats() const {
+    Stats stats;
+    stats.requests = m_requests.load();
+    stats.bytes = m_bytes.load();
+    stats.detections = m_detections.load();
+    stats.errorsInjected = m_errorsInjected.load();
+    stats.connectionsDropped = m_connectionsDropped.load();
+    return stats;
+}
+
+bool MockClamd::parseLatencyModel(const QString& name, LatencyModel* model) {
+    if (name == "fixed") {
+        *model = LatencyModel::Fixed;
+    } else if (name == "uniform") {
+        *model = LatencyModel::Uniform;
+    } else if (name == "lognormal") {
+        *model = LatencyModel::LogNormal;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* MockClamd::eicarSignatureName() {
+    return EICAR_NAME;
+}
@@ -0,0 +1,87 @@
+#ifndef MOCKCLAMD_H
+#define MOCKCLAMD_H
+
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+
+class MockClamdServer;
+
+// In-process stand-in for clamd: speaks the socket protocol (PING, VERSION,
+// VERSIONCOMMANDS, SCAN, CONTSCAN, MULTISCAN, INSTREAM, IDSESSION/END,
+// RELOAD, STATS) on a Unix socket and/or TCP port, but instead of matching
+// signatures it only recognises the EICAR test file. Latency, aggregate
+// throughput and failures follow the configured model, so a benchmark can
+// measure FastAV's own overhead separately from signature matching.
+// Runs on its own thread; blocking clients in the same process are fine.
+class MockClamd {
+public:
+    enum class LatencyModel {
+        Fixed,      // latencyMs for every request
+        Uniform,    // between latencyMs and latencyMaxMs
+        LogNormal   // median latencyMs, shape sigma
+    };
+
+    struct Options {
+        LatencyModel latencyModel;
+        double latencyMs;
+        double latencyMaxMs;
+        double sigma;
+        quint64 throughputBytesPerSec;  // shared by all connections, 0 = unlimited
+        double errorRate;               // share of scans answered with an ERROR
+        double dropRate;                // share of scans whose connection is dropped
+        quint64 streamMaxLength;
+        QString version;
+        quint64 seed;
+
+        Options()
+            : latencyModel(LatencyModel::Fixed), latencyMs(0), latencyMaxMs(0), sigma(0.5)
+            , throughputBytesPerSec(0), errorRate(0), dropRate(0)
+            , streamMaxLength(100 * 1024 * 1024)
+            , version("ClamAV 1.0.0-mock/27000/Thu Jan  1 00:00:00 2026")
+            , seed(1) {}
+    };
+
+    struct Stats {
+        quint64 requests;
+        quint64 bytes;
+        quint64 detections;
+        quint64 errorsInjected;
+        quint64 connectionsDropped;
+    };
+
+    explicit MockClamd(const Options& options = Options());
+    ~MockClamd();
+
+    bool listenLocal(const QString& socketPath);
+    bool listenTcp(quint16 port = 0);     // 0 picks a free port
+    void stop();
+
+    // Endpoints in the form Scanner and ClamdClient take
+    QStringList endpoints() const { return m_endpoints; }
+    QString endpoint() const { return m_endpoints.value(0); }
+    QString errorString() const { return m_error; }
+
+    Stats stats() const;
+
+    static bool parseLatencyModel(const QString& name, LatencyModel* model);
+    static const char* eicarSignatureName();
+
+private:
+    friend class MockClamdServer;
+
+    Options m_options;
+    QThread m_thread;
+    MockClamdServer* m_server;
+    QStringList m_endpoints;
+    QString m_error;
+
+    std::atomic<quint64> m_requests;
+    std::atomic<quint64> m_bytes;
+    std::atomic<quint64> m_detections;
+    std::atomic<quint64> m_errorsInjected;
+    std::atomic<quint64> m_connectionsDropped;
+};
+
+#endif // MOCKCLAMD_H
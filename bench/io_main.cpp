@@ -0,0 +1,299 @@
+// fastav_io_bench - reading a scan's files through the io_uring prefetcher
+// against the workers reading them themselves. Generates (or reuses) a corpus,
+// walks it once, then per mode stats, opens, reads and MD5s every file on
+// --threads workers and prints one JSON object:
+//   fastav_io_bench --files 50000 --median-size 8192 --cold
+// "threads" is the thread-per-file model the scanner used before: each worker
+// does its own stat, open, read and close. "uring" has FilePrefetcher batch
+// those through one ring and hand the workers the contents; files above its
+// slot size are read by the worker, as in the scanner. --cold drops the
+// corpus from the page cache before each mode (posix_fadvise, no root needed).
+
+#include "CorpusGenerator.h"
+#include "core/FilePrefetcher.h"
+#include "core/FileWalker.h"
+#include "core/ExclusionRules.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <atomic>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct RunResult {
+    double seconds;
+    quint64 files;
+    quint64 bytes;
+    quint64 checksum;   // the same in every mode when every file was read right
+
+    RunResult() : seconds(0), files(0), bytes(0), checksum(0) {}
+};
+
+// The first 8 bytes of a digest; the modes add these up, so the order files finish in does not matter
+quint64 digestValue(const QByteArray& digest) {
+    quint64 value = 0;
+    for (int i = 0; i < 8 && i < digest.size(); ++i) {
+        value = value << 8 | quint8(digest[i]);
+    }
+    return value;
+}
+
+quint64 hashData(const QByteArray& data) {
+    return digestValue(QCryptographicHash::hash(data, QCryptographicHash::Md5));
+}
+
+// The worker's own read, as ScanTask does it without prefetched data
+quint64 hashFile(const QString& path, quint64* bytes) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    QCryptographicHash hasher(QCryptographicHash::Md5);
+    QByteArray buffer(256 * 1024, Qt::Uninitialized);
+    while (true) {
+        qint64 length = file.read(buffer.data(), buffer.size());
+        if (length <= 0) {
+            break;
+        }
+        hasher.addData(QByteArrayView(buffer.constData(), length));
+        *bytes += quint64(length);
+    }
+    return digestValue(hasher.result());
+}
+
+void dropCache(const PathArena& paths) {
+#ifdef Q_OS_LINUX
+    for (int file = 0; file < paths.fileCount(); ++file) {
+        int fd = ::open(paths.encodedFilePath(quint32(file)).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+#else
+    Q_UNUSED(paths);
+#endif
+}
+
+RunResult runThreads(const PathArena& paths, const QVector<quint32>& files, QThreadPool* pool) {
+    std::atomic<quint64> checksum(0);
+    std::atomic<quint64> bytes(0);
+    QVector<quint32> work = files;
+    QElapsedTimer timer;
+    timer.start();
+    QtConcurrent::blockingMap(pool, work, [&](quint32 file) {
+        QString path = paths.filePath(file);
+        QFileInfo info(path);
+        if (!info.isFile() || info.size() == 0) {
+            return;
+        }
+        quint64 read = 0;
+        checksum += hashFile(path, &read);
+        bytes += read;
+    });
+
+    RunResult result;
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.files = quint64(files.size());
+    result.bytes = bytes.load();
+    result.checksum = checksum.load();
+    return result;
+}
+
+RunResult runUring(const PathArena& paths, const QVector<quint32>& files, QThreadPool* pool,
+                   FilePrefetcher::Stats* stats, QString* error) {
+    std::atomic<quint64> checksum(0);
+    std::atomic<quint64> bytes(0);
+    QElapsedTimer timer;
+    timer.start();
+
+    FilePrefetcher prefetcher;
+    auto want = [](quint32, quint64) { return true; };
+    auto deliver = [&](const PrefetchedFile& prefetched) {
+        pool->start([&, prefetched]() {
+            if (prefetched.complete) {
+                checksum += hashData(prefetched.contents);
+                bytes += quint64(prefetched.contents.size());
+            } else if (!prefetched.hasStat || prefetched.size > 0) {
+                quint64 read = 0;
+                checksum += hashFile(paths.filePath(prefetched.file), &read);
+                bytes += read;
+            }
+        });
+    };
+    prefetcher.run(paths, files, nullptr, want, 0, deliver, error);
+    pool->waitForDone();
+    *stats = prefetcher.stats();
+
+    RunResult result;
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.files = quint64(files.size());
+    result.bytes = bytes.load();
+    result.checksum = checksum.load();
+    return result;
+}
+
+QJsonObject resultJson(const RunResult& result) {
+    QJsonObject json;
+    json["wall_seconds"] = result.seconds;
+    json["files"] = qint64(result.files);
+    json["bytes"] = qint64(result.bytes);
+    json["files_per_second"] = result.seconds > 0 ? result.files / result.seconds : 0.0;
+    json["mb_per_second"] = result.seconds > 0 ? result.bytes / (1024.0 * 1024.0) / result.seconds : 0.0;
+    json["checksum"] = QString::number(result.checksum, 16);
+    return json;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastav_io_bench");
+    QCoreApplication::setApplicationVersion("1.0.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Reading scan files through io_uring or per worker");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    CorpusGenerator::Options defaults;
+    QCommandLineOption filesOption("files", "Number of files.", "n", "20000");
+    QCommandLineOption distributionOption("distribution", "Size distribution: fixed, uniform or lognormal.",
+                                          "name", "lognormal");
+    QCommandLineOption minSizeOption("min-size", "Smallest file in bytes (the size for 'fixed').", "bytes",
+                                     QString::number(defaults.minSize));
+    QCommandLineOption maxSizeOption("max-size", "Largest file in bytes.", "bytes", "1048576");
+    QCommandLineOption medianOption("median-size", "Median for 'lognormal'.", "bytes",
+                                    QString::number(defaults.medianSize));
+    QCommandLineOption seedOption("seed", "Corpus seed.", "n", QString::number(defaults.seed));
+    QCommandLineOption corpusOption("corpus", "Generate into (or reuse with --reuse) this directory.", "dir");
+    QCommandLineOption reuseOption("reuse", "Read an existing --corpus without regenerating it.");
+    QCommandLineOption threadsOption("threads", "Worker threads (0 = ideal count).", "n", "0");
+    QCommandLineOption modeOption("mode", "threads, uring or both.", "mode", "both");
+    QCommandLineOption coldOption("cold", "Drop the corpus from the page cache before each mode.");
+    parser.addOptions({filesOption, distributionOption, minSizeOption, maxSizeOption, medianOption, seedOption,
+                       corpusOption, reuseOption, threadsOption, modeOption, coldOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    CorpusGenerator::Options options;
+    options.fileCount = parser.value(filesOption).toInt();
+    options.infectedCount = 0;
+    options.minSize = parser.value(minSizeOption).toULongLong();
+    options.maxSize = parser.value(maxSizeOption).toULongLong();
+    options.medianSize = parser.value(medianOption).toULongLong();
+    options.seed = parser.value(seedOption).toULongLong();
+    if (!CorpusGenerator::parseDistribution(parser.value(distributionOption), &options.distribution)) {
+        err << "Unknown distribution: " << parser.value(distributionOption) << Qt::endl;
+        return 2;
+    }
+    QString mode = parser.value(modeOption);
+    if (options.fileCount <= 0 || (mode != "threads" && mode != "uring" && mode != "both")) {
+        err << "Need --files > 0 and --mode threads, uring or both" << Qt::endl;
+        return 2;
+    }
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        err << "Cannot create a temporary directory" << Qt::endl;
+        return 1;
+    }
+    QString corpusRoot = parser.isSet(corpusOption) ? parser.value(corpusOption) : workDir.filePath("corpus");
+    if (parser.isSet(reuseOption)) {
+        if (!QDir(corpusRoot).exists()) {
+            err << "--reuse needs an existing --corpus directory" << Qt::endl;
+            return 2;
+        }
+    } else {
+        err << "Generating " << options.fileCount << " files in " << corpusRoot << Qt::endl;
+        CorpusGenerator generator(options);
+        generator.generate(corpusRoot);
+        if (!generator.errorString().isEmpty()) {
+            err << generator.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+
+    CancellationToken token;
+    FileWalker walker(ExclusionRules(), &token);
+    PathArenaPtr paths = walker.walk(QStringList() << corpusRoot);
+    QVector<quint32> files;
+    files.reserve(paths->fileCount());
+    for (int file = 0; file < paths->fileCount(); ++file) {
+        files.append(quint32(file));
+    }
+
+    int threads = parser.value(threadsOption).toInt();
+    threads = threads > 0 ? threads : QThread::idealThreadCount();
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    QJsonObject root;
+    root["files"] = paths->fileCount();
+    root["threads"] = threads;
+    root["cold"] = parser.isSet(coldOption);
+    root["distribution"] = CorpusGenerator::distributionName(options.distribution);
+    root["median_size"] = qint64(options.medianSize);
+    root["max_size"] = qint64(options.maxSize);
+
+    RunResult threadResult;
+    if (mode != "uring") {
+        if (parser.isSet(coldOption)) {
+            dropCache(*paths);
+        }
+        err << "Reading on " << threads << " workers..." << Qt::endl;
+        threadResult = runThreads(*paths, files, &pool);
+        root["threads_result"] = resultJson(threadResult);
+    }
+
+    if (mode != "threads") {
+        QString reason;
+        if (!FilePrefetcher::isAvailable(&reason)) {
+            err << "io_uring is not available: " << reason << Qt::endl;
+            root["uring_error"] = reason;
+        } else {
+            if (parser.isSet(coldOption)) {
+                dropCache(*paths);
+            }
+            err << "Reading through io_uring..." << Qt::endl;
+            FilePrefetcher::Stats stats;
+            QString error;
+            RunResult uringResult = runUring(*paths, files, &pool, &stats, &error);
+            QJsonObject json = resultJson(uringResult);
+            json["files_loaded"] = qint64(stats.filesLoaded);
+            json["files_by_worker"] = qint64(stats.filesHeaded + stats.filesBare);
+            json["submit_calls"] = qint64(stats.submitCalls);
+            json["files_per_submit"] = stats.submitCalls > 0 ? double(uringResult.files) / stats.submitCalls : 0.0;
+            json["peak_in_flight"] = stats.peakInFlight;
+            json["registered_buffers"] = stats.registeredBuffers;
+            if (!error.isEmpty()) {
+                json["error"] = error;
+            }
+            root["uring_result"] = json;
+            if (mode == "both") {
+                root["checksum_match"] = uringResult.checksum == threadResult.checksum;
+                root["speedup"] = uringResult.seconds > 0 ? threadResult.seconds / uringResult.seconds : 0.0;
+            }
+        }
+    }
+
+    out << QJsonDocument(root).toJson(QJsonDocument::Indented);
+    return 0;
+}
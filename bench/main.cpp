@@ -0,0 +1,458 @@
+// fastav_bench - end-to-end scan throughput on a synthetic corpus.
+//
+// Generates a deterministic file tree, runs Scanner over it against the local
+// clamd exactly as the GUI does, and prints one JSON object:
+//   fastav_bench --files 5000 --infected 25 --seed 7 --output result.json
+// With --mock the scan goes to an in-process mock clamd instead, which takes
+// signature matching out of the numbers and leaves FastAV's own overhead:
+//   fastav_bench --mock --mock-latency 1 --mock-throughput 800
+// --trace writes a Chrome trace of every file and stage on every worker.
+// --backend picks how files are scanned (clamdscan, clamd, clamd-stream,
+// libclamav), to compare backends on the same corpus. --mock-instances
+// starts several mocks and balances the scan across them:
+//   fastav_bench --mock --mock-instances 4 --mock-throughput 200
+
+#include "CorpusGenerator.h"
+#include "MockClamd.h"
+#include "core/Scanner.h"
+#include "core/Database.h"
+#include "core/ThreatReport.h"
+#include "core/ScanTracer.h"
+#include "core/ClamEngine.h"
+#include "core/ScanBackend.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QJsonArray>
+#include <QSettings>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Peak resident set size of this process in KiB (the scanner, not clamd)
+qint64 peakRssKb() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+double millis(quint64 micros) {
+    return micros / 1000.0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastav_bench");
+    QCoreApplication::setApplicationVersion("1.0.0");
+    QCoreApplication::setOrganizationName("FastAV");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("FastAV end-to-end scan benchmark");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    CorpusGenerator::Options defaults;
+    QCommandLineOption filesOption("files", "Number of files.", "n", QString::number(defaults.fileCount));
+    QCommandLineOption infectedOption("infected", "EICAR samples among them.", "n",
+                                      QString::number(defaults.infectedCount));
+    QCommandLineOption depthOption("depth", "Directory depth.", "n", QString::number(defaults.depth));
+    QCommandLineOption fanOutOption("fanout", "Subdirectories per directory.", "n",
+                                    QString::number(defaults.fanOut));
+    QCommandLineOption distributionOption("distribution", "Size distribution: fixed, uniform or lognormal.",
+                                          "name", CorpusGenerator::distributionName(defaults.distribution));
+    QCommandLineOption minSizeOption("min-size", "Smallest file in bytes (the size for 'fixed').", "bytes",
+                                     QString::number(defaults.minSize));
+    QCommandLineOption maxSizeOption("max-size", "Largest file in bytes.", "bytes",
+                                     QString::number(defaults.maxSize));
+    QCommandLineOption medianOption("median-size", "Median for 'lognormal'.", "bytes",
+                                    QString::number(defaults.medianSize));
+    QCommandLineOption sigmaOption("sigma", "Shape for 'lognormal'.", "value", QString::number(defaults.sigma));
+    QCommandLineOption seedOption("seed", "Corpus seed.", "n", QString::number(defaults.seed));
+    QCommandLineOption plantedOption("planted", "Disguise the EICAR samples as droppers (.exe, .sh, "
+                                     "executables without a suffix) among .dat files.");
+    QCommandLineOption sparseOption("sparse", "Percent of clean files left sparse: 64 KiB of data, then "
+                                    "a hole up to their size.", "percent", "0");
+    QCommandLineOption walkOrderOption("walk-order", "Scan in walk order instead of riskiest first.");
+    QCommandLineOption ioUringOption("io-uring", "Prefetch files with io_uring: on or off.", "on|off", "on");
+    QCommandLineOption incrementalOption("incremental", "Walk incrementally against a directory snapshot "
+                                         "kept next to the corpus; run again with --reuse to measure.");
+    QCommandLineOption fullWalkOption("full-walk-every", "With --incremental, list everything again every n "
+                                      "scans (0 = never).", "n", "7");
+    QCommandLineOption strictOption("strict", "Strict mode: send archives whole, no package allowlist.");
+    QCommandLineOption hashIndexOption("hash-index", "Look files up in this hash index first.", "file");
+    QCommandLineOption allowlistOption("allowlist", "Build a package allowlist in the work directory and "
+                                       "skip package-owned files (depends on the installed packages).");
+    QCommandLineOption corpusOption("corpus", "Generate into (or reuse with --reuse) this directory "
+                                    "instead of a temporary one.", "dir");
+    QCommandLineOption reuseOption("reuse", "Scan an existing --corpus without regenerating it.");
+    QCommandLineOption threadsOption("threads", "Scanner worker threads (0 = ideal count).", "n", "0");
+    QCommandLineOption outputOption("output", "Write the JSON result here instead of stdout.", "file");
+    QCommandLineOption traceOption("trace", "Write a Chrome trace of the scan here.", "file");
+    QCommandLineOption endpointOption("endpoint", "Scan through this clamd socket (unix:/path or "
+                                      "tcp:host:port) instead of clamdscan.", "endpoint");
+    QCommandLineOption mockOption("mock", "Scan against an in-process mock clamd.");
+    QCommandLineOption backendOption("backend", "Scan backend: " + ScanBackend::names().join(", ")
+                                     + ". Default: clamd with --endpoint or --mock, else clamdscan.", "name");
+    QCommandLineOption mockModelOption("mock-latency-model", "fixed, uniform or lognormal.", "model", "fixed");
+    QCommandLineOption mockLatencyOption("mock-latency", "Mock per-request latency, ms.", "ms", "0");
+    QCommandLineOption mockLatencyMaxOption("mock-latency-max", "Mock uniform latency upper bound, ms.",
+                                            "ms", "0");
+    QCommandLineOption mockThroughputOption("mock-throughput", "Mock aggregate throughput cap, MB/s.",
+                                            "mbps", "0");
+    QCommandLineOption mockErrorOption("mock-error-rate", "Share of mock scans answered with ERROR.",
+                                       "rate", "0");
+    QCommandLineOption mockInstancesOption("mock-instances", "Number of mock clamd instances, each with "
+                                           "the same options.", "n", "1");
+
+    parser.addOptions({filesOption, infectedOption, depthOption, fanOutOption, distributionOption,
+                       minSizeOption, maxSizeOption, medianOption, sigmaOption, seedOption, plantedOption,
+                       sparseOption, walkOrderOption, ioUringOption, incrementalOption, fullWalkOption,
+                       strictOption, hashIndexOption, allowlistOption,
+                       corpusOption, reuseOption, threadsOption, outputOption, traceOption, endpointOption,
+                       mockOption, backendOption, mockModelOption, mockLatencyOption, mockLatencyMaxOption,
+                       mockThroughputOption, mockErrorOption, mockInstancesOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    CorpusGenerator::Options options;
+    options.fileCount = parser.value(filesOption).toInt();
+    options.infectedCount = parser.value(infectedOption).toInt();
+    options.depth = parser.value(depthOption).toInt();
+    options.fanOut = parser.value(fanOutOption).toInt();
+    options.minSize = parser.value(minSizeOption).toULongLong();
+    options.maxSize = parser.value(maxSizeOption).toULongLong();
+    options.medianSize = parser.value(medianOption).toULongLong();
+    options.sigma = parser.value(sigmaOption).toDouble();
+    options.seed = parser.value(seedOption).toULongLong();
+    options.plantRisky = parser.isSet(plantedOption);
+    options.sparsePercent = qBound(0, parser.value(sparseOption).toInt(), 100);
+
+    if (!CorpusGenerator::parseDistribution(parser.value(distributionOption), &options.distribution)) {
+        err << "Unknown distribution: " << parser.value(distributionOption) << Qt::endl;
+        return 2;
+    }
+    if (options.fileCount <= 0 || options.minSize > options.maxSize) {
+        err << "Need --files > 0 and --min-size <= --max-size" << Qt::endl;
+        return 2;
+    }
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        err << "Cannot create a temporary directory" << Qt::endl;
+        return 1;
+    }
+
+    // An empty settings store of the bench's own: whatever the developer has
+    // configured for FastAV is neither read nor written. Everything the scanner
+    // has a setter for is pinned below; the rest (exclusions, archive
+    // expansion) keeps its built-in default.
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, workDir.filePath("settings"));
+    QSettings::setPath(QSettings::IniFormat, QSettings::SystemScope, workDir.filePath("settings"));
+
+    QString corpusRoot = parser.isSet(corpusOption) ? parser.value(corpusOption) : workDir.filePath("corpus");
+    CorpusGenerator::Result corpus;
+
+    QElapsedTimer generateTimer;
+    generateTimer.start();
+    if (parser.isSet(reuseOption)) {
+        if (!QDir(corpusRoot).exists()) {
+            err << "--reuse needs an existing --corpus directory" << Qt::endl;
+            return 2;
+        }
+    } else {
+        err << "Generating " << options.fileCount << " files in " << corpusRoot << Qt::endl;
+        CorpusGenerator generator(options);
+        corpus = generator.generate(corpusRoot);
+        if (!generator.errorString().isEmpty()) {
+            err << generator.errorString() << Qt::endl;
+            return 1;
+        }
+    }
+    qint64 generateMs = generateTimer.elapsed();
+
+    // A private database, so benchmark runs never show up in the user's history
+    Database database(workDir.filePath("bench.db"));
+    if (!database.initialize()) {
+        err << "Cannot open benchmark database" << Qt::endl;
+        return 1;
+    }
+
+    // Started before the scanner, stopped after it
+    MockClamd::Options mockOptions;
+    if (!MockClamd::parseLatencyModel(parser.value(mockModelOption), &mockOptions.latencyModel)) {
+        err << "Unknown latency model: " << parser.value(mockModelOption) << Qt::endl;
+        return 2;
+    }
+    mockOptions.latencyMs = parser.value(mockLatencyOption).toDouble();
+    mockOptions.latencyMaxMs = parser.value(mockLatencyMaxOption).toDouble();
+    mockOptions.throughputBytesPerSec = quint64(parser.value(mockThroughputOption).toDouble() * 1024 * 1024);
+    mockOptions.errorRate = parser.value(mockErrorOption).toDouble();
+    QVector<QSharedPointer<MockClamd>> mocks;
+
+    QString endpoint = parser.value(endpointOption);
+    if (parser.isSet(mockOption)) {
+        int instances = qMax(1, parser.value(mockInstancesOption).toInt());
+        QStringList endpoints;
+        for (int i = 0; i < instances; ++i) {
+            QSharedPointer<MockClamd> mock(new MockClamd(mockOptions));
+            QString socketName = instances == 1 ? QString("mock-clamd.sock") : QString("mock-clamd-%1.sock").arg(i);
+            if (!mock->listenLocal(workDir.filePath(socketName))) {
+                err << "Cannot start mock clamd: " << mock->errorString() << Qt::endl;
+                return 1;
+            }
+            endpoints.append(mock->endpoint());
+            mocks.append(mock);
+        }
+        endpoint = endpoints.join(',');
+    }
+
+    QString backendName = parser.value(backendOption);
+    if (backendName.isEmpty()) {
+        backendName = endpoint.isEmpty() ? "clamdscan" : "clamd";
+    }
+    if (!ScanBackend::isAvailable(backendName)) {
+        err << "Scan backend not available in this build: " << backendName << Qt::endl;
+        return 2;
+    }
+
+    // Compile the signatures up front, so loading is not counted as scan time
+    qint64 engineLoadMs = 0;
+    if (backendName == "libclamav") {
+        err << "Loading libclamav signatures..." << Qt::endl;
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        QString engineError;
+        if (!ClamEngine::instance().ensureLoaded(&engineError)) {
+            err << "Cannot load libclamav engine: " << engineError << Qt::endl;
+            return 1;
+        }
+        engineLoadMs = loadTimer.elapsed();
+    }
+
+    QScopedPointer<ScanTracer> tracer(parser.isSet(traceOption) ? new ScanTracer : nullptr);
+
+    Scanner scanner(&database);
+    scanner.setMaxThreads(parser.value(threadsOption).toInt());
+    scanner.setClamdEndpoint(endpoint);
+    scanner.setBackend(backendName);
+    scanner.setRiskOrder(!parser.isSet(walkOrderOption));
+    scanner.setIoUring(parser.value(ioUringOption) != "off");
+    scanner.setStrictMode(parser.isSet(strictOption));
+    scanner.setHashIndexEnabled(parser.isSet(hashIndexOption));
+    scanner.setHashIndexPath(parser.value(hashIndexOption));
+    scanner.setAllowlistPath(parser.isSet(allowlistOption) ? workDir.filePath("packages.allowlist") : QString());
+    QString snapshotPath = QDir(corpusRoot).absolutePath() + ".dirsnapshot";
+    scanner.setIncremental(parser.isSet(incrementalOption), snapshotPath);
+    scanner.setFullWalkEvery(parser.value(fullWalkOption).toInt());
+    if (!parser.isSet(reuseOption)) {
+        // A regenerated corpus has new inodes everywhere; an old snapshot would only mislead
+        QFile::remove(snapshotPath);
+    }
+    scanner.setTracer(tracer.data());
+
+    ThreatReport report;
+    QString scanError;
+    QObject::connect(&scanner, &Scanner::scanCompleted, &app, [&](const ThreatReport& completed) {
+        report = completed;
+        app.quit();
+    });
+    QObject::connect(&scanner, &Scanner::scanError, &app, [&](const QString& error) {
+        scanError = error;
+        app.quit();
+    });
+
+    QElapsedTimer scanTimer;
+    QTimer::singleShot(0, &app, [&]() {
+        err << "Scanning..." << Qt::endl;
+        scanTimer.start();
+        scanner.startScan(QStringList() << corpusRoot);
+    });
+    app.exec();
+    double seconds = scanTimer.nsecsElapsed() / 1e9;
+    // The directory snapshot is written in the background
+    QThreadPool::globalInstance()->waitForDone();
+
+    if (!scanError.isEmpty()) {
+        err << "Scan failed: " << scanError << Qt::endl;
+        return 1;
+    }
+
+    const LatencyHistogram& latency = scanner.getFileLatency();
+    quint64 filesScanned = report.getTotalFilesScanned();
+    quint64 bytesScanned = report.getTotalBytesScanned();
+
+    QJsonObject corpusJson;
+    corpusJson["root"] = corpusRoot;
+    corpusJson["reused"] = parser.isSet(reuseOption);
+    corpusJson["files"] = qint64(corpus.files);
+    corpusJson["bytes"] = qint64(corpus.bytes);
+    corpusJson["infected"] = qint64(corpus.infected);
+    corpusJson["sparse"] = qint64(corpus.sparse);
+    corpusJson["directories"] = corpus.directories;
+    corpusJson["distribution"] = CorpusGenerator::distributionName(options.distribution);
+    corpusJson["min_size"] = qint64(options.minSize);
+    corpusJson["max_size"] = qint64(options.maxSize);
+    corpusJson["median_size"] = qint64(options.medianSize);
+    corpusJson["sigma"] = options.sigma;
+    corpusJson["seed"] = qint64(options.seed);
+    corpusJson["planted"] = options.plantRisky;
+    corpusJson["generate_ms"] = generateMs;
+
+    QJsonObject latencyJson;
+    latencyJson["p50"] = millis(latency.percentile(50));
+    latencyJson["p90"] = millis(latency.percentile(90));
+    latencyJson["p99"] = millis(latency.percentile(99));
+    latencyJson["max"] = millis(latency.max());
+    latencyJson["mean"] = latency.mean() / 1000.0;
+
+    QJsonObject stagesJson;
+    for (const StageLatency& stage : report.getStageLatencies()) {
+        QJsonObject stageJson;
+        stageJson["count"] = qint64(stage.count);
+        stageJson["p50"] = millis(stage.p50);
+        stageJson["p90"] = millis(stage.p90);
+        stageJson["p99"] = millis(stage.p99);
+        stageJson["max"] = millis(stage.max);
+        stagesJson[stage.stage] = stageJson;
+    }
+
+    QJsonObject resultJson;
+    resultJson["threads"] = parser.value(threadsOption).toInt() > 0
+        ? parser.value(threadsOption).toInt() : QThread::idealThreadCount();
+    resultJson["wall_seconds"] = seconds;
+    resultJson["files_scanned"] = qint64(filesScanned);
+    resultJson["bytes_scanned"] = qint64(bytesScanned);
+    // What FastAV itself read from disk; sparse holes were streamed and hashed as zeros instead
+    resultJson["bytes_read"] = qint64(report.getTotalBytesRead());
+    resultJson["hole_bytes"] = qint64(report.getHoleBytes());
+    resultJson["threats_found"] = report.getThreatCount();
+    resultJson["files_skipped"] = qint64(report.getFilesSkipped());
+    resultJson["files_timed_out"] = qint64(report.getFilesTimedOut());
+    resultJson["files_failed"] = qint64(report.getFilesFailed());
+    resultJson["order"] = scanner.riskOrder() ? "risk" : "walk";
+    resultJson["strict"] = scanner.strictMode();
+    resultJson["hash_index"] = scanner.hashIndexEnabled();
+    resultJson["allowlist"] = parser.isSet(allowlistOption);
+    FileWalker::Stats walkStats = scanner.getWalkStats();
+    resultJson["incremental"] = scanner.isIncremental();
+    resultJson["directories_unchanged"] = qint64(walkStats.directoriesUnchanged);
+    resultJson["files_unchanged"] = qint64(walkStats.filesUnchanged);
+    // All zero when io_uring was off or not available
+    FilePrefetcher::Stats prefetchStats = scanner.getPrefetchStats();
+    QJsonObject prefetchJson;
+    prefetchJson["enabled"] = scanner.ioUring();
+    prefetchJson["files_loaded"] = qint64(prefetchStats.filesLoaded);
+    prefetchJson["files_headed"] = qint64(prefetchStats.filesHeaded);
+    prefetchJson["bytes_read"] = qint64(prefetchStats.bytesRead);
+    prefetchJson["submit_calls"] = qint64(prefetchStats.submitCalls);
+    prefetchJson["peak_in_flight"] = prefetchStats.peakInFlight;
+    prefetchJson["registered_buffers"] = prefetchStats.registeredBuffers;
+    resultJson["io_uring"] = prefetchJson;
+    // From the start of the walk, so ranking is paid for; null without a detection
+    resultJson["time_to_first_detection_ms"] = report.getTimeToFirstDetection() >= 0
+        ? QJsonValue(report.getTimeToFirstDetection()) : QJsonValue();
+    resultJson["files_per_second"] = seconds > 0 ? filesScanned / seconds : 0.0;
+    resultJson["mb_per_second"] = seconds > 0 ? bytesScanned / (1024.0 * 1024.0) / seconds : 0.0;
+    resultJson["latency_ms"] = latencyJson;
+    resultJson["stage_latency_ms"] = stagesJson;
+    resultJson["peak_rss_kb"] = peakRssKb();
+
+    QJsonObject root;
+    root["corpus"] = corpusJson;
+    root["result"] = resultJson;
+    root["backend"] = backendName;
+    if (backendName == "libclamav") {
+        root["engine_version"] = ClamEngine::instance().version();
+        root["engine_signatures"] = qint64(ClamEngine::instance().signatureCount());
+        root["engine_load_ms"] = engineLoadMs;
+    } else if (!endpoint.isEmpty()) {
+        root["endpoint"] = endpoint;
+    }
+
+    if (parser.isSet(mockOption)) {
+        quint64 requests = 0;
+        quint64 errorsInjected = 0;
+        for (const QSharedPointer<MockClamd>& mock : mocks) {
+            MockClamd::Stats stats = mock->stats();
+            requests += stats.requests;
+            errorsInjected += stats.errorsInjected;
+        }
+        QJsonObject mockJson;
+        mockJson["instances"] = mocks.size();
+        mockJson["latency_model"] = parser.value(mockModelOption);
+        mockJson["latency_ms"] = mockOptions.latencyMs;
+        mockJson["throughput_mbps"] = parser.value(mockThroughputOption).toDouble();
+        mockJson["error_rate"] = mockOptions.errorRate;
+        mockJson["requests"] = qint64(requests);
+        mockJson["errors_injected"] = qint64(errorsInjected);
+        root["mock"] = mockJson;
+    }
+    if (!report.getEndpointStats().isEmpty()) {
+        QJsonArray endpointsJson;
+        for (const EndpointStats& stats : report.getEndpointStats()) {
+            QJsonObject endpointJson;
+            endpointJson["endpoint"] = stats.endpoint;
+            endpointJson["files"] = qint64(stats.files);
+            endpointJson["bytes"] = qint64(stats.bytes);
+            endpointJson["failures"] = qint64(stats.failures);
+            endpointJson["busy_ms"] = stats.busyUs / 1000.0;
+            endpointJson["removals"] = qint64(stats.removals);
+            endpointJson["healthy"] = stats.healthy;
+            endpointsJson.append(endpointJson);
+        }
+        root["endpoints"] = endpointsJson;
+    }
+    if (tracer) {
+        QString traceError;
+        if (!tracer->write(parser.value(traceOption), &traceError)) {
+            err << "Cannot write trace: " << traceError << Qt::endl;
+        }
+        QJsonObject traceJson;
+        traceJson["path"] = parser.value(traceOption);
+        traceJson["events"] = qint64(tracer->eventCount());
+        traceJson["dropped"] = qint64(tracer->droppedCount());
+        root["trace"] = traceJson;
+    }
+    if (!parser.isSet(reuseOption)) {
+        root["detections_match"] = quint64(report.getThreatCount()) == corpus.infected;
+    }
+
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption)) {
+        QFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Cannot write " << output.fileName() << Qt::endl;
+            return 1;
+        }
+        output.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+// fastav_mock_clamd - the benchmark's mock clamd as a standalone daemon, for
+// pointing the GUI (Scanner clamd endpoint) or other clients at it:
+//   fastav_mock_clamd --socket /tmp/mock-clamd.sock --latency 2 --throughput 400
+// Run several on different sockets and give the GUI a comma separated list to
+// try load balancing.
+
+#include "MockClamd.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <csignal>
+
+namespace {
+
+void quitOnSignal(int) {
+    QCoreApplication::quit();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastav_mock_clamd");
+    QCoreApplication::setApplicationVersion("1.0.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mock clamd that only detects EICAR, with configurable timing");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption socketOption("socket", "Listen on this Unix socket.", "path");
+    QCommandLineOption portOption("port", "Listen on this TCP port on 127.0.0.1 (0 = any free port).", "port");
+    QCommandLineOption modelOption("latency-model", "fixed, uniform or lognormal.", "model", "fixed");
+    QCommandLineOption latencyOption("latency", "Per-request latency (median for lognormal), ms.", "ms", "0");
+    QCommandLineOption latencyMaxOption("latency-max", "Upper bound for uniform latency, ms.", "ms", "0");
+    QCommandLineOption sigmaOption("sigma", "Shape for lognormal latency.", "value", "0.5");
+    QCommandLineOption throughputOption("throughput", "Aggregate scan throughput cap, MB/s (0 = none).",
+                                        "mbps", "0");
+    QCommandLineOption errorOption("error-rate", "Share of scans answered with ERROR (0-1).", "rate", "0");
+    QCommandLineOption dropOption("drop-rate", "Share of scans whose connection is dropped (0-1).",
+                                  "rate", "0");
+    QCommandLineOption seedOption("seed", "Seed for latency and failure sampling.", "n", "1");
+
+    parser.addOptions({socketOption, portOption, modelOption, latencyOption, latencyMaxOption,
+                       sigmaOption, throughputOption, errorOption, dropOption, seedOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    MockClamd::Options options;
+    if (!MockClamd::parseLatencyModel(parser.value(modelOption), &options.latencyModel)) {
+        err << "Unknown latency model: " << parser.value(modelOption) << Qt::endl;
+        return 2;
+    }
+    options.latencyMs = parser.value(latencyOption).toDouble();
+    options.latencyMaxMs = parser.value(latencyMaxOption).toDouble();
+    options.sigma = parser.value(sigmaOption).toDouble();
+    options.throughputBytesPerSec = quint64(parser.value(throughputOption).toDouble() * 1024 * 1024);
+    options.errorRate = parser.value(errorOption).toDouble();
+    options.dropRate = parser.value(dropOption).toDouble();
+    options.seed = parser.value(seedOption).toULongLong();
+
+    if (!parser.isSet(socketOption) && !parser.isSet(portOption)) {
+        err << "Need --socket and/or --port" << Qt::endl;
+        return 2;
+    }
+
+    MockClamd mock(options);
+    if (parser.isSet(socketOption) && !mock.listenLocal(parser.value(socketOption))) {
+        err << "Cannot listen on " << parser.value(socketOption) << ": " << mock.errorString() << Qt::endl;
+        return 1;
+    }
+    if (parser.isSet(portOption) && !mock.listenTcp(quint16(parser.value(portOption).toUInt()))) {
+        err << "Cannot listen on port " << parser.value(portOption) << ": " << mock.errorString() << Qt::endl;
+        return 1;
+    }
+
+    for (const QString& endpoint : mock.endpoints()) {
+        out << "Listening on " << endpoint << Qt::endl;
+    }
+
+    std::signal(SIGINT, quitOnSignal);
+    std::signal(SIGTERM, quitOnSignal);
+    int result = app.exec();
+
+    MockClamd::Stats stats = mock.stats();
+    out << "Requests: " << stats.requests << ", bytes: " << stats.bytes
+        << ", detections: " << stats.detections << ", injected errors: " << stats.errorsInjected
+        << ", dropped: " << stats.connectionsDropped << Qt::endl;
+
+    return result;
+}
@@ -0,0 +1,150 @@
+// fastav_threat_bench - memory and time of a ThreatReport with an outbreak's
+// worth of detections. Builds the detections once per layout and prints one
+// JSON object:
+//   fastav_threat_bench --threats 1000000
+//   fastav_threat_bench --threats 1000000 --layout vector
+// "compact" is ThreatStore, "vector" the plain QVector<ThreatInfo> it
+// replaced. Run the layouts in separate processes: freed heap is not handed
+// back to the system, so the second one in a process would look smaller.
+
+#include "core/ThreatReport.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QTextStream>
+#include <QRandomGenerator>
+#include <unistd.h>
+
+namespace {
+
+// Resident set size of this process in KiB, -1 where /proc is missing
+qint64 currentRssKb() {
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+// An outbreak: one worm family with a few variants all over a home directory
+struct Detection {
+    QString path;
+    QString virusName;
+    quint64 size;
+};
+
+class OutbreakGenerator {
+public:
+    explicit OutbreakGenerator(quint64 seed) : m_random(quint32(seed)) {
+        for (int i = 0; i < 40; ++i) {
+            m_names.append(QString("Win.Worm.Outbreak-%1-0").arg(9000000 + i * 17));
+        }
+    }
+
+    Detection next(int index) {
+        Detection detection;
+        detection.path = QString("/home/user/shared/projects/p%1/src/module%2/build/obj%3/file%4.exe")
+            .arg(index / 20000, 3, 10, QChar('0'))
+            .arg(index / 400 % 50, 2, 10, QChar('0'))
+            .arg(index / 20 % 20, 2, 10, QChar('0'))
+            .arg(index, 7, 10, QChar('0'));
+        detection.virusName = m_names[m_random.bounded(int(m_names.size()))];
+        detection.size = 4096 + m_random.bounded(1 << 20);
+        return detection;
+    }
+
+private:
+    QRandomGenerator m_random;
+    QStringList m_names;
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fastav_threat_bench");
+    QCoreApplication::setApplicationVersion("1.0.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Memory use of a scan report with many detections");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption threatsOption("threats", "Number of detections.", "n", "1000000");
+    QCommandLineOption layoutOption("layout", "compact (ThreatStore) or vector (QVector<ThreatInfo>).",
+                                    "layout", "compact");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    parser.addOptions({threatsOption, layoutOption, seedOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    int count = parser.value(threatsOption).toInt();
+    QString layout = parser.value(layoutOption);
+    if (count <= 0 || (layout != "compact" && layout != "vector")) {
+        err << "Need --threats > 0 and --layout compact or vector" << Qt::endl;
+        return 2;
+    }
+
+    OutbreakGenerator generator(parser.value(seedOption).toULongLong());
+    QDateTime now = QDateTime::currentDateTime();
+    quint64 pathBytes = 0;
+    qint64 rssBefore = currentRssKb();
+
+    QElapsedTimer timer;
+    timer.start();
+    ThreatReport report;
+    QVector<ThreatInfo> vector;
+    for (int i = 0; i < count; ++i) {
+        Detection detection = generator.next(i);
+        pathBytes += quint64(detection.path.size());
+        if (layout == "compact") {
+            report.addThreat(detection.path, detection.virusName, detection.size, "27450", now);
+        } else {
+            ThreatInfo threat(detection.path, detection.virusName, detection.size, "27450");
+            threat.detectionTime = now;
+            vector.append(threat);
+        }
+    }
+    qint64 buildMs = timer.elapsed();
+    qint64 rssAfter = currentRssKb();
+
+    // What scanCompleted does to the report on its way to the GUI thread
+    timer.restart();
+    ThreatReport copy = report;
+    QVector<ThreatInfo> vectorCopy = vector;
+    qint64 copyUs = timer.nsecsElapsed() / 1000;
+
+    timer.restart();
+    quint64 checksum = 0;
+    if (layout == "compact") {
+        for (const ThreatInfo& threat : copy.getThreats()) {
+            checksum += threat.fileSize + quint64(threat.filePath.size());
+        }
+    } else {
+        for (const ThreatInfo& threat : vectorCopy) {
+            checksum += threat.fileSize + quint64(threat.filePath.size());
+        }
+    }
+    qint64 iterateMs = timer.elapsed();
+
+    QJsonObject root;
+    root["layout"] = layout;
+    root["threats"] = count;
+    root["average_path_chars"] = double(pathBytes) / count;
+    root["rss_delta_kb"] = rssBefore >= 0 && rssAfter >= 0 ? rssAfter - rssBefore : -1;
+    root["bytes_per_threat"] = rssBefore >= 0 && rssAfter >= 0 ? (rssAfter - rssBefore) * 1024.0 / count : -1.0;
+    if (layout == "compact") {
+        root["store_bytes"] = qint64(report.getThreats().memoryUsage());
+        root["interned_strings"] = report.getThreats().internedCount();
+    }
+    root["build_ms"] = buildMs;
+    root["copy_us"] = copyUs;
+    root["iterate_ms"] = iterateMs;
+    root["checksum"] = qint64(checksum);
+    out << QJsonDocument(root).toJson(QJsonDocument::Indented);
+    return 0;
+}
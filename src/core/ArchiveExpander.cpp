@@ -0,0 +1,149 @@
+#include "ArchiveExpander.h"
+#include "ScanPrefilter.h"
+#include <QFile>
+
+#ifdef FASTAV_WITH_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+
+namespace {
+
+const size_t READ_BLOCK = 1024 * 1024;
+
+typedef ArchiveExpander::Result Result;
+
+struct Walk {
+    const ArchiveExpander::Limits& limits;
+    const ArchiveExpander::Visitor& visit;
+    const CancellationToken* token;
+    QString* error;
+    quint64 expanded;
+};
+
+struct ArchiveHandle {
+    struct archive* archive;
+
+    ArchiveHandle() : archive(archive_read_new()) {
+        archive_read_support_filter_all(archive);
+        archive_read_support_format_all(archive);
+    }
+    ~ArchiveHandle() { archive_read_free(archive); }
+};
+
+bool isArchive(const QByteArray& data) {
+    int length = qMin(data.size(), ScanPrefilter::HeaderSize);
+    return ScanPrefilter::classify(reinterpret_cast<const unsigned char*>(data.constData()), length)
+        == FileClass::Archive;
+}
+
+Result readMembers(struct archive* archive, const QString& prefix, int depth, Walk& walk) {
+    struct archive_entry* entry;
+    while (true) {
+        if (walk.token && walk.token->isCancelled()) {
+            return Result::Cancelled;
+        }
+
+        int status = archive_read_next_header(archive, &entry);
+        if (status == ARCHIVE_EOF) {
+            return Result::Done;
+        }
+        if (status < ARCHIVE_WARN) {
+            *walk.error = QString::fromUtf8(archive_error_string(archive));
+            return Result::Failed;
+        }
+        if (archive_entry_filetype(entry) != AE_IFREG) {
+            continue;
+        }
+
+        const char* utf8 = archive_entry_pathname_utf8(entry);
+        QString name = prefix + (utf8 ? QString::fromUtf8(utf8)
+                                      : QString::fromLocal8Bit(archive_entry_pathname(entry)));
+        if (archive_entry_size_is_set(entry)
+            && quint64(archive_entry_size(entry)) > walk.limits.maxMemberSize) {
+            *walk.error = QString("%1 is larger than the member limit").arg(name);
+            return Result::LimitExceeded;
+        }
+
+        // The header size can be missing or wrong; the limits hold on what is actually read
+        QByteArray data;
+        if (archive_entry_size_is_set(entry)) {
+            data.reserve(int(archive_entry_size(entry)));
+        }
+        QByteArray block(int(READ_BLOCK), Qt::Uninitialized);
+        la_ssize_t length;
+        while ((length = archive_read_data(archive, block.data(), READ_BLOCK)) > 0) {
+            walk.expanded += quint64(length);
+            if (quint64(data.size()) + quint64(length) > walk.limits.maxMemberSize
+                || walk.expanded > walk.limits.maxTotalSize) {
+                *walk.error = QString("Expanding %1 went past the size limits").arg(name);
+                return Result::LimitExceeded;
+            }
+            if (walk.token && walk.token->isCancelled()) {
+                return Result::Cancelled;
+            }
+            data.append(block.constData(), int(length));
+        }
+        if (length < 0) {
+            *walk.error = QString("%1: %2").arg(name, QString::fromUtf8(archive_error_string(archive)));
+            return Result::Failed;
+        }
+
+        // A nested archive libarchive cannot read is still scanned as one member
+        if (depth < walk.limits.maxDepth && isArchive(data)) {
+            ArchiveHandle nested;
+            if (archive_read_open_memory(nested.archive, data.constData(), size_t(data.size())) == ARCHIVE_OK) {
+                QString nestedError;
+                QString* outerError = walk.error;
+                walk.error = &nestedError;
+                Result result = readMembers(nested.archive, name + '!', depth + 1, walk);
+                walk.error = outerError;
+                if (result != Result::Failed) {
+                    if (result != Result::Done) {
+                        *walk.error = nestedError;
+                        return result;
+                    }
+                    continue;
+                }
+            }
+        }
+
+        if (!walk.visit(name, data)) {
+            return Result::Stopped;
+        }
+    }
+}
+
+}
+#endif
+
+bool ArchiveExpander::isAvailable() {
+#ifdef FASTAV_WITH_LIBARCHIVE
+    return true;
+#else
+    return false;
+#endif
+}
+
+ArchiveExpander::Result ArchiveExpander::expand(const QString& path, const Limits& limits, const Visitor& visit,
+                                                const CancellationToken* token, QString* error) {
+    QString localError;
+    error = error ? error : &localError;
+
+#ifdef FASTAV_WITH_LIBARCHIVE
+    ArchiveHandle handle;
+    if (archive_read_open_filename(handle.archive, QFile::encodeName(path).constData(), READ_BLOCK) != ARCHIVE_OK) {
+        *error = QString::fromUtf8(archive_error_string(handle.archive));
+        return Result::Unsupported;
+    }
+
+    Walk walk = {limits, visit, token, error, 0};
+    return readMembers(handle.archive, QString(), 0, walk);
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(limits);
+    Q_UNUSED(visit);
+    Q_UNUSED(token);
+    *error = "FastAV was built without libarchive (FASTAV_WITH_LIBARCHIVE)";
+    return Result::Unsupported;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef ARCHIVEEXPANDER_H
+#define ARCHIVEEXPANDER_H
+
+#include <QString>
+#include <QByteArray>
+#include <functional>
+#include "CancellationToken.h"
+
+// Reads the members of an archive (zip, tar and its compressed variants, 7z,
+// rar, cpio, iso...) into memory one at a time with libarchive, nothing is
+// written to disk. Members that are archives themselves are expanded in turn
+// up to maxDepth; deeper ones are handed over whole, and clamd unpacks them.
+//
+// Without FASTAV_WITH_LIBARCHIVE this compiles to a stub that reports every
+// archive as unsupported.
+class ArchiveExpander {
+public:
+    struct Limits {
+        int maxDepth;           // levels of nested archives expanded below the file itself
+        quint64 maxMemberSize;  // a larger member stops the expansion
+        quint64 maxTotalSize;   // expanded bytes, against archive bombs
+
+        Limits() : maxDepth(2), maxMemberSize(0), maxTotalSize(0) {}
+    };
+
+    enum class Result {
+        Done,
+        Unsupported,    // not an archive libarchive reads, or built without it
+        LimitExceeded,
+        Failed,         // damaged, encrypted or unreadable
+        Cancelled,
+        Stopped         // the visitor returned false
+    };
+
+    // member is the path inside the archive, "a/b.zip!c.exe" for nested ones;
+    // return false to stop
+    typedef std::function<bool(const QString& member, const QByteArray& data)> Visitor;
+
+    static bool isAvailable();
+
+    static Result expand(const QString& path, const Limits& limits, const Visitor& visit,
+                         const CancellationToken* token, QString* error = nullptr);
+};
+
+#endif // ARCHIVEEXPANDER_H
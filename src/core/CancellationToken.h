@@ -0,0 +1,29 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QSharedPointer>
+#include <atomic>
+
+class CancellationToken;
+typedef QSharedPointer<CancellationToken> CancellationTokenPtr;
+
+// Shared flag polled by the walker, the queued tasks and the scan backends.
+// Cancelling never blocks; every holder is expected to notice within a poll interval.
+// A child token (e.g. a per-file deadline) is also cancelled when its parent is.
+class CancellationToken {
+public:
+    CancellationToken() : m_cancelled(false) {}
+    explicit CancellationToken(const CancellationTokenPtr& parent)
+        : m_cancelled(false), m_parent(parent) {}
+
+    void cancel() { m_cancelled.store(true, std::memory_order_release); }
+    bool isCancelled() const {
+        return m_cancelled.load(std::memory_order_acquire) || (m_parent && m_parent->isCancelled());
+    }
+
+private:
+    std::atomic<bool> m_cancelled;
+    CancellationTokenPtr m_parent;
+};
+
+#endif // CANCELLATIONTOKEN_H
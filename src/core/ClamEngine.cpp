@@ -0,0 +1,285 @@
+#include "ClamEngine.h"
+#include "ClamdConfig.h"
+#include <QFile>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#ifdef FASTAV_WITH_LIBCLAMAV
+#include <clamav.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <mutex>
+#endif
+
+struct ClamEngine::Engine {
+#ifdef FASTAV_WITH_LIBCLAMAV
+    struct cl_engine* engine;
+    struct cl_stat dbstat;
+    bool statValid;
+#endif
+    quint32 signatures;
+    quint32 databaseVersion;
+    QString databaseDirectory;
+
+    Engine()
+#ifdef FASTAV_WITH_LIBCLAMAV
+        : engine(nullptr)
+        , statValid(false)
+        , signatures(0)
+        , databaseVersion(0)
+#else
+        : signatures(0)
+        , databaseVersion(0)
+#endif
+    {
+#ifdef FASTAV_WITH_LIBCLAMAV
+        std::memset(&dbstat, 0, sizeof(dbstat));
+#endif
+    }
+
+    ~Engine() {
+#ifdef FASTAV_WITH_LIBCLAMAV
+        if (statValid) {
+            cl_statfree(&dbstat);
+        }
+        if (engine) {
+            cl_engine_free(engine);
+        }
+#endif
+    }
+};
+
+#ifdef FASTAV_WITH_LIBCLAMAV
+namespace {
+
+std::once_flag initOnce;
+cl_error_t initResult = CL_SUCCESS;
+
+// Called before every file and every embedded file; the context is the
+// scan's CancellationToken, so a cancelled scan or an expired deadline
+// stops libclamav at the next archive member instead of the end of the file
+cl_error_t preScanCallback(int fd, const char* type, void* context) {
+    Q_UNUSED(fd);
+    Q_UNUSED(type);
+    const CancellationToken* token = static_cast<const CancellationToken*>(context);
+    return token && token->isCancelled() ? CL_BREAK : CL_CLEAN;
+}
+
+}
+#endif
+
+ClamEngine::ClamEngine() {
+}
+
+ClamEngine& ClamEngine::instance() {
+    static ClamEngine engine;
+    return engine;
+}
+
+bool ClamEngine::isAvailable() {
+#ifdef FASTAV_WITH_LIBCLAMAV
+    return true;
+#else
+    return false;
+#endif
+}
+
+ClamEngine::EnginePtr ClamEngine::current() const {
+    QMutexLocker locker(&m_mutex);
+    return m_engine;
+}
+
+bool ClamEngine::isLoaded() const {
+    return !current().isNull();
+}
+
+quint32 ClamEngine::signatureCount() const {
+    EnginePtr engine = current();
+    return engine ? engine->signatures : 0;
+}
+
+QString ClamEngine::databaseDirectory() const {
+    EnginePtr engine = current();
+    return engine ? engine->databaseDirectory : QString();
+}
+
+QString ClamEngine::version() const {
+#ifdef FASTAV_WITH_LIBCLAMAV
+    return QString::fromLatin1(cl_retver());
+#else
+    return QString();
+#endif
+}
+
+QString ClamEngine::signatureVersion() const {
+    EnginePtr engine = current();
+    return engine && engine->databaseVersion > 0 ? QString::number(engine->databaseVersion) : QString();
+}
+
+ClamEngine::EnginePtr ClamEngine::build(QString* error) const {
+#ifdef FASTAV_WITH_LIBCLAMAV
+    std::call_once(initOnce, []() {
+        initResult = cl_init(CL_INIT_DEFAULT);
+    });
+    if (initResult != CL_SUCCESS) {
+        if (error) {
+            *error = QString("cl_init failed: %1").arg(cl_strerror(initResult));
+        }
+        return EnginePtr();
+    }
+
+    // Same database and limits as clamd, so both backends agree on verdicts
+    ClamdConfig config = ClamdConfig::load();
+    EnginePtr engine(new Engine);
+    engine->databaseDirectory = config.databaseDirectory.isEmpty()
+        ? QString::fromLocal8Bit(cl_retdbdir()) : config.databaseDirectory;
+    QByteArray directory = QFile::encodeName(engine->databaseDirectory);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    engine->engine = cl_engine_new();
+    if (!engine->engine) {
+        if (error) {
+            *error = "cl_engine_new failed";
+        }
+        return EnginePtr();
+    }
+
+    cl_engine_set_num(engine->engine, CL_ENGINE_MAX_FILESIZE, qint64(config.maxFileSize));
+    cl_engine_set_num(engine->engine, CL_ENGINE_MAX_SCANSIZE, qint64(config.maxScanSize));
+    cl_engine_set_clcb_pre_scan(engine->engine, preScanCallback);
+
+    // Stat before loading, so an update that lands mid-load triggers a reload
+    if (cl_statinidir(directory.constData(), &engine->dbstat) == CL_SUCCESS) {
+        engine->statValid = true;
+    }
+
+    unsigned int signatures = 0;
+    cl_error_t result = cl_load(directory.constData(), engine->engine, &signatures, CL_DB_STDOPT);
+    if (result == CL_SUCCESS) {
+        result = cl_engine_compile(engine->engine);
+    }
+    if (result != CL_SUCCESS) {
+        if (error) {
+            *error = QString("Cannot load signatures from %1: %2")
+                .arg(engine->databaseDirectory, cl_strerror(result));
+        }
+        return EnginePtr();
+    }
+    engine->signatures = signatures;
+    engine->databaseVersion = quint32(cl_engine_get_num(engine->engine, CL_ENGINE_DB_VERSION, nullptr));
+
+    qDebug() << "libclamav" << cl_retver() << "loaded" << signatures << "signatures from"
+             << engine->databaseDirectory << "in" << timer.elapsed() << "ms";
+    return engine;
+#else
+    if (error) {
+        *error = "FastAV was built without libclamav (FASTAV_WITH_LIBCLAMAV)";
+    }
+    return EnginePtr();
+#endif
+}
+
+bool ClamEngine::ensureLoaded(QString* error) {
+    QMutexLocker loadLocker(&m_loadMutex);
+    if (isLoaded()) {
+        return true;
+    }
+
+    EnginePtr engine = build(error);
+    if (!engine) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_engine = engine;
+    return true;
+}
+
+bool ClamEngine::reload(QString* error) {
+    QMutexLocker loadLocker(&m_loadMutex);
+
+    // The old engine keeps serving while the new one compiles
+    EnginePtr engine = build(error);
+    if (!engine) {
+        return false;
+    }
+
+    EnginePtr previous;
+    {
+        QMutexLocker locker(&m_mutex);
+        previous = m_engine;
+        m_engine = engine;
+    }
+    qDebug() << "libclamav engine reloaded," << engine->signatures << "signatures";
+    return true;
+}
+
+bool ClamEngine::reloadIfChanged(QString* error) {
+    EnginePtr engine = current();
+    if (!engine) {
+        return ensureLoaded(error);
+    }
+
+#ifdef FASTAV_WITH_LIBCLAMAV
+    bool changed = true;
+    {
+        QMutexLocker loadLocker(&m_loadMutex);
+        if (engine->statValid) {
+            changed = cl_statchkdir(&engine->dbstat) == 1;
+        }
+    }
+    if (!changed) {
+        return true;
+    }
+    return reload(error);
+#else
+    return true;
+#endif
+}
+
+QByteArray ClamEngine::scanFile(const QString& path, const CancellationToken* token) const {
+    QByteArray prefix = QFile::encodeName(path) + ": ";
+
+#ifdef FASTAV_WITH_LIBCLAMAV
+    EnginePtr engine = current();
+    if (!engine) {
+        return prefix + "Engine not loaded ERROR";
+    }
+
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return prefix + "Can't open file ERROR";
+    }
+
+    struct cl_scan_options options;
+    std::memset(&options, 0, sizeof(options));
+    options.parse = ~0u;
+    options.general = CL_SCAN_GENERAL_HEURISTICS;
+
+    const char* virusName = nullptr;
+    unsigned long scanned = 0;
+    cl_error_t result = cl_scandesc_callback(fd, QFile::encodeName(path).constData(), &virusName, &scanned,
+                                             engine->engine, &options,
+                                             const_cast<CancellationToken*>(token));
+    ::close(fd);
+
+    if (result == CL_VIRUS) {
+        return prefix + QByteArray(virusName ? virusName : "Unknown") + " FOUND";
+    }
+    // The callback aborts a cancelled scan with CL_BREAK, which libclamav may
+    // hand back as clean; a scan cut short has no verdict
+    if (token && token->isCancelled()) {
+        return prefix + "Cancelled ERROR";
+    }
+    if (result == CL_CLEAN || result == CL_BREAK) {
+        return prefix + "OK";
+    }
+    return prefix + cl_strerror(result) + " ERROR";
+#else
+    Q_UNUSED(token);
+    return prefix + "libclamav not available ERROR";
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef CLAMENGINE_H
+#define CLAMENGINE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
+#include "CancellationToken.h"
+
+// In-process libclamav, for scanning without a clamd round trip per file.
+// One compiled engine is shared by every worker thread (cl_scandesc is
+// thread-safe on a compiled engine). A reload compiles a new engine next to
+// the old one and swaps it in; scans already running finish on the engine
+// they started with, which is freed when the last of them returns.
+//
+// Without FASTAV_WITH_LIBCLAMAV this compiles to stubs that report the
+// engine as unavailable.
+class ClamEngine {
+public:
+    static ClamEngine& instance();
+    static bool isAvailable();
+
+    // Loads the signatures the first time; blocks for as long as that takes
+    bool ensureLoaded(QString* error = nullptr);
+    // Compiles a fresh engine from the database directory and swaps it in
+    bool reload(QString* error = nullptr);
+    // Reloads only if the database files changed since the last load
+    bool reloadIfChanged(QString* error = nullptr);
+
+    bool isLoaded() const;
+    quint32 signatureCount() const;
+    QString databaseDirectory() const;
+    QString version() const;
+    // Daily signature version of the loaded engine, like clamd's VERSION reports it
+    QString signatureVersion() const;
+
+    // The same reply clamd gives for SCAN: "<path>: <name> FOUND",
+    // "<path>: OK" or "<path>: <reason> ERROR"
+    QByteArray scanFile(const QString& path, const CancellationToken* token) const;
+
+private:
+    struct Engine;
+    typedef QSharedPointer<Engine> EnginePtr;
+
+    ClamEngine();
+    ClamEngine(const ClamEngine&) = delete;
+    ClamEngine& operator=(const ClamEngine&) = delete;
+
+    EnginePtr current() const;
+    EnginePtr build(QString* error) const;
+
+    mutable QMutex m_mutex;  // guards m_engine, held only to copy or swap it
+    QMutex m_loadMutex;      // one compile at a time, they need a lot of memory
+    EnginePtr m_engine;
+};
+
+#endif // CLAMENGINE_H
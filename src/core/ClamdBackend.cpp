@@ -0,0 +1,109 @@
+#include "ClamdBackend.h"
+#include "ClamdClient.h"
+#include <QFileInfo>
+#include <QBuffer>
+#include <QElapsedTimer>
+
+ClamdBackend::ClamdBackend(const QString& endpoint, Mode mode)
+    : m_endpoint(endpoint)
+    , m_mode(mode)
+    , m_streamMaxLength(0)
+{
+}
+
+QString ClamdBackend::name() const {
+    return m_mode == Mode::Stream ? "clamd-stream" : "clamd";
+}
+
+ScanBackend::Capabilities ClamdBackend::capabilities() const {
+    Capabilities capabilities;
+    capabilities.streaming = m_mode == Mode::Stream;
+    capabilities.needsDaemon = true;
+    capabilities.buffers = true;
+    return capabilities;
+}
+
+bool ClamdBackend::prepare(QString* error) {
+    ClamdConfig config = ClamdConfig::load();
+    if (m_endpoint.isEmpty()) {
+        m_endpoint = config.endpoint();
+    }
+    m_streamMaxLength = config.streamMaxLength;
+
+    // Endpoints that do not answer now are left out and retried during the scan
+    m_pool = ClamdPoolPtr(new ClamdPool(ClamdPool::split(m_endpoint)));
+    return m_pool->probeAll(error);
+}
+
+ScanReply ClamdBackend::dispatch(const std::function<QByteArray(ClamdClient&)>& request, quint64 bytes,
+                                 const CancellationToken* token) {
+    QVector<bool> tried(m_pool->size(), false);
+    QString lastError = "No clamd endpoint is available";
+    while (true) {
+        int index = m_pool->acquire(tried);
+        if (index < 0) {
+            ScanReply reply;
+            reply.error = lastError;
+            return reply;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        ClamdClient client(m_pool->endpoint(index));
+        QByteArray line = request(client);
+
+        // No reply and no cancellation: the daemon failed, not the file
+        bool reachable = !line.isEmpty() || (token && token->isCancelled());
+        m_pool->release(index, reachable, bytes, timer.nsecsElapsed() / 1000);
+        if (reachable) {
+            ScanReply reply = ScanReply::parse(line);
+            if (line.isEmpty()) {
+                reply.error = client.errorString();
+            }
+            return reply;
+        }
+
+        lastError = QString("clamd at %1: %2").arg(client.endpoint(), client.errorString());
+        tried[index] = true;
+    }
+}
+
+ScanReply ClamdBackend::scan(const QString& path, const CancellationToken* token) {
+    // clamd would only see the first StreamMaxLength bytes. SCAN by path is no
+    // way out: stream mode is for daemons that cannot see this filesystem.
+    quint64 size = quint64(QFileInfo(path).size());
+    bool stream = m_mode == Mode::Stream;
+    if (stream && m_streamMaxLength > 0 && size > m_streamMaxLength) {
+        return ScanReply::skipped(SkipReason::ExceedsMaxFileSize,
+                                  QString("larger than StreamMaxLength (%1 bytes)").arg(m_streamMaxLength));
+    }
+    ReadCount read;
+    ScanReply reply = dispatch([&](ClamdClient& client) {
+        if (!stream) {
+            return client.scanPath(path, token);
+        }
+        QByteArray line = client.scanStream(path, token);
+        read += client.streamRead();
+        return line;
+    }, size, token);
+    reply.read = read;
+    return reply;
+}
+
+ScanReply ClamdBackend::scanBuffer(const QByteArray& data, const CancellationToken* token) {
+    return dispatch([&](ClamdClient& client) {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        return client.scanStream(&buffer, token);
+    }, quint64(data.size()), token);
+}
+
+QString ClamdBackend::signatureVersion() {
+    QString endpoint = m_pool ? m_pool->primaryEndpoint() : ClamdPool::split(m_endpoint).value(0);
+    return ClamdClient::signatureVersion(ClamdClient(endpoint).version());
+}
+
+QVector<EndpointStats> ClamdBackend::endpointStats() const {
+    return m_pool && m_pool->size() > 1 ? m_pool->stats() : QVector<EndpointStats>();
+}
@@ -0,0 +1,47 @@
+#ifndef CLAMDBACKEND_H
+#define CLAMDBACKEND_H
+
+#include "ScanBackend.h"
+#include "ClamdConfig.h"
+#include "ClamdPool.h"
+#include <functional>
+
+class ClamdClient;
+
+// Talks to clamd over its socket, one connection per file. Path mode sends
+// SCAN and lets clamd open the file; Stream mode sends the contents with
+// INSTREAM, for a clamd that cannot see our files (containers, remote TCP).
+// With several endpoints each request goes to the least busy daemon.
+class ClamdBackend : public ScanBackend {
+public:
+    enum class Mode {
+        Path,
+        Stream
+    };
+
+    // An empty endpoint means the socket from clamd.conf; a comma separated
+    // list balances over all of them
+    ClamdBackend(const QString& endpoint, Mode mode);
+
+    QString name() const override;
+    Capabilities capabilities() const override;
+    bool prepare(QString* error) override;
+    ScanReply scan(const QString& path, const CancellationToken* token) override;
+    ScanReply scanBuffer(const QByteArray& data, const CancellationToken* token) override;
+    QString signatureVersion() override;
+    QVector<EndpointStats> endpointStats() const override;
+
+    QString endpoint() const { return m_endpoint; }
+
+private:
+    // Sends the request to one endpoint after another until one answers
+    ScanReply dispatch(const std::function<QByteArray(ClamdClient&)>& request, quint64 bytes,
+                       const CancellationToken* token);
+
+    QString m_endpoint;
+    Mode m_mode;
+    quint64 m_streamMaxLength;  // 0 = unlimited
+    ClamdPoolPtr m_pool;        // set up by prepare()
+};
+
+#endif // CLAMDBACKEND_H
@@ -0,0 +1,238 @@
+#include "ClamdClient.h"
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+// Granularity of blocking waits, so cancellation is noticed promptly
+const int POLL_MS = 50;
+const int CONNECT_TIMEOUT_MS = 5000;
+// INSTREAM chunk payload; clamd's default StreamMaxLength is a multiple of it
+const int STREAM_CHUNK_SIZE = 64 * 1024;
+}
+
+ClamdClient::ClamdClient(const QString& endpoint)
+    : m_endpoint(endpoint)
+    , m_localSocket(nullptr)
+    , m_tcpSocket(nullptr)
+    , m_device(nullptr)
+{
+}
+
+ClamdClient::~ClamdClient() {
+    close();
+}
+
+bool ClamdClient::open(int timeoutMs) {
+    close();
+
+    if (m_endpoint.startsWith("tcp:")) {
+        QString hostPort = m_endpoint.mid(4);
+        int colon = hostPort.lastIndexOf(':');
+        QString host = hostPort.left(colon);
+        quint16 port = quint16(hostPort.mid(colon + 1).toUInt());
+
+        m_tcpSocket = new QTcpSocket();
+        m_tcpSocket->connectToHost(host, port);
+        if (!m_tcpSocket->waitForConnected(timeoutMs)) {
+            m_error = m_tcpSocket->errorString();
+            close();
+            return false;
+        }
+        m_device = m_tcpSocket;
+    } else {
+        QString path = m_endpoint.startsWith("unix:") ? m_endpoint.mid(5) : m_endpoint;
+
+        m_localSocket = new QLocalSocket();
+        m_localSocket->connectToServer(path);
+        if (!m_localSocket->waitForConnected(timeoutMs)) {
+            m_error = m_localSocket->errorString();
+            close();
+            return false;
+        }
+        m_device = m_localSocket;
+    }
+
+    return true;
+}
+
+void ClamdClient::close() {
+    delete m_localSocket;
+    delete m_tcpSocket;
+    m_localSocket = nullptr;
+    m_tcpSocket = nullptr;
+    m_device = nullptr;
+}
+
+bool ClamdClient::isOpen() const {
+    return m_device != nullptr;
+}
+
+bool ClamdClient::writeAll(const QByteArray& data, int timeoutMs, const CancellationToken* token) {
+    if (m_device->write(data) != data.size()) {
+        m_error = m_device->errorString();
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (m_device->bytesToWrite() > 0) {
+        bool flushed = m_tcpSocket ? m_tcpSocket->waitForBytesWritten(POLL_MS)
+                                   : m_localSocket->waitForBytesWritten(POLL_MS);
+        if (token && token->isCancelled()) {
+            m_error = "Cancelled";
+            return false;
+        }
+        if (!flushed && timeoutMs >= 0 && timer.elapsed() > timeoutMs) {
+            m_error = "Timed out writing to clamd";
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray ClamdClient::readReply(int timeoutMs, const CancellationToken* token) {
+    QByteArray reply;
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true) {
+        reply += m_device->readAll();
+        int end = reply.indexOf('\0');
+        if (end >= 0) {
+            reply.truncate(end);
+            return reply;
+        }
+
+        if (token && token->isCancelled()) {
+            m_error = "Cancelled";
+            return QByteArray();
+        }
+        if (timeoutMs >= 0 && timer.elapsed() > timeoutMs) {
+            m_error = "Timed out waiting for clamd";
+            return QByteArray();
+        }
+
+        bool readable = m_tcpSocket ? m_tcpSocket->waitForReadyRead(POLL_MS)
+                                    : m_localSocket->waitForReadyRead(POLL_MS);
+        if (!readable) {
+            bool connected = m_tcpSocket ? m_tcpSocket->state() == QAbstractSocket::ConnectedState
+                                         : m_localSocket->state() == QLocalSocket::ConnectedState;
+            if (!connected) {
+                // clamd closes the connection right after a single reply
+                reply += m_device->readAll();
+                end = reply.indexOf('\0');
+                if (end >= 0) {
+                    reply.truncate(end);
+                }
+                if (!reply.isEmpty()) {
+                    return reply;
+                }
+                m_error = "clamd closed the connection";
+                return QByteArray();
+            }
+        }
+    }
+}
+
+QByteArray ClamdClient::command(const QByteArray& command, int timeoutMs, const CancellationToken* token) {
+    if (!m_device && !open(timeoutMs >= 0 ? timeoutMs : CONNECT_TIMEOUT_MS)) {
+        return QByteArray();
+    }
+
+    // Without IDSESSION clamd answers one command per connection
+    QByteArray request = "z" + command + '\0';
+    QByteArray reply;
+    if (writeAll(request, timeoutMs)) {
+        reply = readReply(timeoutMs, token);
+    }
+    close();
+
+    return reply;
+}
+
+QByteArray ClamdClient::scanPath(const QString& path, const CancellationToken* token) {
+    return command("SCAN " + QFile::encodeName(path), -1, token);
+}
+
+QByteArray ClamdClient::scanStream(const QString& path, const CancellationToken* token) {
+    m_streamRead = ReadCount();
+    SparseFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = file.errorString();
+        return QByteArray();
+    }
+    QByteArray reply = scanStream(&file, token);
+    m_streamRead = file.readCount();
+    return reply;
+}
+
+QByteArray ClamdClient::scanStream(QIODevice* device, const CancellationToken* token) {
+    if (!m_device && !open(CONNECT_TIMEOUT_MS)) {
+        return QByteArray();
+    }
+
+    bool sent = writeAll(QByteArray("zINSTREAM", 10), -1, token);
+
+    // Each chunk is a 4-byte big-endian length and the data; length 0 ends the stream
+    QByteArray chunk(STREAM_CHUNK_SIZE + 4, Qt::Uninitialized);
+    while (sent) {
+        qint64 length = device->read(chunk.data() + 4, STREAM_CHUNK_SIZE);
+        if (length < 0) {
+            m_error = device->errorString();
+            sent = false;
+            break;
+        }
+
+        quint32 header = qToBigEndian(quint32(length));
+        std::memcpy(chunk.data(), &header, sizeof(header));
+        sent = writeAll(QByteArray::fromRawData(chunk.constData(), int(length) + 4), -1, token);
+        if (length == 0) {
+            break;
+        }
+    }
+
+    // Past StreamMaxLength clamd answers and hangs up mid-stream; keep that answer
+    QByteArray reply;
+    if (!token || !token->isCancelled()) {
+        reply = readReply(sent ? -1 : POLL_MS, token);
+    }
+    close();
+
+    return reply;
+}
+
+bool ClamdClient::ping(int timeoutMs) {
+    return command("PING", timeoutMs) == "PONG";
+}
+
+QString ClamdClient::version(int timeoutMs) {
+    return QString::fromUtf8(command("VERSION", timeoutMs)).trimmed();
+}
+
+QString ClamdClient::signatureVersion(const QString& versionReply) {
+    return versionReply.section('/', 1, 1).trimmed();
+}
+
+bool ClamdClient::versionCommands(QString* version, QStringList* commands, int timeoutMs) {
+    QString reply = QString::fromUtf8(command("VERSIONCOMMANDS", timeoutMs)).trimmed();
+    int separator = reply.indexOf("| COMMANDS:");
+    if (separator < 0) {
+        if (m_error.isEmpty()) {
+            m_error = "Unexpected VERSIONCOMMANDS reply: " + reply;
+        }
+        return false;
+    }
+
+    if (version) {
+        *version = reply.left(separator).trimmed();
+    }
+    if (commands) {
+        *commands = reply.mid(separator + 11).split(' ', Qt::SkipEmptyParts);
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef CLAMDCLIENT_H
+#define CLAMDCLIENT_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include "CancellationToken.h"
+#include "SparseFile.h"
+
+class QIODevice;
+class QLocalSocket;
+class QTcpSocket;
+
+// Blocking client for clamd's socket protocol ("z" commands, NUL terminated
+// replies). Meant to be used from worker threads without an event loop.
+// Endpoints are "unix:/path/to/socket" or "tcp:host:port".
+class ClamdClient {
+public:
+    explicit ClamdClient(const QString& endpoint);
+    ~ClamdClient();
+
+    bool open(int timeoutMs = 2000);
+    void close();
+    bool isOpen() const;
+
+    // Sends one command and returns clamd's reply without the terminator, or
+    // an empty array on error, timeout or cancellation. timeoutMs < 0 waits
+    // until the reply or the token fires.
+    QByteArray command(const QByteArray& command, int timeoutMs, const CancellationToken* token = nullptr);
+
+    // "SCAN <path>": clamd opens the file itself, so it needs read access
+    QByteArray scanPath(const QString& path, const CancellationToken* token);
+    // "INSTREAM": the file is read here and sent in chunks, so clamd needs no
+    // access to it, but it stops reading at StreamMaxLength. Holes of a sparse
+    // file are sent as zeros without being read (see SparseFile).
+    QByteArray scanStream(const QString& path, const CancellationToken* token);
+    // INSTREAM from an open device, e.g. an archive member held in memory
+    QByteArray scanStream(QIODevice* device, const CancellationToken* token);
+
+    bool ping(int timeoutMs = 2000);
+    QString version(int timeoutMs = 2000);
+    // The signature database version in a VERSION reply: "ClamAV 1.2.1/27101/..." -> "27101"
+    static QString signatureVersion(const QString& versionReply);
+    // "ClamAV 1.2.1/27101/...| COMMANDS: SCAN QUIT RELOAD ..." split into both parts
+    bool versionCommands(QString* version, QStringList* commands, int timeoutMs = 2000);
+
+    QString endpoint() const { return m_endpoint; }
+    QString errorString() const { return m_error; }
+    // What the last scanStream(path) read of the file
+    ReadCount streamRead() const { return m_streamRead; }
+
+private:
+    bool writeAll(const QByteArray& data, int timeoutMs, const CancellationToken* token = nullptr);
+    QByteArray readReply(int timeoutMs, const CancellationToken* token);
+
+    QString m_endpoint;
+    QLocalSocket* m_localSocket;
+    QTcpSocket* m_tcpSocket;
+    QIODevice* m_device;
+    QString m_error;
+    ReadCount m_streamRead;
+};
+
+#endif // CLAMDCLIENT_H
@@ -0,0 +1,139 @@
+#include "ClamdConfig.h"
+#include <QFile>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QDebug>
+
+ClamdConfig::ClamdConfig()
+    : tcpPort(0)
+    // clamd's own defaults when the options are not set
+    , maxFileSize(100ULL * 1024 * 1024)
+    , maxScanSize(400ULL * 1024 * 1024)
+    , streamMaxLength(100ULL * 1024 * 1024)
+    , alertExceedsMax(false)
+{
+}
+
+QStringList ClamdConfig::defaultConfigPaths() {
+    return QStringList()
+        << "/etc/clamav/clamd.conf"      // Debian, Ubuntu, Arch
+        << "/etc/clamd.d/scan.conf"      // Fedora, RHEL
+        << "/etc/clamd.conf"
+        << "/usr/local/etc/clamd.conf"
+        << "/opt/homebrew/etc/clamav/clamd.conf";
+}
+
+quint64 ClamdConfig::parseSize(const QString& value, bool* ok) {
+    QString number = value.trimmed();
+    quint64 multiplier = 1;
+
+    if (number.endsWith('K', Qt::CaseInsensitive)) {
+        multiplier = 1024;
+        number.chop(1);
+    } else if (number.endsWith('M', Qt::CaseInsensitive)) {
+        multiplier = 1024 * 1024;
+        number.chop(1);
+    } else if (number.endsWith('G', Qt::CaseInsensitive)) {
+        multiplier = 1024ULL * 1024 * 1024;
+        number.chop(1);
+    }
+
+    return number.toULongLong(ok) * multiplier;
+}
+
+ClamdConfig ClamdConfig::load(const QString& path) {
+    ClamdConfig config;
+
+    QStringList candidates = path.isEmpty() ? defaultConfigPaths() : QStringList(path);
+    QFile file;
+    for (const QString& candidate : candidates) {
+        file.setFileName(candidate);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            config.configPath = candidate;
+            break;
+        }
+    }
+
+    if (config.configPath.isEmpty()) {
+        qDebug() << "No readable clamd.conf, using clamd defaults";
+        return config;
+    }
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QString key = line.section(QRegularExpression("\\s+"), 0, 0);
+        QString value = line.section(QRegularExpression("\\s+"), 1).trimmed();
+        bool ok = true;
+
+        if (key == "LocalSocket") {
+            config.localSocket = value;
+        } else if (key == "TCPSocket") {
+            config.tcpPort = value.toInt(&ok);
+        } else if (key == "TCPAddr") {
+            config.tcpAddr = value;
+        } else if (key == "DatabaseDirectory") {
+            config.databaseDirectory = value;
+        } else if (key == "MaxFileSize") {
+            config.maxFileSize = parseSize(value, &ok);
+        } else if (key == "MaxScanSize") {
+            config.maxScanSize = parseSize(value, &ok);
+        } else if (key == "StreamMaxLength") {
+            config.streamMaxLength = parseSize(value, &ok);
+        } else if (key == "AlertExceedsMax") {
+            config.alertExceedsMax = value.compare("yes", Qt::CaseInsensitive) == 0
+                                  || value.compare("true", Qt::CaseInsensitive) == 0;
+        }
+
+        if (!ok) {
+            qWarning() << "Ignoring malformed clamd option:" << line;
+        }
+    }
+
+    return config;
+}
+
+QString ClamdConfig::endpoint() const {
+    if (!localSocket.isEmpty()) {
+        return "unix:" + localSocket;
+    }
+    if (tcpPort > 0) {
+        return QString("tcp:%1:%2").arg(tcpAddr.isEmpty() ? QString("127.0.0.1") : tcpAddr).arg(tcpPort);
+    }
+#ifdef Q_OS_WIN
+    return "tcp:127.0.0.1:3310";
+#else
+    return "unix:/var/run/clamav/clamd.ctl";
+#endif
+}
+
+QString ClamdConfig::installedSignatureVersion() const {
+    // "ClamAV-VDB:<build time>:<version>:<signatures>:..." in the first 512 bytes
+    quint64 newest = 0;
+    for (const QString& name : QStringList() << "daily.cld" << "daily.cvd") {
+        QFile file(databasePath() + '/' + name);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QByteArray header = file.read(512);
+        if (header.startsWith("ClamAV-VDB:")) {
+            newest = qMax(newest, header.split(':').value(2).toULongLong());
+        }
+    }
+    return newest > 0 ? QString::number(newest) : QString();
+}
+
+QString ClamdConfig::databasePath() const {
+    if (!databaseDirectory.isEmpty()) {
+        return databaseDirectory;
+    }
+#ifdef Q_OS_WIN
+    return "C:/Program Files/ClamAV/database";
+#else
+    return "/var/lib/clamav";
+#endif
+}
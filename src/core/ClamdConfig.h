@@ -0,0 +1,35 @@
+#ifndef CLAMDCONFIG_H
+#define CLAMDCONFIG_H
+
+#include <QString>
+#include <QStringList>
+
+// The subset of clamd.conf FastAV cares about: where clamd listens and the
+// limits beyond which it stops producing a verdict for a file.
+struct ClamdConfig {
+    QString configPath;     // file the values were read from, empty if defaults
+    QString localSocket;
+    QString tcpAddr;
+    int tcpPort;
+    QString databaseDirectory;  // empty = libclamav's compiled-in default
+
+    quint64 maxFileSize;     // 0 = unlimited
+    quint64 maxScanSize;
+    quint64 streamMaxLength;
+    bool alertExceedsMax;    // report Heuristics.Limits.Exceeded instead of OK
+
+    ClamdConfig();
+
+    static ClamdConfig load(const QString& path = QString());
+    static QStringList defaultConfigPaths();
+    static quint64 parseSize(const QString& value, bool* ok = nullptr);
+
+    // "unix:/path" or "tcp:host:port", whichever clamd listens on
+    QString endpoint() const;
+    // DatabaseDirectory, or where freshclam puts the signatures by default
+    QString databasePath() const;
+    // Version of the daily signatures on disk, from the .cld/.cvd header; empty if none
+    QString installedSignatureVersion() const;
+};
+
+#endif // CLAMDCONFIG_H
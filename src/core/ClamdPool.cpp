@@ -0,0 +1,157 @@
+#include "ClamdPool.h"
+#include "ClamdClient.h"
+#include <QDateTime>
+#include <QDebug>
+#include <climits>
+
+namespace {
+
+const int PROBE_TIMEOUT_MS = 1000;
+// An endpoint out of the rotation is pinged this often
+const qint64 RETRY_INTERVAL_MS = 5000;
+// Failed connections in a row before an endpoint is taken out; one dropped
+// connection under load is not enough
+const int MAX_CONSECUTIVE_FAILURES = 3;
+
+}
+
+ClamdPool::ClamdPool(const QStringList& endpoints)
+    : m_rotation(0)
+{
+    for (const QString& endpoint : endpoints) {
+        m_members.append(QSharedPointer<Member>(new Member(endpoint)));
+    }
+}
+
+QStringList ClamdPool::split(const QString& endpoints) {
+    QStringList result;
+    for (const QString& endpoint : endpoints.split(',', Qt::SkipEmptyParts)) {
+        QString trimmed = endpoint.trimmed();
+        if (!trimmed.isEmpty() && !result.contains(trimmed)) {
+            result.append(trimmed);
+        }
+    }
+    return result;
+}
+
+bool ClamdPool::probeAll(QString* error) {
+    QStringList silent;
+    int healthy = 0;
+    for (const QSharedPointer<Member>& member : m_members) {
+        ClamdClient client(member->endpoint);
+        if (client.ping(PROBE_TIMEOUT_MS)) {
+            member->healthy = true;
+            member->consecutiveFailures = 0;
+            healthy++;
+        } else {
+            silent.append(QString("%1 (%2)").arg(member->endpoint, client.errorString()));
+            remove(*member);
+        }
+    }
+
+    if (healthy == 0 && error) {
+        *error = "No clamd endpoint answers: " + silent.join(", ");
+    } else if (!silent.isEmpty()) {
+        qWarning() << "clamd endpoints left out until they answer:" << silent.join(", ");
+    }
+    return healthy > 0;
+}
+
+void ClamdPool::remove(Member& member) {
+    member.retryAtMs = QDateTime::currentMSecsSinceEpoch() + RETRY_INTERVAL_MS;
+    if (member.healthy.exchange(false)) {
+        member.removals++;
+        qWarning() << "clamd at" << member.endpoint << "taken out of the rotation";
+    }
+}
+
+void ClamdPool::probeDue() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const QSharedPointer<Member>& member : m_members) {
+        if (member->healthy.load() || now < member->retryAtMs.load()) {
+            continue;
+        }
+        // One worker probes, the others carry on with the endpoints that work
+        bool expected = false;
+        if (!member->probing.compare_exchange_strong(expected, true)) {
+            continue;
+        }
+        if (ClamdClient(member->endpoint).ping(PROBE_TIMEOUT_MS)) {
+            member->consecutiveFailures = 0;
+            member->healthy = true;
+            qDebug() << "clamd at" << member->endpoint << "rejoined the rotation";
+        } else {
+            member->retryAtMs = QDateTime::currentMSecsSinceEpoch() + RETRY_INTERVAL_MS;
+        }
+        member->probing = false;
+    }
+}
+
+int ClamdPool::acquire(const QVector<bool>& tried) {
+    probeDue();
+
+    int count = m_members.size();
+    int start = count > 0 ? int(m_rotation++ % quint32(count)) : 0;
+    int best = -1;
+    int bestLoad = INT_MAX;
+    for (int offset = 0; offset < count; ++offset) {
+        int index = (start + offset) % count;
+        const Member& member = *m_members[index];
+        if (tried.value(index) || !member.healthy.load()) {
+            continue;
+        }
+        int load = member.outstanding.load();
+        if (load < bestLoad) {
+            best = index;
+            bestLoad = load;
+        }
+    }
+
+    if (best >= 0) {
+        m_members[best]->outstanding++;
+    }
+    return best;
+}
+
+void ClamdPool::release(int index, bool reachable, quint64 bytes, qint64 elapsedUs) {
+    Member& member = *m_members[index];
+    member.outstanding--;
+
+    if (reachable) {
+        member.consecutiveFailures = 0;
+        member.files++;
+        member.bytes += bytes;
+        member.busyUs += quint64(qMax(qint64(0), elapsedUs));
+        return;
+    }
+
+    member.failures++;
+    if (++member.consecutiveFailures >= MAX_CONSECUTIVE_FAILURES) {
+        remove(member);
+    }
+}
+
+QString ClamdPool::primaryEndpoint() const {
+    for (const QSharedPointer<Member>& member : m_members) {
+        if (member->healthy.load()) {
+            return member->endpoint;
+        }
+    }
+    return m_members.isEmpty() ? QString() : m_members.first()->endpoint;
+}
+
+QVector<EndpointStats> ClamdPool::stats() const {
+    QVector<EndpointStats> result;
+    for (const QSharedPointer<Member>& member : m_members) {
+        EndpointStats stats;
+        stats.endpoint = member->endpoint;
+        stats.files = member->files.load();
+        stats.bytes = member->bytes.load();
+        stats.failures = member->failures.load();
+        stats.busyUs = member->busyUs.load();
+        stats.removals = member->removals.load();
+        stats.healthy = member->healthy.load();
+        result.append(stats);
+    }
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef CLAMDPOOL_H
+#define CLAMDPOOL_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+#include <atomic>
+#include "ThreatReport.h"
+
+// Spreads clamd requests over several daemons, local sockets or scan nodes
+// over TCP, by least outstanding requests. An endpoint whose connections
+// keep failing is taken out of the rotation and probed with PING until it
+// answers again; the failed request is retried on another endpoint.
+// acquire() and release() are safe to call from any number of threads.
+class ClamdPool {
+public:
+    explicit ClamdPool(const QStringList& endpoints);
+
+    // "unix:/a.sock,tcp:node2:3310" -> both endpoints
+    static QStringList split(const QString& endpoints);
+
+    int size() const { return m_members.size(); }
+    QString endpoint(int index) const { return m_members[index]->endpoint; }
+
+    // PINGs every endpoint and takes out the silent ones; false if none answered
+    bool probeAll(QString* error = nullptr);
+
+    // Least loaded healthy endpoint whose index is not set in tried, counted
+    // as outstanding until release(); -1 if there is none
+    int acquire(const QVector<bool>& tried = QVector<bool>());
+    // reachable is false when the connection failed or dropped, whatever the file
+    void release(int index, bool reachable, quint64 bytes, qint64 elapsedUs);
+
+    // First endpoint currently in the rotation, for VERSION and the like
+    QString primaryEndpoint() const;
+    QVector<EndpointStats> stats() const;
+
+private:
+    struct Member {
+        QString endpoint;
+        std::atomic<int> outstanding;
+        std::atomic<bool> healthy;
+        std::atomic<bool> probing;
+        std::atomic<int> consecutiveFailures;
+        std::atomic<qint64> retryAtMs;   // next PING while out of the rotation
+        std::atomic<quint64> files;
+        std::atomic<quint64> bytes;
+        std::atomic<quint64> failures;
+        std::atomic<quint64> busyUs;
+        std::atomic<int> removals;
+
+        explicit Member(const QString& name)
+            : endpoint(name), outstanding(0), healthy(true), probing(false), consecutiveFailures(0)
+            , retryAtMs(0), files(0), bytes(0), failures(0), busyUs(0), removals(0) {}
+    };
+
+    void remove(Member& member);
+    void probeDue();
+
+    QVector<QSharedPointer<Member>> m_members;
+    std::atomic<quint32> m_rotation;  // breaks ties between equally loaded endpoints
+};
+
+typedef QSharedPointer<ClamdPool> ClamdPoolPtr;
+
+#endif // CLAMDPOOL_H
@@ -0,0 +1,76 @@
+#include "ClamdscanBackend.h"
+#include "ClamdClient.h"
+#include "ClamdConfig.h"
+#include <QProcess>
+#include <QBuffer>
+
+namespace {
+// How often a running clamdscan checks the token
+const int POLL_MS = 50;
+}
+
+ClamdscanBackend::ClamdscanBackend() {
+}
+
+ScanBackend::Capabilities ClamdscanBackend::capabilities() const {
+    Capabilities capabilities;
+    capabilities.fdPassing = true;
+    capabilities.needsDaemon = true;
+    capabilities.buffers = true;
+    return capabilities;
+}
+
+bool ClamdscanBackend::prepare(QString* error) {
+    Q_UNUSED(error);
+    m_endpoint = ClamdConfig::load().endpoint();
+    return true;
+}
+
+ScanReply ClamdscanBackend::scan(const QString& path, const CancellationToken* token) {
+    QProcess process;
+    process.start("clamdscan", QStringList() << "--fdpass" << "--no-summary" << path);
+
+    // Wait in short slices so a cancelled scan or an expired deadline kills the child
+    while (!process.waitForFinished(POLL_MS)) {
+        if (process.state() == QProcess::NotRunning) {
+            break;
+        }
+        if (token->isCancelled()) {
+            process.kill();
+            process.waitForFinished(POLL_MS);
+            ScanReply reply;
+            reply.error = "Cancelled";
+            return reply;
+        }
+    }
+
+    // The verdict is the last line; warnings may come before it
+    QList<QByteArray> lines = process.readAllStandardOutput().trimmed().split('\n');
+    ScanReply reply = ScanReply::parse(lines.last());
+    if (reply.status == ScanReply::Error && lines.last().trimmed().isEmpty()) {
+        reply.error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+        if (reply.error.isEmpty()) {
+            reply.error = process.errorString();
+        }
+    }
+    return reply;
+}
+
+ScanReply ClamdscanBackend::scanBuffer(const QByteArray& data, const CancellationToken* token) {
+    ClamdClient client(m_endpoint);
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QByteArray line = client.scanStream(&buffer, token);
+
+    ScanReply reply = ScanReply::parse(line);
+    if (line.isEmpty()) {
+        reply.error = client.errorString();
+    }
+    return reply;
+}
+
+QString ClamdscanBackend::signatureVersion() {
+    // clamdscan talks to the clamd named in clamd.conf
+    return ClamdClient::signatureVersion(ClamdClient(ClamdConfig::load().endpoint()).version());
+}
@@ -0,0 +1,24 @@
+#ifndef CLAMDSCANBACKEND_H
+#define CLAMDSCANBACKEND_H
+
+#include "ScanBackend.h"
+
+// Runs "clamdscan --fdpass" per file: works wherever clamdscan does, at the
+// cost of a process start per file. Buffers go straight to the clamd socket
+// from clamd.conf, since clamdscan only takes files.
+class ClamdscanBackend : public ScanBackend {
+public:
+    ClamdscanBackend();
+
+    QString name() const override { return "clamdscan"; }
+    Capabilities capabilities() const override;
+    bool prepare(QString* error) override;
+    ScanReply scan(const QString& path, const CancellationToken* token) override;
+    ScanReply scanBuffer(const QByteArray& data, const CancellationToken* token) override;
+    QString signatureVersion() override;
+
+private:
+    QString m_endpoint;  // from clamd.conf, for scanBuffer()
+};
+
+#endif // CLAMDSCANBACKEND_H
@@ -3,20 +3,35 @@
 #include <QSqlError>
 #include <QStandardPaths>
 #include <QDir>
+#include <QFileInfo>
 #include <QDebug>
 #include <QVariant>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
 
 Database::Database(QObject* parent)
     : QObject(parent)
 {
-    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(dataPath);
-    m_dbPath = dataPath + "/fastav.db";
+    m_dbPath = defaultPath();
+    QDir().mkpath(QFileInfo(m_dbPath).absolutePath());
     
     static int counter = 0;
     m_connectionName = QString("fastav_db_%1").arg(counter++);
 }
 
+Database::Database(const QString& path, QObject* parent)
+    : QObject(parent)
+    , m_dbPath(path)
+{
+    static int counter = 0;
+    m_connectionName = QString("fastav_db_path_%1").arg(counter++);
+}
+
+QString Database::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/fastav.db";
+}
+
 Database::~Database() {
     if (m_db.isOpen()) {
         // Close all active queries
@@ -40,7 +55,17 @@ bool Database::initialize() {
     
     qDebug() << "Database opened:" << m_dbPath;
     
-    return createTables();
+    if (!createTables()) {
+        return false;
+    }
+    
+    // Any scan still marked as running was interrupted by a crash or reboot
+    QSqlQuery query(m_db);
+    if (!query.exec("UPDATE scan_history SET status = 'interrupted' WHERE status = 'running'")) {
+        logError("initialize - interrupted scans", query.lastError().text());
+    }
+    
+    return true;
 }
 
 bool Database::createTables() {
@@ -82,6 +107,66 @@ bool Database::createTables() {
         return false;
     }
     
+    // Columns added after the first release
+    if (!ensureColumn("scan_history", "status", "TEXT DEFAULT 'completed'") ||
+        !ensureColumn("scan_history", "scan_targets", "TEXT DEFAULT ''") ||
+        !ensureColumn("scan_history", "files_timed_out", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "files_failed", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "dirs_pruned", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "files_pruned", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "files_skipped", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "skip_reasons", "TEXT DEFAULT ''") ||
+        !ensureColumn("scan_history", "stage_latency", "TEXT DEFAULT ''") ||
+        !ensureColumn("scan_history", "signature_versions", "TEXT DEFAULT ''") ||
+        !ensureColumn("scan_history", "files_total", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "endpoint_stats", "TEXT DEFAULT ''") ||
+        !ensureColumn("scan_history", "first_detection_ms", "INTEGER DEFAULT -1") ||
+        !ensureColumn("scan_history", "bytes_read", "INTEGER DEFAULT 0") ||
+        !ensureColumn("scan_history", "hole_bytes", "INTEGER DEFAULT 0") ||
+        !ensureColumn("threats", "signature_version", "TEXT DEFAULT ''")) {
+        return false;
+    }
+    
+    // Files already scanned by a scan that has not completed yet
+    QString createCheckpoints = R"(
+        CREATE TABLE IF NOT EXISTS scan_checkpoint_files (
+            scan_id INTEGER NOT NULL,
+            file_path TEXT NOT NULL,
+            PRIMARY KEY (scan_id, file_path),
+            FOREIGN KEY (scan_id) REFERENCES scan_history(id) ON DELETE CASCADE
+        ) WITHOUT ROWID
+    )";
+    
+    if (!query.exec(createCheckpoints)) {
+        logError("createTables - scan_checkpoint_files", query.lastError().text());
+        return false;
+    }
+    
+    // Signature version of each file's last clean verdict
+    QString createVerdicts = R"(
+        CREATE TABLE IF NOT EXISTS file_verdicts (
+            file_path TEXT PRIMARY KEY,
+            signature_version INTEGER NOT NULL,
+            scanned_at DATETIME NOT NULL
+        ) WITHOUT ROWID
+    )";
+    
+    if (!query.exec(createVerdicts)) {
+        logError("createTables - file_verdicts", query.lastError().text());
+        return false;
+    }
+    
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_file_verdicts_version ON file_verdicts(signature_version)")) {
+        logError("createTables - file_verdicts index", query.lastError().text());
+        return false;
+    }
+    
+    // Reports and exports read one scan's threats; outbreak scans have millions
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_threats_scan ON threats(scan_id)")) {
+        logError("createTables - threats index", query.lastError().text());
+        return false;
+    }
+    
     // Enable foreign keys
     query.exec("PRAGMA foreign_keys = ON");
     
@@ -89,14 +174,59 @@ bool Database::createTables() {
     return true;
 }
 
-int Database::createScan(const QString& scanPath) {
+bool Database::ensureColumn(const QString& table, const QString& column, const QString& definition) {
+    QSqlQuery query(m_db);
+    
+    if (!query.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+        logError("ensureColumn - " + table, query.lastError().text());
+        return false;
+    }
+    
+    while (query.next()) {
+        if (query.value("name").toString() == column) {
+            return true;
+        }
+    }
+    
+    if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, definition))) {
+        logError("ensureColumn - " + table + "." + column, query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+ScanHistoryEntry Database::entryFromQuery(const QSqlQuery& query) const {
+    ScanHistoryEntry entry;
+    entry.id = query.value("id").toInt();
+    entry.scanDate = query.value("scan_date").toDateTime();
+    entry.scanPath = query.value("scan_path").toString();
+    entry.filesScanned = query.value("files_scanned").toULongLong();
+    entry.bytesScanned = query.value("bytes_scanned").toULongLong();
+    entry.threatsFound = query.value("threats_found").toInt();
+    entry.scanDuration = query.value("scan_duration").toLongLong();
+    entry.status = query.value("status").toString();
+    entry.filesTotal = query.value("files_total").toULongLong();
+    QVariant firstDetection = query.value("first_detection_ms");
+    entry.firstDetectionMs = firstDetection.isNull() ? -1 : firstDetection.toLongLong();
+    entry.bytesRead = query.value("bytes_read").toULongLong();
+    entry.holeBytes = query.value("hole_bytes").toULongLong();
+    return entry;
+}
+
+int Database::createScan(const QStringList& scanPaths, const QString& label) {
     QMutexLocker locker(&m_mutex);
     
     QSqlQuery query(m_db);
+    QString scanPath = label.isEmpty() ? scanPaths.join(", ") : label;
     
-    query.prepare("INSERT INTO scan_history (scan_date, scan_path) VALUES (?, ?)");
+    query.prepare(R"(
+        INSERT INTO scan_history (scan_date, scan_path, scan_targets, status)
+        VALUES (?, ?, ?, 'running')
+    )");
     query.addBindValue(QDateTime::currentDateTime());
     query.addBindValue(scanPath);
+    query.addBindValue(scanPaths.join('\n'));
     
     if (!query.exec()) {
         logError("createScan", query.lastError().text());
@@ -108,6 +238,22 @@ int Database::createScan(const QString& scanPath) {
     return scanId;
 }
 
+bool Database::setScanTotal(int scanId, quint64 filesTotal) {
+    QMutexLocker locker(&m_mutex);
+    
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE scan_history SET files_total = ? WHERE id = ?");
+    query.addBindValue(filesTotal);
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("setScanTotal", query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
 bool Database::updateScan(int scanId, quint64 filesScanned, quint64 bytesScanned, int threatsFound, qint64 duration) {
     QMutexLocker locker(&m_mutex);
     
@@ -115,7 +261,8 @@ bool Database::updateScan(int scanId, quint64 filesScanned, quint64 bytesScanned
     
     query.prepare(R"(
         UPDATE scan_history 
-        SET files_scanned = ?, bytes_scanned = ?, threats_found = ?, scan_duration = ?
+        SET files_scanned = ?, bytes_scanned = ?, threats_found = ?, scan_duration = ?,
+            status = 'completed'
         WHERE id = ?
     )");
     
@@ -130,18 +277,27 @@ bool Database::updateScan(int scanId, quint64 filesScanned, quint64 bytesScanned
         return false;
     }
     
+    // Completed scans no longer need their checkpoint
+    query.prepare("DELETE FROM scan_checkpoint_files WHERE scan_id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("updateScan - checkpoint", query.lastError().text());
+    }
+    
     qDebug() << "Updated scan ID:" << scanId << "files:" << filesScanned << "threats:" << threatsFound;
     return true;
 }
 
-bool Database::addThreat(int scanId, const QString& filePath, const QString& virusName, quint64 fileSize) {
+bool Database::addThreat(int scanId, const QString& filePath, const QString& virusName, quint64 fileSize,
+                         const QString& signatureVersion) {
     QMutexLocker locker(&m_mutex);
     
     QSqlQuery query(m_db);
     
     query.prepare(R"(
-        INSERT INTO threats (scan_id, file_path, virus_name, file_size, detection_time)
-        VALUES (?, ?, ?, ?, ?)
+        INSERT INTO threats (scan_id, file_path, virus_name, file_size, detection_time, signature_version)
+        VALUES (?, ?, ?, ?, ?, ?)
     )");
     
     query.addBindValue(scanId);
@@ -149,6 +305,7 @@ bool Database::addThreat(int scanId, const QString& filePath, const QString& vir
     query.addBindValue(virusName);
     query.addBindValue(fileSize);
     query.addBindValue(QDateTime::currentDateTime());
+    query.addBindValue(signatureVersion);
     
     if (!query.exec()) {
         logError("addThreat", query.lastError().text());
@@ -159,12 +316,354 @@ bool Database::addThreat(int scanId, const QString& filePath, const QString& vir
     return true;
 }
 
+bool Database::saveScanOutcome(int scanId, const ThreatReport& report) {
+    QMutexLocker locker(&m_mutex);
+    
+    QSqlQuery query(m_db);
+    
+    // One "reason<TAB>count" line per prefilter skip reason
+    QStringList skipReasons;
+    QMap<QString, quint64> reasons = report.getSkipReasons();
+    for (auto it = reasons.constBegin(); it != reasons.constEnd(); ++it) {
+        skipReasons.append(it.key() + '\t' + QString::number(it.value()));
+    }
+    
+    // Stage breakdown as JSON, in pipeline order: [{"stage": "walk", "count": n, "p50_us": ...}, ...]
+    QJsonArray stages;
+    for (const StageLatency& stage : report.getStageLatencies()) {
+        QJsonObject entry;
+        entry["stage"] = stage.stage;
+        entry["count"] = qint64(stage.count);
+        entry["p50_us"] = qint64(stage.p50);
+        entry["p90_us"] = qint64(stage.p90);
+        entry["p99_us"] = qint64(stage.p99);
+        entry["max_us"] = qint64(stage.max);
+        entry["total_us"] = qint64(stage.total);
+        stages.append(entry);
+    }
+    
+    // Per clamd endpoint, for scans spread over several: [{"endpoint": "unix:/...", "files": n, ...}, ...]
+    QJsonArray endpoints;
+    for (const EndpointStats& stats : report.getEndpointStats()) {
+        QJsonObject entry;
+        entry["endpoint"] = stats.endpoint;
+        entry["files"] = qint64(stats.files);
+        entry["bytes"] = qint64(stats.bytes);
+        entry["failures"] = qint64(stats.failures);
+        entry["busy_us"] = qint64(stats.busyUs);
+        entry["removals"] = stats.removals;
+        entry["healthy"] = stats.healthy;
+        endpoints.append(entry);
+    }
+    
+    query.prepare(R"(
+        UPDATE scan_history 
+        SET files_timed_out = ?, files_failed = ?, dirs_pruned = ?, files_pruned = ?,
+            files_skipped = ?, skip_reasons = ?, stage_latency = ?, signature_versions = ?,
+            endpoint_stats = ?, first_detection_ms = ?, bytes_read = ?, hole_bytes = ?
+        WHERE id = ?
+    )");
+    query.addBindValue(report.getFilesTimedOut());
+    query.addBindValue(report.getFilesFailed());
+    query.addBindValue(report.getDirectoriesPruned());
+    query.addBindValue(report.getFilesPruned());
+    query.addBindValue(report.getFilesSkipped());
+    query.addBindValue(skipReasons.join('\n'));
+    query.addBindValue(QString::fromUtf8(QJsonDocument(stages).toJson(QJsonDocument::Compact)));
+    query.addBindValue(report.getSignatureVersions().join(','));
+    query.addBindValue(endpoints.isEmpty() ? QString()
+                                           : QString::fromUtf8(QJsonDocument(endpoints).toJson(QJsonDocument::Compact)));
+    query.addBindValue(report.getTimeToFirstDetection());
+    query.addBindValue(report.getTotalBytesRead());
+    query.addBindValue(report.getHoleBytes());
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("saveScanOutcome", query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+bool Database::saveCheckpoint(int scanId, const QStringList& completedFiles, const ScanCheckpoint& totals) {
+    QMutexLocker locker(&m_mutex);
+    
+    if (!m_db.transaction()) {
+        logError("saveCheckpoint - transaction", m_db.lastError().text());
+        return false;
+    }
+    
+    QSqlQuery query(m_db);
+    
+    query.prepare("INSERT OR IGNORE INTO scan_checkpoint_files (scan_id, file_path) VALUES (?, ?)");
+    for (const QString& filePath : completedFiles) {
+        query.bindValue(0, scanId);
+        query.bindValue(1, filePath);
+        
+        if (!query.exec()) {
+            logError("saveCheckpoint - files", query.lastError().text());
+            m_db.rollback();
+            return false;
+        }
+    }
+    
+    query.prepare(R"(
+        UPDATE scan_history 
+        SET files_scanned = ?, bytes_scanned = ?, threats_found = ?, scan_duration = ?,
+            first_detection_ms = ?, bytes_read = ?, hole_bytes = ?
+        WHERE id = ?
+    )");
+    
+    query.addBindValue(totals.filesScanned);
+    query.addBindValue(totals.bytesScanned);
+    query.addBindValue(totals.threatsFound);
+    query.addBindValue(totals.duration);
+    query.addBindValue(totals.firstDetectionMs);
+    query.addBindValue(totals.bytesRead);
+    query.addBindValue(totals.holeBytes);
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("saveCheckpoint - scan_history", query.lastError().text());
+        m_db.rollback();
+        return false;
+    }
+    
+    if (!m_db.commit()) {
+        logError("saveCheckpoint - commit", m_db.lastError().text());
+        return false;
+    }
+    
+    qDebug() << "Checkpoint scan ID:" << scanId << "files:" << totals.filesScanned;
+    return true;
+}
+
+bool Database::setScanStatus(int scanId, const QString& status) {
+    QMutexLocker locker(&m_mutex);
+    
+    QSqlQuery query(m_db);
+    
+    query.prepare("UPDATE scan_history SET status = ? WHERE id = ?");
+    query.addBindValue(status);
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("setScanStatus", query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+int Database::rollbackToCheckpoint(int scanId) {
+    QMutexLocker locker(&m_mutex);
+    
+    QSqlQuery query(m_db);
+    
+    // Threats recorded after the last checkpoint will be found again on resume.
+    // Archive members ("archive!member") stay with their checkpointed archive,
+    // which the resumed scan will not open again.
+    query.prepare(R"(
+        DELETE FROM threats
+        WHERE scan_id = ? AND file_path NOT IN (
+            SELECT file_path FROM scan_checkpoint_files WHERE scan_id = ?
+        ) AND NOT EXISTS (
+            SELECT 1 FROM scan_checkpoint_files AS done
+            WHERE done.scan_id = ?
+              AND substr(threats.file_path, 1, length(done.file_path) + 1) = done.file_path || '!'
+        )
+    )");
+    query.addBindValue(scanId);
+    query.addBindValue(scanId);
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("rollbackToCheckpoint - threats", query.lastError().text());
+        return -1;
+    }
+    
+    query.prepare("UPDATE scan_history SET status = 'running' WHERE id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("rollbackToCheckpoint - status", query.lastError().text());
+        return -1;
+    }
+    
+    query.prepare("SELECT COUNT(*) FROM threats WHERE scan_id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec() || !query.next()) {
+        logError("rollbackToCheckpoint - count", query.lastError().text());
+        return -1;
+    }
+    
+    return query.value(0).toInt();
+}
+
+QVector<ScanHistoryEntry> Database::getResumableScans() {
+    QVector<ScanHistoryEntry> scans;
+    QSqlQuery query(m_db);
+    
+    if (!query.exec("SELECT * FROM scan_history WHERE status IN ('interrupted', 'cancelled') "
+                    "ORDER BY scan_date DESC")) {
+        logError("getResumableScans", query.lastError().text());
+        return scans;
+    }
+    
+    while (query.next()) {
+        scans.append(entryFromQuery(query));
+    }
+    
+    return scans;
+}
+
+ScanHistoryEntry Database::getScan(int scanId) {
+    ScanHistoryEntry entry;
+    entry.id = -1;
+    QSqlQuery query(m_db);
+    
+    query.prepare("SELECT * FROM scan_history WHERE id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("getScan", query.lastError().text());
+        return entry;
+    }
+    
+    if (query.next()) {
+        entry = entryFromQuery(query);
+    }
+    
+    return entry;
+}
+
+QStringList Database::getScanTargets(int scanId) {
+    QSqlQuery query(m_db);
+    
+    query.prepare("SELECT scan_targets, scan_path FROM scan_history WHERE id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec() || !query.next()) {
+        logError("getScanTargets", query.lastError().text());
+        return QStringList();
+    }
+    
+    QString targets = query.value("scan_targets").toString();
+    if (targets.isEmpty()) {
+        // Scans created before targets were stored only have the display path
+        return query.value("scan_path").toString().split(", ", Qt::SkipEmptyParts);
+    }
+    
+    return targets.split('\n', Qt::SkipEmptyParts);
+}
+
+QSet<QString> Database::getCompletedFiles(int scanId) {
+    QSet<QString> files;
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    
+    query.prepare("SELECT file_path FROM scan_checkpoint_files WHERE scan_id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("getCompletedFiles", query.lastError().text());
+        return files;
+    }
+    
+    while (query.next()) {
+        files.insert(query.value(0).toString());
+    }
+    
+    return files;
+}
+
+bool Database::saveFileVerdicts(const QVector<FileVerdict>& verdicts) {
+    if (verdicts.isEmpty()) {
+        return true;
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    
+    if (!m_db.transaction()) {
+        logError("saveFileVerdicts - transaction", m_db.lastError().text());
+        return false;
+    }
+    
+    QSqlQuery save(m_db);
+    save.prepare("INSERT OR REPLACE INTO file_verdicts (file_path, signature_version, scanned_at) VALUES (?, ?, ?)");
+    QSqlQuery drop(m_db);
+    drop.prepare("DELETE FROM file_verdicts WHERE file_path = ?");
+    QDateTime now = QDateTime::currentDateTime();
+    
+    for (const FileVerdict& verdict : verdicts) {
+        bool ok;
+        if (verdict.signatureVersion > 0) {
+            save.bindValue(0, verdict.path);
+            save.bindValue(1, verdict.signatureVersion);
+            save.bindValue(2, now);
+            ok = save.exec();
+        } else {
+            // Infected files are in the threat list, not in the rescan set
+            drop.bindValue(0, verdict.path);
+            ok = drop.exec();
+        }
+        
+        if (!ok) {
+            logError("saveFileVerdicts", (verdict.signatureVersion > 0 ? save : drop).lastError().text());
+            m_db.rollback();
+            return false;
+        }
+    }
+    
+    if (!m_db.commit()) {
+        logError("saveFileVerdicts - commit", m_db.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+QStringList Database::getStaleCleanFiles(quint64 currentVersion) {
+    QStringList files;
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    
+    query.prepare("SELECT file_path FROM file_verdicts WHERE signature_version < ?");
+    query.addBindValue(currentVersion);
+    
+    if (!query.exec()) {
+        logError("getStaleCleanFiles", query.lastError().text());
+        return files;
+    }
+    
+    while (query.next()) {
+        files.append(query.value(0).toString());
+    }
+    
+    return files;
+}
+
+bool Database::forgetFileVerdicts(const QStringList& filePaths) {
+    QVector<FileVerdict> verdicts;
+    verdicts.reserve(filePaths.size());
+    for (const QString& path : filePaths) {
+        verdicts.append(FileVerdict{path, 0});
+    }
+    return saveFileVerdicts(verdicts);
+}
+
 QVector<ScanHistoryEntry> Database::getHistory(int limit) {
     QVector<ScanHistoryEntry> history;
     QSqlQuery query(m_db);
     
-    // Only get scans with at least 1 file scanned
-    query.prepare("SELECT * FROM scan_history WHERE files_scanned > 0 ORDER BY scan_date DESC LIMIT ?");
+    // Only get scans with at least 1 file scanned, plus scans still running or resumable
+    query.prepare(R"(
+        SELECT * FROM scan_history
+        WHERE files_scanned > 0 OR status IN ('running', 'interrupted', 'cancelled')
+        ORDER BY scan_date DESC LIMIT ?
+    )");
     query.addBindValue(limit);
     
     if (!query.exec()) {
@@ -173,15 +672,7 @@ QVector<ScanHistoryEntry> Database::getHistory(int limit) {
     }
     
     while (query.next()) {
-        ScanHistoryEntry entry;
-        entry.id = query.value("id").toInt();
-        entry.scanDate = query.value("scan_date").toDateTime();
-        entry.scanPath = query.value("scan_path").toString();
-        entry.filesScanned = query.value("files_scanned").toULongLong();
-        entry.bytesScanned = query.value("bytes_scanned").toULongLong();
-        entry.threatsFound = query.value("threats_found").toInt();
-        entry.scanDuration = query.value("scan_duration").toLongLong();
-        history.append(entry);
+        history.append(entryFromQuery(query));
     }
     
     return history;
@@ -194,13 +685,7 @@ ScanHistoryEntry Database::getLastScan() {
     query.exec("SELECT * FROM scan_history WHERE files_scanned > 0 ORDER BY scan_date DESC LIMIT 1");
     
     if (query.next()) {
-        entry.id = query.value("id").toInt();
-        entry.scanDate = query.value("scan_date").toDateTime();
-        entry.scanPath = query.value("scan_path").toString();
-        entry.filesScanned = query.value("files_scanned").toULongLong();
-        entry.bytesScanned = query.value("bytes_scanned").toULongLong();
-        entry.threatsFound = query.value("threats_found").toInt();
-        entry.scanDuration = query.value("scan_duration").toLongLong();
+        entry = entryFromQuery(query);
     }
     
     return entry;
@@ -221,8 +706,56 @@ ThreatReport Database::getScanDetails(int scanId) {
     
     report.setTotalFilesScanned(query.value("files_scanned").toULongLong());
     report.setTotalBytesScanned(query.value("bytes_scanned").toULongLong());
+    report.setTotalBytesRead(query.value("bytes_read").toULongLong());
+    report.setHoleBytes(query.value("hole_bytes").toULongLong());
     report.setStartTime(query.value("scan_date").toDateTime());
     report.setScanDuration(query.value("scan_duration").toLongLong());
+    report.setFilesTimedOut(query.value("files_timed_out").toULongLong());
+    report.setFilesFailed(query.value("files_failed").toULongLong());
+    report.setDirectoriesPruned(query.value("dirs_pruned").toULongLong());
+    report.setFilesPruned(query.value("files_pruned").toULongLong());
+    
+    QMap<QString, quint64> skipReasons;
+    const QStringList skipLines = query.value("skip_reasons").toString().split('\n', Qt::SkipEmptyParts);
+    for (const QString& line : skipLines) {
+        skipReasons.insert(line.section('\t', 0, 0), line.section('\t', 1).toULongLong());
+    }
+    report.setSkipReasons(skipReasons);
+    
+    QVector<StageLatency> stageLatencies;
+    const QJsonArray stages = QJsonDocument::fromJson(query.value("stage_latency").toByteArray()).array();
+    for (const QJsonValue& value : stages) {
+        QJsonObject entry = value.toObject();
+        StageLatency stage;
+        stage.stage = entry["stage"].toString();
+        stage.count = entry["count"].toVariant().toULongLong();
+        stage.p50 = entry["p50_us"].toVariant().toULongLong();
+        stage.p90 = entry["p90_us"].toVariant().toULongLong();
+        stage.p99 = entry["p99_us"].toVariant().toULongLong();
+        stage.max = entry["max_us"].toVariant().toULongLong();
+        stage.total = entry["total_us"].toVariant().toULongLong();
+        stageLatencies.append(stage);
+    }
+    report.setStageLatencies(stageLatencies);
+    report.setSignatureVersions(query.value("signature_versions").toString().split(',', Qt::SkipEmptyParts));
+    
+    QVector<EndpointStats> endpointStats;
+    const QJsonArray endpoints = QJsonDocument::fromJson(query.value("endpoint_stats").toByteArray()).array();
+    for (const QJsonValue& value : endpoints) {
+        QJsonObject entry = value.toObject();
+        EndpointStats stats;
+        stats.endpoint = entry["endpoint"].toString();
+        stats.files = entry["files"].toVariant().toULongLong();
+        stats.bytes = entry["bytes"].toVariant().toULongLong();
+        stats.failures = entry["failures"].toVariant().toULongLong();
+        stats.busyUs = entry["busy_us"].toVariant().toULongLong();
+        stats.removals = entry["removals"].toInt();
+        stats.healthy = entry["healthy"].toBool(true);
+        endpointStats.append(stats);
+    }
+    report.setEndpointStats(endpointStats);
+    QVariant firstDetection = query.value("first_detection_ms");
+    report.setTimeToFirstDetection(firstDetection.isNull() ? -1 : firstDetection.toLongLong());
     
     // Get threats
     query.prepare("SELECT * FROM threats WHERE scan_id = ?");
@@ -237,7 +770,8 @@ ThreatReport Database::getScanDetails(int scanId) {
         QString path = query.value("file_path").toString();
         QString virus = query.value("virus_name").toString();
         quint64 size = query.value("file_size").toULongLong();
-        report.addThreat(path, virus, size);
+        report.addThreat(path, virus, size, query.value("signature_version").toString(),
+                         query.value("detection_time").toDateTime());
     }
     
     return report;
@@ -255,6 +789,14 @@ bool Database::deleteScan(int scanId) {
         return false;
     }
     
+    query.prepare("DELETE FROM scan_checkpoint_files WHERE scan_id = ?");
+    query.addBindValue(scanId);
+    
+    if (!query.exec()) {
+        logError("deleteScan - checkpoint", query.lastError().text());
+        return false;
+    }
+    
     // Delete scan
     query.prepare("DELETE FROM scan_history WHERE id = ?");
     query.addBindValue(scanId);
@@ -5,10 +5,14 @@
 #include <QString>
 #include <QDateTime>
 #include <QVector>
+#include <QSet>
+#include <QStringList>
 #include <QSqlDatabase>
 #include <QMutex>
 #include "ThreatReport.h"
 
+class QSqlQuery;
+
 struct ScanHistoryEntry {
     int id;
     QDateTime scanDate;
@@ -17,20 +21,69 @@ struct ScanHistoryEntry {
     quint64 bytesScanned;
     int threatsFound;
     qint64 scanDuration;
+    QString status;     // running, interrupted, cancelled, completed
+    quint64 filesTotal; // 0 until the walk has finished
+    qint64 firstDetectionMs;    // -1 without a detection
+    quint64 bytesRead;  // from disk; bytesScanned counts logical sizes
+    quint64 holeBytes;
+};
+
+// Running totals written with each checkpoint; all a resumed scan can count on,
+// since the columns saveScanOutcome() writes only exist for finished scans
+struct ScanCheckpoint {
+    quint64 filesScanned;
+    quint64 bytesScanned;
+    int threatsFound;
+    qint64 duration;
+    qint64 firstDetectionMs;
+    quint64 bytesRead;
+    quint64 holeBytes;
+
+    ScanCheckpoint()
+        : filesScanned(0), bytesScanned(0), threatsFound(0), duration(0), firstDetectionMs(-1)
+        , bytesRead(0), holeBytes(0) {}
+};
+
+// Last clean verdict of a file, kept so a signature update can rescan it
+struct FileVerdict {
+    QString path;
+    quint64 signatureVersion;  // 0 for an infected file, which drops the entry
 };
 
 class Database : public QObject {
     Q_OBJECT
 public:
     explicit Database(QObject* parent = nullptr);
+    // Database at an explicit location instead of the per-user data directory
+    explicit Database(const QString& path, QObject* parent = nullptr);
     ~Database();
 
     bool initialize();
+    QString path() const { return m_dbPath; }
+    static QString defaultPath();
     
     // Scan management - simplified
-    int createScan(const QString& scanPath);
+    // label replaces the joined paths in the history, for long target lists
+    int createScan(const QStringList& scanPaths, const QString& label = QString());
+    bool setScanTotal(int scanId, quint64 filesTotal);
     bool updateScan(int scanId, quint64 filesScanned, quint64 bytesScanned, int threatsFound, qint64 duration);
-    bool addThreat(int scanId, const QString& filePath, const QString& virusName, quint64 fileSize);
+    bool addThreat(int scanId, const QString& filePath, const QString& virusName, quint64 fileSize,
+                   const QString& signatureVersion = QString());
+    bool saveScanOutcome(int scanId, const ThreatReport& report);
+    
+    // Checkpoints - let interrupted scans be resumed where they left off
+    bool saveCheckpoint(int scanId, const QStringList& completedFiles, const ScanCheckpoint& totals);
+    bool setScanStatus(int scanId, const QString& status);
+    int rollbackToCheckpoint(int scanId);
+    QVector<ScanHistoryEntry> getResumableScans();
+    ScanHistoryEntry getScan(int scanId);
+    QStringList getScanTargets(int scanId);
+    QSet<QString> getCompletedFiles(int scanId);
+    
+    // Verdict cache - files last found clean under an older signature version
+    bool saveFileVerdicts(const QVector<FileVerdict>& verdicts);
+    QStringList getStaleCleanFiles(quint64 currentVersion);
+    bool forgetFileVerdicts(const QStringList& filePaths);
     
     // History
     QVector<ScanHistoryEntry> getHistory(int limit = 50);
@@ -48,6 +101,8 @@ signals:
 
 private:
     bool createTables();
+    bool ensureColumn(const QString& table, const QString& column, const QString& definition);
+    ScanHistoryEntry entryFromQuery(const QSqlQuery& query) const;
     void logError(const QString& context, const QString& error);
     
     QSqlDatabase m_db;
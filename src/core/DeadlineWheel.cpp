@@ -0,0 +1,114 @@
+#include "DeadlineWheel.h"
+#include <QElapsedTimer>
+
+DeadlineWheel::DeadlineWheel(int tickMs, int slotCount)
+    : m_tickMs(tickMs)
+    , m_slots(slotCount)
+    , m_currentTick(0)
+    , m_nextId(1)
+    , m_running(false)
+    , m_thread(nullptr)
+{
+}
+
+DeadlineWheel::~DeadlineWheel() {
+    stop();
+}
+
+void DeadlineWheel::start() {
+    if (m_thread) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        for (QVector<Entry>& entries : m_slots) {
+            entries.clear();
+        }
+        m_slotOf.clear();
+        // run() counts ticks from its own start
+        m_currentTick = 0;
+    }
+
+    m_running = true;
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->start();
+}
+
+void DeadlineWheel::stop() {
+    if (!m_thread) {
+        return;
+    }
+
+    m_running = false;
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+quint64 DeadlineWheel::schedule(qint64 timeoutMs, const CancellationTokenPtr& token) {
+    quint64 ticks = qMax<qint64>(1, (timeoutMs + m_tickMs - 1) / m_tickMs);
+
+    QMutexLocker locker(&m_mutex);
+    quint64 id = m_nextId++;
+    quint64 expiryTick = m_currentTick + ticks;
+    int slot = expiryTick % m_slots.size();
+
+    m_slots[slot].append(Entry{id, expiryTick, token});
+    m_slotOf.insert(id, slot);
+    return id;
+}
+
+void DeadlineWheel::remove(quint64 timerId) {
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_slotOf.find(timerId);
+    if (it == m_slotOf.end()) {
+        return; // already fired
+    }
+
+    QVector<Entry>& entries = m_slots[it.value()];
+    for (int i = 0; i < entries.size(); ++i) {
+        if (entries[i].id == timerId) {
+            entries.removeAt(i);
+            break;
+        }
+    }
+    m_slotOf.erase(it);
+}
+
+void DeadlineWheel::run() {
+    QElapsedTimer clock;
+    clock.start();
+
+    while (m_running.load()) {
+        QThread::msleep(m_tickMs);
+        // Catch up on ticks missed while the thread was not scheduled
+        advance(clock.elapsed() / m_tickMs);
+    }
+}
+
+void DeadlineWheel::advance(quint64 targetTick) {
+    QVector<CancellationTokenPtr> expired;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_currentTick < targetTick) {
+            ++m_currentTick;
+            QVector<Entry>& entries = m_slots[m_currentTick % m_slots.size()];
+
+            // Entries more than one revolution away stay for a later round
+            for (int i = entries.size() - 1; i >= 0; --i) {
+                if (entries[i].expiryTick <= m_currentTick) {
+                    expired.append(entries[i].token);
+                    m_slotOf.remove(entries[i].id);
+                    entries.removeAt(i);
+                }
+            }
+        }
+    }
+
+    for (const CancellationTokenPtr& token : expired) {
+        token->cancel();
+    }
+}
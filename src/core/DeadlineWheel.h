@@ -0,0 +1,48 @@
+#ifndef DEADLINEWHEEL_H
+#define DEADLINEWHEEL_H
+
+#include <QMutex>
+#include <QVector>
+#include <QHash>
+#include <QThread>
+#include <atomic>
+#include "CancellationToken.h"
+
+// Hashed timer wheel that cancels tokens when their deadline passes.
+// One background thread advances the wheel, so workers never block on timeouts:
+// they just poll the token they were given. The thread only runs between start()
+// and stop(), so an idle scanner does not wake up every tick.
+class DeadlineWheel {
+public:
+    explicit DeadlineWheel(int tickMs = 50, int slotCount = 512);
+    ~DeadlineWheel();
+
+    // Drops deadlines left from a previous run
+    void start();
+    void stop();
+
+    quint64 schedule(qint64 timeoutMs, const CancellationTokenPtr& token);
+    void remove(quint64 timerId);
+
+private:
+    struct Entry {
+        quint64 id;
+        quint64 expiryTick;
+        CancellationTokenPtr token;
+    };
+
+    void run();
+    void advance(quint64 targetTick);
+
+    const int m_tickMs;
+    QMutex m_mutex;
+    QVector<QVector<Entry>> m_slots;
+    QHash<quint64, int> m_slotOf;  // timer id -> slot index
+    quint64 m_currentTick;
+    quint64 m_nextId;
+
+    std::atomic<bool> m_running;
+    QThread* m_thread;
+};
+
+#endif // DEADLINEWHEEL_H
@@ -0,0 +1,194 @@
+#include "DirectorySnapshot.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <type_traits>
+
+namespace {
+
+const quint32 MAGIC = 0x46414453;  // "FADS"
+const quint32 VERSION = 2;
+
+}
+
+QString DirectorySnapshot::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/dirsnapshot.bin";
+}
+
+DirectorySnapshotPtr DirectorySnapshot::load(const QString& path, const QByteArray& fingerprint, QString* error) {
+    QSharedPointer<DirectorySnapshot> snapshot(new DirectorySnapshot);
+    snapshot->m_fingerprint = fingerprint;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error && file.exists()) {
+            *error = file.errorString();
+        }
+        return snapshot;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray storedFingerprint;
+    quint32 walksSinceFull = 0;
+    quint32 count = 0;
+    in >> magic >> version >> storedFingerprint >> walksSinceFull >> count;
+    if (magic != MAGIC || version != VERSION) {
+        if (error) {
+            *error = "Snapshot format changed";
+        }
+        return snapshot;
+    }
+    if (storedFingerprint != fingerprint) {
+        if (error) {
+            *error = "Exclusion rules changed since the last walk";
+        }
+        return snapshot;
+    }
+
+    // Read back on the machine that wrote it, so the nodes go in raw
+    static_assert(std::is_trivially_copyable<Node>::value, "Node is written raw");
+    QVector<Node> nodes(int(count));
+    qint64 nodeBytes = qint64(count) * qint64(sizeof(Node));
+    QByteArray names;
+    if (in.readRawData(reinterpret_cast<char*>(nodes.data()), int(nodeBytes)) != nodeBytes) {
+        if (error) {
+            *error = "Snapshot is truncated";
+        }
+        return snapshot;
+    }
+    in >> names;
+    if (in.status() != QDataStream::Ok) {
+        if (error) {
+            *error = "Snapshot is truncated";
+        }
+        return snapshot;
+    }
+
+    snapshot->m_nodes = nodes;
+    snapshot->m_names = names;
+    snapshot->m_walksSinceFull = walksSinceFull;
+    return snapshot;
+}
+
+bool DirectorySnapshot::save(const QString& path, QString* error) const {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << MAGIC << VERSION << m_fingerprint << m_walksSinceFull << quint32(m_nodes.size());
+    out.writeRawData(reinterpret_cast<const char*>(m_nodes.constData()), int(m_nodes.size() * sizeof(Node)));
+    out << m_names;
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+quint32 DirectorySnapshot::addDirectory(quint32 parent, const QByteArray& name, const Stamp& stamp) {
+    Node node;
+    node.nameOffset = quint64(m_names.size());
+    node.nameLength = quint32(name.size());
+    node.parent = parent;
+    node.stamp = stamp;
+    node.firstChild = None;
+    node.childCount = 0;
+    node.files = 0;
+    node.flags = 0;
+    m_names.append(name);
+    m_nodes.append(node);
+
+    quint32 id = quint32(m_nodes.size() - 1);
+    if (parent != None) {
+        Node& parentNode = m_nodes[parent];
+        if (parentNode.childCount == 0) {
+            parentNode.firstChild = id;
+        }
+        parentNode.childCount++;
+    }
+    return id;
+}
+
+void DirectorySnapshot::setListed(quint32 directory, quint32 files, bool trusted) {
+    Node& node = m_nodes[directory];
+    node.files = files;
+    node.flags = Listed | (trusted ? Trusted : 0);
+}
+
+void DirectorySnapshot::mergeRoots(const DirectorySnapshot& previous) {
+    // A root's tree runs from its id to the next root's
+    for (quint32 root = 0; root < quint32(previous.m_nodes.size());) {
+        quint32 end = root + 1;
+        while (end < quint32(previous.m_nodes.size()) && previous.m_nodes[end].parent != None) {
+            ++end;
+        }
+        if (findRoot(previous.name(root)) == None) {
+            quint32 offset = quint32(m_nodes.size()) - root;
+            for (quint32 id = root; id < end; ++id) {
+                Node node = previous.m_nodes[id];
+                node.nameOffset = quint64(m_names.size());
+                m_names.append(previous.m_names.constData() + previous.m_nodes[id].nameOffset,
+                               qsizetype(node.nameLength));
+                if (node.parent != None) {
+                    node.parent += offset;
+                }
+                if (node.firstChild != None) {
+                    node.firstChild += offset;
+                }
+                m_nodes.append(node);
+            }
+        }
+        root = end;
+    }
+}
+
+void DirectorySnapshot::squeeze() {
+    m_nodes.squeeze();
+    m_names.squeeze();
+}
+
+quint32 DirectorySnapshot::findRoot(const QByteArray& path) const {
+    for (quint32 id = 0; id < quint32(m_nodes.size()); ++id) {
+        if (m_nodes[id].parent == None && name(id) == path) {
+            return id;
+        }
+    }
+    return None;
+}
+
+quint32 DirectorySnapshot::findChild(quint32 directory, const QByteArray& childName) const {
+    const Node& node = m_nodes[directory];
+    for (quint32 i = 0; i < node.childCount; ++i) {
+        const Node& child = m_nodes[node.firstChild + i];
+        if (child.nameLength == quint32(childName.size())
+            && QByteArrayView(m_names.constData() + child.nameOffset, qsizetype(child.nameLength)) == childName) {
+            return node.firstChild + i;
+        }
+    }
+    return None;
+}
+
+QByteArray DirectorySnapshot::name(quint32 directory) const {
+    const Node& node = m_nodes[directory];
+    return m_names.mid(qsizetype(node.nameOffset), qsizetype(node.nameLength));
+}
+
+quint64 DirectorySnapshot::memoryUsage() const {
+    return quint64(m_nodes.capacity()) * sizeof(Node) + quint64(m_names.capacity());
+}
@@ -0,0 +1,105 @@
+#ifndef DIRECTORYSNAPSHOT_H
+#define DIRECTORYSNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QSharedPointer>
+
+// The directories of the last completed incremental walk of each root, with
+// the stat() fields that move whenever an entry is added, removed or renamed
+// in them. A directory whose stamp still matches has the same entries as
+// then, so the walker takes its subdirectories from here instead of listing
+// it, and does not return its files again.
+//
+// Editing a file in place changes neither stamp of its directory; those
+// files are only picked up by a full walk, which the scanner forces every
+// few incremental walks (walksSinceFull). Replacing a file (write to a
+// temporary and rename, as editors, package managers and most droppers do)
+// is a new entry, and is seen.
+//
+// Like PathArena a directory is its parent's id plus its name. A walk adds a
+// directory's subdirectories one after the other, so they get consecutive
+// ids, and each root's tree is one consecutive range.
+class DirectorySnapshot {
+public:
+    static const quint32 None = ~quint32(0);
+
+    DirectorySnapshot() : m_walksSinceFull(0) {}
+
+    struct Stamp {
+        quint64 inode;
+        qint64 mtimeNs;
+        qint64 ctimeNs;
+        quint64 links;      // 2 + subdirectories on most filesystems
+
+        Stamp() : inode(0), mtimeNs(0), ctimeNs(0), links(0) {}
+        bool operator==(const Stamp& other) const {
+            return inode == other.inode && mtimeNs == other.mtimeNs
+                && ctimeNs == other.ctimeNs && links == other.links;
+        }
+        bool operator!=(const Stamp& other) const { return !(*this == other); }
+    };
+
+    static QString defaultPath();
+    // A missing file loads as an empty snapshot; a stale format or other
+    // rules (fingerprint) too, with a reason in error
+    static QSharedPointer<const DirectorySnapshot> load(const QString& path, const QByteArray& fingerprint,
+                                                        QString* error = nullptr);
+    bool save(const QString& path, QString* error = nullptr) const;
+
+    // The exclusion rules the walk ran under; a walk under other rules would
+    // find other files in the same directories
+    void setFingerprint(const QByteArray& fingerprint) { m_fingerprint = fingerprint; }
+    // Incremental walks since the last one that listed every directory
+    quint32 walksSinceFull() const { return m_walksSinceFull; }
+    void setWalksSinceFull(quint32 walks) { m_walksSinceFull = walks; }
+
+    // Filled by the walker; parent is None for a root, whose name is its absolute path
+    quint32 addDirectory(quint32 parent, const QByteArray& name, const Stamp& stamp);
+    // After a listing; an untrusted directory is listed again next time
+    void setListed(quint32 directory, quint32 files, bool trusted);
+    // Keeps the roots of previous this snapshot does not have, so scanning
+    // one root does not forget the others
+    void mergeRoots(const DirectorySnapshot& previous);
+    void squeeze();
+
+    int directoryCount() const { return int(m_nodes.size()); }
+    quint32 findRoot(const QByteArray& path) const;
+    // Subdirectory of directory by name, None if it was not there
+    quint32 findChild(quint32 directory, const QByteArray& name) const;
+    quint32 firstChild(quint32 directory) const { return m_nodes[directory].firstChild; }
+    quint32 childCount(quint32 directory) const { return m_nodes[directory].childCount; }
+    QByteArray name(quint32 directory) const;
+    const Stamp& stamp(quint32 directory) const { return m_nodes[directory].stamp; }
+    quint32 fileCount(quint32 directory) const { return m_nodes[directory].files; }
+    bool isTrusted(quint32 directory) const { return m_nodes[directory].flags & Trusted; }
+
+    quint64 memoryUsage() const;
+
+private:
+    enum Flag : quint32 {
+        Listed = 1,
+        Trusted = 2
+    };
+
+    struct Node {
+        quint64 nameOffset;
+        quint32 nameLength;
+        quint32 parent;
+        Stamp stamp;
+        quint32 firstChild;
+        quint32 childCount;
+        quint32 files;
+        quint32 flags;
+    };
+
+    QVector<Node> m_nodes;
+    QByteArray m_names;
+    QByteArray m_fingerprint;
+    quint32 m_walksSinceFull;
+};
+
+typedef QSharedPointer<const DirectorySnapshot> DirectorySnapshotPtr;
+
+#endif // DIRECTORYSNAPSHOT_H
@@ -0,0 +1,63 @@
+#include "DispatchGate.h"
+#include <QDeadlineTimer>
+
+// Held tasks wake up this often to notice cancellation
+static const int CANCEL_POLL_MS = 50;
+
+DispatchGate::DispatchGate()
+    : m_held(false)
+    , m_inFlight(0)
+{
+}
+
+void DispatchGate::hold() {
+    QMutexLocker locker(&m_mutex);
+    m_held = true;
+}
+
+void DispatchGate::release() {
+    QMutexLocker locker(&m_mutex);
+    m_held = false;
+    m_changed.wakeAll();
+}
+
+bool DispatchGate::isHeld() const {
+    QMutexLocker locker(&m_mutex);
+    return m_held;
+}
+
+bool DispatchGate::enter(const CancellationToken* token) {
+    QMutexLocker locker(&m_mutex);
+    while (m_held) {
+        if (token && token->isCancelled()) {
+            return false;
+        }
+        m_changed.wait(&m_mutex, CANCEL_POLL_MS);
+    }
+    m_inFlight++;
+    return true;
+}
+
+void DispatchGate::leave() {
+    QMutexLocker locker(&m_mutex);
+    m_inFlight--;
+    if (m_inFlight == 0) {
+        m_changed.wakeAll();
+    }
+}
+
+bool DispatchGate::waitIdle(int timeoutMs) {
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (m_inFlight > 0) {
+        if (!m_changed.wait(&m_mutex, deadline)) {
+            return m_inFlight == 0;
+        }
+    }
+    return true;
+}
+
+int DispatchGate::inFlight() const {
+    QMutexLocker locker(&m_mutex);
+    return m_inFlight;
+}
@@ -0,0 +1,36 @@
+#ifndef DISPATCHGATE_H
+#define DISPATCHGATE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include "CancellationToken.h"
+
+// Lets backend requests be paused, e.g. while clamd reloads its signatures.
+// Scan tasks pass through enter() before a backend call and leave() after
+// it. hold() keeps new calls from starting, waitIdle() waits for the ones
+// already in flight, so nothing reaches the daemon mid-reload and every
+// verdict belongs to one signature version.
+class DispatchGate {
+public:
+    DispatchGate();
+
+    void hold();
+    void release();
+    bool isHeld() const;
+
+    // Blocks while held; false if the token was cancelled first
+    bool enter(const CancellationToken* token);
+    void leave();
+
+    // True once no call is in flight; false if that took longer than timeoutMs
+    bool waitIdle(int timeoutMs);
+    int inFlight() const;
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_changed;
+    bool m_held;
+    int m_inFlight;
+};
+
+#endif // DISPATCHGATE_H
@@ -0,0 +1,23 @@
+#include "EngineBackend.h"
+#include "ClamEngine.h"
+
+EngineBackend::EngineBackend() {
+}
+
+ScanBackend::Capabilities EngineBackend::capabilities() const {
+    Capabilities capabilities;
+    capabilities.inProcess = true;
+    return capabilities;
+}
+
+bool EngineBackend::prepare(QString* error) {
+    return ClamEngine::instance().reloadIfChanged(error);
+}
+
+ScanReply EngineBackend::scan(const QString& path, const CancellationToken* token) {
+    return ScanReply::parse(ClamEngine::instance().scanFile(path, token));
+}
+
+QString EngineBackend::signatureVersion() {
+    return ClamEngine::instance().signatureVersion();
+}
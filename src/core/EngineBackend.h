@@ -0,0 +1,19 @@
+#ifndef ENGINEBACKEND_H
+#define ENGINEBACKEND_H
+
+#include "ScanBackend.h"
+
+// Scans in-process with the shared libclamav engine (see ClamEngine)
+class EngineBackend : public ScanBackend {
+public:
+    EngineBackend();
+
+    QString name() const override { return "libclamav"; }
+    Capabilities capabilities() const override;
+    // Compiles the signatures on first use, reloads them when they changed
+    bool prepare(QString* error) override;
+    ScanReply scan(const QString& path, const CancellationToken* token) override;
+    QString signatureVersion() override;
+};
+
+#endif // ENGINEBACKEND_H
@@ -0,0 +1,236 @@
+#include "ExclusionRules.h"
+#include <QSettings>
+#include <QDir>
+#include <QDebug>
+
+ExclusionRules::ExclusionRules()
+    : m_trie(1)
+    , m_hasNamePattern(false)
+    , m_hasPathPattern(false)
+    , m_oneFileSystem(false)
+    , m_skipPseudoFs(true)
+{
+}
+
+QStringList ExclusionRules::defaultRules() {
+    return QStringList()
+        << "/proc"
+        << "/sys"
+        << "/dev"
+        << "/run"
+        << "**/.git/objects";
+}
+
+ExclusionRules ExclusionRules::fromSettings() {
+    QSettings settings("FastAV", "FastAV");
+
+    ExclusionRules rules;
+    QStringList specs = settings.value("exclusions/rules", defaultRules()).toStringList();
+    for (const QString& spec : specs) {
+        rules.addRule(spec);
+    }
+    rules.setOneFileSystem(settings.value("exclusions/oneFileSystem", false).toBool());
+    rules.setSkipPseudoFilesystems(settings.value("exclusions/skipPseudoFilesystems", true).toBool());
+    rules.compile();
+
+    return rules;
+}
+
+void ExclusionRules::saveToSettings(const QStringList& rules, bool oneFileSystem, bool skipPseudoFilesystems) {
+    QSettings settings("FastAV", "FastAV");
+    settings.setValue("exclusions/rules", rules);
+    settings.setValue("exclusions/oneFileSystem", oneFileSystem);
+    settings.setValue("exclusions/skipPseudoFilesystems", skipPseudoFilesystems);
+}
+
+void ExclusionRules::addRule(const QString& rule) {
+    QString spec = rule.trimmed();
+    if (spec.isEmpty()) {
+        return;
+    }
+
+    if (spec.startsWith("re:")) {
+        addRegex(spec.mid(3));
+    } else if (spec.contains('*') || spec.contains('?') || spec.contains('[') || !spec.contains('/')) {
+        addGlob(spec);
+    } else {
+        addPrefix(spec);
+    }
+}
+
+void ExclusionRules::addPrefix(const QString& path) {
+    m_rules << path;
+
+    int node = 0;
+    const QStringList parts = QDir::cleanPath(path).split('/', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        int child = m_trie[node].children.value(part, Unmatched);
+        if (child == Unmatched) {
+            child = m_trie.size();
+            m_trie.append(TrieNode());
+            m_trie[node].children.insert(part, child);
+        }
+        node = child;
+    }
+    m_trie[node].terminal = true;
+}
+
+void ExclusionRules::addGlob(const QString& pattern) {
+    m_rules << pattern;
+
+    if (pattern.contains('/')) {
+        m_pathPatterns << globToRegex(pattern);
+    } else if (pattern.contains('*') || pattern.contains('?') || pattern.contains('[')) {
+        m_nameGlobs << globToRegex(pattern);
+    } else {
+        m_names.insert(pattern);
+    }
+}
+
+void ExclusionRules::addRegex(const QString& pattern) {
+    QRegularExpression check(pattern);
+    if (!check.isValid()) {
+        qWarning() << "Ignoring invalid exclusion regex:" << pattern << check.errorString();
+        return;
+    }
+
+    m_rules << "re:" + pattern;
+    m_pathPatterns << pattern;
+}
+
+void ExclusionRules::compile() {
+    m_hasNamePattern = !m_nameGlobs.isEmpty();
+    if (m_hasNamePattern) {
+        m_namePattern.setPattern("\\A(?:" + m_nameGlobs.join(")\\z|\\A(?:") + ")\\z");
+        m_namePattern.optimize();
+    }
+
+    m_hasPathPattern = !m_pathPatterns.isEmpty();
+    if (m_hasPathPattern) {
+        m_pathPattern.setPattern("(?:" + m_pathPatterns.join(")|(?:") + ")");
+        m_pathPattern.optimize();
+    }
+}
+
+int ExclusionRules::childNode(int node, const QString& name) const {
+    // Once outside the trie no prefix rule can match below this point
+    if (node < 0) {
+        return node;
+    }
+
+    auto it = m_trie[node].children.constFind(name);
+    if (it == m_trie[node].children.constEnd()) {
+        return Unmatched;
+    }
+
+    return m_trie[it.value()].terminal ? Excluded : it.value();
+}
+
+int ExclusionRules::nodeForPath(const QString& absolutePath) const {
+    int node = rootNode();
+    const QStringList parts = QDir::cleanPath(absolutePath).split('/', Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        node = childNode(node, part);
+        if (node < 0) {
+            break;
+        }
+    }
+    return node;
+}
+
+bool ExclusionRules::matchesName(const QString& name) const {
+    if (m_names.contains(name)) {
+        return true;
+    }
+    return m_hasNamePattern && m_namePattern.match(name).hasMatch();
+}
+
+bool ExclusionRules::matchesPath(const QString& absolutePath) const {
+    return m_hasPathPattern && m_pathPattern.match(absolutePath).hasMatch();
+}
+
+QByteArray ExclusionRules::fingerprint() const {
+    QByteArray flags = QByteArray(m_oneFileSystem ? "x" : "-") + (m_skipPseudoFs ? "p" : "-");
+    return flags + '\n' + m_rules.join('\n').toUtf8();
+}
+
+QString ExclusionRules::globSetToRegex(const QString& glob, int start, int* end) {
+    // As in fnmatch: '!' or '^' negates, a leading ']' is literal, '\\' escapes
+    // the next character. Everything else is escaped for the regex class.
+    int i = start + 1;
+    bool negate = i < glob.size() && (glob[i] == '!' || glob[i] == '^');
+    if (negate) {
+        ++i;
+    }
+
+    QString body;
+    for (bool first = true; i < glob.size(); ++i, first = false) {
+        QChar c = glob[i];
+        if (c == ']' && !first) {
+            *end = i;
+            // A negated set still stays inside one path component
+            return QString(negate ? "[^/" : "[") + body + ']';
+        }
+        if (c == '-' && !first && i + 1 < glob.size() && glob[i + 1] != ']') {
+            body += '-';
+            continue;
+        }
+        if (c == '\\' && i + 1 < glob.size()) {
+            c = glob[++i];
+        }
+        if (c == '\\' || c == ']' || c == '[' || c == '^' || c == '-') {
+            body += '\\';
+        }
+        body += c;
+    }
+
+    return QString(); // unterminated, '[' is literal
+}
+
+QString ExclusionRules::globToRegex(const QString& glob) {
+    QString regex;
+    bool pathGlob = glob.contains('/');
+
+    for (int i = 0; i < glob.size(); ++i) {
+        QChar c = glob[i];
+        if (c == '*') {
+            // '**' spans directories only as a whole component: "**/" is any
+            // number of them, a final "**" everything below. Glued to a name
+            // it is a plain '*', so "**/cache" never matches "precache".
+            bool component = i == 0 || glob[i - 1] == '/';
+            if (component && glob.mid(i, 3) == "**/") {
+                regex += "(?:.*/)?";
+                i += 2;
+            } else if (component && glob.mid(i) == "**") {
+                regex += ".*";
+                ++i;
+            } else {
+                regex += "[^/]*";
+                while (i + 1 < glob.size() && glob[i + 1] == '*') {
+                    ++i;
+                }
+            }
+        } else if (c == '?') {
+            regex += "[^/]";
+        } else if (c == '[') {
+            int end = 0;
+            QString set = globSetToRegex(glob, i, &end);
+            if (set.isEmpty()) {
+                regex += "\\[";
+            } else {
+                regex += set;
+                i = end;
+            }
+        } else if (c == '\\' && i + 1 < glob.size()) {
+            regex += QRegularExpression::escape(QString(glob[++i]));
+        } else {
+            regex += QRegularExpression::escape(QString(c));
+        }
+    }
+
+    // Path globs are anchored at the end; relative ones may start at any component
+    if (pathGlob) {
+        return (glob.startsWith('/') ? "\\A" : "(?:\\A|/)") + regex + "\\z";
+    }
+    return regex;
+}
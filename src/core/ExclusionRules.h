@@ -0,0 +1,78 @@
+#ifndef EXCLUSIONRULES_H
+#define EXCLUSIONRULES_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QRegularExpression>
+
+// Paths the walker must not enter or queue. Rules are compiled once per scan:
+//   /abs/path      prefix  - the path and everything below it (component trie)
+//   name, *.iso    glob    - matched against the entry name only
+//   **/.git/objects glob   - contains '/', matched against the full path;
+//                            '*' stays inside one component, '**' spans several
+//   re:<pattern>   regex   - searched in the full path
+// All name globs are merged into one expression, as are path globs and regexes,
+// so each directory entry costs one hash lookup and at most two regex matches.
+class ExclusionRules {
+public:
+    static const int Excluded = -1;   // a prefix rule covers this path
+    static const int Unmatched = -2;  // below no prefix rule at all
+
+    ExclusionRules();
+
+    static QStringList defaultRules();
+    static ExclusionRules fromSettings();
+    static void saveToSettings(const QStringList& rules, bool oneFileSystem, bool skipPseudoFilesystems);
+
+    void addRule(const QString& rule);
+    void addPrefix(const QString& path);
+    void addGlob(const QString& pattern);
+    void addRegex(const QString& pattern);
+    void compile();
+
+    // Trie walk: node of a directory's child, Excluded or Unmatched
+    int rootNode() const { return 0; }
+    int childNode(int node, const QString& name) const;
+    int nodeForPath(const QString& absolutePath) const;
+
+    bool matchesName(const QString& name) const;
+    bool matchesPath(const QString& absolutePath) const;
+
+    QStringList rules() const { return m_rules; }
+    // Same rules and flags, same fingerprint
+    QByteArray fingerprint() const;
+    bool oneFileSystem() const { return m_oneFileSystem; }
+    bool skipPseudoFilesystems() const { return m_skipPseudoFs; }
+    void setOneFileSystem(bool enabled) { m_oneFileSystem = enabled; }
+    void setSkipPseudoFilesystems(bool enabled) { m_skipPseudoFs = enabled; }
+
+private:
+    struct TrieNode {
+        QHash<QString, int> children;
+        bool terminal;
+        TrieNode() : terminal(false) {}
+    };
+
+    static QString globToRegex(const QString& glob);
+    // The regex class for the set opening at start; empty if it is not closed
+    static QString globSetToRegex(const QString& glob, int start, int* end);
+
+    QStringList m_rules;
+    QVector<TrieNode> m_trie;
+
+    QSet<QString> m_names;             // globs without wildcards
+    QStringList m_nameGlobs;           // wildcard globs, compiled into m_namePattern
+    QStringList m_pathPatterns;        // path globs and regexes, compiled into m_pathPattern
+    QRegularExpression m_namePattern;
+    QRegularExpression m_pathPattern;
+    bool m_hasNamePattern;
+    bool m_hasPathPattern;
+
+    bool m_oneFileSystem;
+    bool m_skipPseudoFs;
+};
+
+#endif // EXCLUSIONRULES_H
@@ -0,0 +1,346 @@
+#include "FilePrefetcher.h"
+#include "IoRing.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDebug>
+#include <memory>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef STATX_BASIC_STATS
+#include <linux/stat.h>
+#endif
+#endif
+
+// Slots of one size in one allocation, registered with the ring as a whole
+class BufferPool {
+public:
+    BufferPool(int slots, quint32 slotSize)
+        : m_slotSize(slotSize)
+        , m_memory(new char[size_t(slots) * slotSize])
+    {
+        for (int slot = slots - 1; slot >= 0; --slot) {
+            m_free.append(slot);
+        }
+    }
+
+    char* base() { return m_memory.get(); }
+    char* slot(int slot) { return m_memory.get() + quint64(slot) * m_slotSize; }
+
+    int tryAcquire() {
+        QMutexLocker locker(&m_mutex);
+        return m_free.isEmpty() ? -1 : m_free.takeLast();
+    }
+
+    void release(int slot) {
+        QMutexLocker locker(&m_mutex);
+        m_free.append(slot);
+        m_available.wakeAll();
+    }
+
+    // Returns when a slot comes back or after timeoutMs
+    void waitForSlot(int timeoutMs) {
+        QMutexLocker locker(&m_mutex);
+        if (m_free.isEmpty()) {
+            m_available.wait(&m_mutex, timeoutMs);
+        }
+    }
+
+private:
+    quint32 m_slotSize;
+    std::unique_ptr<char[]> m_memory;
+    QMutex m_mutex;
+    QWaitCondition m_available;
+    QVector<int> m_free;
+};
+
+BufferLease::~BufferLease() {
+    m_pool->release(m_slot);
+}
+
+namespace {
+
+// How long the prefetcher waits for a consumer to give a slot back before
+// looking at the cancellation token again
+const int CANCEL_POLL_MS = 50;
+
+#ifdef Q_OS_LINUX
+
+const unsigned STATX_WANTED = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+
+// One file on its way through statx, openat, read and close. Each entry has
+// at most one operation queued or in flight, so QueueDepth entries never
+// overfill a ring of QueueDepth submissions.
+struct Entry {
+    enum Phase { Stat, Open, Read, Close };
+
+    Phase phase;
+    quint32 file;
+    QByteArray path;        // must outlive the statx and openat
+    struct statx stx;
+    bool statOk;
+    int fd;
+    int slot;
+    bool whole;
+    quint32 length;         // bytes wanted
+    quint32 done;           // bytes read so far
+    bool readOk;
+};
+
+#endif
+
+}
+
+FilePrefetcher::FilePrefetcher() {}
+
+bool FilePrefetcher::isAvailable(QString* reason) {
+    return IoRing::isSupported(reason);
+}
+
+bool FilePrefetcher::run(const PathArena& paths, const QVector<quint32>& files, const CancellationToken* token,
+                         const WantFunction& want, int headBytes, const DeliverFunction& deliver,
+                         QString* error) {
+    m_stats = Stats();
+    QString localError;
+    error = error ? error : &localError;
+
+    auto deliverBare = [&](int from) {
+        for (int i = from; i < files.size() && !(token && token->isCancelled()); ++i) {
+            PrefetchedFile result;
+            result.file = files[i];
+            m_stats.filesBare++;
+            deliver(result);
+        }
+    };
+
+#ifdef Q_OS_LINUX
+    if (!IoRing::isSupported(error)) {
+        deliverBare(0);
+        return false;
+    }
+
+    // Declared first so it outlives the ring and any read still landing in it
+    QSharedPointer<BufferPool> pool(new BufferPool(SlotCount, SlotSize));
+    IoRing ring(QueueDepth);
+    if (!ring.isValid()) {
+        *error = ring.errorString();
+        deliverBare(0);
+        return false;
+    }
+    // Plain reads into the same slots if the memory cannot be pinned
+    m_stats.registeredBuffers = ring.registerBuffers(pool->base(), SlotSize, SlotCount);
+
+    QVector<Entry> entries(QueueDepth);
+    QVector<int> idle;
+    for (int index = QueueDepth - 1; index >= 0; --index) {
+        idle.append(index);
+    }
+    int active = 0;
+    int next = 0;
+
+    auto complete = [&](int index) {
+        Entry& entry = entries[index];
+        PrefetchedFile result;
+        result.file = entry.file;
+        if (entry.statOk) {
+            result.hasStat = true;
+            result.size = entry.stx.stx_size;
+            result.mtime = entry.stx.stx_mtime.tv_sec;
+        }
+
+        // A file that shrank since the statx is delivered as it was read
+        bool read = entry.readOk && entry.done > 0;
+        if (read && entry.whole) {
+            result.contents = QByteArray::fromRawData(pool->slot(entry.slot), qsizetype(entry.done));
+            result.complete = true;
+            result.lease = BufferLeasePtr(new BufferLease(pool, entry.slot));
+            m_stats.filesLoaded++;
+        } else {
+            if (read) {
+                result.contents = QByteArray(pool->slot(entry.slot), qsizetype(entry.done));
+                m_stats.filesHeaded++;
+            } else {
+                m_stats.filesBare++;
+            }
+            pool->release(entry.slot);
+        }
+        m_stats.bytesRead += entry.done;
+
+        active--;
+        idle.append(index);
+        if (!(token && token->isCancelled())) {
+            deliver(result);
+        }
+    };
+
+    auto readNext = [&](int index) {
+        Entry& entry = entries[index];
+        entry.phase = Entry::Read;
+        ring.prepareRead(entry.fd, pool->slot(entry.slot) + entry.done, entry.length - entry.done, entry.done,
+                         entry.slot, quint64(index));
+    };
+
+    auto closeFile = [&](int index) {
+        Entry& entry = entries[index];
+        entry.phase = Entry::Close;
+        ring.prepareClose(entry.fd, quint64(index));
+    };
+
+    auto advance = [&](int index, int result) {
+        Entry& entry = entries[index];
+        bool cancelled = token && token->isCancelled();
+        switch (entry.phase) {
+        case Entry::Stat: {
+            entry.statOk = result >= 0;
+            if (!entry.statOk || cancelled || !S_ISREG(entry.stx.stx_mode) || entry.stx.stx_size == 0) {
+                complete(index);
+                return;
+            }
+            quint64 size = entry.stx.stx_size;
+            entry.whole = size <= SlotSize && want(entry.file, size);
+            entry.length = entry.whole ? quint32(size) : quint32(qMin(size, quint64(qMax(headBytes, 0))));
+            if (entry.length == 0) {
+                complete(index);
+                return;
+            }
+            entry.phase = Entry::Open;
+            ring.prepareOpen(entry.path.constData(), O_RDONLY | O_CLOEXEC, quint64(index));
+            return;
+        }
+        case Entry::Open:
+            if (result < 0) {
+                complete(index);
+                return;
+            }
+            entry.fd = result;
+            if (cancelled) {
+                closeFile(index);
+                return;
+            }
+            readNext(index);
+            return;
+        case Entry::Read:
+            if (result < 0 || cancelled) {
+                entry.readOk = false;
+                closeFile(index);
+                return;
+            }
+            entry.readOk = true;
+            entry.done += quint32(result);
+            // Short reads continue where they stopped; 0 is the end of the file
+            if (result > 0 && entry.done < entry.length) {
+                readNext(index);
+                return;
+            }
+            closeFile(index);
+            return;
+        case Entry::Close:
+            complete(index);
+            return;
+        }
+    };
+
+    while (true) {
+        bool cancelled = token && token->isCancelled();
+        // A new file needs an entry and a slot; without a free slot the
+        // workers are behind, and the prefetcher waits for them
+        while (!cancelled && next < files.size() && !idle.isEmpty()) {
+            int slot = pool->tryAcquire();
+            if (slot < 0) {
+                break;
+            }
+            int index = idle.takeLast();
+            Entry& entry = entries[index];
+            entry.phase = Entry::Stat;
+            entry.file = files[next++];
+            entry.path = paths.encodedFilePath(entry.file);
+            entry.statOk = false;
+            entry.fd = -1;
+            entry.slot = slot;
+            entry.whole = false;
+            entry.length = 0;
+            entry.done = 0;
+            entry.readOk = false;
+            ring.prepareStatx(entry.path.constData(), STATX_WANTED, &entry.stx, quint64(index));
+            active++;
+        }
+        m_stats.peakInFlight = qMax(m_stats.peakInFlight, active);
+
+        if (active == 0) {
+            if (cancelled || next >= files.size()) {
+                break;
+            }
+            pool->waitForSlot(CANCEL_POLL_MS);
+            continue;
+        }
+
+        if (ring.submit(1) < 0) {
+            // Not seen in practice; whatever was in flight is given up on and
+            // everything not delivered yet goes out bare. Operations already in
+            // the kernel may still write into their slot or use their file, so
+            // they are waited for first; the ones only queued never start.
+            *error = ring.errorString();
+            bool drained = true;
+            while (drained && ring.inFlight() > 0) {
+                drained = ring.waitForCompletions(ring.inFlight());
+                quint64 userData = 0;
+                int result = 0;
+                while (ring.nextCompletion(&userData, &result)) {
+                    Entry& entry = entries[int(userData)];
+                    if (entry.phase == Entry::Open && result >= 0) {
+                        entry.fd = result;
+                    } else if (entry.phase == Entry::Close) {
+                        entry.fd = -1;
+                    }
+                }
+            }
+            if (!drained) {
+                // Nothing can tell when the kernel is done with the slots and
+                // files, so neither is given back: the pool is leaked on purpose
+                qWarning() << "io_uring operations could not be waited for:" << ring.errorString();
+                new QSharedPointer<BufferPool>(pool);
+            }
+            for (int index = 0; index < entries.size(); ++index) {
+                if (!idle.contains(index)) {
+                    if (!drained) {
+                        PrefetchedFile result;
+                        result.file = entries[index].file;
+                        m_stats.filesBare++;
+                        if (!(token && token->isCancelled())) {
+                            deliver(result);
+                        }
+                        continue;
+                    }
+                    if (entries[index].fd >= 0) {
+                        ::close(entries[index].fd);
+                    }
+                    entries[index].statOk = false;
+                    entries[index].readOk = false;
+                    complete(index);
+                }
+            }
+            deliverBare(next);
+            m_stats.submitCalls = ring.submitCalls();
+            return false;
+        }
+
+        quint64 userData = 0;
+        int result = 0;
+        while (ring.nextCompletion(&userData, &result)) {
+            advance(int(userData), result);
+        }
+    }
+
+    m_stats.submitCalls = ring.submitCalls();
+    return true;
+#else
+    Q_UNUSED(paths);
+    Q_UNUSED(want);
+    Q_UNUSED(headBytes);
+    IoRing::isSupported(error);
+    deliverBare(0);
+    return false;
+#endif
+}
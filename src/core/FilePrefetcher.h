@@ -0,0 +1,97 @@
+#ifndef FILEPREFETCHER_H
+#define FILEPREFETCHER_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "CancellationToken.h"
+#include "PathArena.h"
+
+class BufferPool;
+
+// Holds one slot of the prefetcher's buffer memory; the slot goes back to the
+// pool, and may be overwritten, once the last copy of the lease is gone
+class BufferLease {
+public:
+    ~BufferLease();
+
+private:
+    friend class FilePrefetcher;
+    BufferLease(const QSharedPointer<BufferPool>& pool, int slot) : m_pool(pool), m_slot(slot) {}
+
+    QSharedPointer<BufferPool> m_pool;
+    int m_slot;
+};
+typedef QSharedPointer<BufferLease> BufferLeasePtr;
+
+// What the prefetcher found out about one file. Without stat data the file
+// could not be looked at here and the consumer goes to the disk itself.
+struct PrefetchedFile {
+    quint32 file;
+    bool hasStat;
+    quint64 size;
+    qint64 mtime;           // seconds since the epoch
+    // The whole file when complete, else its first bytes (at most headBytes).
+    // A complete file's data lives in a pool slot and is valid while lease is held.
+    QByteArray contents;
+    bool complete;
+    BufferLeasePtr lease;
+
+    PrefetchedFile() : file(0), hasStat(false), size(0), mtime(0), complete(false) {}
+};
+
+// Loads the files of a scan ahead of the workers with io_uring: statx, openat,
+// read and close for up to QueueDepth files at a time, handed to the kernel in
+// one system call per round instead of four or more per file on every worker.
+// Reads of files the consumer will use whole go into a fixed set of
+// registered buffer slots. Other files only have their header read and give
+// their slot back at once, so the slots only hold back whole files: deliver()
+// is where the consumer caps how far ahead the prefetcher gets, by blocking.
+//
+// Runs on the calling thread. Where io_uring is missing every file is
+// delivered bare, and the consumer reads it the way it always did.
+class FilePrefetcher {
+public:
+    static const int QueueDepth = 64;
+    static const int SlotCount = 2 * QueueDepth;
+    static const quint32 SlotSize = 256 * 1024;
+
+    struct Stats {
+        quint64 filesLoaded;    // read whole
+        quint64 filesHeaded;    // header only
+        quint64 filesBare;      // nothing read: not regular, empty, unreadable, or io_uring unavailable
+        quint64 bytesRead;
+        quint64 submitCalls;
+        int peakInFlight;
+        bool registeredBuffers;
+
+        Stats()
+            : filesLoaded(0), filesHeaded(0), filesBare(0), bytesRead(0), submitCalls(0), peakInFlight(0),
+              registeredBuffers(false) {}
+    };
+
+    // Decides from the size whether the consumer wants a file whole
+    typedef std::function<bool(quint32 file, quint64 size)> WantFunction;
+    // Called on the prefetcher's thread, once per file, in about the order of files
+    typedef std::function<void(const PrefetchedFile& file)> DeliverFunction;
+
+    FilePrefetcher();
+
+    // io_uring with every operation the prefetcher needs
+    static bool isAvailable(QString* reason = nullptr);
+
+    // Delivers every file unless token is cancelled first; false if io_uring
+    // could not be used, with the reason in error, and the files went out bare
+    bool run(const PathArena& paths, const QVector<quint32>& files, const CancellationToken* token,
+             const WantFunction& want, int headBytes, const DeliverFunction& deliver,
+             QString* error = nullptr);
+
+    Stats stats() const { return m_stats; }
+
+private:
+    Stats m_stats;
+};
+
+#endif // FILEPREFETCHER_H
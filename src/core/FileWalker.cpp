@@ -0,0 +1,381 @@
+#include "FileWalker.h"
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QFile>
+#include <QVector>
+#include <QHash>
+#include <QDateTime>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/vfs.h>
+#endif
+
+namespace {
+
+struct PendingDir {
+    quint32 directory; // in the arena, which builds the path when it is opened
+    int node;          // position in the exclusion trie
+    quint64 device;    // st_dev, to notice mount points
+    quint32 previous;  // in the previous snapshot, None if new there or not incremental
+};
+
+#ifdef Q_OS_LINUX
+// statfs() magic numbers of kernel pseudo-filesystems, see statfs(2)
+const quint32 PSEUDO_FS_MAGIC[] = {
+    0x00009fa0,  // proc
+    0x62656572,  // sysfs
+    0x00001cd1,  // devpts
+    0x0027e0eb,  // cgroup
+    0x63677270,  // cgroup2
+    0x64626720,  // debugfs
+    0x74726163,  // tracefs
+    0x73636673,  // securityfs
+    0x6165676c,  // pstore
+    0xcafe4a11,  // bpf
+    0x62656570,  // configfs
+    0x65735543,  // fusectl
+    0x19800202,  // mqueue
+    0x42494e4d,  // binfmt_misc
+    0x958458f6,  // hugetlbfs
+    0x6e736673,  // nsfs
+};
+#endif
+
+#ifdef Q_OS_UNIX
+// A directory changed this shortly before its listing can change again
+// within the same timestamp tick; it is listed again next time
+const qint64 RACY_WINDOW_NS = 2000000000LL;
+
+// More subdirectories than this are looked up by hash
+const quint32 LINEAR_LOOKUP_CHILDREN = 32;
+
+DirectorySnapshot::Stamp stampOf(const struct stat& st) {
+    DirectorySnapshot::Stamp stamp;
+    stamp.inode = quint64(st.st_ino);
+    stamp.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.ctimeNs = qint64(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+    stamp.links = quint64(st.st_nlink);
+    return stamp;
+}
+
+// One directory's subdirectories in the previous snapshot, by name
+class PreviousChildren {
+public:
+    PreviousChildren(const DirectorySnapshot* snapshot, quint32 directory)
+        : m_snapshot(snapshot), m_directory(directory)
+    {
+        if (m_snapshot && m_directory != DirectorySnapshot::None
+            && m_snapshot->childCount(m_directory) > LINEAR_LOOKUP_CHILDREN) {
+            quint32 first = m_snapshot->firstChild(m_directory);
+            for (quint32 i = 0; i < m_snapshot->childCount(m_directory); ++i) {
+                m_byName.insert(m_snapshot->name(first + i), first + i);
+            }
+        }
+    }
+
+    quint32 find(const QByteArray& name) const {
+        if (!m_snapshot || m_directory == DirectorySnapshot::None) {
+            return DirectorySnapshot::None;
+        }
+        if (!m_byName.isEmpty()) {
+            return m_byName.value(name, DirectorySnapshot::None);
+        }
+        return m_snapshot->findChild(m_directory, name);
+    }
+
+private:
+    const DirectorySnapshot* m_snapshot;
+    quint32 m_directory;
+    QHash<QByteArray, quint32> m_byName;
+};
+#endif
+
+}
+
+FileWalker::FileWalker(const ExclusionRules& rules, const CancellationToken* token,
+                       ScanMetrics* metrics)
+    : m_rules(rules)
+    , m_token(token)
+    , m_metrics(metrics)
+    , m_filesFound(nullptr)
+{
+}
+
+bool FileWalker::isPseudoFilesystem(const QString& path) {
+#ifdef Q_OS_LINUX
+    struct statfs fs;
+    if (::statfs(QFile::encodeName(path).constData(), &fs) != 0) {
+        return false;
+    }
+
+    quint32 type = quint32(fs.f_type);
+    for (quint32 magic : PSEUDO_FS_MAGIC) {
+        if (type == magic) {
+            return true;
+        }
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    return false;
+}
+
+void FileWalker::setIncremental(const DirectorySnapshotPtr& previous) {
+    m_previous = previous ? previous : DirectorySnapshotPtr(new DirectorySnapshot);
+    m_snapshot.reset(new DirectorySnapshot);
+    m_snapshot->setFingerprint(m_rules.fingerprint());
+}
+
+PathArenaPtr FileWalker::walk(const QStringList& roots) {
+    QSharedPointer<PathArena> arena(new PathArena);
+
+    for (const QString& root : roots) {
+        if (m_token->isCancelled()) {
+            break;
+        }
+
+        QFileInfo info(root);
+        QString path = info.absoluteFilePath();
+        int node = m_rules.nodeForPath(path);
+        bool excluded = node == ExclusionRules::Excluded
+            || m_rules.matchesName(info.fileName())
+            || m_rules.matchesPath(path);
+
+        if (info.isFile()) {
+            if (excluded) {
+                m_stats.filesPruned++;
+            } else {
+                arena->addFile(PathArena::NoDirectory, QFile::encodeName(path));
+                countFile();
+            }
+        } else if (info.isDir()) {
+            if (excluded) {
+                m_stats.directoriesPruned++;
+            } else if (m_rules.skipPseudoFilesystems() && isPseudoFilesystem(path)) {
+                m_stats.pseudoFilesystems++;
+            } else {
+                walkTree(path, node, *arena);
+            }
+        }
+    }
+
+    arena->squeeze();
+    if (m_snapshot) {
+        m_snapshot->mergeRoots(*m_previous);
+        m_snapshot->squeeze();
+    }
+    return arena;
+}
+
+#ifdef Q_OS_UNIX
+
+void FileWalker::walkTree(const QString& root, int node, PathArena& arena) {
+    QByteArray encodedRoot = QFile::encodeName(root);
+    struct stat st;
+    if (::stat(encodedRoot.constData(), &st) != 0) {
+        return;
+    }
+
+    const quint64 rootDevice = st.st_dev;
+    DirectorySnapshot* snapshot = m_snapshot.data();
+    const DirectorySnapshot* previous = snapshot ? m_previous.data() : nullptr;
+    QVector<PendingDir> stack;
+    quint32 rootId = arena.addDirectory(PathArena::NoDirectory, encodedRoot);
+    if (snapshot) {
+        snapshot->addDirectory(DirectorySnapshot::None, encodedRoot, stampOf(st));
+    }
+    stack.append(PendingDir{rootId, node, rootDevice,
+                            previous ? previous->findRoot(encodedRoot) : DirectorySnapshot::None});
+
+    // Queues a subdirectory that passed the rules; dirFd is its parent's
+    auto enter = [&](const PendingDir& parent, int dirFd, const char* rawName, const QString& path,
+                     int childNode, quint32 previousChild) {
+        if (::fstatat(dirFd, rawName, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(st.st_mode)) {
+            return;
+        }
+
+        // A different st_dev means a mount point
+        quint64 device = st.st_dev;
+        if (device != parent.device) {
+            if (m_rules.oneFileSystem() && device != rootDevice) {
+                m_stats.otherFilesystems++;
+                return;
+            }
+            if (m_rules.skipPseudoFilesystems() && isPseudoFilesystem(path)) {
+                m_stats.pseudoFilesystems++;
+                return;
+            }
+        }
+
+        quint32 id = arena.addDirectory(parent.directory, QByteArray(rawName));
+        if (snapshot) {
+            snapshot->addDirectory(parent.directory, QByteArray(rawName), stampOf(st));
+        }
+        stack.append(PendingDir{id, childNode, device, previousChild});
+    };
+
+    while (!stack.isEmpty() && !m_token->isCancelled()) {
+        PendingDir current = stack.takeLast();
+        QByteArray encodedPath = arena.encodedDirectoryPath(current.directory);
+        QString currentPath = QFile::decodeName(encodedPath);
+        QString prefix = currentPath.endsWith('/') ? currentPath : currentPath + '/';
+        StageTimer listStage(m_metrics, ScanStage::Walk, currentPath);
+
+        // Same entries as last time: its subdirectories come from the snapshot, its files are not returned
+        if (previous && current.previous != DirectorySnapshot::None && previous->isTrusted(current.previous)
+            && previous->stamp(current.previous) == snapshot->stamp(current.directory)) {
+            int dirFd = ::open(encodedPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dirFd < 0) {
+                continue;
+            }
+
+            m_stats.directoriesUnchanged++;
+            m_stats.filesUnchanged += previous->fileCount(current.previous);
+            snapshot->setListed(current.directory, previous->fileCount(current.previous), true);
+
+            quint32 first = previous->firstChild(current.previous);
+            for (quint32 i = 0; i < previous->childCount(current.previous) && !m_token->isCancelled(); ++i) {
+                QByteArray rawName = previous->name(first + i);
+                QString name = QFile::decodeName(rawName);
+                QString path = prefix + name;
+                int childNode = m_rules.childNode(current.node, name);
+                if (childNode == ExclusionRules::Excluded || m_rules.matchesName(name) || m_rules.matchesPath(path)) {
+                    m_stats.directoriesPruned++;
+                    continue;
+                }
+                enter(current, dirFd, rawName.constData(), path, childNode, first + i);
+            }
+
+            ::close(dirFd);
+            continue;
+        }
+
+        DIR* dir = ::opendir(encodedPath.constData());
+        if (!dir) {
+            continue;
+        }
+
+        int dirFd = ::dirfd(dir);
+        qint64 listedAtNs = QDateTime::currentMSecsSinceEpoch() * 1000000LL;
+        PreviousChildren previousChildren(previous, current.previous);
+        quint32 files = 0;
+
+        while (struct dirent* entry = ::readdir(dir)) {
+            if (m_token->isCancelled()) {
+                break;
+            }
+
+            const char* rawName = entry->d_name;
+            if (rawName[0] == '.' && (rawName[1] == '\0' || (rawName[1] == '.' && rawName[2] == '\0'))) {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                if (::fstatat(dirFd, rawName, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR
+                     : S_ISREG(st.st_mode) ? DT_REG
+                     : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+            }
+
+            if (type == DT_LNK) {
+                // Links to files are scanned; linked directories are not followed
+                if (::fstatat(dirFd, rawName, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                    continue;
+                }
+                type = DT_REG;
+            }
+
+            // FIFOs, sockets and devices can block a reader and never hold a verdict
+            if (type != DT_DIR && type != DT_REG) {
+                continue;
+            }
+
+            QString name = QFile::decodeName(rawName);
+            QString path = prefix + name;
+
+            int childNode = m_rules.childNode(current.node, name);
+            if (childNode == ExclusionRules::Excluded || m_rules.matchesName(name) || m_rules.matchesPath(path)) {
+                if (type == DT_DIR) {
+                    m_stats.directoriesPruned++;
+                } else {
+                    m_stats.filesPruned++;
+                }
+                continue;
+            }
+
+            if (type == DT_REG) {
+                arena.addFile(current.directory, QByteArray(rawName));
+                countFile();
+                files++;
+                continue;
+            }
+
+            enter(current, dirFd, rawName, path, childNode,
+                  previous ? previousChildren.find(QByteArray(rawName)) : DirectorySnapshot::None);
+        }
+
+        ::closedir(dir);
+
+        if (snapshot) {
+            // Changed within the timestamp tick of the listing: it may change again unseen
+            const DirectorySnapshot::Stamp& stamp = snapshot->stamp(current.directory);
+            bool racy = listedAtNs - stamp.mtimeNs < RACY_WINDOW_NS || listedAtNs - stamp.ctimeNs < RACY_WINDOW_NS;
+            snapshot->setListed(current.directory, files, !racy && !m_token->isCancelled());
+        }
+    }
+}
+
+#else
+
+void FileWalker::walkTree(const QString& root, int node, PathArena& arena) {
+    QVector<PendingDir> stack;
+    // No incremental walk here, the snapshot stays empty
+    stack.append(PendingDir{arena.addDirectory(PathArena::NoDirectory, QFile::encodeName(root)), node, 0,
+                            DirectorySnapshot::None});
+
+    while (!stack.isEmpty() && !m_token->isCancelled()) {
+        PendingDir current = stack.takeLast();
+        QString currentPath = arena.directoryPath(current.directory);
+        StageTimer listStage(m_metrics, ScanStage::Walk, currentPath);
+
+        QDirIterator it(currentPath, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+        while (it.hasNext() && !m_token->isCancelled()) {
+            QString path = it.next();
+            QFileInfo info = it.fileInfo();
+            bool isDir = info.isDir() && !info.isSymLink();
+            if (!isDir && !info.isFile()) {
+                continue;
+            }
+
+            QString name = info.fileName();
+            int childNode = m_rules.childNode(current.node, name);
+            if (childNode == ExclusionRules::Excluded || m_rules.matchesName(name) || m_rules.matchesPath(path)) {
+                if (isDir) {
+                    m_stats.directoriesPruned++;
+                } else {
+                    m_stats.filesPruned++;
+                }
+                continue;
+            }
+
+            if (isDir) {
+                stack.append(PendingDir{arena.addDirectory(current.directory, QFile::encodeName(name)), childNode, 0,
+                                        DirectorySnapshot::None});
+            } else {
+                arena.addFile(current.directory, QFile::encodeName(name));
+                countFile();
+            }
+        }
+    }
+}
+
+#endif
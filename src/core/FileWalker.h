@@ -0,0 +1,67 @@
+#ifndef FILEWALKER_H
+#define FILEWALKER_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include "ExclusionRules.h"
+#include "CancellationToken.h"
+#include "ScanMetrics.h"
+#include "PathArena.h"
+#include "DirectorySnapshot.h"
+
+// Enumerates the regular files below a set of roots, evaluating the exclusion
+// rules once per directory entry so excluded subtrees are never opened. The
+// files come back as a PathArena, in walk order.
+//
+// An incremental walk stats every directory but lists only those changed
+// since the previous snapshot; see DirectorySnapshot for what that misses.
+class FileWalker {
+public:
+    struct Stats {
+        quint64 directoriesPruned;   // excluded by a rule, subtree not read
+        quint64 filesPruned;
+        quint64 otherFilesystems;    // mount points skipped in one-file-system mode
+        quint64 pseudoFilesystems;   // proc, sysfs, cgroup, ... mount points skipped
+        quint64 directoriesUnchanged;  // incremental: not listed, files not returned
+        quint64 filesUnchanged;        // in those, as of the previous walk
+
+        Stats() : directoriesPruned(0), filesPruned(0), otherFilesystems(0), pseudoFilesystems(0)
+                , directoriesUnchanged(0), filesUnchanged(0) {}
+        quint64 totalPruned() const {
+            return directoriesPruned + filesPruned + otherFilesystems + pseudoFilesystems;
+        }
+    };
+
+    FileWalker(const ExclusionRules& rules, const CancellationToken* token,
+               ScanMetrics* metrics = nullptr);
+
+    // Before walk(); previous may be empty, which lists everything once
+    void setIncremental(const DirectorySnapshotPtr& previous);
+    // Bumped for every file returned, so progress can be read while the walk runs
+    void setFilesFound(std::atomic<quint64>* counter) { m_filesFound = counter; }
+    PathArenaPtr walk(const QStringList& roots);
+    Stats stats() const { return m_stats; }
+    // Incremental only: this walk's directories, plus the previous roots it did not walk
+    QSharedPointer<DirectorySnapshot> snapshot() const { return m_snapshot; }
+
+    static bool isPseudoFilesystem(const QString& path);
+
+private:
+    void walkTree(const QString& root, int node, PathArena& arena);
+    void countFile() {
+        if (m_filesFound) {
+            m_filesFound->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const ExclusionRules& m_rules;
+    const CancellationToken* m_token;
+    ScanMetrics* m_metrics;     // optional, times each directory listing
+    std::atomic<quint64>* m_filesFound;  // optional
+    Stats m_stats;
+    DirectorySnapshotPtr m_previous;
+    QSharedPointer<DirectorySnapshot> m_snapshot;  // ids match the arena's directories
+};
+
+#endif // FILEWALKER_H
@@ -0,0 +1,264 @@
+#include "HashIndex.h"
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDir>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'A', 'V', 'H', 'A', 'S', 'H', '1'};
+const quint32 VERSION = 1;
+
+// Large enough reads that hashing is CPU-bound, not syscall-bound
+const qint64 READ_CHUNK = 256 * 1024;
+
+quint64 readU64(const uchar* data) {
+    quint64 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+quint32 readU32(const uchar* data) {
+    quint32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+QCryptographicHash::Algorithm algorithm(HashIndex::HashType type) {
+    switch (type) {
+    case HashIndex::Md5:
+        return QCryptographicHash::Md5;
+    case HashIndex::Sha1:
+        return QCryptographicHash::Sha1;
+    default:
+        return QCryptographicHash::Sha256;
+    }
+}
+
+}
+
+HashIndex::HashIndex()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_header(nullptr)
+{
+}
+
+HashIndex::~HashIndex() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+}
+
+int HashIndex::digestSize(HashType type) {
+    switch (type) {
+    case Md5:
+        return 16;
+    case Sha1:
+        return 20;
+    default:
+        return 32;
+    }
+}
+
+QString HashIndex::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/hashindex";
+}
+
+QString HashIndex::defaultPath() {
+    return defaultDirectory() + "/index.bin";
+}
+
+QSharedPointer<const HashIndex> HashIndex::open(const QString& path, QString* error) {
+    QSharedPointer<HashIndex> index(new HashIndex);
+    index->m_file.setFileName(path);
+    if (!index->m_file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = index->m_file.errorString();
+        }
+        return QSharedPointer<const HashIndex>();
+    }
+
+    // The mapping stays valid after the builder renames a new index over this one
+    index->m_size = quint64(index->m_file.size());
+    index->m_data = index->m_size >= sizeof(Header) ? index->m_file.map(0, qint64(index->m_size)) : nullptr;
+    if (!index->m_data) {
+        if (error) {
+            *error = "Cannot map hash index";
+        }
+        return QSharedPointer<const HashIndex>();
+    }
+
+    index->m_header = reinterpret_cast<const Header*>(index->m_data);
+    const Header* header = index->m_header;
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+        && header->version == VERSION
+        && header->bloomBits > 0 && (header->bloomBits & (header->bloomBits - 1)) == 0
+        && header->bloomOffset + header->bloomBits / 8 <= index->m_size
+        && header->sizeOffset + header->sizeCount * 8 <= index->m_size
+        && header->namesOffset + header->namesSize <= index->m_size;
+    for (int type = 0; valid && type < HashTypeCount; ++type) {
+        valid = header->tableOffset[type] + header->tableCount[type] * recordSize(HashType(type)) <= index->m_size;
+    }
+    if (!valid) {
+        if (error) {
+            *error = "Not a FastAV hash index, or built by another version";
+        }
+        return QSharedPointer<const HashIndex>();
+    }
+
+    return index;
+}
+
+quint64 HashIndex::signatureCount() const {
+    quint64 total = 0;
+    for (int type = 0; type < HashTypeCount; ++type) {
+        total += m_header->tableCount[type];
+    }
+    return total;
+}
+
+bool HashIndex::hasSize(quint64 fileSize) const {
+    const uchar* sizes = m_data + m_header->sizeOffset;
+    quint64 low = 0;
+    quint64 high = m_header->sizeCount;
+    while (low < high) {
+        quint64 middle = (low + high) / 2;
+        quint64 value = readU64(sizes + middle * 8);
+        if (value == fileSize) {
+            return true;
+        } else if (value < fileSize) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+void HashIndex::bloomPositions(const unsigned char* digest, quint64 bloomBits, quint32 count,
+                               quint64* positions) {
+    // Digests are already uniformly distributed; double hashing on two words of it
+    quint64 first = readU64(digest);
+    quint64 second = readU64(digest + 8) | 1;
+    for (quint32 i = 0; i < count; ++i) {
+        positions[i] = (first + i * second) & (bloomBits - 1);
+    }
+}
+
+bool HashIndex::mayContain(const unsigned char* digest) const {
+    quint64 positions[32];
+    quint32 count = qMin(m_header->bloomHashes, quint32(32));
+    bloomPositions(digest, m_header->bloomBits, count, positions);
+
+    const uchar* bits = m_data + m_header->bloomOffset;
+    for (quint32 i = 0; i < count; ++i) {
+        if (!(bits[positions[i] / 8] & (1 << (positions[i] % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HashIndex::contains(HashType type, const unsigned char* digest, quint64 fileSize, QString* name) const {
+    if (!mayContain(digest)) {
+        return false;
+    }
+
+    const int length = digestSize(type);
+    const int stride = recordSize(type);
+    const uchar* table = m_data + m_header->tableOffset[type];
+
+    // First record whose digest is not below ours
+    quint64 low = 0;
+    quint64 high = m_header->tableCount[type];
+    while (low < high) {
+        quint64 middle = (low + high) / 2;
+        if (std::memcmp(table + middle * stride, digest, length) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Same digest can be listed with several sizes
+    for (quint64 i = low; i < m_header->tableCount[type]; ++i) {
+        const uchar* record = table + i * stride;
+        if (std::memcmp(record, digest, length) != 0) {
+            break;
+        }
+        if (readU64(record + length) == fileSize) {
+            if (name) {
+                quint32 offset = readU32(record + length + 8);
+                const char* text = reinterpret_cast<const char*>(m_data + m_header->namesOffset + offset);
+                *name = QString::fromUtf8(text, qsizetype(qstrnlen(text, size_t(m_header->namesSize - offset))));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HashIndex::matchFile(const QString& path, quint64 fileSize, QString* name,
+                          const CancellationToken* token, const QByteArray* contents, ReadCount* read) const {
+    if (!hasSize(fileSize)) {
+        return false;
+    }
+
+    SparseFile file(path);
+    if (!contents && !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // One pass over the file feeds every digest type the index has entries for
+    QCryptographicHash* hashers[HashTypeCount] = {nullptr, nullptr, nullptr};
+    for (int type = 0; type < HashTypeCount; ++type) {
+        if (m_header->tableCount[type] > 0) {
+            hashers[type] = new QCryptographicHash(algorithm(HashType(type)));
+            if (contents) {
+                hashers[type]->addData(*contents);
+            }
+        }
+    }
+
+    QByteArray buffer(contents ? 0 : int(qMin(qint64(fileSize), READ_CHUNK)), Qt::Uninitialized);
+    bool complete = true;
+    while (!contents) {
+        if (token && token->isCancelled()) {
+            complete = false;
+            break;
+        }
+        qint64 length = file.read(buffer.data(), buffer.size());
+        if (length < 0) {
+            complete = false;
+            break;
+        }
+        if (length == 0) {
+            break;
+        }
+        for (QCryptographicHash* hasher : hashers) {
+            if (hasher) {
+                hasher->addData(QByteArrayView(buffer.constData(), length));
+            }
+        }
+    }
+
+    if (read && !contents) {
+        *read += file.readCount();
+    }
+
+    bool found = false;
+    for (int type = 0; type < HashTypeCount && complete && !found; ++type) {
+        if (hashers[type]) {
+            QByteArray digest = hashers[type]->result();
+            found = contains(HashType(type), reinterpret_cast<const unsigned char*>(digest.constData()),
+                             fileSize, name);
+        }
+    }
+
+    for (QCryptographicHash* hasher : hashers) {
+        delete hasher;
+    }
+    return found;
+}
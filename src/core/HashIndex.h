@@ -0,0 +1,84 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <QString>
+#include <QFile>
+#include <QSharedPointer>
+#include "CancellationToken.h"
+#include "SparseFile.h"
+
+// Read-only, memory-mapped index of ClamAV's whole-file hash signatures
+// (.hdb/.hsb and the copies inside main/daily.cvd), so exact known-bad files
+// are flagged without a backend round trip. Built by HashIndexBuilder.
+//
+// Layout: header, the sorted distinct file sizes, a Bloom filter over all
+// digests, then one table per digest type sorted by digest, then the
+// signature names. A file is only hashed when its size is in the size table,
+// and a digest is only searched for when the Bloom filter lets it through.
+class HashIndex {
+public:
+    enum HashType {
+        Md5,
+        Sha1,
+        Sha256,
+        HashTypeCount
+    };
+
+    static const int MaxDigestSize = 32;
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 bloomHashes;
+        quint64 bloomBits;      // a power of two
+        quint64 bloomOffset;
+        quint64 sizeCount;
+        quint64 sizeOffset;
+        quint64 tableCount[HashTypeCount];
+        quint64 tableOffset[HashTypeCount];
+        quint64 namesOffset;
+        quint64 namesSize;
+    };
+
+    // Table record: digest, then file size (quint64), then name offset (quint32)
+    static int digestSize(HashType type);
+    static int recordSize(HashType type) { return digestSize(type) + 12; }
+
+    ~HashIndex();
+
+    // Null if the file is missing or not a valid index
+    static QSharedPointer<const HashIndex> open(const QString& path, QString* error = nullptr);
+    static QString defaultDirectory();
+    static QString defaultPath();
+
+    quint64 signatureCount() const;
+    bool hasSize(quint64 fileSize) const;
+
+    // Looks up a digest the caller already has; the name is set on a match
+    bool contains(HashType type, const unsigned char* digest, quint64 fileSize, QString* name = nullptr) const;
+
+    // Reads the file once, computing only the digests the index has tables
+    // for. False without reading if the size rules the file out. contents,
+    // when given, is the whole file already in memory and nothing is read.
+    // Holes of a sparse file are hashed as the zeros they are, without a
+    // read; read, when given, adds up what was read.
+    bool matchFile(const QString& path, quint64 fileSize, QString* name,
+                   const CancellationToken* token = nullptr, const QByteArray* contents = nullptr,
+                   ReadCount* read = nullptr) const;
+
+    static void bloomPositions(const unsigned char* digest, quint64 bloomBits, quint32 count, quint64* positions);
+
+private:
+    HashIndex();
+
+    bool mayContain(const unsigned char* digest) const;
+
+    QFile m_file;
+    const uchar* m_data;
+    quint64 m_size;
+    const Header* m_header;
+};
+
+typedef QSharedPointer<const HashIndex> HashIndexPtr;
+
+#endif // HASHINDEX_H
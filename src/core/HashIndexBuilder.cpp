@@ -0,0 +1,570 @@
+#include "HashIndexBuilder.h"
+#include "HashIndex.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QMutex>
+#include <QDebug>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+// .cvd/.cld: a 512-byte text header, then a (usually gzipped) tar
+const int CVD_HEADER_SIZE = 512;
+const int TAR_BLOCK = 512;
+const qint64 READ_CHUNK = 1024 * 1024;
+
+const quint32 CACHE_MAGIC = 0x46415653;  // "FAVS"
+const quint32 CACHE_VERSION = 1;
+
+// ~1% false positives at 10 bits and 7 probes per entry
+const quint64 BLOOM_BITS_PER_ENTRY = 10;
+const quint32 BLOOM_HASHES = 7;
+
+QMutex rebuildMutex;
+
+struct Signature {
+    quint8 type;
+    bool falsePositive;
+    quint64 size;
+    QByteArray digest;
+    QByteArray name;
+};
+
+typedef std::function<void(const QString& member, const QByteArray& data)> MemberHandler;
+
+bool isFalsePositiveList(const QString& name) {
+    return name.endsWith(".fp") || name.endsWith(".sfp");
+}
+
+bool isHashList(const QString& name) {
+    return name.endsWith(".hdb") || name.endsWith(".hsb") || name.endsWith(".hdu")
+        || name.endsWith(".hsu") || isFalsePositiveList(name);
+}
+
+// "HashString:FileSize:MalwareName[:MinFL[:MaxFL]]"; the digest length gives its type
+void parseHashList(const QByteArray& data, bool falsePositive, QVector<Signature>& out, quint64* wildcards) {
+    int start = 0;
+    while (start < data.size()) {
+        int end = data.indexOf('\n', start);
+        if (end < 0) {
+            end = data.size();
+        }
+        QByteArray line = data.mid(start, end - start).trimmed();
+        start = end + 1;
+
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QList<QByteArray> fields = line.split(':');
+        if (fields.size() < 3) {
+            continue;
+        }
+
+        HashIndex::HashType type;
+        switch (fields[0].size()) {
+        case 32:
+            type = HashIndex::Md5;
+            break;
+        case 40:
+            type = HashIndex::Sha1;
+            break;
+        case 64:
+            type = HashIndex::Sha256;
+            break;
+        default:
+            continue;
+        }
+
+        if (fields[1] == "*") {
+            (*wildcards)++;
+            continue;
+        }
+        bool ok = false;
+        quint64 size = fields[1].toULongLong(&ok);
+        QByteArray digest = QByteArray::fromHex(fields[0]);
+        if (!ok || digest.size() != HashIndex::digestSize(type)) {
+            continue;
+        }
+
+        Signature signature;
+        signature.type = quint8(type);
+        signature.falsePositive = falsePositive;
+        signature.size = size;
+        signature.digest = digest;
+        signature.name = fields[2];
+        out.append(signature);
+    }
+}
+
+// Streams tar members to the handler, keeping only the hash lists in memory
+class TarReader {
+public:
+    explicit TarReader(const MemberHandler& handler)
+        : m_handler(handler), m_remaining(0), m_padding(0), m_wanted(false), m_finished(false) {}
+
+    void feed(const char* data, qint64 size) {
+        while (size > 0 && !m_finished) {
+            if (m_padding > 0) {
+                qint64 skip = qMin(size, m_padding);
+                data += skip;
+                size -= skip;
+                m_padding -= skip;
+            } else if (m_remaining > 0) {
+                qint64 take = qMin(size, m_remaining);
+                if (m_wanted) {
+                    m_data.append(data, take);
+                }
+                data += take;
+                size -= take;
+                m_remaining -= take;
+                if (m_remaining == 0) {
+                    finishMember();
+                }
+            } else {
+                qint64 take = qMin(size, qint64(TAR_BLOCK - m_header.size()));
+                m_header.append(data, take);
+                data += take;
+                size -= take;
+                if (m_header.size() == TAR_BLOCK) {
+                    startMember();
+                }
+            }
+        }
+    }
+
+private:
+    void startMember() {
+        const char* header = m_header.constData();
+        if (header[0] == '\0') {
+            // Zero block: end of archive
+            m_finished = true;
+            return;
+        }
+
+        m_name = QString::fromLatin1(header, qsizetype(qstrnlen(header, 100)));
+        QByteArray sizeField(header + 124, 12);
+        int terminator = sizeField.indexOf('\0');
+        if (terminator >= 0) {
+            sizeField.truncate(terminator);
+        }
+        qint64 size = qint64(sizeField.trimmed().toULongLong(nullptr, 8));
+        char typeFlag = header[156];
+
+        m_wanted = (typeFlag == '0' || typeFlag == '\0') && isHashList(m_name);
+        m_data.clear();
+        if (m_wanted) {
+            m_data.reserve(size);
+        }
+        m_remaining = size;
+        m_padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+        m_header.clear();
+
+        if (size == 0) {
+            finishMember();
+        }
+    }
+
+    void finishMember() {
+        if (m_wanted) {
+            m_handler(m_name, m_data);
+        }
+        m_data.clear();
+        m_wanted = false;
+    }
+
+    MemberHandler m_handler;
+    QByteArray m_header;
+    QByteArray m_data;
+    QString m_name;
+    qint64 m_remaining;
+    qint64 m_padding;
+    bool m_wanted;
+    bool m_finished;
+};
+
+bool readArchive(const QString& path, const MemberHandler& handler, QString* error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    if (!file.read(CVD_HEADER_SIZE).startsWith("ClamAV-VDB:")) {
+        *error = "Not a ClamAV database archive";
+        return false;
+    }
+
+    TarReader tar(handler);
+    QByteArray input = file.read(READ_CHUNK);
+
+    // .cld files are usually stored uncompressed
+    bool gzipped = input.size() >= 2 && uchar(input[0]) == 0x1f && uchar(input[1]) == 0x8b;
+    if (!gzipped) {
+        while (!input.isEmpty()) {
+            tar.feed(input.constData(), input.size());
+            input = file.read(READ_CHUNK);
+        }
+        return true;
+    }
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        *error = "Cannot initialise zlib";
+        return false;
+    }
+
+    QByteArray output(256 * 1024, Qt::Uninitialized);
+    int result = Z_OK;
+    while (result != Z_STREAM_END && !input.isEmpty()) {
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = uInt(input.size());
+
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = uInt(output.size());
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                inflateEnd(&stream);
+                *error = QString("Corrupt archive: %1").arg(stream.msg ? stream.msg : "inflate failed");
+                return false;
+            }
+            tar.feed(output.constData(), output.size() - qint64(stream.avail_out));
+        } while (stream.avail_out == 0 && result != Z_STREAM_END);
+
+        input = file.read(READ_CHUNK);
+    }
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END) {
+        *error = "Truncated archive";
+        return false;
+    }
+    return true;
+}
+
+struct SourceEntries {
+    QVector<Signature> signatures;
+    quint64 wildcards;
+
+    SourceEntries() : wildcards(0) {}
+};
+
+bool parseSource(const QFileInfo& source, SourceEntries* entries, QString* error) {
+    MemberHandler handler = [entries](const QString& member, const QByteArray& data) {
+        parseHashList(data, isFalsePositiveList(member), entries->signatures, &entries->wildcards);
+    };
+
+    QString suffix = source.suffix();
+    if (suffix == "cvd" || suffix == "cld") {
+        return readArchive(source.filePath(), handler, error);
+    }
+
+    QFile file(source.filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    handler(source.fileName(), file.readAll());
+    return true;
+}
+
+QString cachePath(const QString& indexDirectory, const QFileInfo& source) {
+    return indexDirectory + "/sources/" + source.fileName() + ".sig";
+}
+
+bool loadCache(const QString& path, const QFileInfo& source, SourceEntries* entries) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 size = 0;
+    qint64 modified = 0;
+    quint32 count = 0;
+    in >> magic >> version >> size >> modified >> entries->wildcards >> count;
+    if (magic != CACHE_MAGIC || version != CACHE_VERSION || size != quint64(source.size())
+        || modified != source.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+
+    entries->signatures.resize(count);
+    for (Signature& signature : entries->signatures) {
+        in >> signature.type >> signature.falsePositive >> signature.size >> signature.digest >> signature.name;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+void saveCache(const QString& path, const QFileInfo& source, const SourceEntries& entries) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot cache hash signatures of" << source.fileName() << "-" << file.errorString();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CACHE_MAGIC << CACHE_VERSION << quint64(source.size())
+        << qint64(source.lastModified().toMSecsSinceEpoch()) << entries.wildcards
+        << quint32(entries.signatures.size());
+    for (const Signature& signature : entries.signatures) {
+        out << signature.type << signature.falsePositive << signature.size << signature.digest << signature.name;
+    }
+    file.commit();
+}
+
+QByteArray signatureKey(const Signature& signature) {
+    QByteArray key;
+    key.reserve(1 + signature.digest.size() + 8);
+    key.append(char(signature.type));
+    key.append(signature.digest);
+    key.append(reinterpret_cast<const char*>(&signature.size), sizeof(signature.size));
+    return key;
+}
+
+quint64 align8(quint64 offset) {
+    return (offset + 7) & ~quint64(7);
+}
+
+bool writeIndex(const QString& path, QVector<Signature> tables[HashIndex::HashTypeCount], QString* error) {
+    // Distinct sizes, for the cheap "could this file be listed at all" check
+    QVector<quint64> sizes;
+    quint64 total = 0;
+    for (int type = 0; type < HashIndex::HashTypeCount; ++type) {
+        for (const Signature& signature : tables[type]) {
+            sizes.append(signature.size);
+        }
+        total += tables[type].size();
+    }
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    quint64 bloomBits = 64 * 8;
+    while (bloomBits < total * BLOOM_BITS_PER_ENTRY) {
+        bloomBits *= 2;
+    }
+    QByteArray bloom(int(bloomBits / 8), '\0');
+
+    QByteArray names;
+    QHash<QByteArray, quint32> nameOffsets;
+    QByteArray records[HashIndex::HashTypeCount];
+    for (int type = 0; type < HashIndex::HashTypeCount; ++type) {
+        records[type].reserve(tables[type].size() * HashIndex::recordSize(HashIndex::HashType(type)));
+        for (const Signature& signature : tables[type]) {
+            auto offset = nameOffsets.constFind(signature.name);
+            if (offset == nameOffsets.constEnd()) {
+                offset = nameOffsets.insert(signature.name, quint32(names.size()));
+                names.append(signature.name);
+                names.append('\0');
+            }
+
+            records[type].append(signature.digest);
+            records[type].append(reinterpret_cast<const char*>(&signature.size), sizeof(signature.size));
+            quint32 nameOffset = offset.value();
+            records[type].append(reinterpret_cast<const char*>(&nameOffset), sizeof(nameOffset));
+
+            quint64 positions[BLOOM_HASHES];
+            HashIndex::bloomPositions(reinterpret_cast<const unsigned char*>(signature.digest.constData()),
+                                      bloomBits, BLOOM_HASHES, positions);
+            for (quint64 position : positions) {
+                bloom[int(position / 8)] = char(bloom[int(position / 8)] | (1 << (position % 8)));
+            }
+        }
+    }
+
+    HashIndex::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "FAVHASH1", sizeof(header.magic));
+    header.version = 1;
+    header.bloomHashes = BLOOM_HASHES;
+    header.bloomBits = bloomBits;
+
+    quint64 offset = align8(sizeof(header));
+    header.sizeOffset = offset;
+    header.sizeCount = quint64(sizes.size());
+    offset = align8(offset + header.sizeCount * 8);
+    header.bloomOffset = offset;
+    offset = align8(offset + quint64(bloom.size()));
+    for (int type = 0; type < HashIndex::HashTypeCount; ++type) {
+        header.tableOffset[type] = offset;
+        header.tableCount[type] = quint64(tables[type].size());
+        offset = align8(offset + quint64(records[type].size()));
+    }
+    header.namesOffset = offset;
+    header.namesSize = quint64(names.size());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    auto writeAt = [&file](quint64 position, const char* data, qint64 size) {
+        static const char padding[8] = {0};
+        while (quint64(file.pos()) < position) {
+            file.write(padding, qMin(qint64(8), qint64(position - quint64(file.pos()))));
+        }
+        file.write(data, size);
+    };
+    writeAt(0, reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.sizeOffset, reinterpret_cast<const char*>(sizes.constData()), sizes.size() * 8);
+    writeAt(header.bloomOffset, bloom.constData(), bloom.size());
+    for (int type = 0; type < HashIndex::HashTypeCount; ++type) {
+        writeAt(header.tableOffset[type], records[type].constData(), records[type].size());
+    }
+    writeAt(header.namesOffset, names.constData(), names.size());
+
+    if (!file.commit()) {
+        *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+}
+
+QStringList HashIndexBuilder::sourceFiles(const QString& databaseDirectory) {
+    QStringList sources;
+    const QFileInfoList entries = QDir(databaseDirectory).entryInfoList(
+        QStringList() << "*.cvd" << "*.cld" << "*.hdb" << "*.hsb" << "*.hdu" << "*.hsu" << "*.fp" << "*.sfp",
+        QDir::Files | QDir::Readable, QDir::Name);
+    for (const QFileInfo& entry : entries) {
+        sources.append(entry.filePath());
+    }
+    return sources;
+}
+
+bool HashIndexBuilder::rebuild(const QString& databaseDirectory, const QString& indexDirectory,
+                               QString* error, Stats* stats) {
+    QString localError;
+    error = error ? error : &localError;
+    Stats localStats;
+    stats = stats ? stats : &localStats;
+
+    // A second rebuild would only redo the same work
+    if (!rebuildMutex.tryLock()) {
+        *error = "A rebuild is already running";
+        return false;
+    }
+    struct Unlock {
+        ~Unlock() { rebuildMutex.unlock(); }
+    } unlock;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!QDir().mkpath(indexDirectory + "/sources")) {
+        *error = "Cannot create " + indexDirectory;
+        return false;
+    }
+
+    QStringList sources = sourceFiles(databaseDirectory);
+    stats->sources = sources.size();
+
+    // Same sources with the same sizes and mtimes: the index is current
+    QByteArray manifest;
+    for (const QString& path : sources) {
+        QFileInfo source(path);
+        manifest += source.fileName().toUtf8() + '\t' + QByteArray::number(source.size()) + '\t'
+            + QByteArray::number(source.lastModified().toMSecsSinceEpoch()) + '\n';
+    }
+    QString indexPath = indexDirectory + "/index.bin";
+    QString manifestPath = indexDirectory + "/manifest";
+    QFile previousManifest(manifestPath);
+    if (previousManifest.open(QIODevice::ReadOnly) && previousManifest.readAll() == manifest
+        && HashIndex::open(indexPath)) {
+        stats->unchanged = true;
+        stats->elapsedMs = timer.elapsed();
+        return true;
+    }
+
+    QVector<Signature> tables[HashIndex::HashTypeCount];
+    QSet<QByteArray> falsePositives;
+    QSet<QString> cacheFiles;
+
+    for (const QString& path : sources) {
+        QFileInfo source(path);
+        QString cache = cachePath(indexDirectory, source);
+        cacheFiles.insert(QFileInfo(cache).fileName());
+
+        SourceEntries entries;
+        if (!loadCache(cache, source, &entries)) {
+            entries = SourceEntries();
+            QString sourceError;
+            if (!parseSource(source, &entries, &sourceError)) {
+                // One bad archive should not cost the signatures of the others
+                qWarning() << "Skipping hash signatures of" << source.fileName() << "-" << sourceError;
+                continue;
+            }
+            saveCache(cache, source, entries);
+            stats->sourcesParsed++;
+        }
+
+        stats->wildcardSizes += entries.wildcards;
+        for (const Signature& signature : entries.signatures) {
+            if (signature.falsePositive) {
+                falsePositives.insert(signatureKey(signature));
+            } else {
+                tables[signature.type].append(signature);
+            }
+        }
+    }
+
+    // Drop caches of sources that are gone, e.g. a .cld replaced by a .cvd
+    QDir cacheDirectory(indexDirectory + "/sources");
+    for (const QString& name : cacheDirectory.entryList(QStringList() << "*.sig", QDir::Files)) {
+        if (!cacheFiles.contains(name)) {
+            cacheDirectory.remove(name);
+        }
+    }
+
+    for (int type = 0; type < HashIndex::HashTypeCount; ++type) {
+        QVector<Signature>& table = tables[type];
+        if (!falsePositives.isEmpty()) {
+            auto end = std::remove_if(table.begin(), table.end(), [&falsePositives](const Signature& signature) {
+                return falsePositives.contains(signatureKey(signature));
+            });
+            stats->falsePositives += quint64(table.end() - end);
+            table.erase(end, table.end());
+        }
+
+        std::sort(table.begin(), table.end(), [](const Signature& a, const Signature& b) {
+            int order = std::memcmp(a.digest.constData(), b.digest.constData(), size_t(a.digest.size()));
+            return order != 0 ? order < 0 : a.size < b.size;
+        });
+        table.erase(std::unique(table.begin(), table.end(), [](const Signature& a, const Signature& b) {
+            return a.digest == b.digest && a.size == b.size;
+        }), table.end());
+        stats->signatures += quint64(table.size());
+    }
+
+    if (!writeIndex(indexPath, tables, error)) {
+        return false;
+    }
+
+    QSaveFile manifestFile(manifestPath);
+    if (manifestFile.open(QIODevice::WriteOnly)) {
+        manifestFile.write(manifest);
+        manifestFile.commit();
+    }
+
+    stats->elapsedMs = timer.elapsed();
+    qDebug() << "Hash index rebuilt:" << stats->signatures << "signatures from" << stats->sources
+             << "sources (" << stats->sourcesParsed << "parsed," << stats->falsePositives << "false positives,"
+             << stats->wildcardSizes << "wildcard sizes left to the backend) in" << stats->elapsedMs << "ms";
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef HASHINDEXBUILDER_H
+#define HASHINDEXBUILDER_H
+
+#include <QString>
+#include <QStringList>
+
+// Builds the HashIndex from a ClamAV database directory: loose .hdb/.hsb/
+// .hdu/.hsu files and the members of the same names inside .cvd/.cld
+// archives. Entries also listed in .fp/.sfp (false positives) are left out.
+// Wildcard-size entries ("*") are left to the backend: without a size they
+// would force hashing every file.
+//
+// Each source's parsed entries are cached next to the index, keyed by the
+// source's size and mtime, so after freshclam only changed archives (usually
+// just daily) are decompressed and parsed again. The new index is written
+// beside the old one and renamed over it; open mappings keep the old data.
+class HashIndexBuilder {
+public:
+    struct Stats {
+        int sources;
+        int sourcesParsed;     // not served from the cache
+        quint64 signatures;
+        quint64 falsePositives;
+        quint64 wildcardSizes;
+        qint64 elapsedMs;
+        bool unchanged;        // nothing to do, the index is current
+
+        Stats() : sources(0), sourcesParsed(0), signatures(0), falsePositives(0),
+                  wildcardSizes(0), elapsedMs(0), unchanged(false) {}
+    };
+
+    // Returns false on failure, or when another rebuild is already running
+    static bool rebuild(const QString& databaseDirectory, const QString& indexDirectory,
+                        QString* error = nullptr, Stats* stats = nullptr);
+
+    static QStringList sourceFiles(const QString& databaseDirectory);
+};
+
+#endif // HASHINDEXBUILDER_H
@@ -0,0 +1,334 @@
+#include "IoRing.h"
+#include <QMutex>
+#include <cstring>
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#define FASTAV_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <vector>
+#endif
+
+#ifdef FASTAV_IO_URING
+
+struct IoRing::Submission : io_uring_sqe {};
+
+namespace {
+
+int ringSetup(unsigned entries, io_uring_params* params) {
+    return int(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return int(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+const quint8 REQUIRED_OPS[] = {
+    IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE
+};
+
+}
+
+IoRing::IoRing(unsigned entries)
+    : m_fd(-1)
+    , m_sqRing(nullptr), m_sqRingSize(0)
+    , m_cqRing(nullptr), m_cqRingSize(0)
+    , m_sqes(nullptr), m_sqesSize(0)
+    , m_sqHead(nullptr), m_sqTail(nullptr), m_sqArray(nullptr), m_sqMask(0), m_sqEntries(0)
+    , m_sqLocalTail(0), m_toSubmit(0)
+    , m_cqHead(nullptr), m_cqTail(nullptr), m_cqMask(0), m_cqes(nullptr)
+    , m_inFlight(0), m_registeredSlots(0), m_submitCalls(0)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    m_fd = ringSetup(entries, &params);
+    if (m_fd < 0) {
+        m_error = QString("io_uring_setup: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+        return;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        m_sqRingSize = m_cqRingSize = qMax(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                      IORING_OFF_SQ_RING);
+    m_cqRing = singleMap ? m_sqRing
+                         : ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  m_fd, IORING_OFF_CQ_RING);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                        IORING_OFF_SQES);
+    if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        m_error = QString("io_uring mmap: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+        m_sqRing = m_sqRing == MAP_FAILED ? nullptr : m_sqRing;
+        m_cqRing = m_cqRing == MAP_FAILED ? nullptr : m_cqRing;
+        m_sqes = sqes == MAP_FAILED ? nullptr : static_cast<Submission*>(sqes);
+        unmap();
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    m_sqes = static_cast<Submission*>(sqes);
+
+    char* sq = static_cast<char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    m_sqLocalTail = *m_sqTail;
+
+    char* cq = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<Completion*>(cq + params.cq_off.cqes);
+    static_assert(sizeof(Completion) == sizeof(io_uring_cqe), "Completion mirrors io_uring_cqe");
+}
+
+IoRing::~IoRing() {
+    if (m_fd < 0) {
+        return;
+    }
+    // Closing the ring unregisters the buffers; pending operations are cancelled by the kernel
+    unmap();
+    ::close(m_fd);
+}
+
+void IoRing::unmap() {
+    if (m_sqes) {
+        ::munmap(m_sqes, m_sqesSize);
+    }
+    if (m_cqRing && m_cqRing != m_sqRing) {
+        ::munmap(m_cqRing, m_cqRingSize);
+    }
+    if (m_sqRing) {
+        ::munmap(m_sqRing, m_sqRingSize);
+    }
+    m_sqes = nullptr;
+    m_cqRing = nullptr;
+    m_sqRing = nullptr;
+}
+
+bool IoRing::isSupported(QString* reason) {
+    static QMutex mutex;
+    static bool probed = false;
+    static bool supported = false;
+    static QString failure;
+
+    QMutexLocker locker(&mutex);
+    if (!probed) {
+        probed = true;
+        IoRing ring(2);
+        if (!ring.isValid()) {
+            failure = ring.errorString();
+        } else {
+            // io_uring_probe is followed by one io_uring_probe_op per opcode
+            std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+            io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+            if (ringRegister(ring.m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                failure = QString("io_uring probe: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            } else {
+                supported = true;
+                for (quint8 op : REQUIRED_OPS) {
+                    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                        supported = false;
+                        failure = QString("io_uring lacks opcode %1").arg(op);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    if (reason) {
+        *reason = failure;
+    }
+    return supported;
+}
+
+bool IoRing::registerBuffers(char* base, quint32 slotSize, int slots) {
+    std::vector<iovec> vectors(static_cast<size_t>(slots));
+    for (int i = 0; i < slots; ++i) {
+        vectors[size_t(i)].iov_base = base + quint64(i) * slotSize;
+        vectors[size_t(i)].iov_len = slotSize;
+    }
+    if (ringRegister(m_fd, IORING_REGISTER_BUFFERS, vectors.data(), unsigned(slots)) < 0) {
+        m_error = QString("io_uring buffers: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+        return false;
+    }
+    m_registeredSlots = slots;
+    return true;
+}
+
+IoRing::Submission* IoRing::nextSubmission() {
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (m_sqLocalTail - head >= m_sqEntries) {
+        return nullptr;
+    }
+    unsigned index = m_sqLocalTail & m_sqMask;
+    Submission* sqe = &m_sqes[index];
+    std::memset(static_cast<io_uring_sqe*>(sqe), 0, sizeof(io_uring_sqe));
+    m_sqArray[index] = index;
+    ++m_sqLocalTail;
+    ++m_toSubmit;
+    return sqe;
+}
+
+bool IoRing::prepareStatx(const char* path, unsigned mask, struct statx* out, quint64 userData) {
+    Submission* sqe = nextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = quint64(reinterpret_cast<quintptr>(path));
+    sqe->len = mask;
+    sqe->off = quint64(reinterpret_cast<quintptr>(out));
+    sqe->statx_flags = 0;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoRing::prepareOpen(const char* path, int flags, quint64 userData) {
+    Submission* sqe = nextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = quint64(reinterpret_cast<quintptr>(path));
+    sqe->open_flags = quint32(flags);
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoRing::prepareRead(int fd, char* buffer, quint32 length, quint64 offset, int slot, quint64 userData) {
+    Submission* sqe = nextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    bool fixed = slot >= 0 && slot < m_registeredSlots;
+    sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = quint64(reinterpret_cast<quintptr>(buffer));
+    sqe->len = length;
+    sqe->off = offset;
+    if (fixed) {
+        sqe->buf_index = quint16(slot);
+    }
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoRing::prepareClose(int fd, quint64 userData) {
+    Submission* sqe = nextSubmission();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = userData;
+    return true;
+}
+
+int IoRing::submit(unsigned waitFor) {
+    __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = m_toSubmit;
+    if (toSubmit == 0 && waitFor == 0) {
+        return 0;
+    }
+
+    while (true) {
+        int submitted = ringEnter(m_fd, toSubmit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+        m_submitCalls++;
+        if (submitted >= 0) {
+            m_toSubmit -= unsigned(submitted);
+            m_inFlight += unsigned(submitted);
+            return submitted;
+        }
+        if (errno != EINTR) {
+            m_error = QString("io_uring_enter: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return -1;
+        }
+    }
+}
+
+bool IoRing::waitForCompletions(unsigned waitFor) {
+    while (true) {
+        int result = ringEnter(m_fd, 0, waitFor, IORING_ENTER_GETEVENTS);
+        m_submitCalls++;
+        if (result >= 0) {
+            return true;
+        }
+        if (errno != EINTR) {
+            m_error = QString("io_uring_enter: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+    }
+}
+
+bool IoRing::nextCompletion(quint64* userData, int* result) {
+    unsigned head = *m_cqHead;
+    if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const Completion& completion = m_cqes[head & m_cqMask];
+    *userData = completion.userData;
+    *result = completion.result;
+    __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+    m_inFlight--;
+    return true;
+}
+
+#else
+
+struct IoRing::Submission {};
+
+IoRing::IoRing(unsigned entries)
+    : m_fd(-1)
+    , m_sqRing(nullptr), m_sqRingSize(0)
+    , m_cqRing(nullptr), m_cqRingSize(0)
+    , m_sqes(nullptr), m_sqesSize(0)
+    , m_sqHead(nullptr), m_sqTail(nullptr), m_sqArray(nullptr), m_sqMask(0), m_sqEntries(0)
+    , m_sqLocalTail(0), m_toSubmit(0)
+    , m_cqHead(nullptr), m_cqTail(nullptr), m_cqMask(0), m_cqes(nullptr)
+    , m_inFlight(0), m_registeredSlots(0), m_submitCalls(0)
+    , m_error("io_uring is not available on this system")
+{
+    Q_UNUSED(entries);
+}
+
+IoRing::~IoRing() {}
+void IoRing::unmap() {}
+
+bool IoRing::isSupported(QString* reason) {
+    if (reason) {
+        *reason = "io_uring is not available on this system";
+    }
+    return false;
+}
+
+bool IoRing::registerBuffers(char*, quint32, int) { return false; }
+IoRing::Submission* IoRing::nextSubmission() { return nullptr; }
+bool IoRing::prepareStatx(const char*, unsigned, struct statx*, quint64) { return false; }
+bool IoRing::prepareOpen(const char*, int, quint64) { return false; }
+bool IoRing::prepareRead(int, char*, quint32, quint64, int, quint64) { return false; }
+bool IoRing::prepareClose(int, quint64) { return false; }
+int IoRing::submit(unsigned) { return -1; }
+bool IoRing::waitForCompletions(unsigned) { return false; }
+bool IoRing::nextCompletion(quint64*, int*) { return false; }
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef IORING_H
+#define IORING_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct statx;
+
+// A bare io_uring, set up with the raw system calls (no liburing): one
+// submission and one completion queue mapped from the kernel, optional
+// registered buffers, and the four operations the prefetcher needs. Owned
+// and driven by one thread. Everything fails cleanly where io_uring is
+// missing (older kernels, other systems, seccomp or io_uring_disabled).
+class IoRing {
+public:
+    explicit IoRing(unsigned entries);
+    ~IoRing();
+
+    // Runs a probe once: the kernel has io_uring with STATX, OPENAT, READ,
+    // READ_FIXED and CLOSE (Linux 5.6 or later)
+    static bool isSupported(QString* reason = nullptr);
+
+    bool isValid() const { return m_fd >= 0; }
+    QString errorString() const { return m_error; }
+
+    // One slotSize region per slot, starting at base. Registered buffers are
+    // pinned once instead of on every read; false if RLIMIT_MEMLOCK is too
+    // small, and reads then go through plain READ into the same memory.
+    bool registerBuffers(char* base, quint32 slotSize, int slots);
+    bool hasRegisteredBuffers() const { return m_registeredSlots > 0; }
+
+    // Queue one operation; false when the submission queue is full. path and
+    // out must stay valid until the completion. userData comes back with it.
+    bool prepareStatx(const char* path, unsigned mask, struct statx* out, quint64 userData);
+    bool prepareOpen(const char* path, int flags, quint64 userData);
+    // slot < 0, or no registered buffers, reads with plain READ
+    bool prepareRead(int fd, char* buffer, quint32 length, quint64 offset, int slot, quint64 userData);
+    bool prepareClose(int fd, quint64 userData);
+
+    // Hands the queued operations to the kernel in one call and waits for at
+    // least waitFor completions; -1 on error
+    int submit(unsigned waitFor);
+    // Waits for at least waitFor completions without handing over anything
+    // still queued, which then never runs; false on error
+    bool waitForCompletions(unsigned waitFor);
+
+    // Takes the next completion, false if there is none yet. result is what
+    // the system call would have returned, or -errno.
+    bool nextCompletion(quint64* userData, int* result);
+
+    unsigned inFlight() const { return m_inFlight; }
+    quint64 submitCalls() const { return m_submitCalls; }
+
+private:
+    // Same layout as struct io_uring_cqe
+    struct Completion {
+        quint64 userData;
+        qint32 result;
+        quint32 flags;
+    };
+
+    struct Submission;
+    Submission* nextSubmission();
+    void unmap();
+
+    int m_fd;
+    QString m_error;
+
+    void* m_sqRing;
+    size_t m_sqRingSize;
+    void* m_cqRing;
+    size_t m_cqRingSize;
+    Submission* m_sqes;
+    size_t m_sqesSize;
+
+    unsigned* m_sqHead;
+    unsigned* m_sqTail;
+    unsigned* m_sqArray;
+    unsigned m_sqMask;
+    unsigned m_sqEntries;
+    unsigned m_sqLocalTail;   // queued, not yet published to the kernel
+    unsigned m_toSubmit;
+
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned m_cqMask;
+    Completion* m_cqes;
+
+    unsigned m_inFlight;
+    int m_registeredSlots;
+    quint64 m_submitCalls;
+};
+
+#endif // IORING_H
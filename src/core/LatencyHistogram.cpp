@@ -0,0 +1,115 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) {
+    reset();
+    merge(other);
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other) {
+    if (this != &other) {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+int LatencyHistogram::bucketIndex(quint64 micros) {
+    if (micros < quint64(SubBuckets)) {
+        return int(micros);
+    }
+
+    // Position of the highest set bit picks the range, the next 4 bits the sub-bucket
+    int msb = 63 - __builtin_clzll(micros);
+    int shift = msb - 4;
+    int sub = int((micros >> shift) & (SubBuckets - 1));
+    return (shift + 1) * SubBuckets + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SubBuckets) {
+        return quint64(index);
+    }
+
+    int shift = index / SubBuckets - 1;
+    quint64 sub = quint64(index % SubBuckets);
+    quint64 lower = (quint64(SubBuckets) + sub) << shift;
+    return lower + ((quint64(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(quint64 micros) {
+    m_counts[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(micros, std::memory_order_relaxed);
+
+    quint64 current = m_max.load(std::memory_order_relaxed);
+    while (micros > current && !m_max.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BucketCount; ++i) {
+        quint64 count = other.m_counts[i].load(std::memory_order_relaxed);
+        if (count > 0) {
+            m_counts[i].fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+    m_sum.fetch_add(other.sum(), std::memory_order_relaxed);
+
+    quint64 otherMax = other.max();
+    quint64 current = m_max.load(std::memory_order_relaxed);
+    while (otherMax > current && !m_max.compare_exchange_weak(current, otherMax, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<quint64>& count : m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    m_max.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const {
+    quint64 total = 0;
+    for (const std::atomic<quint64>& count : m_counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+double LatencyHistogram::mean() const {
+    quint64 total = count();
+    return total > 0 ? sum() / double(total) : 0.0;
+}
+
+quint64 LatencyHistogram::percentile(double percent) const {
+    quint64 total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    quint64 rank = quint64(percent / 100.0 * total + 0.5);
+    rank = qBound(quint64(1), rank, total);
+
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return qMin(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+quint64 LatencyHistogram::countAtOrBelow(quint64 micros) const {
+    int last = qMin(bucketIndex(micros), BucketCount - 1);
+
+    quint64 total = 0;
+    for (int i = 0; i <= last; ++i) {
+        total += m_counts[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
@@ -0,0 +1,42 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// HDR-style histogram of durations in microseconds: one power-of-two range per
+// major bucket, split into 16 linear sub-buckets, so any recorded value is off
+// by at most 1/16 (~6%). Recording is a relaxed atomic increment, safe from
+// any number of threads; readers see a consistent-enough snapshot.
+class LatencyHistogram {
+public:
+    static const int SubBuckets = 16;
+    static const int BucketCount = 64 * SubBuckets;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void record(quint64 micros);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    quint64 count() const;
+    quint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    quint64 sum() const { return m_sum.load(std::memory_order_relaxed); }
+    double mean() const;
+    // Highest value equivalent to the given percentile (0-100)
+    quint64 percentile(double percent) const;
+    // Values recorded at or below the given one, to the bucket's resolution
+    quint64 countAtOrBelow(quint64 micros) const;
+
+    static int bucketIndex(quint64 micros);
+    static quint64 bucketUpperBound(int index);
+
+private:
+    std::atomic<quint64> m_counts[BucketCount];
+    std::atomic<quint64> m_max;
+    std::atomic<quint64> m_sum;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,298 @@
+#include "MetricsServer.h"
+#include "Scanner.h"
+#include "LatencyHistogram.h"
+#include "ScanMetrics.h"
+#include "ScanPrefilter.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHostAddress>
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+
+// Requests larger than this are not a scrape
+const int MAX_REQUEST_BYTES = 8192;
+
+// Histogram buckets exported to Prometheus, in microseconds. The underlying
+// histograms are much finer; these are what dashboards usually want.
+const quint64 BUCKET_BOUNDS_US[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+    250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+};
+
+QByteArray seconds(quint64 micros) {
+    return QByteArray::number(micros / 1e6, 'g', 9);
+}
+
+void writeHeader(QByteArray& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void writeSample(QByteArray& out, const QByteArray& name, const QByteArray& labels,
+                 const QByteArray& value) {
+    out += name;
+    if (!labels.isEmpty()) {
+        out += '{' + labels + '}';
+    }
+    out += ' ' + value + '\n';
+}
+
+void writeSample(QByteArray& out, const char* name, quint64 value) {
+    writeSample(out, name, QByteArray(), QByteArray::number(value));
+}
+
+void writeHistogram(QByteArray& out, const char* name, const QByteArray& labels,
+                    const LatencyHistogram& histogram) {
+    QByteArray prefix = labels.isEmpty() ? QByteArray() : labels + ',';
+    QByteArray bucket = QByteArray(name) + "_bucket";
+
+    for (quint64 bound : BUCKET_BOUNDS_US) {
+        writeSample(out, bucket, prefix + "le=\"" + seconds(bound) + '"',
+                    QByteArray::number(histogram.countAtOrBelow(bound)));
+    }
+
+    quint64 count = histogram.count();
+    writeSample(out, bucket, prefix + "le=\"+Inf\"", QByteArray::number(count));
+    writeSample(out, QByteArray(name) + "_sum", labels, seconds(histogram.sum()));
+    writeSample(out, QByteArray(name) + "_count", labels, QByteArray::number(count));
+}
+
+}
+
+MetricsServer::MetricsServer(Scanner* scanner, QObject* parent)
+    : QObject(parent)
+    , m_scanner(scanner)
+    , m_tcpServer(nullptr)
+    , m_localServer(nullptr)
+{
+}
+
+MetricsServer::~MetricsServer() {
+    close();
+}
+
+bool MetricsServer::listen(const QString& endpoint) {
+    close();
+
+    if (endpoint.startsWith("tcp:")) {
+        QString hostPort = endpoint.mid(4);
+        int colon = hostPort.lastIndexOf(':');
+        QString host = colon >= 0 ? hostPort.left(colon) : QString("127.0.0.1");
+        quint16 port = quint16(hostPort.mid(colon + 1).toUInt());
+
+        // Counters leak what is being scanned; never expose them beyond this host
+        QHostAddress address = host == "localhost" ? QHostAddress(QHostAddress::LocalHost) : QHostAddress(host);
+        if (!address.isLoopback()) {
+            m_error = QString("Refusing to serve metrics on non-loopback address %1").arg(host);
+            return false;
+        }
+
+        m_tcpServer = new QTcpServer(this);
+        if (!m_tcpServer->listen(address, port)) {
+            m_error = m_tcpServer->errorString();
+            close();
+            return false;
+        }
+        connect(m_tcpServer, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket* socket = m_tcpServer->nextPendingConnection()) {
+                connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                accept(socket);
+            }
+        });
+    } else {
+        QString path = endpoint.startsWith("unix:") ? endpoint.mid(5) : endpoint;
+
+        QLocalServer::removeServer(path);
+        m_localServer = new QLocalServer(this);
+        m_localServer->setSocketOptions(QLocalServer::UserAccessOption);
+        if (!m_localServer->listen(path)) {
+            m_error = m_localServer->errorString();
+            close();
+            return false;
+        }
+        connect(m_localServer, &QLocalServer::newConnection, this, [this]() {
+            while (QLocalSocket* socket = m_localServer->nextPendingConnection()) {
+                connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+                accept(socket);
+            }
+        });
+    }
+
+    qDebug() << "Serving metrics on" << this->endpoint();
+    return true;
+}
+
+void MetricsServer::close() {
+    delete m_tcpServer;
+    m_tcpServer = nullptr;
+    delete m_localServer;
+    m_localServer = nullptr;
+}
+
+bool MetricsServer::isListening() const {
+    return (m_tcpServer && m_tcpServer->isListening()) || (m_localServer && m_localServer->isListening());
+}
+
+QString MetricsServer::endpoint() const {
+    if (m_tcpServer) {
+        return QString("tcp:%1:%2").arg(m_tcpServer->serverAddress().toString())
+                                   .arg(m_tcpServer->serverPort());
+    }
+    if (m_localServer) {
+        return "unix:" + m_localServer->fullServerName();
+    }
+    return QString();
+}
+
+void MetricsServer::accept(QIODevice* socket) {
+    // The socket is a child of its server, so close() also drops scrapes in flight
+    connect(socket, &QIODevice::readyRead, this, [this, socket]() {
+        QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+        if (request.contains("\r\n\r\n") || request.contains("\n\n")) {
+            respond(socket, request);
+        } else if (request.size() > MAX_REQUEST_BYTES) {
+            respond(socket, QByteArray());
+        } else {
+            socket->setProperty("request", request);
+        }
+    });
+}
+
+void MetricsServer::respond(QIODevice* socket, const QByteArray& request) {
+    // "GET /metrics HTTP/1.1" - anything else gets a short error
+    QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray status;
+    QByteArray body;
+    QByteArray contentType = "text/plain; charset=utf-8";
+
+    if (requestLine.size() < 2) {
+        status = "400 Bad Request";
+        body = "Bad request\n";
+    } else if (requestLine[0] != "GET" && requestLine[0] != "HEAD") {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    } else if (requestLine[1] != "/metrics" && requestLine[1] != "/") {
+        status = "404 Not Found";
+        body = "Metrics are at /metrics\n";
+    } else {
+        status = "200 OK";
+        body = render();
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+    }
+
+    QByteArray response = "HTTP/1.0 " + status + "\r\n"
+        + "Content-Type: " + contentType + "\r\n"
+        + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n";
+    if (requestLine.value(0) != "HEAD") {
+        response += body;
+    }
+
+    socket->disconnect(this);
+    socket->write(response);
+    if (QTcpSocket* tcp = qobject_cast<QTcpSocket*>(socket)) {
+        tcp->disconnectFromHost();
+    } else if (QLocalSocket* local = qobject_cast<QLocalSocket*>(socket)) {
+        local->disconnectFromServer();
+    }
+}
+
+QByteArray MetricsServer::render() const {
+    QByteArray out;
+    out.reserve(16 * 1024);
+
+    writeHeader(out, "fastav_scan_active", "gauge", "1 while a scan is running.");
+    writeSample(out, "fastav_scan_active", m_scanner->isScanning() ? 1 : 0);
+
+    writeHeader(out, "fastav_files_total", "gauge",
+                "Files in the current scan, including those done before a resume.");
+    writeSample(out, "fastav_files_total", m_scanner->getTotalFiles());
+
+    // Counters below restart with each scan; rate() treats that as a reset
+    writeHeader(out, "fastav_files_scanned_total", "counter", "Files with a result in the current scan.");
+    writeSample(out, "fastav_files_scanned_total", m_scanner->getFilesScanned());
+
+    writeHeader(out, "fastav_bytes_scanned_total", "counter", "Bytes scanned in the current scan.");
+    writeSample(out, "fastav_bytes_scanned_total", m_scanner->getBytesScanned());
+
+    writeHeader(out, "fastav_bytes_read_total", "counter", "Bytes read from disk to stream and hash files.");
+    writeSample(out, "fastav_bytes_read_total", m_scanner->getBytesRead());
+
+    writeHeader(out, "fastav_hole_bytes_total", "counter", "Sparse-file holes sent and hashed as zeros, not read.");
+    writeSample(out, "fastav_hole_bytes_total", m_scanner->getHoleBytes());
+
+    writeHeader(out, "fastav_threats_found_total", "counter", "Infected files found in the current scan.");
+    writeSample(out, "fastav_threats_found_total", m_scanner->getThreatsFound());
+
+    writeHeader(out, "fastav_files_timed_out_total", "counter", "Files given up on after their deadline.");
+    writeSample(out, "fastav_files_timed_out_total", m_scanner->getFilesTimedOut());
+
+    writeHeader(out, "fastav_files_failed_total", "counter", "Files the backend answered with an error.");
+    writeSample(out, "fastav_files_failed_total", m_scanner->getFilesFailed());
+
+    writeHeader(out, "fastav_files_skipped_total", "counter",
+                "Files not sent to the backend because it could not give a verdict.");
+    for (int i = int(SkipReason::None) + 1; i < int(SkipReason::Count); ++i) {
+        writeSample(out, "fastav_files_skipped_total",
+                    "reason=\"" + ScanPrefilter::reasonKey(SkipReason(i)) + '"',
+                    QByteArray::number(m_scanner->getFilesSkipped(SkipReason(i))));
+    }
+
+    writeHeader(out, "fastav_hash_lookups_total", "counter",
+                "Files hashed because their size is in the local hash index.");
+    writeSample(out, "fastav_hash_lookups_total", m_scanner->getFilesHashed());
+
+    writeHeader(out, "fastav_hash_hits_total", "counter", "Files flagged by the local hash index.");
+    writeSample(out, "fastav_hash_hits_total", m_scanner->getHashHits());
+
+    writeHeader(out, "fastav_queue_depth", "gauge", "Files waiting for a worker thread.");
+    writeSample(out, "fastav_queue_depth", m_scanner->getQueueDepth());
+
+    writeHeader(out, "fastav_tasks_running", "gauge", "Files being scanned right now.");
+    writeSample(out, "fastav_tasks_running", quint64(qMax(0, m_scanner->getTasksRunning())));
+
+    writeHeader(out, "fastav_worker_threads", "gauge", "Maximum number of concurrent scan tasks.");
+    writeSample(out, "fastav_worker_threads", quint64(m_scanner->getMaxThreads()));
+
+    writeHeader(out, "fastav_backend_throughput_bytes_per_second", "gauge",
+                "Moving average of backend throughput, which sizes the per-file deadlines.");
+    writeSample(out, "fastav_backend_throughput_bytes_per_second", QByteArray(),
+                QByteArray::number(m_scanner->getThroughput() * 1000.0, 'f', 0));
+
+    writeHeader(out, "fastav_checkpoint_backlog", "gauge",
+                "Results not yet written to the history database.");
+    writeSample(out, "fastav_checkpoint_backlog", m_scanner->getCheckpointBacklog());
+
+    qint64 lastCheckpoint = m_scanner->getLastCheckpointTime();
+    if (lastCheckpoint > 0) {
+        writeHeader(out, "fastav_checkpoint_age_seconds", "gauge",
+                    "Time since the history database last caught up with the scan.");
+        writeSample(out, "fastav_checkpoint_age_seconds", QByteArray(),
+                    QByteArray::number((QDateTime::currentMSecsSinceEpoch() - lastCheckpoint) / 1000.0, 'f', 3));
+    }
+
+    writeHeader(out, "fastav_file_duration_seconds", "histogram",
+                "Wall time per file, from task start to result.");
+    writeHistogram(out, "fastav_file_duration_seconds", QByteArray(), m_scanner->getFileLatency());
+
+    writeHeader(out, "fastav_stage_duration_seconds", "histogram",
+                "Time spent in each stage of the scan pipeline.");
+    const ScanMetrics* metrics = m_scanner->metrics();
+    for (int i = 0; i < int(ScanStage::Count); ++i) {
+        QByteArray labels = "stage=\"" + ScanMetrics::stageName(ScanStage(i)).toUtf8() + '"';
+        writeHistogram(out, "fastav_stage_duration_seconds", labels, metrics->merged(ScanStage(i)));
+    }
+
+    return out;
+}
@@ -0,0 +1,44 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+
+class Scanner;
+class LatencyHistogram;
+class QIODevice;
+class QTcpServer;
+class QLocalServer;
+
+// Serves the scanner's counters in Prometheus text exposition format over a
+// minimal HTTP/1.0 responder, for fleet monitoring of long-running instances.
+// Rendering only loads atomics and merges histogram shards, so a scrape never
+// blocks a worker thread.
+class MetricsServer : public QObject {
+    Q_OBJECT
+public:
+    explicit MetricsServer(Scanner* scanner, QObject* parent = nullptr);
+    ~MetricsServer();
+
+    // "tcp:port", "tcp:127.0.0.1:port" or "unix:/path". TCP only binds loopback.
+    bool listen(const QString& endpoint);
+    void close();
+    bool isListening() const;
+    // Where it actually listens, with the bound port for "tcp:0"
+    QString endpoint() const;
+    QString errorString() const { return m_error; }
+
+    QByteArray render() const;
+
+private:
+    void accept(QIODevice* socket);
+    void respond(QIODevice* socket, const QByteArray& request);
+
+    Scanner* m_scanner;
+    QTcpServer* m_tcpServer;
+    QLocalServer* m_localServer;
+    QString m_error;
+};
+
+#endif // METRICSSERVER_H
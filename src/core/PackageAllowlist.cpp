@@ -0,0 +1,178 @@
+#include "PackageAllowlist.h"
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'A', 'V', 'P', 'K', 'G', 'A', '1'};
+const quint32 VERSION = 1;
+
+const qint64 READ_CHUNK = 256 * 1024;
+
+}
+
+PackageAllowlist::PackageAllowlist()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_header(nullptr)
+    , m_records(nullptr)
+{
+}
+
+PackageAllowlist::~PackageAllowlist() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+}
+
+QString PackageAllowlist::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/packages.bin";
+}
+
+quint64 PackageAllowlist::hashPath(const QByteArray& path) {
+    // FNV-1a: stable across runs, unlike qHash
+    quint64 hash = 14695981039346656037ULL;
+    for (char c : path) {
+        hash ^= uchar(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+QSharedPointer<const PackageAllowlist> PackageAllowlist::open(const QString& path, QString* error) {
+    QSharedPointer<PackageAllowlist> allowlist(new PackageAllowlist);
+    allowlist->m_file.setFileName(path);
+    if (!allowlist->m_file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = allowlist->m_file.errorString();
+        }
+        return QSharedPointer<const PackageAllowlist>();
+    }
+
+    allowlist->m_size = quint64(allowlist->m_file.size());
+    allowlist->m_data = allowlist->m_size >= sizeof(Header)
+        ? allowlist->m_file.map(0, qint64(allowlist->m_size)) : nullptr;
+    if (!allowlist->m_data) {
+        if (error) {
+            *error = "Cannot map package allowlist";
+        }
+        return QSharedPointer<const PackageAllowlist>();
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(allowlist->m_data);
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+        && header->version == VERSION
+        && header->recordSize == sizeof(Record)
+        && header->recordOffset % 8 == 0
+        && header->recordOffset + header->recordCount * sizeof(Record) <= allowlist->m_size
+        && header->pathsOffset + header->pathsSize <= allowlist->m_size;
+    if (!valid) {
+        if (error) {
+            *error = "Not a FastAV package allowlist, or built by another version";
+        }
+        return QSharedPointer<const PackageAllowlist>();
+    }
+
+    allowlist->m_header = header;
+    allowlist->m_records = reinterpret_cast<const Record*>(allowlist->m_data + header->recordOffset);
+    return allowlist;
+}
+
+QByteArray PackageAllowlist::sourceDigest() const {
+    return QByteArray(reinterpret_cast<const char*>(m_header->sourceDigest), sizeof(m_header->sourceDigest));
+}
+
+const PackageAllowlist::Record* PackageAllowlist::find(const QString& path) const {
+    QByteArray key = path.toUtf8();
+    quint64 hash = hashPath(key);
+
+    quint64 low = 0;
+    quint64 high = m_header->recordCount;
+    while (low < high) {
+        quint64 middle = (low + high) / 2;
+        if (m_records[middle].pathHash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    const char* paths = reinterpret_cast<const char*>(m_data + m_header->pathsOffset);
+    for (quint64 i = low; i < m_header->recordCount && m_records[i].pathHash == hash; ++i) {
+        const Record& record = m_records[i];
+        if (record.pathLength == quint32(key.size())
+            && quint64(record.pathOffset) + record.pathLength <= m_header->pathsSize
+            && std::memcmp(paths + record.pathOffset, key.constData(), record.pathLength) == 0) {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+bool PackageAllowlist::verify(const QString& path, quint64 fileSize, qint64 mtime,
+                              const CancellationToken* token, const QByteArray* contents, ReadCount* read) const {
+    const Record* record = find(path);
+    if (!record) {
+        return false;
+    }
+
+    if (record->size != UnknownSize && record->size != fileSize) {
+        return false;
+    }
+    if ((record->flags & ExactMtime) && record->mtime != mtime) {
+        return false;
+    }
+    if ((record->flags & InstalledAt) && mtime > record->mtime) {
+        return false;
+    }
+
+    QCryptographicHash::Algorithm algorithm;
+    int digestSize;
+    if (record->flags & DigestSha256) {
+        algorithm = QCryptographicHash::Sha256;
+        digestSize = 32;
+    } else if (record->flags & DigestMd5) {
+        algorithm = QCryptographicHash::Md5;
+        digestSize = 16;
+    } else {
+        return false;
+    }
+
+    QCryptographicHash hasher(algorithm);
+    if (contents) {
+        hasher.addData(*contents);
+    } else {
+        SparseFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QByteArray buffer(int(qMax(qint64(1), qMin(qint64(fileSize), READ_CHUNK))), Qt::Uninitialized);
+        bool complete = true;
+        while (true) {
+            if (token && token->isCancelled()) {
+                complete = false;
+                break;
+            }
+            qint64 length = file.read(buffer.data(), buffer.size());
+            if (length < 0) {
+                complete = false;
+                break;
+            }
+            if (length == 0) {
+                break;
+            }
+            hasher.addData(QByteArrayView(buffer.constData(), length));
+        }
+        if (read) {
+            *read += file.readCount();
+        }
+        if (!complete) {
+            return false;
+        }
+    }
+
+    QByteArray digest = hasher.result();
+    return digest.size() == digestSize && std::memcmp(digest.constData(), record->digest, size_t(digestSize)) == 0;
+}
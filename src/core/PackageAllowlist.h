@@ -0,0 +1,82 @@
+#ifndef PACKAGEALLOWLIST_H
+#define PACKAGEALLOWLIST_H
+
+#include <QString>
+#include <QFile>
+#include <QSharedPointer>
+#include "CancellationToken.h"
+#include "SparseFile.h"
+
+// Read-only, memory-mapped table of the files the system package manager
+// installed, keyed by path, with the checksum (and where recorded, the size
+// and mtime) from the package database. A file that still matches its record
+// is the distribution's own copy and does not need a backend scan. Built by
+// PackageAllowlistBuilder.
+//
+// Layout: header, records sorted by path hash, then the paths.
+class PackageAllowlist {
+public:
+    enum Flag {
+        DigestMd5 = 0x1,
+        DigestSha256 = 0x2,
+        ExactMtime = 0x4,   // pacman: mtime as packaged
+        InstalledAt = 0x8   // dpkg: the file must not be newer than the install
+    };
+
+    static const quint64 UnknownSize = ~quint64(0);
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 recordSize;
+        quint64 recordCount;
+        quint64 recordOffset;
+        quint64 pathsOffset;
+        quint64 pathsSize;
+        unsigned char sourceDigest[20];  // SHA-1 over the package database listing
+        quint32 reserved;
+    };
+
+    struct Record {
+        quint64 pathHash;
+        quint32 pathOffset;
+        quint32 pathLength;
+        quint64 size;
+        qint64 mtime;       // seconds since epoch, meaning set by the flags
+        quint32 flags;
+        quint32 reserved;
+        unsigned char digest[32];
+    };
+
+    ~PackageAllowlist();
+
+    // Null if the file is missing or not a valid allowlist
+    static QSharedPointer<const PackageAllowlist> open(const QString& path, QString* error = nullptr);
+    static QString defaultPath();
+    static quint64 hashPath(const QByteArray& path);
+
+    quint64 recordCount() const { return m_header->recordCount; }
+    QByteArray sourceDigest() const;
+    const Record* find(const QString& path) const;
+
+    // True if the file on disk is the one its package installed. Size and
+    // mtime are checked first, the checksum is computed only if they pass,
+    // over contents when the whole file is already in memory. read, when
+    // given, adds up what was read of the file.
+    bool verify(const QString& path, quint64 fileSize, qint64 mtime,
+                const CancellationToken* token = nullptr, const QByteArray* contents = nullptr,
+                ReadCount* read = nullptr) const;
+
+private:
+    PackageAllowlist();
+
+    QFile m_file;
+    const uchar* m_data;
+    quint64 m_size;
+    const Header* m_header;
+    const Record* m_records;
+};
+
+typedef QSharedPointer<const PackageAllowlist> PackageAllowlistPtr;
+
+#endif // PACKAGEALLOWLIST_H
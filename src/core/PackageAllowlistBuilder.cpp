@@ -0,0 +1,295 @@
+#include "PackageAllowlistBuilder.h"
+#include "PackageAllowlist.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMutex>
+#include <QDebug>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char DPKG_INFO[] = "/var/lib/dpkg/info";
+const char PACMAN_LOCAL[] = "/var/lib/pacman/local";
+
+QMutex rebuildMutex;
+
+struct Entry {
+    QByteArray path;
+    PackageAllowlist::Record record;
+};
+
+PackageAllowlist::Record emptyRecord() {
+    PackageAllowlist::Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.size = PackageAllowlist::UnknownSize;
+    return record;
+}
+
+// "<md5>  <path relative to />"
+void parseMd5sums(const QString& path, QVector<Entry>& entries) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    qint64 installedAt = QFileInfo(file).lastModified().toSecsSinceEpoch();
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        if (line.endsWith('\n')) {
+            line.chop(1);
+        }
+        if (line.size() < 35 || line[32] != ' ') {
+            continue;
+        }
+        QByteArray digest = QByteArray::fromHex(line.left(32));
+        QByteArray relative = line.mid(34);
+        if (digest.size() != 16 || relative.isEmpty()) {
+            continue;
+        }
+
+        Entry entry;
+        entry.path = '/' + relative;
+        entry.record = emptyRecord();
+        entry.record.mtime = installedAt;
+        entry.record.flags = PackageAllowlist::DigestMd5 | PackageAllowlist::InstalledAt;
+        std::memcpy(entry.record.digest, digest.constData(), 16);
+        entries.append(entry);
+    }
+}
+
+// mtree paths escape unusual bytes as \ooo
+QByteArray unescapeMtree(const QByteArray& text) {
+    QByteArray result;
+    result.reserve(text.size());
+    for (int i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 3 < text.size() && text[i + 1] >= '0' && text[i + 1] <= '7') {
+            bool ok = false;
+            int value = text.mid(i + 1, 3).toInt(&ok, 8);
+            if (ok) {
+                result.append(char(value));
+                i += 3;
+                continue;
+            }
+        }
+        result.append(text[i]);
+    }
+    return result;
+}
+
+QByteArray readGzip(const QString& path) {
+    // gzread also passes uncompressed files through
+    gzFile file = gzopen(QFile::encodeName(path).constData(), "rb");
+    if (!file) {
+        return QByteArray();
+    }
+    QByteArray data;
+    char buffer[64 * 1024];
+    int length;
+    while ((length = gzread(file, buffer, sizeof(buffer))) > 0) {
+        data.append(buffer, length);
+    }
+    gzclose(file);
+    return length < 0 ? QByteArray() : data;
+}
+
+void parseMtree(const QString& path, QVector<Entry>& entries) {
+    QByteArray data = readGzip(path);
+    QByteArray defaultType = "file";
+
+    for (const QByteArray& rawLine : data.split('\n')) {
+        QByteArray line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QList<QByteArray> fields = line.split(' ');
+        if (fields[0] == "/set") {
+            for (const QByteArray& field : fields) {
+                if (field.startsWith("type=")) {
+                    defaultType = field.mid(5);
+                }
+            }
+            continue;
+        }
+        // ./.PKGINFO and friends are package metadata, not installed files
+        if (!fields[0].startsWith("./") || fields[0].startsWith("./.")) {
+            continue;
+        }
+
+        Entry entry;
+        entry.path = unescapeMtree(fields[0].mid(1));
+        entry.record = emptyRecord();
+        QByteArray type = defaultType;
+        QByteArray sha256;
+        QByteArray md5;
+        for (int i = 1; i < fields.size(); ++i) {
+            const QByteArray& field = fields[i];
+            if (field.startsWith("type=")) {
+                type = field.mid(5);
+            } else if (field.startsWith("size=")) {
+                entry.record.size = field.mid(5).toULongLong();
+            } else if (field.startsWith("time=")) {
+                QByteArray time = field.mid(5);
+                entry.record.mtime = time.left(time.indexOf('.') < 0 ? time.size() : time.indexOf('.')).toLongLong();
+                entry.record.flags |= PackageAllowlist::ExactMtime;
+            } else if (field.startsWith("sha256digest=")) {
+                sha256 = QByteArray::fromHex(field.mid(13));
+            } else if (field.startsWith("md5digest=")) {
+                md5 = QByteArray::fromHex(field.mid(10));
+            }
+        }
+        if (type != "file") {
+            continue;
+        }
+
+        if (sha256.size() == 32) {
+            entry.record.flags |= PackageAllowlist::DigestSha256;
+            std::memcpy(entry.record.digest, sha256.constData(), 32);
+        } else if (md5.size() == 16) {
+            entry.record.flags |= PackageAllowlist::DigestMd5;
+            std::memcpy(entry.record.digest, md5.constData(), 16);
+        } else {
+            continue;
+        }
+        entries.append(entry);
+    }
+}
+
+QByteArray listingDigest(const QStringList& sources) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const QString& path : sources) {
+        QFileInfo source(path);
+        hash.addData(path.toUtf8());
+        hash.addData(QByteArray::number(source.size()));
+        hash.addData(QByteArray::number(source.lastModified().toMSecsSinceEpoch()));
+    }
+    return hash.result();
+}
+
+}
+
+QStringList PackageAllowlistBuilder::sourceFiles() {
+    QStringList sources;
+    QDir dpkg(DPKG_INFO);
+    for (const QString& name : dpkg.entryList(QStringList() << "*.md5sums", QDir::Files, QDir::Name)) {
+        sources.append(dpkg.filePath(name));
+    }
+
+    QDir pacman(PACMAN_LOCAL);
+    for (const QString& name : pacman.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+        QString mtree = pacman.filePath(name + "/mtree");
+        if (QFileInfo::exists(mtree)) {
+            sources.append(mtree);
+        }
+    }
+    return sources;
+}
+
+bool PackageAllowlistBuilder::rebuild(const QString& outputPath, QString* error, Stats* stats) {
+    QString localError;
+    error = error ? error : &localError;
+    Stats localStats;
+    stats = stats ? stats : &localStats;
+
+    QMutexLocker locker(&rebuildMutex);
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList sources = sourceFiles();
+    stats->sources = sources.size();
+    if (sources.isEmpty()) {
+        *error = "No dpkg or pacman package database found";
+        return false;
+    }
+
+    // An install, upgrade or removal changes the listing
+    QByteArray digest = listingDigest(sources);
+    PackageAllowlistPtr existing = PackageAllowlist::open(outputPath);
+    if (existing && existing->sourceDigest() == digest) {
+        stats->records = existing->recordCount();
+        stats->unchanged = true;
+        stats->elapsedMs = timer.elapsed();
+        return true;
+    }
+    existing.reset();
+
+    QVector<Entry> entries;
+    for (const QString& source : sources) {
+        if (source.endsWith(".md5sums")) {
+            parseMd5sums(source, entries);
+        } else {
+            parseMtree(source, entries);
+        }
+    }
+    for (Entry& entry : entries) {
+        entry.record.pathHash = PackageAllowlist::hashPath(entry.path);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.record.pathHash != b.record.pathHash ? a.record.pathHash < b.record.pathHash : a.path < b.path;
+    });
+    // A path owned twice (diversions, overlapping packages) cannot be trusted either way
+    QVector<Entry> unique;
+    unique.reserve(entries.size());
+    for (int i = 0; i < entries.size();) {
+        int next = i + 1;
+        while (next < entries.size() && entries[next].path == entries[i].path) {
+            ++next;
+        }
+        if (next == i + 1) {
+            unique.append(entries[i]);
+        }
+        i = next;
+    }
+
+    QByteArray paths;
+    QVector<PackageAllowlist::Record> records;
+    records.reserve(unique.size());
+    for (Entry& entry : unique) {
+        entry.record.pathOffset = quint32(paths.size());
+        entry.record.pathLength = quint32(entry.path.size());
+        paths.append(entry.path);
+        records.append(entry.record);
+    }
+
+    PackageAllowlist::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "FAVPKGA1", sizeof(header.magic));
+    header.version = 1;
+    header.recordSize = sizeof(PackageAllowlist::Record);
+    header.recordCount = quint64(records.size());
+    header.recordOffset = (sizeof(header) + 7) & ~quint64(7);
+    header.pathsOffset = header.recordOffset + header.recordCount * sizeof(PackageAllowlist::Record);
+    header.pathsSize = quint64(paths.size());
+    std::memcpy(header.sourceDigest, digest.constData(), sizeof(header.sourceDigest));
+
+    QDir().mkpath(QFileInfo(outputPath).absolutePath());
+    QSaveFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(QByteArray(int(header.recordOffset - sizeof(header)), '\0'));
+    file.write(reinterpret_cast<const char*>(records.constData()),
+               qint64(records.size()) * qint64(sizeof(PackageAllowlist::Record)));
+    file.write(paths);
+    if (!file.commit()) {
+        *error = file.errorString();
+        return false;
+    }
+
+    stats->records = header.recordCount;
+    stats->elapsedMs = timer.elapsed();
+    qDebug() << "Package allowlist rebuilt:" << stats->records << "files from" << stats->sources
+             << "package records in" << stats->elapsedMs << "ms";
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef PACKAGEALLOWLISTBUILDER_H
+#define PACKAGEALLOWLISTBUILDER_H
+
+#include <QString>
+#include <QStringList>
+
+// Builds the PackageAllowlist from the local package database:
+//   dpkg    /var/lib/dpkg/info/*.md5sums     path and MD5; the install time
+//                                            (mtime of the .md5sums) bounds
+//                                            the file's mtime
+//   pacman  /var/lib/pacman/local/*/mtree    path, size, mtime and SHA-256
+// dpkg conffiles are not in .md5sums and pacman backup files are expected to
+// differ, so edited configuration is always scanned. The listing of the
+// database is digested and stored in the allowlist; when it has not changed
+// the existing allowlist is kept.
+class PackageAllowlistBuilder {
+public:
+    struct Stats {
+        int sources;
+        quint64 records;
+        qint64 elapsedMs;
+        bool unchanged;
+
+        Stats() : sources(0), records(0), elapsedMs(0), unchanged(false) {}
+    };
+
+    // False on failure, or when no supported package database was found
+    static bool rebuild(const QString& outputPath, QString* error = nullptr, Stats* stats = nullptr);
+
+    static QStringList sourceFiles();
+};
+
+#endif // PACKAGEALLOWLISTBUILDER_H
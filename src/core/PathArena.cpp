@@ -0,0 +1,80 @@
+#include "PathArena.h"
+#include <QFile>
+#include <QVarLengthArray>
+
+quint64 PathArena::appendName(const QByteArray& name) {
+    quint64 offset = quint64(m_names.size());
+    m_names.append(name);
+    return offset;
+}
+
+quint32 PathArena::addDirectory(quint32 parent, const QByteArray& name) {
+    Node node;
+    node.nameOffset = appendName(name);
+    node.nameLength = quint32(name.size());
+    node.parent = parent;
+    m_directories.append(node);
+    return quint32(m_directories.size() - 1);
+}
+
+quint32 PathArena::addFile(quint32 directory, const QByteArray& name) {
+    Node node;
+    node.nameOffset = appendName(name);
+    node.nameLength = quint32(name.size());
+    node.parent = directory;
+    m_files.append(node);
+    return quint32(m_files.size() - 1);
+}
+
+void PathArena::squeeze() {
+    m_directories.squeeze();
+    m_files.squeeze();
+    m_names.squeeze();
+}
+
+void PathArena::appendPath(quint32 directory, QByteArray& path) const {
+    // Collected leaf first, appended root first
+    QVarLengthArray<quint32, 64> chain;
+    for (quint32 id = directory; id != NoDirectory; id = m_directories[id].parent) {
+        chain.append(id);
+    }
+
+    for (qsizetype i = chain.size() - 1; i >= 0; --i) {
+        const Node& node = m_directories[chain[i]];
+        if (!path.isEmpty() && !path.endsWith('/')) {
+            path.append('/');
+        }
+        path.append(m_names.constData() + node.nameOffset, qsizetype(node.nameLength));
+    }
+}
+
+QByteArray PathArena::encodedFilePath(quint32 file) const {
+    const Node& node = m_files[file];
+    QByteArray path;
+    path.reserve(256);
+    appendPath(node.parent, path);
+    if (!path.isEmpty() && !path.endsWith('/')) {
+        path.append('/');
+    }
+    path.append(m_names.constData() + node.nameOffset, qsizetype(node.nameLength));
+    return path;
+}
+
+QByteArray PathArena::encodedDirectoryPath(quint32 directory) const {
+    QByteArray path;
+    appendPath(directory, path);
+    return path;
+}
+
+QString PathArena::filePath(quint32 file) const {
+    return QFile::decodeName(encodedFilePath(file));
+}
+
+QString PathArena::directoryPath(quint32 directory) const {
+    return QFile::decodeName(encodedDirectoryPath(directory));
+}
+
+quint64 PathArena::memoryUsage() const {
+    return quint64(m_directories.capacity() + m_files.capacity()) * sizeof(Node)
+        + quint64(m_names.capacity());
+}
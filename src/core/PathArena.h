@@ -0,0 +1,56 @@
+#ifndef PATHARENA_H
+#define PATHARENA_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QSharedPointer>
+
+// The files a walk found, stored as a tree instead of as full paths: a
+// directory is its parent's id plus its name, a file its directory's id plus
+// its name, and all names sit in one byte arena in the filesystem encoding.
+// Deep trees share their prefixes, so a 10M file scan pays for each name once
+// instead of for 10M UTF-16 paths. Full paths are built when a file is opened.
+//
+// Filled by one thread (the walker), then shared read-only with the scan
+// tasks; the const methods are safe to call concurrently.
+class PathArena {
+public:
+    // Parent of a walk root; its name is the root's absolute path
+    static const quint32 NoDirectory = ~quint32(0);
+
+    quint32 addDirectory(quint32 parent, const QByteArray& name);
+    quint32 addFile(quint32 directory, const QByteArray& name);
+    // Drops spare capacity once the walk is done
+    void squeeze();
+
+    int fileCount() const { return int(m_files.size()); }
+    int directoryCount() const { return int(m_directories.size()); }
+    quint32 fileDirectory(quint32 file) const { return m_files[file].parent; }
+
+    // Encoded paths are what open() and opendir() take
+    QByteArray encodedFilePath(quint32 file) const;
+    QByteArray encodedDirectoryPath(quint32 directory) const;
+    QString filePath(quint32 file) const;
+    QString directoryPath(quint32 directory) const;
+
+    quint64 memoryUsage() const;
+
+private:
+    struct Node {
+        quint64 nameOffset;
+        quint32 nameLength;
+        quint32 parent;     // directory id, NoDirectory for a root
+    };
+
+    quint64 appendName(const QByteArray& name);
+    void appendPath(quint32 directory, QByteArray& path) const;
+
+    QVector<Node> m_directories;
+    QVector<Node> m_files;
+    QByteArray m_names;
+};
+
+typedef QSharedPointer<const PathArena> PathArenaPtr;
+
+#endif // PATHARENA_H
@@ -0,0 +1,231 @@
+#include "RiskRank.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const qint64 RECENT_DROP_SECS = 30 * 24 * 3600;
+
+struct Extensions {
+    QSet<QString> executable;
+    QSet<QString> script;
+    QSet<QString> document;
+};
+
+const Extensions& extensions() {
+    static const Extensions table = [] {
+        Extensions t;
+        t.executable = {"exe", "dll", "scr", "com", "sys", "msi", "cpl", "ocx", "so", "dylib",
+                        "elf", "bin", "run", "appimage", "apk", "jar", "deb", "rpm"};
+        t.script = {"sh", "bash", "zsh", "ps1", "psm1", "bat", "cmd", "vbs", "vbe", "js", "jse",
+                    "wsf", "hta", "py", "pl", "rb", "php", "lua", "desktop"};
+        t.document = {"pdf", "doc", "docm", "docx", "xls", "xlsm", "xlsx", "ppt", "pptm", "pptx",
+                      "rtf", "odt", "ods", "odp", "one", "lnk", "iso", "img"};
+        return t;
+    }();
+    return table;
+}
+
+// The download and desktop directories FileScanner::getCommonLocations offers,
+// plus the temp directories droppers favour; encoded, with a trailing slash
+QVector<QByteArray> dropPrefixes() {
+    QVector<QByteArray> prefixes;
+    const QStringList locations = {
+        QStandardPaths::writableLocation(QStandardPaths::DownloadLocation),
+        QStandardPaths::writableLocation(QStandardPaths::DesktopLocation),
+        QDir::tempPath(), "/tmp", "/var/tmp", "/dev/shm"
+    };
+    for (const QString& location : locations) {
+        // An unset XDG directory falls back to the home directory itself
+        if (location.isEmpty() || QDir(location) == QDir::home()) {
+            continue;
+        }
+        QByteArray prefix = QFile::encodeName(QDir::cleanPath(location)) + '/';
+        if (!prefixes.contains(prefix)) {
+            prefixes.append(prefix);
+        }
+    }
+    return prefixes;
+}
+
+bool inDropLocation(const QByteArray& path) {
+    static const QVector<QByteArray> prefixes = dropPrefixes();
+    for (const QByteArray& prefix : prefixes) {
+        if (path.startsWith(prefix)) {
+            return true;
+        }
+    }
+    // Downloads of other users, mounted homes, browser profiles
+    return path.contains("/Downloads/") || path.contains("/downloads/");
+}
+
+enum class Magic {
+    None,
+    Binary,     // ELF or PE
+    Shebang
+};
+
+Magic sniff(const QByteArray& path) {
+    int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return Magic::None;
+    }
+    unsigned char head[4] = {0, 0, 0, 0};
+    ssize_t length = ::read(fd, head, sizeof(head));
+    ::close(fd);
+
+    if (length >= 4 && head[0] == 0x7f && head[1] == 'E' && head[2] == 'L' && head[3] == 'F') {
+        return Magic::Binary;
+    }
+    if (length >= 2 && head[0] == 'M' && head[1] == 'Z') {
+        return Magic::Binary;
+    }
+    if (length >= 2 && head[0] == '#' && head[1] == '!') {
+        return Magic::Shebang;
+    }
+    return Magic::None;
+}
+
+QString suffixOf(const QByteArray& path) {
+    int slash = path.lastIndexOf('/');
+    int dot = path.lastIndexOf('.');
+    if (dot <= slash + 1) {
+        return QString();
+    }
+    return QFile::decodeName(path.mid(dot + 1)).toLower();
+}
+
+RiskRank::Tier rank(const QByteArray& path, bool regular, bool executable, qint64 ageSecs, bool drop) {
+    const Extensions& table = extensions();
+    QString suffix = suffixOf(path);
+
+    if (table.executable.contains(suffix)) {
+        return RiskRank::Executable;
+    }
+    if (table.script.contains(suffix)) {
+        return RiskRank::Script;
+    }
+    if (table.document.contains(suffix)) {
+        return RiskRank::Document;
+    }
+
+    // No telling suffix: the magic settles it, read only where it is likely to pay
+    if (regular && (executable || drop)) {
+        switch (sniff(path)) {
+        case Magic::Binary:
+            return RiskRank::Executable;
+        case Magic::Shebang:
+            return RiskRank::Script;
+        case Magic::None:
+            break;
+        }
+    }
+    if (executable) {
+        return suffix.isEmpty() ? RiskRank::Executable : RiskRank::Script;
+    }
+    if (drop && ageSecs <= RECENT_DROP_SECS) {
+        return RiskRank::RecentDrop;
+    }
+    return RiskRank::Other;
+}
+
+struct Ranked {
+    quint32 index;
+    quint8 tier;
+    bool drop;
+    qint64 mtime;
+};
+
+bool riskier(const Ranked& a, const Ranked& b) {
+    if (a.tier != b.tier) {
+        return a.tier < b.tier;
+    }
+    if (a.drop != b.drop) {
+        return a.drop;
+    }
+    return a.mtime > b.mtime;
+}
+
+}
+
+RiskRank::Tier RiskRank::classify(const QFileInfo& info, qint64 nowSecs) {
+    QByteArray path = QFile::encodeName(info.absoluteFilePath());
+    return rank(path, info.isFile(), info.isExecutable(),
+                nowSecs - info.lastModified().toSecsSinceEpoch(), inDropLocation(path));
+}
+
+QStringList RiskRank::order(const QStringList& paths, QStringList* missing) {
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    QVector<Ranked> ranked;
+    ranked.reserve(paths.size());
+    for (int i = 0; i < paths.size(); ++i) {
+        QFileInfo info(paths[i]);
+        if (!info.exists()) {
+            if (missing) {
+                missing->append(paths[i]);
+            }
+            continue;
+        }
+        ranked.append(Ranked{quint32(i), quint8(classify(info, now)),
+                             inDropLocation(QFile::encodeName(info.absoluteFilePath())),
+                             info.lastModified().toSecsSinceEpoch()});
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), riskier);
+
+    QStringList ordered;
+    ordered.reserve(ranked.size());
+    for (const Ranked& entry : ranked) {
+        ordered.append(paths[int(entry.index)]);
+    }
+    return ordered;
+}
+
+QVector<quint32> RiskRank::order(const PathArena& paths, const QVector<quint32>& files,
+                                 const CancellationToken* token) {
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    QVector<Ranked> ranked(files.size());
+    for (int i = 0; i < files.size(); ++i) {
+        ranked[i].index = files[i];
+    }
+
+    // One stat() per file, which the scan repeats from a warm cache
+    QtConcurrent::blockingMap(ranked, [&paths, now, token](Ranked& entry) {
+        entry.tier = Other;
+        entry.drop = false;
+        entry.mtime = 0;
+        if (token && token->isCancelled()) {
+            return;
+        }
+        QByteArray path = paths.encodedFilePath(entry.index);
+        struct stat st;
+        if (::stat(path.constData(), &st) != 0) {
+            entry.tier = TierCount;
+            return;
+        }
+        entry.drop = inDropLocation(path);
+        entry.mtime = qint64(st.st_mtime);
+        entry.tier = quint8(rank(path, S_ISREG(st.st_mode), (st.st_mode & 0111) != 0,
+                                 now - entry.mtime, entry.drop));
+    });
+    if (token && token->isCancelled()) {
+        return files;
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end(), riskier);
+
+    QVector<quint32> ordered;
+    ordered.reserve(ranked.size());
+    for (const Ranked& entry : ranked) {
+        ordered.append(entry.index);
+    }
+    return ordered;
+}
@@ -0,0 +1,41 @@
+#ifndef RISKRANK_H
+#define RISKRANK_H
+
+#include <QString>
+#include <QStringList>
+#include <QFileInfo>
+#include <QVector>
+#include "PathArena.h"
+#include "CancellationToken.h"
+
+// Orders files so the ones most likely to carry malware are scanned first:
+// executables, then scripts, then documents with active content, then
+// anything recently dropped where users and droppers put files, then the
+// rest. Within a tier files in a drop location (Downloads, the desktop, temp
+// directories) come first, then the most recently modified. Only the name,
+// one stat() and, for a file with no telling suffix that is executable or
+// sits in a drop location, its first four bytes are read, so ranking costs
+// far less than the scan it orders.
+class RiskRank {
+public:
+    enum Tier {
+        Executable,      // by suffix, mode bit, or ELF/PE magic
+        Script,          // by suffix or "#!"
+        Document,
+        RecentDrop,      // in a drop location, modified in the last 30 days
+        Other,
+        TierCount
+    };
+
+    static Tier classify(const QFileInfo& info, qint64 nowSecs);
+
+    // Stable; files that no longer exist are left out and, if asked, returned in missing
+    static QStringList order(const QStringList& paths, QStringList* missing = nullptr);
+    // The scan queue: files (ids into paths) reordered, ranked on the global
+    // thread pool. Files that cannot be stat()ed rank last and are kept, the
+    // scan reports them. A cancelled token returns files as they were.
+    static QVector<quint32> order(const PathArena& paths, const QVector<quint32>& files,
+                                  const CancellationToken* token = nullptr);
+};
+
+#endif // RISKRANK_H
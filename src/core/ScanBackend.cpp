@@ -0,0 +1,94 @@
+#include "ScanBackend.h"
+#include "ClamdscanBackend.h"
+#include "ClamdBackend.h"
+#include "EngineBackend.h"
+#include "ClamEngine.h"
+#include <QSettings>
+
+ScanReply ScanReply::skipped(SkipReason reason, const QString& why) {
+    ScanReply reply;
+    reply.status = Skipped;
+    reply.skipReason = reason;
+    reply.error = why;
+    return reply;
+}
+
+ScanReply ScanReply::parse(const QByteArray& line) {
+    ScanReply reply;
+    QString text = QString::fromUtf8(line).trimmed();
+    if (text.isEmpty()) {
+        reply.error = "No reply";
+        return reply;
+    }
+
+    // Paths may contain ": ", the verdict follows the last one
+    int separator = text.lastIndexOf(": ");
+    QString verdict = separator >= 0 ? text.mid(separator + 2) : text;
+
+    if (verdict == "OK") {
+        reply.status = Clean;
+    } else if (verdict.endsWith(" FOUND")) {
+        reply.status = Infected;
+        reply.virusName = verdict.left(verdict.size() - 6);
+    } else if (verdict.endsWith(" ERROR")) {
+        reply.error = verdict.left(verdict.size() - 6);
+        // StreamMaxLength: clamd stopped reading, the file was never scanned whole
+        if (reply.error.contains("size limit exceeded")) {
+            reply.status = Skipped;
+            reply.skipReason = SkipReason::ExceedsMaxFileSize;
+        }
+    } else {
+        reply.error = "Unexpected reply: " + text;
+    }
+    return reply;
+}
+
+ScanReply ScanBackend::scanBuffer(const QByteArray& data, const CancellationToken* token) {
+    Q_UNUSED(data);
+    Q_UNUSED(token);
+    ScanReply reply;
+    reply.error = QString("The %1 backend cannot scan from memory").arg(name());
+    return reply;
+}
+
+QStringList ScanBackend::names() {
+    return QStringList() << "clamdscan" << "clamd" << "clamd-stream" << "libclamav";
+}
+
+bool ScanBackend::isAvailable(const QString& name) {
+    if (name == "libclamav") {
+        return ClamEngine::isAvailable();
+    }
+    return names().contains(name);
+}
+
+QString ScanBackend::describe(const QString& name) {
+    if (name == "clamdscan") {
+        return "clamdscan --fdpass, one process per file";
+    } else if (name == "clamd") {
+        return "clamd socket, SCAN by path";
+    } else if (name == "clamd-stream") {
+        return "clamd socket, INSTREAM of the file contents";
+    } else if (name == "libclamav") {
+        return "in-process libclamav engine";
+    }
+    return QString();
+}
+
+ScanBackend* ScanBackend::create(const QString& name, const QString& endpoint) {
+    if (name == "clamdscan") {
+        return new ClamdscanBackend();
+    } else if (name == "clamd") {
+        return new ClamdBackend(endpoint, ClamdBackend::Mode::Path);
+    } else if (name == "clamd-stream") {
+        return new ClamdBackend(endpoint, ClamdBackend::Mode::Stream);
+    } else if (name == "libclamav" && ClamEngine::isAvailable()) {
+        return new EngineBackend();
+    }
+    return nullptr;
+}
+
+QString ScanBackend::defaultName() {
+    QSettings settings("FastAV", "FastAV");
+    return settings.value("scanner/backend", "clamdscan").toString();
+}
@@ -0,0 +1,91 @@
+#ifndef SCANBACKEND_H
+#define SCANBACKEND_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QVector>
+#include "CancellationToken.h"
+#include "ThreatReport.h"
+#include "SparseFile.h"
+#include "ScanPrefilter.h"
+
+// What a backend said about one file. Only Clean is a clean verdict: callers
+// handle every status, and neither Skipped nor Error may be taken for Clean.
+struct ScanReply {
+    enum Status {
+        Clean,
+        Infected,
+        Skipped,    // no verdict by design: the backend declined the file, skipReason says why
+        Error       // no verdict: unreadable, daemon failure, cancelled
+    };
+
+    Status status;
+    QString virusName;
+    QString error;
+    SkipReason skipReason;
+    ReadCount read;     // what FastAV read to send the file; empty when the backend read it
+
+    ScanReply() : status(Error), skipReason(SkipReason::None) {}
+
+    static ScanReply skipped(SkipReason reason, const QString& why);
+
+    // One clamd reply line: "<path>: OK", "<path>: <name> FOUND" or
+    // "<path>: <reason> ERROR". Anything else is an error, except clamd's
+    // INSTREAM size limit, which is Skipped as ExceedsMaxFileSize.
+    static ScanReply parse(const QByteArray& line);
+};
+
+// One way of getting a verdict for a file. A backend is created per scan and
+// shared by all of its tasks, so scan() must be safe to call concurrently.
+class ScanBackend {
+public:
+    struct Capabilities {
+        bool batch;         // can take several files per request
+        bool fdPassing;     // hands clamd an open descriptor instead of a path
+        bool streaming;     // sends file contents, the scanner needs no file access
+        bool inProcess;     // no daemon involved
+        bool needsDaemon;   // clamd must be running and reachable
+        bool buffers;       // scanBuffer() works, so archive members can be scanned from memory
+
+        Capabilities()
+            : batch(false), fdPassing(false), streaming(false), inProcess(false), needsDaemon(false),
+              buffers(false) {}
+    };
+
+    virtual ~ScanBackend() {}
+
+    virtual QString name() const = 0;
+    virtual Capabilities capabilities() const = 0;
+
+    // Called once per scan on a worker thread before any file is scanned;
+    // returning false aborts the scan with the error
+    virtual bool prepare(QString* error) { Q_UNUSED(error); return true; }
+
+    virtual ScanReply scan(const QString& path, const CancellationToken* token) = 0;
+
+    // Contents already in memory; backends without the buffers capability return an error
+    virtual ScanReply scanBuffer(const QByteArray& data, const CancellationToken* token);
+
+    // Daily signature version the verdicts come from ("27101"); empty if unknown
+    virtual QString signatureVersion() { return QString(); }
+
+    // Per-daemon work when requests are spread over several; empty otherwise
+    virtual QVector<EndpointStats> endpointStats() const { return QVector<EndpointStats>(); }
+
+    // "clamdscan", "clamd", "clamd-stream", "libclamav"
+    static QStringList names();
+    static bool isAvailable(const QString& name);
+    static QString describe(const QString& name);
+    // endpoint is "unix:/path" or "tcp:host:port" for the clamd backends, a
+    // comma separated list to balance over several daemons, or empty for the
+    // socket named in clamd.conf
+    static ScanBackend* create(const QString& name, const QString& endpoint);
+    // From the scanner/backend setting, clamdscan if unset
+    static QString defaultName();
+};
+
+typedef QSharedPointer<ScanBackend> ScanBackendPtr;
+
+#endif // SCANBACKEND_H
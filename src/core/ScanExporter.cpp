@@ -0,0 +1,376 @@
+#include "ScanExporter.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSaveFile>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QUrl>
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+const char SARIF_SCHEMA[] = "https://json.schemastore.org/sarif-2.1.0.json";
+
+// Rows between looks at the cancellation token
+const quint64 CANCEL_CHECK_ROWS = 1024;
+
+std::atomic<int> connectionCounter(0);
+
+// A connection of its own: QSqlDatabase connections belong to one thread.
+// Queries on it must be destroyed before it is.
+class ReadOnlyConnection {
+public:
+    explicit ReadOnlyConnection(const QString& path)
+        : m_name(QString("fastav_export_%1").arg(connectionCounter++))
+    {
+        m_db = QSqlDatabase::addDatabase("QSQLITE", m_name);
+        m_db.setDatabaseName(path);
+        m_db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+    }
+
+    ~ReadOnlyConnection() {
+        m_db.close();
+        m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_name);
+    }
+
+    bool open(QString* error) {
+        if (!m_db.open()) {
+            *error = m_db.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    QSqlDatabase& db() { return m_db; }
+
+private:
+    QString m_name;
+    QSqlDatabase m_db;
+};
+
+// Counts what was written and remembers the first failure
+class Output {
+public:
+    explicit Output(QIODevice* device) : m_device(device), m_bytes(0), m_failed(false) {}
+
+    void write(const QByteArray& data) {
+        if (m_failed) {
+            return;
+        }
+        if (m_device->write(data) != data.size()) {
+            m_failed = true;
+            return;
+        }
+        m_bytes += quint64(data.size());
+    }
+
+    bool failed() const { return m_failed; }
+    quint64 bytes() const { return m_bytes; }
+    QString errorString() const { return m_device->errorString(); }
+
+private:
+    QIODevice* m_device;
+    quint64 m_bytes;
+    bool m_failed;
+};
+
+QByteArray compact(const QJsonObject& object) {
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QByteArray compact(const QJsonArray& array) {
+    return QJsonDocument(array).toJson(QJsonDocument::Compact);
+}
+
+// RFC 4180: quote fields with separators, quotes or line breaks
+QByteArray csvField(const QString& text) {
+    QByteArray field = text.toUtf8();
+    if (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r')) {
+        field.replace("\"", "\"\"");
+        return '"' + field + '"';
+    }
+    return field;
+}
+
+QString isoTime(const QVariant& value) {
+    return value.toDateTime().toString(Qt::ISODate);
+}
+
+QJsonObject scanObject(const QSqlQuery& scan) {
+    QJsonObject object;
+    object["id"] = scan.value("id").toInt();
+    object["date"] = isoTime(scan.value("scan_date"));
+    object["path"] = scan.value("scan_path").toString();
+    object["status"] = scan.value("status").toString();
+    object["files_scanned"] = scan.value("files_scanned").toLongLong();
+    object["bytes_scanned"] = scan.value("bytes_scanned").toLongLong();
+    object["bytes_read"] = scan.value("bytes_read").toLongLong();
+    object["hole_bytes"] = scan.value("hole_bytes").toLongLong();
+    object["threats_found"] = scan.value("threats_found").toLongLong();
+    object["duration_s"] = scan.value("scan_duration").toLongLong();
+    object["files_timed_out"] = scan.value("files_timed_out").toLongLong();
+    object["files_failed"] = scan.value("files_failed").toLongLong();
+    object["files_skipped"] = scan.value("files_skipped").toLongLong();
+    QVariant firstDetection = scan.value("first_detection_ms");
+    if (!firstDetection.isNull() && firstDetection.toLongLong() >= 0) {
+        object["first_detection_ms"] = firstDetection.toLongLong();
+    }
+    object["signature_versions"] = QJsonArray::fromStringList(
+        scan.value("signature_versions").toString().split(',', Qt::SkipEmptyParts));
+    return object;
+}
+
+void writeHeader(Output& out, ScanExporter::Format format, const QSqlQuery& scan) {
+    switch (format) {
+    case ScanExporter::Format::Ndjson: {
+        QJsonObject object = scanObject(scan);
+        object["type"] = "scan";
+        out.write(compact(object) + '\n');
+        break;
+    }
+    case ScanExporter::Format::Csv:
+        out.write("scan_id,file_path,virus_name,file_size,detection_time,signature_version\r\n");
+        break;
+    case ScanExporter::Format::Sarif: {
+        QJsonObject driver;
+        driver["name"] = "FastAV";
+        driver["version"] = QCoreApplication::applicationVersion();
+        QJsonObject tool;
+        tool["driver"] = driver;
+
+        QDateTime start = scan.value("scan_date").toDateTime();
+        QJsonObject invocation;
+        invocation["executionSuccessful"] = scan.value("status").toString() == "completed";
+        invocation["startTimeUtc"] = start.toUTC().toString(Qt::ISODate);
+        invocation["endTimeUtc"] = start.addSecs(scan.value("scan_duration").toLongLong())
+            .toUTC().toString(Qt::ISODate);
+
+        // The results array is streamed, so the document is opened by hand
+        out.write(QByteArray("{\"version\":\"2.1.0\",\"$schema\":\"") + SARIF_SCHEMA + "\",\"runs\":[{");
+        out.write("\"tool\":" + compact(tool));
+        out.write(",\"invocations\":" + compact(QJsonArray{invocation}));
+        out.write(",\"properties\":" + compact(scanObject(scan)));
+        out.write(",\"results\":[\n");
+        break;
+    }
+    }
+}
+
+void writeThreat(Output& out, ScanExporter::Format format, int scanId, const QSqlQuery& threat, bool first) {
+    QString path = threat.value(0).toString();
+    QString virus = threat.value(1).toString();
+    qint64 size = threat.value(2).toLongLong();
+    QString time = isoTime(threat.value(3));
+    QString version = threat.value(4).toString();
+
+    switch (format) {
+    case ScanExporter::Format::Ndjson: {
+        QJsonObject object;
+        object["type"] = "threat";
+        object["scan_id"] = scanId;
+        object["file_path"] = path;
+        object["virus_name"] = virus;
+        object["file_size"] = size;
+        object["detection_time"] = time;
+        object["signature_version"] = version;
+        out.write(compact(object) + '\n');
+        break;
+    }
+    case ScanExporter::Format::Csv:
+        out.write(QByteArray::number(scanId) + ',' + csvField(path) + ',' + csvField(virus) + ','
+                  + QByteArray::number(size) + ',' + csvField(time) + ',' + csvField(version) + "\r\n");
+        break;
+    case ScanExporter::Format::Sarif: {
+        QJsonObject message;
+        message["text"] = virus + " detected";
+        QJsonObject artifact;
+        artifact["uri"] = QUrl::fromLocalFile(path).toString(QUrl::FullyEncoded);
+        QJsonObject physical;
+        physical["artifactLocation"] = artifact;
+        QJsonObject location;
+        location["physicalLocation"] = physical;
+        QJsonObject properties;
+        properties["fileSize"] = size;
+        properties["detectionTime"] = time;
+        properties["signatureVersion"] = version;
+
+        QJsonObject result;
+        result["ruleId"] = virus;
+        result["level"] = "error";
+        result["message"] = message;
+        result["locations"] = QJsonArray{location};
+        result["properties"] = properties;
+        out.write((first ? QByteArray() : QByteArray(",\n")) + compact(result));
+        break;
+    }
+    }
+}
+
+bool writeScan(QSqlDatabase& db, int scanId, ScanExporter::Format format, Output& out,
+               const CancellationToken* token, QString* error, quint64* threats) {
+    QSqlQuery scan(db);
+    scan.prepare("SELECT * FROM scan_history WHERE id = ?");
+    scan.addBindValue(scanId);
+    if (!scan.exec()) {
+        *error = scan.lastError().text();
+        return false;
+    }
+    if (!scan.next()) {
+        *error = QString("No scan with ID %1").arg(scanId);
+        return false;
+    }
+    writeHeader(out, format, scan);
+
+    // Forward only: SQLite hands over one row at a time, nothing is cached
+    QSqlQuery threat(db);
+    threat.setForwardOnly(true);
+    threat.prepare(R"(
+        SELECT file_path, virus_name, file_size, detection_time, signature_version
+        FROM threats WHERE scan_id = ? ORDER BY id
+    )");
+    threat.addBindValue(scanId);
+    if (!threat.exec()) {
+        *error = threat.lastError().text();
+        return false;
+    }
+
+    while (threat.next()) {
+        if (*threats % CANCEL_CHECK_ROWS == 0 && token && token->isCancelled()) {
+            *error = "Export cancelled";
+            return false;
+        }
+        writeThreat(out, format, scanId, threat, *threats == 0);
+        (*threats)++;
+        if (out.failed()) {
+            *error = out.errorString();
+            return false;
+        }
+    }
+
+    if (format == ScanExporter::Format::Sarif) {
+        out.write("\n]}]}\n");
+    }
+    if (out.failed()) {
+        *error = out.errorString();
+        return false;
+    }
+    return true;
+}
+
+}
+
+ScanExporter::ScanExporter(const QString& databasePath)
+    : m_databasePath(databasePath)
+{
+}
+
+int ScanExporter::latestScanId(QString* error) const {
+    QString localError;
+    error = error ? error : &localError;
+
+    ReadOnlyConnection connection(m_databasePath);
+    if (!connection.open(error)) {
+        return -1;
+    }
+    QSqlQuery query(connection.db());
+    if (!query.exec("SELECT id FROM scan_history ORDER BY id DESC LIMIT 1")) {
+        *error = query.lastError().text();
+        return -1;
+    }
+    if (!query.next()) {
+        *error = "No scans in the history";
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+QStringList ScanExporter::formatNames() {
+    return QStringList() << "ndjson" << "csv" << "sarif";
+}
+
+bool ScanExporter::parseFormat(const QString& name, Format* format) {
+    QString lower = name.toLower();
+    if (lower == "ndjson" || lower == "jsonl") {
+        *format = Format::Ndjson;
+    } else if (lower == "csv") {
+        *format = Format::Csv;
+    } else if (lower == "sarif") {
+        *format = Format::Sarif;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString ScanExporter::formatName(Format format) {
+    switch (format) {
+    case Format::Ndjson: return "ndjson";
+    case Format::Csv: return "csv";
+    case Format::Sarif: return "sarif";
+    }
+    return QString();
+}
+
+QString ScanExporter::fileSuffix(Format format) {
+    return formatName(format);
+}
+
+bool ScanExporter::exportScan(int scanId, Format format, const QString& output,
+                              const CancellationToken* token, QString* error, Stats* stats) {
+    QString localError;
+    error = error ? error : &localError;
+
+    if (output == "-") {
+        QFile out;
+        if (!out.open(stdout, QIODevice::WriteOnly)) {
+            *error = out.errorString();
+            return false;
+        }
+        bool ok = exportScan(scanId, format, &out, token, error, stats);
+        out.flush();
+        return ok;
+    }
+
+    // A cancelled or failed export leaves an existing file alone
+    QSaveFile file(output);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    if (!exportScan(scanId, format, &file, token, error, stats)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ScanExporter::exportScan(int scanId, Format format, QIODevice* device,
+                              const CancellationToken* token, QString* error, Stats* stats) {
+    QString localError;
+    error = error ? error : &localError;
+    Stats localStats;
+    stats = stats ? stats : &localStats;
+
+    QElapsedTimer timer;
+    timer.start();
+    Output out(device);
+    ReadOnlyConnection connection(m_databasePath);
+    bool ok = connection.open(error)
+        && writeScan(connection.db(), scanId, format, out, token, error, &stats->threats);
+
+    stats->bytes = out.bytes();
+    stats->elapsedMs = timer.elapsed();
+    return ok;
+}
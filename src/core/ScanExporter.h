@@ -0,0 +1,56 @@
+#ifndef SCANEXPORTER_H
+#define SCANEXPORTER_H
+
+#include <QString>
+#include <QStringList>
+#include "CancellationToken.h"
+
+class QIODevice;
+
+// Writes one scan's results straight from the database to a file or pipe,
+// row by row off a forward-only cursor, so memory stays flat however many
+// detections the scan has. Opens its own read-only connection and can run
+// on any thread, next to a scan writing to the same database.
+//   ndjson  a "scan" object, then one "threat" object per line
+//   csv     one row per threat, with a header row
+//   sarif   a SARIF 2.1.0 log with one result per threat
+class ScanExporter {
+public:
+    enum class Format {
+        Ndjson,
+        Csv,
+        Sarif
+    };
+
+    struct Stats {
+        quint64 threats;
+        quint64 bytes;
+        qint64 elapsedMs;
+
+        Stats() : threats(0), bytes(0), elapsedMs(0) {}
+    };
+
+    explicit ScanExporter(const QString& databasePath);
+
+    // Newest scan in the history, -1 if there is none
+    int latestScanId(QString* error = nullptr) const;
+
+    static QStringList formatNames();
+    static bool parseFormat(const QString& name, Format* format);
+    static QString formatName(Format format);
+    static QString fileSuffix(Format format);
+
+    // output is a file path, or "-" for stdout; a file is only replaced once
+    // the export is complete
+    bool exportScan(int scanId, Format format, const QString& output,
+                    const CancellationToken* token = nullptr, QString* error = nullptr,
+                    Stats* stats = nullptr);
+    bool exportScan(int scanId, Format format, QIODevice* device,
+                    const CancellationToken* token = nullptr, QString* error = nullptr,
+                    Stats* stats = nullptr);
+
+private:
+    QString m_databasePath;
+};
+
+#endif // SCANEXPORTER_H
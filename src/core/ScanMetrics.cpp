@@ -0,0 +1,138 @@
+#include "ScanMetrics.h"
+
+namespace {
+
+std::atomic<quint64> nextInstanceId(1);
+
+// The calling thread's shard of the ScanMetrics it used last. Keyed by an id
+// rather than the address, so a new instance at a reused address misses.
+struct ThreadShardCache {
+    quint64 instanceId;
+    void* shard;
+};
+
+thread_local ThreadShardCache shardCache = {0, nullptr};
+
+}
+
+ScanMetrics::ScanMetrics()
+    : m_instanceId(nextInstanceId.fetch_add(1))
+    , m_shardCount(0)
+    , m_tracer(nullptr)
+{
+    for (std::atomic<Shard*>& shard : m_shards) {
+        shard.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ScanMetrics::~ScanMetrics() {
+    int count = m_shardCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        delete m_shards[i].load(std::memory_order_relaxed);
+    }
+}
+
+ScanMetrics::Shard* ScanMetrics::shardForThisThread() {
+    if (shardCache.instanceId == m_instanceId) {
+        return static_cast<Shard*>(shardCache.shard);
+    }
+
+    // A thread that went back and forth between instances keeps its old shard
+    Qt::HANDLE thread = QThread::currentThreadId();
+    Shard* shard = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        int count = m_shardCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; ++i) {
+            Shard* candidate = m_shards[i].load(std::memory_order_relaxed);
+            if (candidate->thread == thread) {
+                shard = candidate;
+                break;
+            }
+        }
+        if (!shard && count == MaxShards) {
+            shard = m_shards[MaxShards - 1].load(std::memory_order_relaxed);
+        } else if (!shard) {
+            shard = new Shard;
+            shard->thread = thread;
+            // Published before the count, so readers never see a missing shard
+            m_shards[count].store(shard, std::memory_order_release);
+            m_shardCount.store(count + 1, std::memory_order_release);
+        }
+    }
+
+    shardCache.instanceId = m_instanceId;
+    shardCache.shard = shard;
+    return shard;
+}
+
+void ScanMetrics::record(ScanStage stage, quint64 micros) {
+    shardForThisThread()->stages[int(stage)].record(micros);
+}
+
+void ScanMetrics::reset() {
+    int count = m_shardCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        for (LatencyHistogram& histogram : m_shards[i].load(std::memory_order_acquire)->stages) {
+            histogram.reset();
+        }
+    }
+}
+
+LatencyHistogram ScanMetrics::merged(ScanStage stage) const {
+    LatencyHistogram result;
+
+    // Counters are read with relaxed loads while the workers keep recording
+    int count = m_shardCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        result.merge(m_shards[i].load(std::memory_order_acquire)->stages[int(stage)]);
+    }
+    return result;
+}
+
+QVector<StageLatency> ScanMetrics::summary() const {
+    QVector<StageLatency> stages;
+
+    for (int i = 0; i < int(ScanStage::Count); ++i) {
+        LatencyHistogram histogram = merged(ScanStage(i));
+
+        StageLatency stage;
+        stage.stage = stageName(ScanStage(i));
+        stage.count = histogram.count();
+        stage.p50 = histogram.percentile(50);
+        stage.p90 = histogram.percentile(90);
+        stage.p99 = histogram.percentile(99);
+        stage.max = histogram.max();
+        stage.total = histogram.sum();
+        stages.append(stage);
+    }
+
+    return stages;
+}
+
+QString ScanMetrics::stageName(ScanStage stage) {
+    return QString::fromLatin1(stageLabel(stage));
+}
+
+const char* ScanMetrics::stageLabel(ScanStage stage) {
+    switch (stage) {
+    case ScanStage::Walk:
+        return "walk";
+    case ScanStage::Stat:
+        return "stat";
+    case ScanStage::Read:
+        return "read";
+    case ScanStage::Verify:
+        return "verify";
+    case ScanStage::Hash:
+        return "hash";
+    case ScanStage::Backend:
+        return "backend";
+    case ScanStage::Parse:
+        return "parse";
+    case ScanStage::Report:
+        return "report";
+    default:
+        return "";
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef SCANMETRICS_H
+#define SCANMETRICS_H
+
+#include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+#include "LatencyHistogram.h"
+#include "ThreatReport.h"
+#include "ScanTracer.h"
+
+enum class ScanStage {
+    Walk,       // listing one directory
+    Stat,       // size and type of one file
+    Read,       // prefilter: open and read the header
+    Verify,     // checksum of a file against its package record
+    Hash,       // digest of a file whose size is in the hash index
+    Backend,    // clamd round trip
+    Parse,      // interpreting the backend's answer
+    Report,     // bookkeeping, signals and the threat insert
+    Count
+};
+
+// Per-stage latency of the scan pipeline. Each thread records into its own
+// shard, so recording never contends; shards are merged only when someone
+// asks for a breakdown. Shards are only ever appended, and readers walk them
+// with atomic loads, so a scrape during the scan takes no lock at all.
+class ScanMetrics {
+public:
+    ScanMetrics();
+    ~ScanMetrics();
+
+    void record(ScanStage stage, quint64 micros);
+    void reset();
+
+    LatencyHistogram merged(ScanStage stage) const;
+    QVector<StageLatency> summary() const;
+
+    // Optional span recording next to the histograms; not owned
+    void setTracer(ScanTracer* tracer) { m_tracer.store(tracer); }
+    ScanTracer* tracer() const { return m_tracer.load(std::memory_order_relaxed); }
+
+    static QString stageName(ScanStage stage);
+    static const char* stageLabel(ScanStage stage);
+
+private:
+    struct Shard {
+        Qt::HANDLE thread;
+        LatencyHistogram stages[int(ScanStage::Count)];
+    };
+
+    Shard* shardForThisThread();
+
+    // Threads past this share the last shard; its histograms are atomic too
+    static const int MaxShards = 256;
+
+    const quint64 m_instanceId;
+    QMutex m_mutex;  // serializes adding shards, taken once per thread
+    std::atomic<Shard*> m_shards[MaxShards];
+    std::atomic<int> m_shardCount;
+    std::atomic<ScanTracer*> m_tracer;
+};
+
+// Times one stage from construction to destruction (or to stop()), and
+// traces it as a span when the metrics have a tracer
+class StageTimer {
+public:
+    StageTimer(ScanMetrics* metrics, ScanStage stage, const QString& detail = QString())
+        : m_metrics(metrics)
+        , m_stage(stage)
+        , m_tracer(metrics ? metrics->tracer() : nullptr)
+        , m_traceStart(m_tracer ? m_tracer->now() : 0) {
+        if (m_tracer) {
+            m_detail = detail;
+        }
+        m_timer.start();
+    }
+    ~StageTimer() { stop(); }
+
+    void stop() {
+        if (m_metrics) {
+            m_metrics->record(m_stage, quint64(m_timer.nsecsElapsed() / 1000));
+            m_metrics = nullptr;
+        }
+        if (m_tracer) {
+            m_tracer->record(ScanMetrics::stageLabel(m_stage), m_traceStart, m_tracer->now(), m_detail);
+            m_tracer = nullptr;
+        }
+    }
+
+private:
+    ScanMetrics* m_metrics;
+    ScanStage m_stage;
+    ScanTracer* m_tracer;
+    quint64 m_traceStart;
+    QString m_detail;
+    QElapsedTimer m_timer;
+};
+
+#endif // SCANMETRICS_H
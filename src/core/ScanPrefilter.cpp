@@ -0,0 +1,245 @@
+#include "ScanPrefilter.h"
+#include "ClamdClient.h"
+#include <QFile>
+#include <QVector>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+struct Signature {
+    int offset;
+    const char* magic;
+    int length;
+    FileClass fileClass;
+};
+
+// Magic numbers at offset 0, dispatched on their first byte
+const Signature LEADING_SIGNATURES[] = {
+    {0, "\x7f" "ELF", 4, FileClass::Executable},
+    {0, "MZ", 2, FileClass::Executable},
+    {0, "\xfe\xed\xfa\xce", 4, FileClass::Executable},   // Mach-O
+    {0, "\xfe\xed\xfa\xcf", 4, FileClass::Executable},
+    {0, "\xce\xfa\xed\xfe", 4, FileClass::Executable},
+    {0, "\xcf\xfa\xed\xfe", 4, FileClass::Executable},
+    {0, "\xca\xfe\xba\xbe", 4, FileClass::Executable},   // Mach-O fat, Java class
+    {0, "\x00" "asm", 4, FileClass::Executable},         // WebAssembly
+    {0, "#!", 2, FileClass::Script},
+    {0, "PK\x03\x04", 4, FileClass::Archive},            // zip, jar, apk, docx
+    {0, "PK\x05\x06", 4, FileClass::Archive},
+    {0, "\x1f\x8b", 2, FileClass::Archive},              // gzip
+    {0, "BZh", 3, FileClass::Archive},
+    {0, "\xfd" "7zXZ\x00", 6, FileClass::Archive},
+    {0, "7z\xbc\xaf\x27\x1c", 6, FileClass::Archive},
+    {0, "Rar!\x1a\x07", 6, FileClass::Archive},
+    {0, "\x28\xb5\x2f\xfd", 4, FileClass::Archive},      // zstd
+    {0, "MSCF", 4, FileClass::Archive},                  // cab
+    {0, "!<arch>", 7, FileClass::Archive},               // ar, deb
+    {0, "\xed\xab\xee\xdb", 4, FileClass::Archive},      // rpm
+    {0, "%PDF", 4, FileClass::Document},
+    {0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8, FileClass::Document},  // OLE2
+    {0, "{\\rtf", 5, FileClass::Document},
+    {0, "\x89PNG", 4, FileClass::Image},
+    {0, "\xff\xd8\xff", 3, FileClass::Image},
+    {0, "GIF8", 4, FileClass::Image},
+    {0, "BM", 2, FileClass::Image},
+    {0, "ID3", 3, FileClass::Media},
+    {0, "OggS", 4, FileClass::Media},
+    {0, "RIFF", 4, FileClass::Media},
+    {0, "fLaC", 4, FileClass::Media},
+    {0, "\x1a\x45\xdf\xa3", 4, FileClass::Media},        // Matroska, WebM
+};
+
+// Magic numbers further into the header, checked after the leading ones
+const Signature EMBEDDED_SIGNATURES[] = {
+    {4, "ftyp", 4, FileClass::Media},                    // MP4, MOV, HEIF
+    {257, "ustar", 5, FileClass::Archive},
+};
+
+// First byte -> candidate leading signatures. A file costs one table load and
+// a memcmp per candidate, rarely more than two, instead of a pass over all.
+struct SignatureIndex {
+    QVector<const Signature*> byFirstByte[256];
+    bool textByte[256];
+
+    SignatureIndex() {
+        for (const Signature& signature : LEADING_SIGNATURES) {
+            byFirstByte[static_cast<unsigned char>(signature.magic[0])].append(&signature);
+        }
+        for (int byte = 0; byte < 256; ++byte) {
+            // Printable ASCII, common whitespace and anything that may be UTF-8
+            textByte[byte] = (byte >= 0x20 && byte != 0x7f) || byte == '\t' || byte == '\n'
+                          || byte == '\r' || byte == '\f';
+        }
+    }
+};
+
+const SignatureIndex& signatureIndex() {
+    static const SignatureIndex index;
+    return index;
+}
+
+bool matches(const Signature& signature, const unsigned char* header, int length) {
+    return signature.offset + signature.length <= length
+        && std::memcmp(header + signature.offset, signature.magic, signature.length) == 0;
+}
+
+const int PROBE_TIMEOUT_MS = 2000;
+
+}
+
+ScanPrefilter::ScanPrefilter() {
+}
+
+ScanPrefilter::ScanPrefilter(const ClamdConfig& config)
+    : m_config(config)
+{
+}
+
+ScanPrefilter ScanPrefilter::probe(const QString& endpoint) {
+    ScanPrefilter prefilter(ClamdConfig::load());
+
+    ClamdClient client(endpoint.isEmpty() ? prefilter.m_config.endpoint() : endpoint);
+    if (client.versionCommands(&prefilter.m_daemonVersion, &prefilter.m_daemonCommands, PROBE_TIMEOUT_MS)) {
+        qDebug() << "clamd" << prefilter.m_daemonVersion << "commands:" << prefilter.m_daemonCommands.join(' ');
+    } else {
+        qDebug() << "clamd at" << client.endpoint() << "did not answer VERSIONCOMMANDS:" << client.errorString();
+    }
+
+    qDebug() << "clamd limits - MaxFileSize:" << prefilter.m_config.maxFileSize
+             << "MaxScanSize:" << prefilter.m_config.maxScanSize
+             << "StreamMaxLength:" << prefilter.m_config.streamMaxLength
+             << "AlertExceedsMax:" << prefilter.m_config.alertExceedsMax;
+
+    return prefilter;
+}
+
+SkipReason ScanPrefilter::check(const QString& path, quint64 fileSize, FileClass* fileClass,
+                                const QByteArray* header) const {
+    *fileClass = FileClass::Unknown;
+
+    if (fileSize == 0) {
+        return SkipReason::Empty;
+    }
+
+    // clamd answers OK without looking past MaxFileSize unless told to alert
+    if (m_config.maxFileSize > 0 && fileSize > m_config.maxFileSize && !m_config.alertExceedsMax) {
+        return SkipReason::ExceedsMaxFileSize;
+    }
+
+    if (header && !header->isEmpty()) {
+        *fileClass = classify(reinterpret_cast<const unsigned char*>(header->constData()),
+                              int(qMin(header->size(), qsizetype(HeaderSize))));
+        return SkipReason::None;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return SkipReason::Unreadable;
+    }
+
+    unsigned char buffer[HeaderSize];
+    qint64 length = file.read(reinterpret_cast<char*>(buffer), HeaderSize);
+    if (length <= 0) {
+        return SkipReason::Unreadable;
+    }
+
+    *fileClass = classify(buffer, int(length));
+    return SkipReason::None;
+}
+
+FileClass ScanPrefilter::classify(const unsigned char* header, int length) {
+    if (length <= 0) {
+        return FileClass::Unknown;
+    }
+
+    const SignatureIndex& index = signatureIndex();
+
+    for (const Signature* signature : index.byFirstByte[header[0]]) {
+        if (matches(*signature, header, length)) {
+            return signature->fileClass;
+        }
+    }
+
+    for (const Signature& signature : EMBEDDED_SIGNATURES) {
+        if (matches(signature, header, length)) {
+            return signature.fileClass;
+        }
+    }
+
+    // No NUL and at most a few control bytes: treat as text
+    int binaryBytes = 0;
+    for (int i = 0; i < length; ++i) {
+        if (header[i] == 0) {
+            return FileClass::Unknown;
+        }
+        binaryBytes += index.textByte[header[i]] ? 0 : 1;
+    }
+
+    return binaryBytes * 20 <= length ? FileClass::Text : FileClass::Unknown;
+}
+
+bool ScanPrefilter::exceedsStreamLimit(quint64 fileSize) const {
+    return m_config.streamMaxLength > 0 && fileSize > m_config.streamMaxLength;
+}
+
+int ScanPrefilter::deadlineFactor(FileClass fileClass) {
+    switch (fileClass) {
+    case FileClass::Archive:
+    case FileClass::Document:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+QString ScanPrefilter::reasonName(SkipReason reason) {
+    switch (reason) {
+    case SkipReason::Empty:
+        return "Empty file";
+    case SkipReason::ExceedsMaxFileSize:
+        return "Larger than clamd MaxFileSize";
+    case SkipReason::Unreadable:
+        return "Unreadable";
+    case SkipReason::PackageVerified:
+        return "Matches its package checksum";
+    default:
+        return QString();
+    }
+}
+
+QByteArray ScanPrefilter::reasonKey(SkipReason reason) {
+    switch (reason) {
+    case SkipReason::Empty:
+        return "empty";
+    case SkipReason::ExceedsMaxFileSize:
+        return "over_max_file_size";
+    case SkipReason::Unreadable:
+        return "unreadable";
+    case SkipReason::PackageVerified:
+        return "package_verified";
+    default:
+        return QByteArray();
+    }
+}
+
+QString ScanPrefilter::className(FileClass fileClass) {
+    switch (fileClass) {
+    case FileClass::Text:
+        return "Text";
+    case FileClass::Executable:
+        return "Executable";
+    case FileClass::Script:
+        return "Script";
+    case FileClass::Archive:
+        return "Archive";
+    case FileClass::Document:
+        return "Document";
+    case FileClass::Image:
+        return "Image";
+    case FileClass::Media:
+        return "Media";
+    default:
+        return "Unknown";
+    }
+}
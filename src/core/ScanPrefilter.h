@@ -0,0 +1,75 @@
+#ifndef SCANPREFILTER_H
+#define SCANPREFILTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include "ClamdConfig.h"
+
+// Broad content type from the first bytes of a file
+enum class FileClass {
+    Unknown,
+    Text,
+    Executable,
+    Script,
+    Archive,     // clamd unpacks these, so they cost far more than their size
+    Document,    // PDF, OLE2, RTF - also unpacked
+    Image,
+    Media,
+    Count
+};
+
+// Why a file was not sent to clamd
+enum class SkipReason {
+    None,
+    Empty,
+    ExceedsMaxFileSize,
+    Unreadable,
+    PackageVerified,    // unchanged copy of a file its package installed
+    Count
+};
+
+// Decides, before any clamd round trip, whether a file can produce a verdict
+// at all. Limits come from clamd.conf; VERSIONCOMMANDS tells which daemon and
+// protocol features are available. Built once per scan, then only read.
+class ScanPrefilter {
+public:
+    // Enough to reach the tar "ustar" magic at offset 257
+    static const int HeaderSize = 512;
+
+    ScanPrefilter();
+    explicit ScanPrefilter(const ClamdConfig& config);
+
+    // Reads clamd.conf and asks the daemon for its version and commands;
+    // an explicit endpoint overrides the socket named in clamd.conf
+    static ScanPrefilter probe(const QString& endpoint = QString());
+
+    // Size checks first, then one read of the header to classify the file;
+    // header, when given, is the start of the file already in memory
+    SkipReason check(const QString& path, quint64 fileSize, FileClass* fileClass,
+                     const QByteArray* header = nullptr) const;
+
+    static FileClass classify(const unsigned char* header, int length);
+
+    // Would INSTREAM truncate the file? Such files must be scanned by path or fd
+    bool exceedsStreamLimit(quint64 fileSize) const;
+    // Budget multiplier for the per-file deadline
+    static int deadlineFactor(FileClass fileClass);
+
+    static QString reasonName(SkipReason reason);
+    // Stable snake_case id, for metric labels
+    static QByteArray reasonKey(SkipReason reason);
+    static QString className(FileClass fileClass);
+
+    const ClamdConfig& config() const { return m_config; }
+    QString daemonVersion() const { return m_daemonVersion; }
+    QStringList daemonCommands() const { return m_daemonCommands; }
+    bool supportsCommand(const QString& command) const { return m_daemonCommands.contains(command); }
+
+private:
+    ClamdConfig m_config;
+    QString m_daemonVersion;
+    QStringList m_daemonCommands;
+};
+
+#endif // SCANPREFILTER_H
@@ -0,0 +1,180 @@
+#include "ScanTracer.h"
+#include <QSaveFile>
+
+namespace {
+
+std::atomic<quint64> nextInstanceId(1);
+
+// The calling thread's buffer in the tracer it used last, as in ScanMetrics
+struct ThreadBufferCache {
+    quint64 instanceId;
+    void* buffer;
+};
+
+thread_local ThreadBufferCache bufferCache = {0, nullptr};
+
+// JSON string body, without the quotes
+QByteArray escape(const QString& text) {
+    QByteArray utf8 = text.toUtf8();
+    QByteArray out;
+    out.reserve(utf8.size() + 8);
+
+    for (char c : utf8) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (uchar(c) < 0x20) {
+                out += "\\u00" + QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+// Trace timestamps are microseconds; keep the nanoseconds as a fraction
+QByteArray micros(quint64 nanos) {
+    return QByteArray::number(nanos / 1000) + '.'
+        + QByteArray::number(nanos % 1000).rightJustified(3, '0');
+}
+
+}
+
+ScanTracer::ScanTracer(int eventsPerThread)
+    : m_instanceId(nextInstanceId.fetch_add(1))
+    , m_eventsPerThread(qMax(1, eventsPerThread))
+{
+    m_clock.start();
+}
+
+ScanTracer::~ScanTracer() {
+    qDeleteAll(m_buffers);
+}
+
+ScanTracer::Buffer* ScanTracer::bufferForThisThread() {
+    if (bufferCache.instanceId == m_instanceId) {
+        return static_cast<Buffer*>(bufferCache.buffer);
+    }
+
+    Qt::HANDLE thread = QThread::currentThreadId();
+    Buffer* buffer = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (Buffer* candidate : m_buffers) {
+            if (candidate->thread == thread) {
+                buffer = candidate;
+                break;
+            }
+        }
+        if (!buffer) {
+            buffer = new Buffer;
+            buffer->thread = thread;
+            buffer->tid = m_buffers.size() + 1;
+            buffer->events.resize(m_eventsPerThread);
+            buffer->written = 0;
+            m_buffers.append(buffer);
+        }
+    }
+
+    bufferCache.instanceId = m_instanceId;
+    bufferCache.buffer = buffer;
+    return buffer;
+}
+
+void ScanTracer::record(const char* name, quint64 startNs, quint64 endNs, const QString& detail) {
+    Buffer* buffer = bufferForThisThread();
+
+    Event& event = buffer->events[int(buffer->written % quint64(buffer->events.size()))];
+    event.name = name;
+    event.start = startNs;
+    event.duration = endNs > startNs ? endNs - startNs : 0;
+    event.detail = detail;
+    buffer->written++;
+}
+
+quint64 ScanTracer::eventCount() const {
+    QMutexLocker locker(&m_mutex);
+    quint64 total = 0;
+    for (const Buffer* buffer : m_buffers) {
+        total += qMin(buffer->written, quint64(buffer->events.size()));
+    }
+    return total;
+}
+
+quint64 ScanTracer::droppedCount() const {
+    QMutexLocker locker(&m_mutex);
+    quint64 total = 0;
+    for (const Buffer* buffer : m_buffers) {
+        quint64 size = quint64(buffer->events.size());
+        total += buffer->written > size ? buffer->written - size : 0;
+    }
+    return total;
+}
+
+bool ScanTracer::write(const QString& path, QString* error) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    QByteArray out;
+    out.reserve(1 << 20);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"FastAV\"}}";
+
+    quint64 dropped = 0;
+    for (const Buffer* buffer : m_buffers) {
+        QByteArray tid = QByteArray::number(buffer->tid);
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+            + ",\"args\":{\"name\":\"thread " + tid + "\"}}";
+
+        // Oldest first; once the ring has wrapped that is the slot after the newest
+        quint64 size = quint64(buffer->events.size());
+        quint64 first = buffer->written > size ? buffer->written - size : 0;
+        dropped += first;
+
+        for (quint64 i = first; i < buffer->written; ++i) {
+            const Event& event = buffer->events[int(i % size)];
+            out += ",\n{\"name\":\"";
+            out += event.name;
+            out += "\",\"cat\":\"scan\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid
+                + ",\"ts\":" + micros(event.start) + ",\"dur\":" + micros(event.duration);
+            if (!event.detail.isEmpty()) {
+                out += ",\"args\":{\"path\":\"" + escape(event.detail) + "\"}";
+            }
+            out += '}';
+
+            if (out.size() > (1 << 20)) {
+                file.write(out);
+                out.clear();
+            }
+        }
+    }
+
+    out += "\n],\"otherData\":{\"droppedEvents\":" + QByteArray::number(dropped) + "}}\n";
+    file.write(out);
+
+    if (!file.commit()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef SCANTRACER_H
+#define SCANTRACER_H
+
+#include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+
+// Records timed spans per thread and writes them as Chrome trace events
+// (chrome://tracing, ui.perfetto.dev). Every thread gets a ring buffer
+// allocated on its first span; recording is a couple of stores into it, and
+// when it wraps the oldest spans are overwritten and counted as dropped.
+class ScanTracer {
+public:
+    static const int DefaultEventsPerThread = 1 << 16;
+
+    explicit ScanTracer(int eventsPerThread = DefaultEventsPerThread);
+    ~ScanTracer();
+
+    // Nanoseconds since the tracer was created, the clock for every span
+    quint64 now() const { return quint64(m_clock.nsecsElapsed()); }
+
+    // name must be a string literal, it is kept by pointer
+    void record(const char* name, quint64 startNs, quint64 endNs, const QString& detail = QString());
+
+    quint64 eventCount() const;
+    quint64 droppedCount() const;
+
+    // Call once the traced threads are idle, e.g. after the scan finished
+    bool write(const QString& path, QString* error = nullptr) const;
+
+private:
+    struct Event {
+        const char* name;
+        quint64 start;
+        quint64 duration;
+        QString detail;
+    };
+
+    struct Buffer {
+        Qt::HANDLE thread;
+        int tid;
+        QVector<Event> events;
+        quint64 written;  // total ever recorded; the ring holds the last events.size()
+    };
+
+    Buffer* bufferForThisThread();
+
+    const quint64 m_instanceId;
+    const int m_eventsPerThread;
+    QElapsedTimer m_clock;
+    mutable QMutex m_mutex;  // guards m_buffers, taken once per thread
+    QVector<Buffer*> m_buffers;
+};
+
+// Records one span from construction to destruction; a null tracer costs nothing
+class TraceSpan {
+public:
+    TraceSpan(ScanTracer* tracer, const char* name, const QString& detail = QString())
+        : m_tracer(tracer), m_name(name), m_detail(detail), m_start(tracer ? tracer->now() : 0) {}
+    ~TraceSpan() {
+        if (m_tracer) {
+            m_tracer->record(m_name, m_start, m_tracer->now(), m_detail);
+        }
+    }
+
+private:
+    ScanTracer* m_tracer;
+    const char* m_name;
+    QString m_detail;
+    quint64 m_start;
+};
+
+#endif // SCANTRACER_H
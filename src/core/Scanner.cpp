@@ -1,86 +1,671 @@
 #include "Scanner.h"
 #include <QDir>
 #include <QFileInfo>
-#include <QDirIterator>
-#include <QProcess>
 #include <QDebug>
 #include <QThread>
 #include <QMetaObject>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSettings>
+#include <QWaitCondition>
+#include "PackageAllowlistBuilder.h"
+#include "ClamdPool.h"
+#include "RiskRank.h"
+
+// How often a running scan writes its progress to the database
+static const int CHECKPOINT_INTERVAL_MS = 5000;
+
+// How often in-flight work checks its cancellation token
+static const int CANCEL_POLL_MS = 50;
+
+// Per-file deadlines: a fixed allowance for process start-up and clamd queueing,
+// plus the time the file needs at a pessimistic share of the observed throughput
+static const qint64 DEADLINE_BASE_MS = 10000;
+static const qint64 DEADLINE_MAX_MS = 30 * 60 * 1000;
+static const double DEADLINE_THROUGHPUT_SHARE = 0.25;
+static const double INITIAL_THROUGHPUT = 5.0 * 1024;     // bytes per ms (5 MB/s)
+static const quint64 THROUGHPUT_MIN_SAMPLE = 256 * 1024; // smaller files measure overhead only
+
+// Timed-out files go back on the queue behind regular work with a larger budget
+static const int MAX_SCAN_ATTEMPTS = 2;
+static const int RETRY_BUDGET_FACTOR = 4;
+static const int RETRY_PRIORITY = -1;
+
+// Archives at least this large are expanded here and their members scanned in parallel
+static const quint64 EXPAND_MIN_SIZE = 256ULL * 1024 * 1024;
+static const int EXPAND_MAX_DEPTH = 2;
+// Members are held in memory until scanned; also the cap without a StreamMaxLength
+static const quint64 EXPAND_MAX_MEMBER = 256ULL * 1024 * 1024;
+// Expanding to more than this many times the archive's size looks like a bomb
+static const quint64 EXPAND_MAX_RATIO = 20;
+// Member data waiting on other workers; past it the expanding worker scans members itself
+static const quint64 EXPAND_MAX_IN_FLIGHT = 512ULL * 1024 * 1024;
+
+namespace {
+
+// Keeps Scanner's running-task gauge right on every return path of run()
+class RunningTask {
+public:
+    explicit RunningTask(Scanner* scanner) : m_scanner(scanner) { m_scanner->taskStarted(); }
+    ~RunningTask() { m_scanner->taskFinished(); }
+
+private:
+    Scanner* m_scanner;
+};
+
+// Members of one expanded archive, some of them on other workers
+class MemberBatch {
+public:
+    MemberBatch() : m_outstanding(0), m_bytesInFlight(0), m_infected(0), m_timedOut(0), m_failed(0) {}
+
+    // Room for one more member on another worker?
+    bool reserve(quint64 size) {
+        QMutexLocker locker(&m_mutex);
+        if (m_bytesInFlight > 0 && m_bytesInFlight + size > EXPAND_MAX_IN_FLIGHT) {
+            return false;
+        }
+        m_outstanding++;
+        m_bytesInFlight += size;
+        return true;
+    }
+
+    void count(ScanVerdict verdict) {
+        QMutexLocker locker(&m_mutex);
+        countLocked(verdict);
+    }
+
+    // Ends a reservation; Skipped just returns it
+    void finish(ScanVerdict verdict, quint64 size) {
+        QMutexLocker locker(&m_mutex);
+        countLocked(verdict);
+        m_outstanding--;
+        m_bytesInFlight -= size;
+        m_finished.wakeAll();
+    }
+
+    // A cancelled scan stops waiting: Scanner::stopScan() drops queued members unrun
+    void waitIdle(const CancellationToken* token) {
+        QMutexLocker locker(&m_mutex);
+        while (m_outstanding > 0 && !token->isCancelled()) {
+            m_finished.wait(&m_mutex, CANCEL_POLL_MS);
+        }
+    }
+
+    int infected() { QMutexLocker locker(&m_mutex); return m_infected; }
+    int timedOut() { QMutexLocker locker(&m_mutex); return m_timedOut; }
+    int failed() { QMutexLocker locker(&m_mutex); return m_failed; }
+
+private:
+    void countLocked(ScanVerdict verdict) {
+        if (verdict == ScanVerdict::Infected) {
+            m_infected++;
+        } else if (verdict == ScanVerdict::TimedOut) {
+            m_timedOut++;
+        } else if (verdict == ScanVerdict::Failed) {
+            m_failed++;
+        }
+    }
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    int m_outstanding;
+    quint64 m_bytesInFlight;
+    int m_infected;
+    int m_timedOut;
+    int m_failed;
+};
+typedef QSharedPointer<MemberBatch> MemberBatchPtr;
+
+// Sends one member to the backend from memory; Skipped if the scan was cancelled
+ScanVerdict scanMember(Scanner* scanner, const ScanContextPtr& context, const QString& path,
+                       const QByteArray& data) {
+    const CancellationTokenPtr& token = context->token;
+    ScanMetrics* metrics = scanner->metrics();
+    TraceSpan memberSpan(metrics->tracer(), "member", path);
+    
+    DispatchGate* gate = scanner->dispatchGate();
+    if (!gate->enter(token.data())) {
+        return ScanVerdict::Skipped;
+    }
+    QString signatureVersion = scanner->signatureVersion();
+    
+    int headerLength = qMin(int(data.size()), ScanPrefilter::HeaderSize);
+    FileClass fileClass = ScanPrefilter::classify(reinterpret_cast<const unsigned char*>(data.constData()),
+                                                  headerLength);
+    CancellationTokenPtr deadline(new CancellationToken(token));
+    quint64 timerId = scanner->armDeadline(quint64(data.size()), fileClass, 0, deadline);
+    
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+    StageTimer backendStage(metrics, ScanStage::Backend);
+    ScanReply reply = context->backend->scanBuffer(data, deadline.data());
+    qint64 elapsedMs = scanTimer.elapsed();
+    backendStage.stop();
+    gate->leave();
+    scanner->disarmDeadline(timerId);
+    
+    if (token->isCancelled()) {
+        return ScanVerdict::Skipped;
+    }
+    if (deadline->isCancelled()) {
+        qWarning() << "Timed out scanning archive member" << path;
+        return ScanVerdict::TimedOut;
+    }
+    scanner->recordThroughput(quint64(data.size()), elapsedMs);
+    
+    switch (reply.status) {
+    case ScanReply::Clean:
+    case ScanReply::Infected:
+        break;
+    case ScanReply::Skipped:
+    case ScanReply::Error:
+        // The archive is not clean if one of its members could not be scanned
+        qWarning() << context->backend->name() << "could not scan" << path << "-" << reply.error;
+        return ScanVerdict::Failed;
+    }
+    bool infected = reply.status == ScanReply::Infected;
+    
+    StageTimer reportStage(metrics, ScanStage::Report);
+    scanner->reportMember(path, infected ? reply.virusName : QString(), quint64(data.size()), signatureVersion);
+    return infected ? ScanVerdict::Infected : ScanVerdict::Clean;
+}
+
+class MemberTask : public QRunnable {
+public:
+    MemberTask(Scanner* scanner, const ScanContextPtr& context, const MemberBatchPtr& batch,
+               const QString& path, const QByteArray& data)
+        : m_scanner(scanner), m_context(context), m_batch(batch), m_path(path), m_data(data) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        RunningTask running(m_scanner);
+        ScanVerdict verdict = m_context->token->isCancelled()
+            ? ScanVerdict::Skipped : scanMember(m_scanner, m_context, m_path, m_data);
+        m_batch->finish(verdict, quint64(m_data.size()));
+    }
+
+private:
+    Scanner* m_scanner;
+    ScanContextPtr m_context;
+    MemberBatchPtr m_batch;
+    QString m_path;
+    QByteArray m_data;
+};
+
+}
 
 // ScanTask implementation
-ScanTask::ScanTask(const QString& filePath, Scanner* scanner)
-    : m_filePath(filePath), m_scanner(scanner) {
+ScanTask::ScanTask(quint32 file, Scanner* scanner, const ScanContextPtr& context, int attempt,
+                   const PrefetchedFile& prefetched)
+    : m_file(file), m_scanner(scanner), m_context(context), m_attempt(attempt), m_prefetched(prefetched) {
     setAutoDelete(true);
 }
 
-QString ScanTask::scanWithClamdscan(const QString& path) {
-    QProcess process;
-    process.start("clamdscan", QStringList() << "--fdpass" << "--no-summary" << path);
-    
-    if (!process.waitForFinished(60000)) { // 60 second timeout
-        return "TIMEOUT";
+ScanTask::~ScanTask() {
+    // Run or dropped by QThreadPool::clear(), either way the prefetcher may go on;
+    // retries were not queued by it
+    if (m_attempt == 0 && m_context->prefetchAhead) {
+        m_context->prefetchAhead->release();
     }
-    
-    QString output = process.readAllStandardOutput();
-    return output.trimmed();
 }
 
 void ScanTask::run() {
-    QFileInfo info(m_filePath);
-    quint64 fileSize = info.size();
+    RunningTask running(m_scanner);
+    const CancellationTokenPtr& token = m_context->token;
+    if (token->isCancelled()) {
+        return;
+    }
+    m_filePath = m_context->paths->filePath(m_file);
+    
+    QElapsedTimer timer;
+    timer.start();
+    ScanMetrics* metrics = m_scanner->metrics();
+    TraceSpan fileSpan(metrics->tracer(), "file", m_filePath);
+    
+    StageTimer statStage(metrics, ScanStage::Stat);
+    quint64 fileSize = m_prefetched.size;
+    qint64 mtime = m_prefetched.mtime;
+    if (!m_prefetched.hasStat) {
+        QFileInfo info(m_filePath);
+        fileSize = info.size();
+        mtime = m_context->allowlist ? info.lastModified().toSecsSinceEpoch() : 0;
+    }
+    statStage.stop();
+    
+    // What the prefetcher read: the header, or the whole file if it did not change size since
+    const QByteArray* header = m_prefetched.contents.isEmpty() ? nullptr : &m_prefetched.contents;
+    const QByteArray* contents = m_prefetched.complete && quint64(m_prefetched.contents.size()) == fileSize
+        ? &m_prefetched.contents : nullptr;
+    // Every read below adds to the scan's bytes read, the prefetcher's included
+    ReadCount prefetchRead;
+    prefetchRead.bytes = quint64(m_prefetched.contents.size());
+    m_scanner->recordRead(prefetchRead);
+    
+    // Don't pay a clamd round trip for files it cannot give a verdict on
+    StageTimer readStage(metrics, ScanStage::Read);
+    FileClass fileClass = FileClass::Unknown;
+    SkipReason skip = m_context->prefilter.check(m_filePath, fileSize, &fileClass, header);
+    readStage.stop();
+    if (skip != SkipReason::None) {
+        StageTimer reportStage(metrics, ScanStage::Report);
+        m_scanner->recordLatency(timer.nsecsElapsed() / 1000);
+        m_scanner->reportSkipped(m_filePath, skip);
+        return;
+    }
+    
+    // Unmodified files from the distribution's packages; the checksum is verified
+    // here, on the worker, so verification runs as parallel as the scan itself
+    if (m_context->allowlist) {
+        StageTimer verifyStage(metrics, ScanStage::Verify);
+        ReadCount verifyRead;
+        bool verified = m_context->allowlist->verify(m_filePath, fileSize, mtime, token.data(), contents,
+                                                     &verifyRead);
+        verifyStage.stop();
+        m_scanner->recordRead(verifyRead);
+        if (verified) {
+            StageTimer reportStage(metrics, ScanStage::Report);
+            m_scanner->recordLatency(timer.nsecsElapsed() / 1000);
+            m_scanner->reportSkipped(m_filePath, SkipReason::PackageVerified);
+            return;
+        }
+    }
+    
+    // Exact known-bad files are settled locally; only files of a listed size get hashed
+    const HashIndexPtr& hashIndex = m_context->hashIndex;
+    if (hashIndex && hashIndex->hasSize(fileSize)) {
+        StageTimer hashStage(metrics, ScanStage::Hash);
+        QString signature;
+        ReadCount hashRead;
+        bool hit = hashIndex->matchFile(m_filePath, fileSize, &signature, token.data(), contents, &hashRead);
+        hashStage.stop();
+        m_scanner->recordRead(hashRead);
+        m_scanner->recordHashLookup(hit);
+        if (hit) {
+            StageTimer reportStage(metrics, ScanStage::Report);
+            m_scanner->recordLatency(timer.nsecsElapsed() / 1000);
+            m_scanner->reportResult(m_filePath, ScanVerdict::Infected, signature, fileSize,
+                                    m_scanner->signatureVersion());
+            return;
+        }
+    }
+    
+    // A single backend call would keep a huge archive on one clamd thread; its
+    // members are spread over the idle workers instead
+    if (m_context->expandArchives && fileClass == FileClass::Archive
+        && fileSize >= m_context->expandMinSize && m_attempt == 0) {
+        if (scanMembers(fileSize)) {
+            m_scanner->recordLatency(timer.nsecsElapsed() / 1000);
+            return;
+        }
+    }
+    
+    // Held while clamd reloads, so each verdict comes from one known signature version;
+    // waiting here does not eat into the file's deadline
+    DispatchGate* gate = m_scanner->dispatchGate();
+    if (!gate->enter(token.data())) {
+        return;
+    }
+    QString signatureVersion = m_scanner->signatureVersion();
+    
+    // The scanner's timer wheel cancels this token when the file's budget runs out
+    CancellationTokenPtr deadline(new CancellationToken(token));
+    quint64 timerId = m_scanner->armDeadline(fileSize, fileClass, m_attempt, deadline);
+    
+    QElapsedTimer scanTimer;
+    scanTimer.start();
+    StageTimer backendStage(metrics, ScanStage::Backend);
+    ScanReply reply = contents && m_context->backend->capabilities().streaming
+        ? m_context->backend->scanBuffer(*contents, deadline.data())
+        : m_context->backend->scan(m_filePath, deadline.data());
+    qint64 elapsedMs = scanTimer.elapsed();
+    backendStage.stop();
+    gate->leave();
+    m_scanner->disarmDeadline(timerId);
+    m_scanner->recordRead(reply.read);
+    
+    if (token->isCancelled()) {
+        return;
+    }
+    
+    m_scanner->recordLatency(timer.nsecsElapsed() / 1000);
+    
+    if (deadline->isCancelled()) {
+        m_scanner->reportTimeout(m_file, m_filePath, fileSize, m_attempt, m_context);
+        return;
+    }
     
-    QString result = scanWithClamdscan(m_filePath);
+    m_scanner->recordThroughput(fileSize, elapsedMs);
     
-    bool infected = false;
+    StageTimer parseStage(metrics, ScanStage::Parse);
+    ScanVerdict verdict = ScanVerdict::Clean;
     QString virusName;
     
-    if (result.contains("FOUND")) {
-        infected = true;
-        // Parse virus name from output like: "file: Virus.Name FOUND"
-        int colonPos = result.indexOf(':');
-        if (colonPos != -1) {
-            virusName = result.mid(colonPos + 1).trimmed();
-            virusName.remove(" FOUND");
+    // No default: a status added to ScanReply has to be handled here
+    switch (reply.status) {
+    case ScanReply::Clean:
+        break;
+    case ScanReply::Infected:
+        verdict = ScanVerdict::Infected;
+        virusName = reply.virusName;
+        break;
+    case ScanReply::Skipped:
+        parseStage.stop();
+        qDebug() << m_context->backend->name() << "skipped" << m_filePath << "-" << reply.error;
+        m_scanner->reportSkipped(m_filePath, reply.skipReason);
+        return;
+    case ScanReply::Error:
+        // No verdict: counted apart, and the file is not cached as clean
+        verdict = ScanVerdict::Failed;
+        qWarning() << m_context->backend->name() << "could not scan" << m_filePath << "-" << reply.error;
+        break;
+    }
+    parseStage.stop();
+    
+    if (verdict == ScanVerdict::Failed) {
+        m_scanner->distrustFile(m_file);
+    }
+    StageTimer reportStage(metrics, ScanStage::Report);
+    m_scanner->reportResult(m_filePath, verdict, virusName, fileSize, signatureVersion);
+}
+
+bool ScanTask::scanMembers(quint64 fileSize) {
+    const CancellationTokenPtr& token = m_context->token;
+    MemberBatchPtr batch(new MemberBatch);
+    // The oldest version any member may have been scanned with
+    QString signatureVersion = m_scanner->signatureVersion();
+    
+    ArchiveExpander::Limits limits = m_context->archiveLimits;
+    limits.maxTotalSize = fileSize * EXPAND_MAX_RATIO;
+    
+    QElapsedTimer timer;
+    timer.start();
+    int members = 0;
+    auto visit = [&](const QString& member, const QByteArray& data) {
+        QString path = m_filePath + '!' + member;
+        members++;
+        if (batch->reserve(quint64(data.size()))) {
+            MemberTask* task = new MemberTask(m_scanner, m_context, batch, path, data);
+            if (m_scanner->tryStartTask(task)) {
+                return !token->isCancelled();
+            }
+            delete task;
+            batch->finish(ScanVerdict::Skipped, quint64(data.size()));
         }
+        // No idle worker or too much data in flight: this worker scans it
+        batch->count(scanMember(m_scanner, m_context, path, data));
+        return !token->isCancelled();
+    };
+    
+    QString error;
+    ArchiveExpander::Result result = ArchiveExpander::expand(m_filePath, limits, visit, token.data(), &error);
+    batch->waitIdle(token.data());
+    if (token->isCancelled()) {
+        return true;
     }
     
-    m_scanner->reportResult(m_filePath, infected, virusName, fileSize);
+    // Members already found infected settle the archive; otherwise clamd gets it whole
+    int infected = batch->infected();
+    if (result != ArchiveExpander::Result::Done && infected == 0) {
+        qDebug() << "Scanning" << m_filePath << "as a whole:" << error;
+        return false;
+    }
+    
+    qDebug() << "Expanded" << m_filePath << "-" << members << "members in" << timer.elapsed() << "ms";
+    ScanVerdict verdict = infected > 0 ? ScanVerdict::InfectedMembers
+        : batch->timedOut() > 0 ? ScanVerdict::TimedOut
+        : batch->failed() > 0 ? ScanVerdict::Failed : ScanVerdict::Clean;
+    if (verdict == ScanVerdict::TimedOut || verdict == ScanVerdict::Failed) {
+        m_scanner->distrustFile(m_file);
+    }
+    StageTimer reportStage(m_scanner->metrics(), ScanStage::Report);
+    m_scanner->reportResult(m_filePath, verdict, QString(), fileSize, signatureVersion);
+    return true;
 }
 
 // Scanner implementation
 Scanner::Scanner(Database* database, QObject* parent)
     : QObject(parent)
     , m_database(database)
+    , m_backendName(ScanBackend::defaultName())
+    , m_hashIndexEnabled(QSettings("FastAV", "FastAV").value("scanner/hashIndex", true).toBool())
+    , m_strictMode(QSettings("FastAV", "FastAV").value("scanner/strict", false).toBool())
+    , m_riskOrder(QSettings("FastAV", "FastAV").value("scanner/riskOrder", true).toBool())
+    , m_incremental(QSettings("FastAV", "FastAV").value("scanner/incremental", false).toBool())
+    , m_fullWalkEvery(QSettings("FastAV", "FastAV").value("scanner/incrementalFullWalkEvery", 7).toInt())
+    , m_ioUring(QSettings("FastAV", "FastAV").value("scanner/ioUring", true).toBool())
+    , m_snapshotPath(DirectorySnapshot::defaultPath())
+    , m_hashIndexPath(HashIndex::defaultPath())
+    , m_allowlistPath(PackageAllowlist::defaultPath())
     , m_currentScanId(-1)
     , m_threadPool(new QThreadPool(this))
+    , m_checkpointTimer(new QTimer(this))
+    , m_context(new ScanContext)
+    , m_drainTimer(new QTimer(this))
+    , m_cancelPending(false)
+    , m_deadlines(new DeadlineWheel)
+    , m_throughput(INITIAL_THROUGHPUT)
+    , m_maxThreads(QThread::idealThreadCount())
+    , m_tasksRunning(0)
+    , m_checkpointBacklog(0)
+    , m_lastCheckpointMs(0)
     , m_isScanning(false)
     , m_filesScanned(0)
     , m_threatsFound(0)
     , m_bytesScanned(0)
+    , m_bytesRead(0)
+    , m_holeBytes(0)
     , m_totalFiles(0)
+    , m_filesTimedOut(0)
+    , m_filesFailed(0)
+    , m_filesHashed(0)
+    , m_hashHits(0)
+    , m_firstDetectionMs(-1)
+    , m_prefetchThread(nullptr)
+    , m_previousDuration(0)
 {
     m_threadPool->setMaxThreadCount(QThread::idealThreadCount());
+    
+    for (std::atomic<quint64>& skipped : m_filesSkipped) {
+        skipped = 0;
+    }
+    
+    m_checkpointTimer->setInterval(CHECKPOINT_INTERVAL_MS);
+    connect(m_checkpointTimer, &QTimer::timeout, this, &Scanner::saveCheckpoint);
+    
+    m_drainTimer->setInterval(CANCEL_POLL_MS);
+    connect(m_drainTimer, &QTimer::timeout, this, &Scanner::checkDrained);
 }
 
 Scanner::~Scanner() {
+    // Whoever listened may be half destroyed by now
+    blockSignals(true);
     stopScan();
+    // Drains synchronously and writes the last checkpoint, so the scan is
+    // left cancelled and resumable with everything finished so far
+    waitForStopped();
+    delete m_deadlines;
+}
+
+quint64 Scanner::armDeadline(quint64 fileSize, FileClass fileClass, int attempt,
+                             const CancellationTokenPtr& token) {
+    double throughput = m_throughput.load(std::memory_order_relaxed) * DEADLINE_THROUGHPUT_SHARE;
+    // Archives and documents are unpacked by clamd and take longer than their size suggests
+    qint64 budgetMs = DEADLINE_BASE_MS
+        + qint64(fileSize / throughput) * ScanPrefilter::deadlineFactor(fileClass);
+    for (int i = 0; i < attempt; ++i) {
+        budgetMs *= RETRY_BUDGET_FACTOR;
+    }
+    // Clamped last, so a retried file still gets a bounded budget
+    budgetMs = qMin(budgetMs, DEADLINE_MAX_MS);
+    
+    return m_deadlines->schedule(budgetMs, token);
+}
+
+void Scanner::setMaxThreads(int threads) {
+    m_maxThreads = threads > 0 ? threads : QThread::idealThreadCount();
+    m_threadPool->setMaxThreadCount(m_maxThreads);
+}
+
+void Scanner::disarmDeadline(quint64 timerId) {
+    m_deadlines->remove(timerId);
+}
+
+void Scanner::recordThroughput(quint64 bytes, qint64 elapsedMs) {
+    if (bytes < THROUGHPUT_MIN_SAMPLE || elapsedMs <= 0) {
+        return;
+    }
+    
+    // Exponential moving average, updated lock-free from the workers
+    double sample = bytes / double(elapsedMs);
+    double current = m_throughput.load(std::memory_order_relaxed);
+    while (!m_throughput.compare_exchange_weak(current, current * 0.9 + sample * 0.1,
+                                               std::memory_order_relaxed)) {
+    }
+}
+
+void Scanner::reportTimeout(quint32 file, const QString& path, quint64 fileSize, int attempt,
+                            const ScanContextPtr& context) {
+    if (!m_isScanning.load()) {
+        return;
+    }
+    
+    if (attempt + 1 < MAX_SCAN_ATTEMPTS) {
+        qDebug() << "Scan timed out, retrying later:" << path;
+        m_threadPool->start(new ScanTask(file, this, context, attempt + 1), RETRY_PRIORITY);
+        return;
+    }
+    
+    qWarning() << "Scan timed out after" << MAX_SCAN_ATTEMPTS << "attempts:" << path;
+    distrustFile(file);
+    reportResult(path, ScanVerdict::TimedOut, QString(), fileSize);
+}
+
+void Scanner::distrustFile(quint32 file) {
+    QMutexLocker locker(&m_checkpointMutex);
+    m_distrustedFiles.append(file);
+}
+
+void Scanner::reportSkipped(const QString& path, SkipReason reason) {
+    if (!m_isScanning.load()) {
+        return;
+    }
+    
+    m_filesSkipped[int(reason)]++;
+    reportResult(path, ScanVerdict::Skipped, QString(), 0);
+}
+
+void Scanner::setSignatureVersion(const QString& version) {
+    QMutexLocker locker(&m_versionMutex);
+    m_signatureVersion = version;
+    if (m_isScanning.load() && !version.isEmpty()
+        && (m_scanSignatureVersions.isEmpty() || m_scanSignatureVersions.last() != version)) {
+        m_scanSignatureVersions.append(version);
+    }
+}
+
+void Scanner::reportMember(const QString& path, const QString& virusName, quint64 fileSize,
+                           const QString& signatureVersion) {
+    if (!m_isScanning.load()) {
+        return;
+    }
+    
+    // Counted as a threat of its own; the archive itself is counted once as a file
+    if (!virusName.isEmpty()) {
+        m_threatsFound++;
+        noteDetection();
+        {
+            QMutexLocker locker(&m_threatMutex);
+            m_threats.append(path, virusName, fileSize, signatureVersion);
+        }
+        if (m_database && m_currentScanId >= 0) {
+            m_database->addThreat(m_currentScanId, path, virusName, fileSize, signatureVersion);
+        }
+    }
+    
+    emit fileScanned(path, !virusName.isEmpty(), virusName);
+}
+
+void Scanner::setIncremental(bool enabled, const QString& snapshotPath) {
+    m_incremental = enabled;
+    m_snapshotPath = snapshotPath;
+}
+
+void Scanner::noteDetection() {
+    qint64 none = -1;
+    if (m_firstDetectionMs.compare_exchange_strong(none, m_scanClock.elapsed())) {
+        qDebug() << "First detection after" << m_firstDetectionMs.load() << "ms";
+    }
+}
+
+QString Scanner::signatureVersion() const {
+    QMutexLocker locker(&m_versionMutex);
+    return m_signatureVersion;
+}
+
+quint64 Scanner::getQueueDepth() const {
+    if (!m_isScanning.load()) {
+        return 0;
+    }
+    
+    // Everything not yet reported is either running or waiting in the pool
+    quint64 total = m_totalFiles.load();
+    quint64 pending = total - qMin(total, m_filesScanned.load());
+    quint64 running = quint64(qMax(0, m_tasksRunning.load()));
+    return pending > running ? pending - running : 0;
 }
 
-void Scanner::reportResult(const QString& path, bool infected, const QString& virusName, quint64 fileSize) {
+quint64 Scanner::getFilesSkipped() const {
+    quint64 total = 0;
+    for (const std::atomic<quint64>& skipped : m_filesSkipped) {
+        total += skipped.load();
+    }
+    return total;
+}
+
+void Scanner::reportResult(const QString& path, ScanVerdict verdict, const QString& virusName, quint64 fileSize,
+                           const QString& signatureVersion) {
     // Safety check: ignore results if not scanning anymore
     if (!m_isScanning.load()) {
         return;
     }
     
+    // A clean verdict is cached with its signature version, so the files an
+    // update has not vetted yet can be found again; a detection or a failed
+    // scan drops the entry
+    quint64 version = signatureVersion.toULongLong();
+    {
+        QMutexLocker locker(&m_checkpointMutex);
+        m_pendingCheckpoint.append(path);
+        if (verdict == ScanVerdict::Clean && version > 0) {
+            m_pendingVerdicts.append(FileVerdict{path, version});
+        } else if (verdict == ScanVerdict::Infected || verdict == ScanVerdict::InfectedMembers
+                   || verdict == ScanVerdict::Failed) {
+            m_pendingVerdicts.append(FileVerdict{path, 0});
+        }
+    }
+    m_checkpointBacklog++;
+    
     m_filesScanned++;
     m_bytesScanned += fileSize;
     
-    if (infected) {
+    if (verdict == ScanVerdict::TimedOut) {
+        m_filesTimedOut++;
+    } else if (verdict == ScanVerdict::Failed) {
+        m_filesFailed++;
+    }
+    
+    if (verdict == ScanVerdict::Infected) {
         m_threatsFound++;
+        noteDetection();
+        {
+            QMutexLocker locker(&m_threatMutex);
+            m_threats.append(path, virusName, fileSize, signatureVersion);
+        }
         
         // Save to database (thread-safe: Database has internal mutex)
         if (m_database && m_currentScanId >= 0) {
-            m_database->addThreat(m_currentScanId, path, virusName, fileSize);
+            m_database->addThreat(m_currentScanId, path, virusName, fileSize, signatureVersion);
         }
         
         emit fileScanned(path, true, virusName);
@@ -103,7 +688,7 @@ void Scanner::reportResult(const QString& path, bool infected, const QString& vi
     }
 }
 
-void Scanner::startScan(const QStringList& paths) {
+void Scanner::startScan(const QStringList& paths, const QString& label) {
     if (m_isScanning.load()) {
         emit scanError("Scan already in progress");
         return;
@@ -114,70 +699,504 @@ void Scanner::startScan(const QStringList& paths) {
         return;
     }
     
+    // A cancelled scan may still be draining, its tasks are already aborting
+    waitForStopped();
+    
     // Reset counters
     m_filesScanned = 0;
     m_threatsFound = 0;
     m_bytesScanned = 0;
-    m_scanStartTime = QDateTime::currentDateTime();
+    m_bytesRead = 0;
+    m_holeBytes = 0;
+    m_filesTimedOut = 0;
+    m_filesFailed = 0;
+    for (std::atomic<quint64>& skipped : m_filesSkipped) {
+        skipped = 0;
+    }
+    m_filesHashed = 0;
+    m_hashHits = 0;
+    m_firstDetectionMs = -1;
+    {
+        QMutexLocker locker(&m_versionMutex);
+        m_scanSignatureVersions.clear();
+    }
+    m_previousDuration = 0;
+    m_fileLatency.reset();
+    m_metrics.reset();
+    {
+        QMutexLocker locker(&m_threatMutex);
+        m_threats.clear();
+    }
+    {
+        QMutexLocker locker(&m_prefetchMutex);
+        m_prefetchStats = FilePrefetcher::Stats();
+    }
     
     // Create scan record
-    m_currentScanId = m_database->createScan(paths.join(", "));
+    m_currentScanId = m_database->createScan(paths, label);
     if (m_currentScanId < 0) {
         emit scanError("Cannot create scan record in database");
         return;
     }
     
-    // Expand paths
-    QStringList allFiles = expandPaths(paths);
-    m_totalFiles = allFiles.size();
+    walkAsync(paths, QSet<QString>());
+}
+
+void Scanner::resumeScan(int scanId) {
+    if (m_isScanning.load()) {
+        emit scanError("Scan already in progress");
+        return;
+    }
+    
+    if (!m_database) {
+        emit scanError("Database not initialized");
+        return;
+    }
+    
+    waitForStopped();
     
-    if (m_totalFiles == 0) {
-        emit scanError("No files to scan");
+    ScanHistoryEntry entry = m_database->getScan(scanId);
+    if (entry.id < 0) {
+        emit scanError("Cannot find scan to resume");
         return;
     }
     
+    int threatsFound = m_database->rollbackToCheckpoint(scanId);
+    if (threatsFound < 0) {
+        emit scanError("Cannot restore scan checkpoint");
+        return;
+    }
+    
+    m_currentScanId = scanId;
+    m_filesScanned = 0;
+    m_threatsFound = threatsFound;
+    m_bytesScanned = entry.bytesScanned;
+    m_filesTimedOut = 0;
+    m_filesFailed = 0;
+    for (std::atomic<quint64>& skipped : m_filesSkipped) {
+        skipped = 0;
+    }
+    m_filesHashed = 0;
+    m_hashHits = 0;
+    {
+        QMutexLocker locker(&m_versionMutex);
+        m_scanSignatureVersions.clear();
+    }
+    m_previousDuration = entry.scanDuration;
+    m_fileLatency.reset();
+    m_metrics.reset();
+    {
+        QMutexLocker locker(&m_prefetchMutex);
+        m_prefetchStats = FilePrefetcher::Stats();
+    }
+    {
+        // The detections before the checkpoint survived the rollback. Totals
+        // come from the checkpoint: an unfinished scan has no saved outcome.
+        ThreatReport previous = m_database->getScanDetails(scanId);
+        m_firstDetectionMs = previous.getThreatCount() > 0 ? entry.firstDetectionMs : -1;
+        m_bytesRead = entry.bytesRead;
+        m_holeBytes = entry.holeBytes;
+        QMutexLocker locker(&m_threatMutex);
+        m_threats = previous.getThreats();
+    }
+    
+    // Skip everything the checkpoint already covers
+    walkAsync(m_database->getScanTargets(scanId), m_database->getCompletedFiles(scanId));
+}
+
+void Scanner::walkAsync(const QStringList& targets, const QSet<QString>& completed) {
+    m_context = ScanContextPtr(new ScanContext);
+    m_context->backend = ScanBackendPtr(ScanBackend::create(m_backendName, m_clamdEndpoint));
     m_isScanning = true;
+    // Grows while the walk runs; beginScan() sets the final count
+    m_totalFiles = 0;
+    m_scanStartTime = QDateTime::currentDateTime();
+    m_scanClock.start();
+    
+    // Walk off the GUI thread; the pool is also what stopScan() drains
+    CancellationTokenPtr token = m_context->token;
+    ExclusionRules rules = ExclusionRules::fromSettings();
+    if (!m_context->backend) {
+        abortScan(QString("Scan backend '%1' is not available in this build").arg(m_backendName));
+        return;
+    }
+    
+    QString endpoint = m_clamdEndpoint;
+    ScanBackendPtr backend = m_context->backend;
+    bool useHashIndex = m_hashIndexEnabled;
+    bool useAllowlist = !m_strictMode && !m_allowlistPath.isEmpty();
+    QString hashIndexPath = m_hashIndexPath;
+    QString allowlistPath = m_allowlistPath;
+    bool riskOrder = m_riskOrder;
+    QString snapshotPath = m_incremental ? m_snapshotPath : QString();
+    int fullWalkEvery = m_fullWalkEvery;
+    m_walkSnapshot.reset();
+    m_threadPool->start([this, targets, completed, token, rules, endpoint, backend, useHashIndex,
+                         useAllowlist, hashIndexPath, allowlistPath, riskOrder, snapshotPath, fullWalkEvery]() {
+        // Slow set-up (compiling signatures, reaching the daemon) stays off the GUI thread
+        QString backendError;
+        if (!backend->prepare(&backendError)) {
+            QMetaObject::invokeMethod(this, [this, backendError, backend, token]() {
+                if (!token->isCancelled()) {
+                    abortScan(QString("Cannot start %1 backend: %2").arg(backend->name(), backendError));
+                }
+            }, Qt::QueuedConnection);
+            return;
+        }
+        
+        // Whatever the backend is serving now; the updater moves it on after a reload
+        QString version = backend->signatureVersion();
+        if (!version.isEmpty()) {
+            setSignatureVersion(version);
+        }
+        
+        // clamd's limits are read once per scan, next to the walk that needs them;
+        // an in-process engine applies the same clamd.conf limits but has no daemon to ask
+        ScanPrefilter prefilter = backend->capabilities().needsDaemon
+            ? ScanPrefilter::probe(ClamdPool::split(endpoint).value(0))
+            : ScanPrefilter(ClamdConfig::load());
+        
+        // Mapped once per scan; a rebuild during the scan replaces the file, not this mapping
+        HashIndexPtr hashIndex;
+        if (useHashIndex) {
+            QString indexError;
+            hashIndex = HashIndex::open(hashIndexPath, &indexError);
+            if (!hashIndex) {
+                qDebug() << "Hash index not used:" << indexError;
+            }
+        }
+        
+        // Cheap when no package changed since the last scan
+        PackageAllowlistPtr allowlist;
+        if (useAllowlist) {
+            QString allowlistError;
+            if (PackageAllowlistBuilder::rebuild(allowlistPath, &allowlistError)) {
+                allowlist = PackageAllowlist::open(allowlistPath, &allowlistError);
+            }
+            if (!allowlist) {
+                qDebug() << "Package allowlist not used:" << allowlistError;
+            }
+        }
+        
+        FileWalker walker(rules, token.data(), &m_metrics);
+        walker.setFilesFound(&m_totalFiles);
+        quint32 walksSinceFull = 0;
+        if (!snapshotPath.isEmpty()) {
+            QString snapshotError;
+            DirectorySnapshotPtr previous = DirectorySnapshot::load(snapshotPath, rules.fingerprint(), &snapshotError);
+            if (!snapshotError.isEmpty()) {
+                qDebug() << "Incremental walk lists everything:" << snapshotError;
+            }
+            // An unchanged directory hides files edited in place; every few scans
+            // everything is listed again, and the other roots start over too
+            walksSinceFull = previous->directoryCount() > 0 ? previous->walksSinceFull() + 1 : 0;
+            if (fullWalkEvery > 0 && walksSinceFull >= quint32(fullWalkEvery)) {
+                qDebug() << "Incremental walk lists everything after" << previous->walksSinceFull()
+                         << "incremental walks";
+                previous.reset();
+                walksSinceFull = 0;
+            }
+            walker.setIncremental(previous);
+        }
+        PathArenaPtr paths = walker.walk(targets);
+        if (walker.snapshot()) {
+            walker.snapshot()->setWalksSinceFull(walksSinceFull);
+        }
+        DirectorySnapshotPtr snapshot = walker.snapshot();
+        FileWalker::Stats walkStats = walker.stats();
+        QVector<quint32> remaining;
+        remaining.reserve(paths->fileCount());
+        for (int file = 0; file < paths->fileCount(); ++file) {
+            if (completed.isEmpty() || !completed.contains(paths->filePath(quint32(file)))) {
+                remaining.append(quint32(file));
+            }
+        }
+        quint64 alreadyScanned = paths->fileCount() - remaining.size();
+        qDebug() << "Walk found" << paths->fileCount() << "files in" << paths->directoryCount()
+                 << "directories, paths take" << paths->memoryUsage() / 1024 << "KiB";
+        
+        // The pool runs tasks in the order they are queued, so ranking the queue is enough
+        if (riskOrder) {
+            QElapsedTimer rankTimer;
+            rankTimer.start();
+            remaining = RiskRank::order(*paths, remaining, token.data());
+            qDebug() << "Ranked" << remaining.size() << "files by risk in" << rankTimer.elapsed() << "ms";
+        }
+        
+        QMetaObject::invokeMethod(this, [this, paths, remaining, alreadyScanned, walkStats, prefilter, hashIndex,
+                                         allowlist, snapshot, token]() {
+            if (!token->isCancelled()) {
+                beginScan(paths, remaining, alreadyScanned, walkStats, prefilter, hashIndex, allowlist, snapshot);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Scanner::beginScan(const PathArenaPtr& paths, const QVector<quint32>& files, quint64 alreadyScanned,
+                        const FileWalker::Stats& walkStats, const ScanPrefilter& prefilter,
+                        const HashIndexPtr& hashIndex, const PackageAllowlistPtr& allowlist,
+                        const DirectorySnapshotPtr& snapshot) {
+    m_walkStats = walkStats;
+    m_walkSnapshot = snapshot;
+    m_context->paths = paths;
+    m_context->prefilter = prefilter;
+    m_context->hashIndex = hashIndex;
+    m_context->allowlist = allowlist;
+    m_filesScanned = alreadyScanned;
+    m_totalFiles = files.size() + alreadyScanned;
+    m_database->setScanTotal(m_currentScanId, m_totalFiles);
+    
+    // Needs libarchive and a backend that scans buffers; strict mode sends archives whole
+    QSettings settings("FastAV", "FastAV");
+    m_context->expandArchives = ArchiveExpander::isAvailable() && !m_strictMode
+        && m_context->backend->capabilities().buffers
+        && settings.value("scanner/expandArchives", true).toBool();
+    bool sizeOk = false;
+    m_context->expandMinSize = ClamdConfig::parseSize(settings.value("scanner/expandArchivesMinSize").toString(),
+                                                      &sizeOk);
+    if (!sizeOk) {
+        m_context->expandMinSize = EXPAND_MIN_SIZE;
+    }
+    m_context->archiveLimits.maxDepth = settings.value("scanner/expandArchivesDepth", EXPAND_MAX_DEPTH).toInt();
+    // INSTREAM stops at StreamMaxLength; a larger member sends the archive whole
+    quint64 streamMaxLength = prefilter.config().streamMaxLength;
+    m_context->archiveLimits.maxMemberSize = streamMaxLength > 0 ? qMin(streamMaxLength, EXPAND_MAX_MEMBER)
+                                                                 : EXPAND_MAX_MEMBER;
+    
+    {
+        QMutexLocker locker(&m_checkpointMutex);
+        m_pendingCheckpoint.clear();
+        m_pendingVerdicts.clear();
+        m_distrustedFiles.clear();
+    }
+    m_checkpointBacklog = 0;
+    m_lastCheckpointMs = QDateTime::currentMSecsSinceEpoch();
+    
+    if (files.isEmpty()) {
+        m_isScanning = false;
+        if (alreadyScanned > 0 || walkStats.directoriesUnchanged > 0) {
+            // Everything was scanned before the interruption, or nothing changed
+            // since the last incremental scan; just close the record
+            emit scanStarted(m_totalFiles);
+            finalizeScan();
+        } else {
+            m_database->setScanStatus(m_currentScanId, "completed");
+            emit scanError("No files to scan");
+        }
+        return;
+    }
+    
+    if (walkStats.totalPruned() > 0) {
+        qDebug() << "Walk pruned" << walkStats.directoriesPruned << "directories,"
+                 << walkStats.filesPruned << "files," << walkStats.otherFilesystems
+                 << "other filesystems," << walkStats.pseudoFilesystems << "pseudo filesystems";
+    }
+    
+    if (walkStats.directoriesUnchanged > 0) {
+        qDebug() << "Incremental walk skipped" << walkStats.directoriesUnchanged << "unchanged directories with"
+                 << walkStats.filesUnchanged << "files";
+    }
+    
+    if (alreadyScanned > 0) {
+        qDebug() << "Resuming scan ID:" << m_currentScanId << "remaining:" << files.size()
+                 << "of" << m_totalFiles.load();
+    }
+    
     emit scanStarted(m_totalFiles);
+    m_deadlines->start();
+    m_checkpointTimer->start();
+    
+    QString prefetchUnavailable;
+    if (m_ioUring && FilePrefetcher::isAvailable(&prefetchUnavailable)) {
+        startPrefetch(files);
+        return;
+    }
+    if (m_ioUring) {
+        qDebug() << "Files are read by the workers:" << prefetchUnavailable;
+    }
     
     // Queue all tasks
-    for (const QString& file : allFiles) {
-        ScanTask* task = new ScanTask(file, this);
+    for (quint32 file : files) {
+        ScanTask* task = new ScanTask(file, this, m_context);
         m_threadPool->start(task);
     }
 }
 
+void Scanner::startPrefetch(const QVector<quint32>& files) {
+    // Only a streaming backend and the hash index use a file's contents; clamd
+    // and libclamav open the file themselves, so for them only the header the
+    // prefilter needs is read, unless the size is one the hash index lists
+    ScanContextPtr context = m_context;
+    ScanBackend::Capabilities capabilities = context->backend->capabilities();
+    bool streaming = capabilities.streaming && capabilities.buffers;
+    
+    // Header-only files give their slot back at once, so the slots do not hold
+    // the feeder back; it waits for the workers here instead of queueing a task
+    // and a header for every file of the scan
+    context->prefetchAhead = QSharedPointer<QSemaphore>(new QSemaphore(FilePrefetcher::QueueDepth * m_maxThreads));
+    
+    // The feeder mostly waits on the kernel; it runs on its own thread beside
+    // the workers, so the pool keeps exactly the configured size
+    waitForPrefetch();
+    m_prefetchThread = QThread::create([this, context, files, streaming]() {
+        const HashIndexPtr& hashIndex = context->hashIndex;
+        auto want = [&hashIndex, streaming](quint32, quint64 size) {
+            return streaming || (hashIndex && hashIndex->hasSize(size));
+        };
+        // Tasks start in the order the files come back, close to the (risk) order they went in
+        auto deliver = [this, &context](const PrefetchedFile& file) {
+            while (!context->prefetchAhead->tryAcquire(1, CANCEL_POLL_MS)) {
+                if (context->token->isCancelled()) {
+                    return;
+                }
+            }
+            m_threadPool->start(new ScanTask(file.file, this, context, 0, file));
+        };
+        
+        FilePrefetcher prefetcher;
+        QString error;
+        if (!prefetcher.run(*context->paths, files, context->token.data(), want, ScanPrefilter::HeaderSize,
+                            deliver, &error)) {
+            qDebug() << "io_uring prefetch stopped, files are read by the workers:" << error;
+        }
+        FilePrefetcher::Stats stats = prefetcher.stats();
+        qDebug() << "Prefetched" << stats.filesLoaded << "files whole," << stats.filesHeaded << "headers,"
+                 << stats.bytesRead / 1024 << "KiB in" << stats.submitCalls << "system calls";
+        {
+            QMutexLocker locker(&m_prefetchMutex);
+            m_prefetchStats = stats;
+        }
+    });
+    m_prefetchThread->start();
+}
+
+void Scanner::waitForPrefetch() {
+    if (!m_prefetchThread) {
+        return;
+    }
+    
+    m_prefetchThread->wait();
+    delete m_prefetchThread;
+    m_prefetchThread = nullptr;
+}
+
+FilePrefetcher::Stats Scanner::getPrefetchStats() const {
+    QMutexLocker locker(&m_prefetchMutex);
+    return m_prefetchStats;
+}
+
 void Scanner::stopScan() {
-    m_isScanning = false;
+    bool wasScanning = m_isScanning.exchange(false);
+    m_context->token->cancel();
     m_threadPool->clear();
+    m_checkpointTimer->stop();
+    
+    // Running tasks abort within CANCEL_POLL_MS; finish without blocking the caller
+    if (wasScanning) {
+        m_cancelPending = true;
+        m_drainTimer->start();
+        emit scanStopping();
+    }
+}
+
+void Scanner::waitForStopped() {
+    // The feeder may still hand tasks to the pool until it sees the token
+    waitForPrefetch();
     m_threadPool->waitForDone();
+    finishCancel();
 }
 
-QStringList Scanner::expandPaths(const QStringList& paths) {
-    QStringList files;
+void Scanner::checkDrained() {
+    if (m_threadPool->activeThreadCount() > 0
+        || (m_prefetchThread && m_prefetchThread->isRunning())) {
+        return;
+    }
     
-    for (const QString& path : paths) {
-        QFileInfo info(path);
-        
-        if (info.isFile()) {
-            files.append(info.absoluteFilePath());
-        } else if (info.isDir()) {
-            QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot, 
-                           QDirIterator::Subdirectories);
-            while (it.hasNext()) {
-                files.append(it.next());
-            }
-        }
+    finishCancel();
+}
+
+void Scanner::abortScan(const QString& error) {
+    qWarning() << error;
+    m_isScanning = false;
+    
+    // Leave the record resumable, nothing was scanned yet
+    if (m_database && m_currentScanId >= 0) {
+        m_database->setScanStatus(m_currentScanId, "cancelled");
+    }
+    emit scanError(error);
+}
+
+void Scanner::finishCancel() {
+    m_drainTimer->stop();
+    // No worker is left to arm a deadline
+    m_deadlines->stop();
+    if (!m_cancelPending) {
+        return;
     }
+    m_cancelPending = false;
     
-    return files;
+    // Keep what was done so far so the scan can be resumed later
+    if (m_database && m_currentScanId >= 0) {
+        saveCheckpoint();
+        m_database->setScanStatus(m_currentScanId, "cancelled");
+    }
+    
+    emit scanCancelled();
+}
+
+qint64 Scanner::elapsedSeconds() const {
+    return m_previousDuration + m_scanStartTime.secsTo(QDateTime::currentDateTime());
+}
+
+void Scanner::saveCheckpoint() {
+    if (!m_database || m_currentScanId < 0) {
+        return;
+    }
+    
+    QStringList completed;
+    QVector<FileVerdict> verdicts;
+    {
+        QMutexLocker locker(&m_checkpointMutex);
+        completed.swap(m_pendingCheckpoint);
+        verdicts.swap(m_pendingVerdicts);
+    }
+    
+    ScanCheckpoint totals;
+    totals.filesScanned = m_filesScanned.load();
+    totals.bytesScanned = m_bytesScanned.load();
+    totals.threatsFound = int(m_threatsFound.load());
+    totals.duration = elapsedSeconds();
+    totals.firstDetectionMs = m_firstDetectionMs.load();
+    totals.bytesRead = m_bytesRead.load();
+    totals.holeBytes = m_holeBytes.load();
+    m_database->saveCheckpoint(m_currentScanId, completed, totals);
+    m_database->saveFileVerdicts(verdicts);
+    m_checkpointBacklog -= qMin(quint64(completed.size()), m_checkpointBacklog.load());
+    m_lastCheckpointMs = QDateTime::currentMSecsSinceEpoch();
 }
 
 void Scanner::finalizeScan() {
     // Wait for all threads to finish before touching database
+    waitForPrefetch();
     m_threadPool->waitForDone();
+    m_checkpointTimer->stop();
+    m_deadlines->stop();
+    
+    QVector<FileVerdict> verdicts;
+    QVector<quint32> distrusted;
+    {
+        QMutexLocker locker(&m_checkpointMutex);
+        m_pendingCheckpoint.clear();
+        verdicts.swap(m_pendingVerdicts);
+        distrusted.swap(m_distrustedFiles);
+    }
+    m_checkpointBacklog = 0;
     
     // Now it's safe to update database from main thread
-    qint64 duration = m_scanStartTime.secsTo(QDateTime::currentDateTime());
+    if (m_database) {
+        m_database->saveFileVerdicts(verdicts);
+    }
+    qint64 duration = elapsedSeconds();
     
     if (m_database && m_currentScanId >= 0) {
         m_database->updateScan(m_currentScanId, m_filesScanned.load(), 
@@ -186,11 +1205,69 @@ void Scanner::finalizeScan() {
     
     // Create report
     ThreatReport report;
+    {
+        QMutexLocker locker(&m_threatMutex);
+        report.setThreats(m_threats);
+    }
     report.setTotalFilesScanned(m_filesScanned.load());
     report.setTotalBytesScanned(m_bytesScanned.load());
+    report.setTotalBytesRead(m_bytesRead.load());
+    report.setHoleBytes(m_holeBytes.load());
     report.setStartTime(m_scanStartTime);
     report.setEndTime(QDateTime::currentDateTime());
     report.setScanDuration(duration);
+    report.setTimeToFirstDetection(m_firstDetectionMs.load());
+    report.setFilesTimedOut(m_filesTimedOut.load());
+    report.setFilesFailed(m_filesFailed.load());
+    report.setDirectoriesPruned(m_walkStats.directoriesPruned + m_walkStats.otherFilesystems
+                                + m_walkStats.pseudoFilesystems);
+    report.setFilesPruned(m_walkStats.filesPruned);
+    
+    QMap<QString, quint64> skipReasons;
+    for (int reason = int(SkipReason::None) + 1; reason < int(SkipReason::Count); ++reason) {
+        quint64 count = m_filesSkipped[reason].load();
+        if (count > 0) {
+            skipReasons.insert(ScanPrefilter::reasonName(SkipReason(reason)), count);
+        }
+    }
+    report.setSkipReasons(skipReasons);
+    report.setStageLatencies(m_metrics.summary());
+    if (m_context->backend) {
+        report.setEndpointStats(m_context->backend->endpointStats());
+    }
+    {
+        QMutexLocker locker(&m_versionMutex);
+        report.setSignatureVersions(m_scanSignatureVersions);
+    }
+    
+    if (m_database && m_currentScanId >= 0) {
+        m_database->saveScanOutcome(m_currentScanId, report);
+    }
+    
+    // Written off the GUI thread; a scan that starts meanwhile still reads the old file
+    if (m_walkSnapshot) {
+        DirectorySnapshotPtr snapshot = m_walkSnapshot;
+        if (!distrusted.isEmpty()) {
+            // Listing such a directory again rescans the file; the snapshot's
+            // directory ids are the walk's
+            QSharedPointer<DirectorySnapshot> retried(new DirectorySnapshot(*snapshot));
+            for (quint32 file : distrusted) {
+                quint32 directory = m_context->paths->fileDirectory(file);
+                if (directory != PathArena::NoDirectory) {
+                    retried->setListed(directory, retried->fileCount(directory), false);
+                }
+            }
+            snapshot = retried;
+        }
+        QString snapshotPath = m_snapshotPath;
+        m_walkSnapshot.reset();
+        QThreadPool::globalInstance()->start([snapshot, snapshotPath]() {
+            QString error;
+            if (!snapshot->save(snapshotPath, &error)) {
+                qWarning() << "Cannot save directory snapshot:" << error;
+            }
+        });
+    }
     
     emit scanCompleted(report);
 }
@@ -7,22 +7,76 @@
 #include <QThreadPool>
 #include <QRunnable>
 #include <QMutex>
+#include <QSemaphore>
+#include <QTimer>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <atomic>
 #include "ThreatReport.h"
 #include "Database.h"
+#include "CancellationToken.h"
+#include "DeadlineWheel.h"
+#include "FileWalker.h"
+#include "ScanPrefilter.h"
+#include "LatencyHistogram.h"
+#include "ScanMetrics.h"
+#include "ScanBackend.h"
+#include "HashIndex.h"
+#include "PackageAllowlist.h"
+#include "DispatchGate.h"
+#include "ArchiveExpander.h"
+#include "PathArena.h"
+#include "FilePrefetcher.h"
 
 class Scanner;
 
+enum class ScanVerdict {
+    Clean,
+    Infected,
+    TimedOut,   // no answer within the deadline, even after a retry
+    Skipped,    // dropped by the prefilter, clamd could not give a verdict
+    Failed,     // the backend answered with an error; never cached as clean
+    InfectedMembers  // expanded archive; each infected member was reported on its own
+};
+
+// State shared by every task of one scan. Tasks keep it alive while they
+// drain, so a new scan never sees a previous scan's token or limits.
+struct ScanContext {
+    CancellationTokenPtr token;
+    ScanPrefilter prefilter;
+    ScanBackendPtr backend;  // shared by all tasks, created when the scan starts
+    HashIndexPtr hashIndex;  // null when disabled or not built yet
+    PackageAllowlistPtr allowlist;  // null in strict mode or without a package database
+    PathArenaPtr paths;      // the walk's files; tasks only hold an id into it
+    bool expandArchives;     // large archives are scanned member by member
+    quint64 expandMinSize;
+    ArchiveExpander::Limits archiveLimits;
+    // With the prefetcher: one permit per queued task it may run ahead by,
+    // given back when the task is gone
+    QSharedPointer<QSemaphore> prefetchAhead;
+
+    ScanContext() : token(new CancellationToken), expandArchives(false), expandMinSize(0) {}
+};
+typedef QSharedPointer<ScanContext> ScanContextPtr;
+
 class ScanTask : public QRunnable {
 public:
-    ScanTask(const QString& filePath, Scanner* scanner);
+    // prefetched is what the io_uring prefetcher already read of the file, if anything
+    ScanTask(quint32 file, Scanner* scanner, const ScanContextPtr& context, int attempt = 0,
+             const PrefetchedFile& prefetched = PrefetchedFile());
+    ~ScanTask() override;
     void run() override;
 
 private:
-    QString m_filePath;
+    // False if the archive could not be expanded and must be scanned whole
+    bool scanMembers(quint64 fileSize);
+    
+    quint32 m_file;
+    QString m_filePath;         // built from the arena when the task runs
     Scanner* m_scanner;
-    QString scanWithClamdscan(const QString& path);
+    ScanContextPtr m_context;
+    int m_attempt;
+    PrefetchedFile m_prefetched;
 };
 
 class Scanner : public QObject {
@@ -31,40 +85,213 @@ public:
     explicit Scanner(Database* database, QObject* parent = nullptr);
     ~Scanner();
 
-    void startScan(const QStringList& paths);
+    // label names the scan in the history instead of its paths
+    void startScan(const QStringList& paths, const QString& label = QString());
+    void resumeScan(int scanId);
     void stopScan();
+    void waitForStopped();
     bool isScanning() const { return m_isScanning.load(); }
+    // Cancelled, still draining and checkpointing; scanCancelled() ends it
+    bool isStopping() const { return m_cancelPending; }
+    void setMaxThreads(int threads);
+    // One of ScanBackend::names(); takes effect with the next scan
+    void setBackend(const QString& name) { m_backendName = name; }
+    QString backendName() const { return m_backendName; }
+    // "unix:/path" or "tcp:host:port" for the clamd backends, comma separated to
+    // balance over several daemons; empty uses clamd.conf
+    void setClamdEndpoint(const QString& endpoint) { m_clamdEndpoint = endpoint; }
+    QString clamdEndpoint() const { return m_clamdEndpoint; }
+    // Flag files found in the local hash index without asking the backend
+    void setHashIndexEnabled(bool enabled) { m_hashIndexEnabled = enabled; }
+    bool hashIndexEnabled() const { return m_hashIndexEnabled; }
+    // Strict mode sends every file to the backend, package-owned ones included
+    void setStrictMode(bool strict) { m_strictMode = strict; }
+    bool strictMode() const { return m_strictMode; }
+    // Where the hash index is read and the package allowlist kept; an empty
+    // allowlist path leaves the allowlist out, as strict mode does
+    void setHashIndexPath(const QString& path) { m_hashIndexPath = path; }
+    void setAllowlistPath(const QString& path) { m_allowlistPath = path; }
+    // Queue the riskiest files first (see RiskRank) instead of in walk order
+    void setRiskOrder(bool enabled) { m_riskOrder = enabled; }
+    bool riskOrder() const { return m_riskOrder; }
+    // List only directories changed since the last completed incremental scan
+    // (see DirectorySnapshot); the snapshot is kept in snapshotPath
+    void setIncremental(bool enabled, const QString& snapshotPath = DirectorySnapshot::defaultPath());
+    bool isIncremental() const { return m_incremental; }
+    // Every this many incremental scans the walk lists everything again, for
+    // files edited in place; 0 never does
+    void setFullWalkEvery(int scans) { m_fullWalkEvery = scans; }
+    int fullWalkEvery() const { return m_fullWalkEvery; }
+    // Stat, open and read files ahead of the workers with io_uring where the
+    // kernel has it (see FilePrefetcher)
+    void setIoUring(bool enabled) { m_ioUring = enabled; }
+    bool ioUring() const { return m_ioUring; }
+    
+    // Signature version stamped on every verdict from now on; safe from any thread
+    void setSignatureVersion(const QString& version);
+    QString signatureVersion() const;
+    // Backend calls wait here while the signatures are reloaded
+    DispatchGate* dispatchGate() { return &m_dispatchGate; }
     
     quint64 getFilesScanned() const { return m_filesScanned.load(); }
     quint64 getThreatsFound() const { return m_threatsFound.load(); }
     quint64 getBytesScanned() const { return m_bytesScanned.load(); }
+    // What the workers and clamd streams read from disk, and the sparse holes
+    // they skipped; getBytesScanned() counts logical sizes
+    quint64 getBytesRead() const { return m_bytesRead.load(); }
+    quint64 getHoleBytes() const { return m_holeBytes.load(); }
+    quint64 getFilesTimedOut() const { return m_filesTimedOut.load(); }
+    quint64 getFilesFailed() const { return m_filesFailed.load(); }
+    quint64 getFilesSkipped() const;
+    quint64 getFilesSkipped(SkipReason reason) const { return m_filesSkipped[int(reason)].load(); }
+    quint64 getTotalFiles() const { return m_totalFiles.load(); }
+    // Files whose size put them in the hash index's range, and how many matched
+    quint64 getFilesHashed() const { return m_filesHashed.load(); }
+    quint64 getHashHits() const { return m_hashHits.load(); }
+    // Milliseconds from the start of the scan, walk included, to its first detection; -1 before one
+    qint64 getTimeToFirstDetection() const { return m_firstDetectionMs.load(); }
     
-    void reportResult(const QString& path, bool infected, const QString& virusName, quint64 fileSize);
+    // Pipeline state for monitoring; plain atomic loads, safe from any thread
+    int getMaxThreads() const { return m_maxThreads.load(); }
+    int getTasksRunning() const { return m_tasksRunning.load(); }
+    quint64 getQueueDepth() const;
+    double getThroughput() const { return m_throughput.load(std::memory_order_relaxed); }
+    quint64 getCheckpointBacklog() const { return m_checkpointBacklog.load(); }
+    qint64 getLastCheckpointTime() const { return m_lastCheckpointMs.load(); }
+    FileWalker::Stats getWalkStats() const { return m_walkStats; }
+    // Zero unless the last scan was prefetched with io_uring
+    FilePrefetcher::Stats getPrefetchStats() const;
+    // Wall time of each file from task start to result, in microseconds
+    const LatencyHistogram& getFileLatency() const { return m_fileLatency; }
+    // Per-stage breakdown, merged from the worker shards on each call
+    QVector<StageLatency> getStageLatencies() const { return m_metrics.summary(); }
+    
+    // Called from ScanTask worker threads
+    void reportResult(const QString& path, ScanVerdict verdict, const QString& virusName, quint64 fileSize,
+                      const QString& signatureVersion = QString());
+    void reportTimeout(quint32 file, const QString& path, quint64 fileSize, int attempt,
+                       const ScanContextPtr& context);
+    void reportSkipped(const QString& path, SkipReason reason);
+    // A file left without a verdict (timed out, failed): the next incremental
+    // walk lists its directory again instead of trusting it
+    void distrustFile(quint32 file);
+    // One member of an expanded archive, "archive!member"; an empty virusName means clean
+    void reportMember(const QString& path, const QString& virusName, quint64 fileSize,
+                      const QString& signatureVersion);
+    // Runs task on an idle worker; false, and the task is not taken, if none is idle
+    bool tryStartTask(QRunnable* task) { return m_threadPool->tryStart(task); }
+    quint64 armDeadline(quint64 fileSize, FileClass fileClass, int attempt,
+                        const CancellationTokenPtr& token);
+    void disarmDeadline(quint64 timerId);
+    void recordThroughput(quint64 bytes, qint64 elapsedMs);
+    void recordLatency(quint64 micros) { m_fileLatency.record(micros); }
+    void recordHashLookup(bool hit) { m_filesHashed++; if (hit) m_hashHits++; }
+    void recordRead(const ReadCount& read) { m_bytesRead += read.bytes; m_holeBytes += read.holes; }
+    ScanMetrics* metrics() { return &m_metrics; }
+    // Spans for every file and stage go here while set; not owned
+    void setTracer(ScanTracer* tracer) { m_metrics.setTracer(tracer); }
+    const ScanMetrics* metrics() const { return &m_metrics; }
+    void taskStarted() { m_tasksRunning++; }
+    void taskFinished() { m_tasksRunning--; }
 
 private slots:
     void finalizeScan();
+    void saveCheckpoint();
+    void checkDrained();
 
 signals:
     void scanStarted(quint64 totalFiles);
     void fileScanned(const QString& path, bool infected, const QString& virusName);
     void scanProgress(quint64 scanned, quint64 total);
     void scanCompleted(const ThreatReport& report);
+    // stopScan() cancelled a running scan; scanCancelled() follows once it has drained
+    void scanStopping();
+    void scanCancelled();
     void scanError(const QString& error);
 
 private:
-    QStringList expandPaths(const QStringList& paths);
+    void walkAsync(const QStringList& targets, const QSet<QString>& completed);
+    // files are ids into paths, the ones left to scan
+    void beginScan(const PathArenaPtr& paths, const QVector<quint32>& files, quint64 alreadyScanned,
+                   const FileWalker::Stats& walkStats,
+                   const ScanPrefilter& prefilter, const HashIndexPtr& hashIndex,
+                   const PackageAllowlistPtr& allowlist, const DirectorySnapshotPtr& snapshot);
+    void startPrefetch(const QVector<quint32>& files);
+    void waitForPrefetch();
+    void finishCancel();
+    void abortScan(const QString& error);
+    void noteDetection();
+    qint64 elapsedSeconds() const;
     
     Database* m_database;
+    QString m_backendName;
+    QString m_clamdEndpoint;
+    bool m_hashIndexEnabled;
+    bool m_strictMode;
+    bool m_riskOrder;
+    bool m_incremental;
+    int m_fullWalkEvery;
+    bool m_ioUring;
+    QString m_snapshotPath;
+    QString m_hashIndexPath;
+    QString m_allowlistPath;
+    DirectorySnapshotPtr m_walkSnapshot;  // saved once the scan completes, so nothing unscanned is skipped
     int m_currentScanId;
     QThreadPool* m_threadPool;
     
+    // Checkpointing - completed files not yet written to the database
+    QTimer* m_checkpointTimer;
+    QMutex m_checkpointMutex;
+    QStringList m_pendingCheckpoint;
+    QVector<FileVerdict> m_pendingVerdicts;  // flushed with the checkpoint
+    QVector<quint32> m_distrustedFiles;      // under the same lock, applied to the snapshot
+    
+    // Detections for the report; shared with it, not copied, at the end
+    QMutex m_threatMutex;
+    ThreatStore m_threats;
+    
+    // Cancellation - stopScan() returns at once, m_drainTimer finishes it off
+    ScanContextPtr m_context;
+    QTimer* m_drainTimer;
+    bool m_cancelPending;
+    
+    // Signature version of new verdicts, and all versions seen by this scan
+    mutable QMutex m_versionMutex;
+    QString m_signatureVersion;
+    QStringList m_scanSignatureVersions;
+    DispatchGate m_dispatchGate;
+    
+    // Adaptive per-file deadlines
+    DeadlineWheel* m_deadlines;
+    std::atomic<double> m_throughput;  // bytes per millisecond, moving average
+    std::atomic<int> m_maxThreads;     // mirrors the pool, which locks on every query
+    std::atomic<int> m_tasksRunning;
+    std::atomic<quint64> m_checkpointBacklog;  // results not yet written by saveCheckpoint()
+    std::atomic<qint64> m_lastCheckpointMs;     // ms since epoch
+    
     std::atomic<bool> m_isScanning;
     std::atomic<quint64> m_filesScanned;
     std::atomic<quint64> m_threatsFound;
     std::atomic<quint64> m_bytesScanned;
+    std::atomic<quint64> m_bytesRead;
+    std::atomic<quint64> m_holeBytes;
     std::atomic<quint64> m_totalFiles;
+    std::atomic<quint64> m_filesTimedOut;
+    std::atomic<quint64> m_filesFailed;
+    std::atomic<quint64> m_filesSkipped[int(SkipReason::Count)];
+    std::atomic<quint64> m_filesHashed;
+    std::atomic<quint64> m_hashHits;
+    std::atomic<qint64> m_firstDetectionMs;
     
+    FileWalker::Stats m_walkStats;
+    mutable QMutex m_prefetchMutex;
+    FilePrefetcher::Stats m_prefetchStats;  // written by the feeder when it is done
+    QThread* m_prefetchThread;              // the feeder, outside the pool
+    LatencyHistogram m_fileLatency;
+    ScanMetrics m_metrics;
     QDateTime m_scanStartTime;
+    QElapsedTimer m_scanClock;  // started with the walk, for time to first detection
+    qint64 m_previousDuration;  // seconds spent before a resume
 };
 
 #endif // SCANNER_H
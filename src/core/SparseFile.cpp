@@ -0,0 +1,145 @@
+#include "SparseFile.h"
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+SparseFile::SparseFile(const QString& path)
+    : m_file(path)
+    , m_size(0)
+    , m_sparse(false)
+    , m_extentStart(0)
+    , m_extentEnd(0)
+    , m_inHole(false)
+    , m_bytesRead(0)
+    , m_holeBytes(0)
+{
+}
+
+SparseFile::~SparseFile() {
+    close();
+}
+
+bool SparseFile::open(OpenMode mode) {
+    if (mode & WriteOnly) {
+        setErrorString("SparseFile is read-only");
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_sparse = false;
+    m_extentStart = m_extentEnd = 0;
+    m_inHole = false;
+    m_bytesRead = 0;
+    m_holeBytes = 0;
+#if defined(Q_OS_UNIX) && defined(SEEK_DATA)
+    // st_blocks is in 512-byte units whatever the filesystem's block size
+    struct stat info;
+    if (::fstat(m_file.handle(), &info) == 0) {
+        m_sparse = qint64(info.st_blocks) * 512 < m_size;
+    }
+#endif
+
+    // Reads go straight to the caller's buffer, chunk for chunk
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void SparseFile::close() {
+    if (isOpen()) {
+        QIODevice::close();
+    }
+    m_file.close();
+}
+
+qint64 SparseFile::size() const {
+    return m_size;
+}
+
+ReadCount SparseFile::readCount() const {
+    ReadCount count;
+    count.bytes = m_bytesRead;
+    count.holes = m_holeBytes;
+    return count;
+}
+
+void SparseFile::locate(qint64 offset) {
+    m_extentStart = offset;
+    m_extentEnd = m_size;
+    m_inHole = false;
+#if defined(Q_OS_UNIX) && defined(SEEK_DATA)
+    int fd = m_file.handle();
+    off_t data = ::lseek(fd, offset, SEEK_DATA);
+    if (data < 0) {
+        // ENXIO: nothing but a hole up to the end. Anything else (a filesystem
+        // without the call): read the rest as data.
+        m_inHole = errno == ENXIO;
+        return;
+    }
+    if (data > offset) {
+        m_inHole = true;
+        m_extentEnd = qMin(qint64(data), m_size);
+        return;
+    }
+    off_t hole = ::lseek(fd, offset, SEEK_HOLE);
+    if (hole > offset) {
+        m_extentEnd = qMin(qint64(hole), m_size);
+    }
+#endif
+}
+
+qint64 SparseFile::readData(char* data, qint64 maxSize) {
+    qint64 offset = pos();
+    if (offset >= m_size || maxSize <= 0) {
+        return 0;
+    }
+
+    if (m_sparse && (offset < m_extentStart || offset >= m_extentEnd)) {
+        locate(offset);
+    }
+    qint64 wanted = qMin(maxSize, m_size - offset);
+    if (m_sparse) {
+        wanted = qMin(wanted, m_extentEnd - offset);
+        if (m_inHole) {
+            std::memset(data, 0, size_t(wanted));
+            m_holeBytes += quint64(wanted);
+            return wanted;
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    // pread leaves the descriptor's offset alone, so locate() may move it freely
+    qint64 length;
+    do {
+        length = ::pread(m_file.handle(), data, size_t(wanted), off_t(offset));
+    } while (length < 0 && errno == EINTR);
+    if (length < 0) {
+        setErrorString(QString::fromLocal8Bit(std::strerror(errno)));
+        return -1;
+    }
+#else
+    if (!m_file.seek(offset)) {
+        setErrorString(m_file.errorString());
+        return -1;
+    }
+    qint64 length = m_file.read(data, wanted);
+    if (length < 0) {
+        setErrorString(m_file.errorString());
+        return -1;
+    }
+#endif
+    m_bytesRead += quint64(length);
+    return length;
+}
+
+qint64 SparseFile::writeData(const char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
@@ -0,0 +1,66 @@
+#ifndef SPARSEFILE_H
+#define SPARSEFILE_H
+
+#include <QIODevice>
+#include <QFile>
+#include <QString>
+
+// What reading a file took: bytes from the disk, and bytes of holes that
+// were handed out as zeros without a read
+struct ReadCount {
+    quint64 bytes;
+    quint64 holes;
+
+    ReadCount() : bytes(0), holes(0) {}
+    ReadCount& operator+=(const ReadCount& other) {
+        bytes += other.bytes;
+        holes += other.holes;
+        return *this;
+    }
+};
+
+// A read-only file that reads only its data extents. Holes (the unallocated
+// ranges of a sparse VM image or database file) are found with SEEK_DATA and
+// SEEK_HOLE and come back as zeros made here, without a read. Readers still
+// see every logical byte: INSTREAM and the index digests are defined over the
+// whole file, zeros included.
+//
+// A file with as many blocks allocated as its size needs is read straight
+// through; so is every file where the system has no SEEK_DATA.
+class SparseFile : public QIODevice {
+public:
+    explicit SparseFile(const QString& path);
+    ~SparseFile() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override;
+    bool isSequential() const override { return false; }
+
+    // Fewer blocks allocated than the size needs; known once open
+    bool isSparse() const { return m_sparse; }
+    // Read from the file, and handed out as zeros for holes, since open()
+    quint64 bytesRead() const { return m_bytesRead; }
+    quint64 holeBytes() const { return m_holeBytes; }
+    ReadCount readCount() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    // Where the data or hole around offset ends, for the extent cache below
+    void locate(qint64 offset);
+
+    QFile m_file;
+    qint64 m_size;
+    bool m_sparse;
+    // [m_extentStart, m_extentEnd) is data or, if m_inHole, a hole
+    qint64 m_extentStart;
+    qint64 m_extentEnd;
+    bool m_inHole;
+    quint64 m_bytesRead;
+    quint64 m_holeBytes;
+};
+
+#endif // SPARSEFILE_H
@@ -1,15 +1,39 @@
 #include "ThreatReport.h"
 
+namespace {
+
+// An outbreak can have a million detections; the summary names the first ones
+const int SUMMARY_THREAT_LIMIT = 1000;
+
+}
+
 ThreatReport::ThreatReport()
     : m_totalFilesScanned(0)
     , m_totalBytesScanned(0)
+    , m_totalBytesRead(0)
+    , m_holeBytes(0)
     , m_scanDuration(0)
+    , m_filesTimedOut(0)
+    , m_filesFailed(0)
+    , m_directoriesPruned(0)
+    , m_filesPruned(0)
+    , m_firstDetectionMs(-1)
 {
     m_startTime = QDateTime::currentDateTime();
 }
 
-void ThreatReport::addThreat(const QString& path, const QString& virusName, quint64 fileSize) {
-    m_threats.append(ThreatInfo(path, virusName, fileSize));
+void ThreatReport::addThreat(const QString& path, const QString& virusName, quint64 fileSize,
+                             const QString& signatureVersion, const QDateTime& detectionTime) {
+    m_threats.append(path, virusName, fileSize, signatureVersion,
+                     detectionTime.isValid() ? detectionTime : QDateTime::currentDateTime());
+}
+
+quint64 ThreatReport::getFilesSkipped() const {
+    quint64 total = 0;
+    for (quint64 count : m_skipReasons) {
+        total += count;
+    }
+    return total;
 }
 
 QString ThreatReport::getFormattedSize(quint64 bytes) const {
@@ -33,15 +57,84 @@ QString ThreatReport::getSummary() const {
     summary += QString("Scan completed in %1 seconds\n").arg(m_scanDuration);
     summary += QString("Files scanned: %1\n").arg(m_totalFilesScanned);
     summary += QString("Data scanned: %1\n").arg(getFormattedSize(m_totalBytesScanned));
+    summary += QString("Data read by FastAV: %1\n").arg(getFormattedSize(m_totalBytesRead));
+    if (m_holeBytes > 0) {
+        summary += QString("Sparse holes not read: %1\n").arg(getFormattedSize(m_holeBytes));
+    }
     summary += QString("Threats found: %1\n").arg(m_threats.size());
+    if (m_firstDetectionMs >= 0) {
+        summary += QString("First detection after: %1 s\n").arg(m_firstDetectionMs / 1000.0, 0, 'f', 2);
+    }
+    
+    if (!m_signatureVersions.isEmpty()) {
+        summary += QString("Signature version: %1\n").arg(m_signatureVersions.join(" → "));
+    }
+    
+    if (m_directoriesPruned > 0 || m_filesPruned > 0) {
+        summary += QString("Excluded: %1 directories, %2 files\n")
+            .arg(m_directoriesPruned)
+            .arg(m_filesPruned);
+    }
+    
+    if (!m_skipReasons.isEmpty()) {
+        summary += QString("Skipped (not sent to the backend): %1\n").arg(getFilesSkipped());
+        for (auto it = m_skipReasons.constBegin(); it != m_skipReasons.constEnd(); ++it) {
+            summary += QString("  • %1: %2\n").arg(it.key()).arg(it.value());
+        }
+    }
+    
+    if (m_filesTimedOut > 0) {
+        summary += QString("Timed out (not verified): %1\n").arg(m_filesTimedOut);
+    }
+    if (m_filesFailed > 0) {
+        summary += QString("Scan errors (not verified): %1\n").arg(m_filesFailed);
+    }
+    
+    bool hasStages = false;
+    for (const StageLatency& stage : m_stageLatencies) {
+        hasStages = hasStages || stage.count > 0;
+    }
+    if (hasStages) {
+        summary += "\nStage latency (p50 / p90 / p99 / max):\n";
+        for (const StageLatency& stage : m_stageLatencies) {
+            if (stage.count == 0) {
+                continue;
+            }
+            summary += QString("  • %1: %2 / %3 / %4 / %5 ms (%6 samples)\n")
+                .arg(stage.stage, -8)
+                .arg(stage.p50 / 1000.0, 0, 'f', 2)
+                .arg(stage.p90 / 1000.0, 0, 'f', 2)
+                .arg(stage.p99 / 1000.0, 0, 'f', 2)
+                .arg(stage.max / 1000.0, 0, 'f', 2)
+                .arg(stage.count);
+        }
+    }
+    
+    if (!m_endpointStats.isEmpty()) {
+        summary += "\nclamd endpoints:\n";
+        for (const EndpointStats& endpoint : m_endpointStats) {
+            double seconds = m_scanDuration > 0 ? double(m_scanDuration) : 1.0;
+            summary += QString("  • %1: %2 files, %3, %4/s%5%6\n")
+                .arg(endpoint.endpoint)
+                .arg(endpoint.files)
+                .arg(getFormattedSize(endpoint.bytes))
+                .arg(getFormattedSize(quint64(endpoint.bytes / seconds)))
+                .arg(endpoint.failures > 0 ? QString(", %1 failed connections").arg(endpoint.failures) : QString())
+                .arg(endpoint.healthy ? QString() : QString(", down at the end"));
+        }
+    }
     
     if (!m_threats.isEmpty()) {
         summary += "\nDetected threats:\n";
-        for (const ThreatInfo& threat : m_threats) {
+        for (ThreatStore::const_iterator it = m_threats.begin(); it != m_threats.end(); ++it) {
+            if (it.index() == SUMMARY_THREAT_LIMIT) {
+                summary += QString("  … and %1 more\n").arg(m_threats.size() - SUMMARY_THREAT_LIMIT);
+                break;
+            }
             summary += QString("  • %1: %2 (%3)\n")
-                .arg(threat.virusName)
-                .arg(threat.filePath)
-                .arg(getFormattedSize(threat.fileSize));
+                .arg(it->virusName)
+                .arg(it->filePath)
+                .arg(getFormattedSize(it->fileSize));
         }
     }
     
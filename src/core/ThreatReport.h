@@ -4,53 +4,108 @@
 #include <QString>
 #include <QDateTime>
 #include <QVector>
+#include <QMap>
+#include <QStringList>
 #include <QMetaType>
+#include "ThreatStore.h"
 
-struct ThreatInfo {
-    QString filePath;
-    QString virusName;
-    quint64 fileSize;
-    QDateTime detectionTime;
+// Latency breakdown of one scan pipeline stage, in microseconds
+struct StageLatency {
+    QString stage;
+    quint64 count;
+    quint64 p50;
+    quint64 p90;
+    quint64 p99;
+    quint64 max;
+    quint64 total;
     
-    ThreatInfo() : fileSize(0) {}
-    ThreatInfo(const QString& path, const QString& virus, quint64 size)
-        : filePath(path), virusName(virus), fileSize(size)
-        , detectionTime(QDateTime::currentDateTime()) {}
+    StageLatency() : count(0), p50(0), p90(0), p99(0), max(0), total(0) {}
+};
+
+// Work one clamd endpoint did during a scan
+struct EndpointStats {
+    QString endpoint;
+    quint64 files;      // requests answered
+    quint64 bytes;
+    quint64 failures;   // failed connections, retried on another endpoint
+    quint64 busyUs;     // summed request time
+    int removals;       // times taken out of the rotation
+    bool healthy;       // in the rotation when the scan ended
+    
+    EndpointStats() : files(0), bytes(0), failures(0), busyUs(0), removals(0), healthy(true) {}
 };
 
 class ThreatReport {
 public:
     ThreatReport();
     
-    void addThreat(const QString& path, const QString& virusName, quint64 fileSize);
+    // An invalid detectionTime means now
+    void addThreat(const QString& path, const QString& virusName, quint64 fileSize,
+                   const QString& signatureVersion = QString(),
+                   const QDateTime& detectionTime = QDateTime());
     
     // Getters
-    QVector<ThreatInfo> getThreats() const { return m_threats; }
+    const ThreatStore& getThreats() const { return m_threats; }
     int getThreatCount() const { return m_threats.size(); }
     quint64 getTotalFilesScanned() const { return m_totalFilesScanned; }
     quint64 getTotalBytesScanned() const { return m_totalBytesScanned; }
+    quint64 getTotalBytesRead() const { return m_totalBytesRead; }
+    quint64 getHoleBytes() const { return m_holeBytes; }
     QDateTime getStartTime() const { return m_startTime; }
     QDateTime getEndTime() const { return m_endTime; }
     qint64 getScanDuration() const { return m_scanDuration; }
+    quint64 getFilesTimedOut() const { return m_filesTimedOut; }
+    quint64 getFilesFailed() const { return m_filesFailed; }
+    quint64 getDirectoriesPruned() const { return m_directoriesPruned; }
+    quint64 getFilesPruned() const { return m_filesPruned; }
+    QMap<QString, quint64> getSkipReasons() const { return m_skipReasons; }
+    quint64 getFilesSkipped() const;
+    QVector<StageLatency> getStageLatencies() const { return m_stageLatencies; }
+    QStringList getSignatureVersions() const { return m_signatureVersions; }
+    QVector<EndpointStats> getEndpointStats() const { return m_endpointStats; }
+    qint64 getTimeToFirstDetection() const { return m_firstDetectionMs; }
     
     // Setters
+    void setThreats(const ThreatStore& threats) { m_threats = threats; }
     void setTotalFilesScanned(quint64 total) { m_totalFilesScanned = total; }
     void setTotalBytesScanned(quint64 total) { m_totalBytesScanned = total; }
+    void setTotalBytesRead(quint64 total) { m_totalBytesRead = total; }
+    void setHoleBytes(quint64 total) { m_holeBytes = total; }
     void setStartTime(const QDateTime& time) { m_startTime = time; }
     void setEndTime(const QDateTime& time) { m_endTime = time; }
     void setScanDuration(qint64 seconds) { m_scanDuration = seconds; }
+    void setFilesTimedOut(quint64 count) { m_filesTimedOut = count; }
+    void setFilesFailed(quint64 count) { m_filesFailed = count; }
+    void setDirectoriesPruned(quint64 count) { m_directoriesPruned = count; }
+    void setFilesPruned(quint64 count) { m_filesPruned = count; }
+    void setSkipReasons(const QMap<QString, quint64>& reasons) { m_skipReasons = reasons; }
+    void setStageLatencies(const QVector<StageLatency>& stages) { m_stageLatencies = stages; }
+    void setSignatureVersions(const QStringList& versions) { m_signatureVersions = versions; }
+    void setEndpointStats(const QVector<EndpointStats>& endpoints) { m_endpointStats = endpoints; }
+    void setTimeToFirstDetection(qint64 ms) { m_firstDetectionMs = ms; }
     
     // Summary
     QString getSummary() const;
     QString getFormattedSize(quint64 bytes) const;
     
 private:
-    QVector<ThreatInfo> m_threats;
+    ThreatStore m_threats;  // shared, copying a report does not copy the detections
     quint64 m_totalFilesScanned;
-    quint64 m_totalBytesScanned;
+    quint64 m_totalBytesScanned; // logical size of every file with a verdict
+    quint64 m_totalBytesRead; // what FastAV read from disk to stream and hash them
+    quint64 m_holeBytes; // sparse holes streamed and hashed as zeros, never read
     QDateTime m_startTime;
     QDateTime m_endTime;
     qint64 m_scanDuration; // in seconds
+    quint64 m_filesTimedOut; // no verdict within the deadline
+    quint64 m_filesFailed; // the backend answered with an error instead of a verdict
+    quint64 m_directoriesPruned; // excluded subtrees, never read
+    quint64 m_filesPruned;
+    QMap<QString, quint64> m_skipReasons; // prefilter reason -> files not sent to clamd
+    QVector<StageLatency> m_stageLatencies;
+    QStringList m_signatureVersions; // every version live during the scan, in order
+    QVector<EndpointStats> m_endpointStats; // only when clamd ran on more than one endpoint
+    qint64 m_firstDetectionMs; // from the start of the walk, -1 without a detection
 };
 
 Q_DECLARE_METATYPE(ThreatReport)
@@ -0,0 +1,125 @@
+#include "ThreatStore.h"
+#include <limits>
+
+ThreatStore::ThreatStore()
+    : d(new Data)
+{
+}
+
+quint32 ThreatStore::intern(const QString& text) {
+    if (text.isEmpty()) {
+        return 0;
+    }
+    auto it = d->stringIds.constFind(text);
+    if (it != d->stringIds.constEnd()) {
+        return it.value();
+    }
+    quint32 id = quint32(d->strings.size());
+    d->strings.append(text);
+    d->stringIds.insert(text, id);
+    return id;
+}
+
+void ThreatStore::append(const QString& path, const QString& virusName, quint64 fileSize,
+                         const QString& signatureVersion, const QDateTime& detectionTime) {
+    Data* data = d.data();
+    QByteArray encoded = path.toUtf8();
+
+    // Every RestartInterval-th path is stored whole so at() never decodes far
+    quint32 shared = 0;
+    if (data->entries.size() % RestartInterval != 0) {
+        int limit = qMin(encoded.size(), data->lastPath.size());
+        while (int(shared) < limit && encoded[shared] == data->lastPath[shared]) {
+            shared++;
+        }
+    }
+
+    qint64 seconds = detectionTime.isValid() ? detectionTime.toSecsSinceEpoch() : 0;
+    if (!data->hasBase) {
+        data->baseTime = seconds;
+        data->hasBase = true;
+    }
+    qint64 offset = seconds - data->baseTime;
+
+    Entry entry;
+    entry.fileSize = fileSize;
+    entry.suffixOffset = quint64(data->arena.size());
+    entry.suffixLength = quint32(encoded.size()) - shared;
+    entry.sharedPrefix = shared;
+    entry.nameId = intern(virusName);
+    entry.versionId = intern(signatureVersion);
+    entry.detectedAt = qint32(qBound(qint64(std::numeric_limits<qint32>::min()), offset,
+                                     qint64(std::numeric_limits<qint32>::max())));
+    data->entries.append(entry);
+    data->arena.append(encoded.constData() + shared, encoded.size() - int(shared));
+    data->lastPath = encoded;
+}
+
+void ThreatStore::reserve(int count) {
+    d->entries.reserve(count);
+}
+
+void ThreatStore::clear() {
+    d = new Data;
+}
+
+void ThreatStore::decodePath(int index, QByteArray& path, int& pathIndex) const {
+    int restart = index - index % RestartInterval;
+    int from = (pathIndex >= restart && pathIndex <= index) ? pathIndex + 1 : restart;
+    for (int i = from; i <= index; ++i) {
+        const Entry& entry = d->entries[i];
+        path.truncate(int(entry.sharedPrefix));
+        path.append(d->arena.constData() + qsizetype(entry.suffixOffset), qsizetype(entry.suffixLength));
+    }
+    pathIndex = index;
+}
+
+ThreatInfo ThreatStore::decode(int index, const QByteArray& path) const {
+    const Entry& entry = d->entries[index];
+    ThreatInfo threat;
+    threat.filePath = QString::fromUtf8(path);
+    threat.virusName = d->strings[entry.nameId];
+    threat.fileSize = entry.fileSize;
+    threat.detectionTime = QDateTime::fromSecsSinceEpoch(d->baseTime + entry.detectedAt);
+    threat.signatureVersion = d->strings[entry.versionId];
+    return threat;
+}
+
+ThreatInfo ThreatStore::at(int index) const {
+    QByteArray path;
+    int pathIndex = -1;
+    decodePath(index, path, pathIndex);
+    return decode(index, path);
+}
+
+QString ThreatStore::filePath(int index) const {
+    QByteArray path;
+    int pathIndex = -1;
+    decodePath(index, path, pathIndex);
+    return QString::fromUtf8(path);
+}
+
+QDateTime ThreatStore::detectionTime(int index) const {
+    return QDateTime::fromSecsSinceEpoch(d->baseTime + d->entries[index].detectedAt);
+}
+
+quint64 ThreatStore::memoryUsage() const {
+    quint64 bytes = quint64(d->entries.capacity()) * sizeof(Entry)
+        + quint64(d->arena.capacity())
+        + quint64(d->lastPath.capacity());
+    for (const QString& text : d->strings) {
+        bytes += sizeof(QString) + quint64(text.capacity()) * sizeof(QChar);
+    }
+    // A QHash node holds the key and value, plus roughly a span slot per entry
+    bytes += quint64(d->stringIds.capacity()) * (sizeof(QString) + sizeof(quint32) + 2);
+    return bytes;
+}
+
+const ThreatInfo& ThreatStore::const_iterator::operator*() const {
+    if (!m_decoded) {
+        m_store->decodePath(m_index, m_path, m_pathIndex);
+        m_current = m_store->decode(m_index, m_path);
+        m_decoded = true;
+    }
+    return m_current;
+}
@@ -0,0 +1,128 @@
+#ifndef THREATSTORE_H
+#define THREATSTORE_H
+
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <iterator>
+
+struct ThreatInfo {
+    QString filePath;
+    QString virusName;
+    quint64 fileSize;
+    QDateTime detectionTime;
+    QString signatureVersion;   // signatures that produced the verdict, empty if unknown
+
+    ThreatInfo() : fileSize(0) {}
+    ThreatInfo(const QString& path, const QString& virus, quint64 size,
+               const QString& version = QString())
+        : filePath(path), virusName(virus), fileSize(size)
+        , detectionTime(QDateTime::currentDateTime()), signatureVersion(version) {}
+};
+
+// The detections of a scan, packed for outbreaks with hundreds of thousands
+// of them. Virus names and signature versions are interned, paths are front
+// coded against the previous path in a UTF-8 arena (with a full path every
+// RestartInterval entries for random access), and detection times are
+// seconds from the first one. A detection costs one 40 byte entry plus the
+// part of its path that differs from the one before.
+//
+// Implicitly shared: copying a store, or a ThreatReport, is a reference count
+// and only the next append copies the data. Iterate instead of calling at()
+// in a loop; the iterator decodes each path from the previous one.
+class ThreatStore {
+public:
+    static const int RestartInterval = 16;
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef ThreatInfo value_type;
+        typedef qptrdiff difference_type;
+        typedef const ThreatInfo* pointer;
+        typedef const ThreatInfo& reference;
+
+        const ThreatInfo& operator*() const;
+        const ThreatInfo* operator->() const { return &operator*(); }
+        const_iterator& operator++() { ++m_index; m_decoded = false; return *this; }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+        int index() const { return m_index; }
+
+    private:
+        friend class ThreatStore;
+        const_iterator(const ThreatStore* store, int index)
+            : m_store(store), m_index(index), m_pathIndex(-1), m_decoded(false) {}
+
+        const ThreatStore* m_store;
+        int m_index;
+        mutable QByteArray m_path;   // UTF-8 path of entry m_pathIndex
+        mutable int m_pathIndex;
+        mutable ThreatInfo m_current;
+        mutable bool m_decoded;
+    };
+
+    ThreatStore();
+
+    void append(const QString& path, const QString& virusName, quint64 fileSize,
+                const QString& signatureVersion = QString(),
+                const QDateTime& detectionTime = QDateTime::currentDateTime());
+    void reserve(int count);
+    void clear();
+
+    int size() const { return int(d->entries.size()); }
+    bool isEmpty() const { return d->entries.isEmpty(); }
+
+    // Random access decodes up to RestartInterval paths
+    ThreatInfo at(int index) const;
+    ThreatInfo operator[](int index) const { return at(index); }
+    QString filePath(int index) const;
+    QString virusName(int index) const { return d->strings[d->entries[index].nameId]; }
+    QString signatureVersion(int index) const { return d->strings[d->entries[index].versionId]; }
+    quint64 fileSize(int index) const { return d->entries[index].fileSize; }
+    QDateTime detectionTime(int index) const;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    // Distinct virus names and signature versions, for grouping without decoding paths
+    int internedCount() const { return int(d->strings.size()); }
+    // Heap bytes held, including spare capacity
+    quint64 memoryUsage() const;
+
+private:
+    struct Entry {
+        quint64 fileSize;
+        quint64 suffixOffset;   // into the path arena, which may pass 4 GiB
+        quint32 suffixLength;
+        quint32 sharedPrefix;   // bytes taken from the previous path
+        quint32 nameId;         // into the string table
+        quint32 versionId;
+        qint32 detectedAt;      // seconds after baseTime
+    };
+
+    struct Data : public QSharedData {
+        QVector<Entry> entries;
+        QByteArray arena;
+        QVector<QString> strings;       // 0 is the empty string
+        QHash<QString, quint32> stringIds;
+        QByteArray lastPath;            // UTF-8 of the last appended path
+        qint64 baseTime;                // seconds since epoch, from the first detection
+        bool hasBase;
+
+        Data() : baseTime(0), hasBase(false) { strings.append(QString()); }
+    };
+
+    quint32 intern(const QString& text);
+    // Brings path (holding entry pathIndex, or anything if pathIndex is -1) to entry index
+    void decodePath(int index, QByteArray& path, int& pathIndex) const;
+    ThreatInfo decode(int index, const QByteArray& path) const;
+
+    QSharedDataPointer<Data> d;
+};
+
+#endif // THREATSTORE_H
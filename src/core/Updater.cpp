@@ -1,15 +1,34 @@
 #include "Updater.h"
+#include "ClamdClient.h"
+#include "ClamdConfig.h"
+#include "DispatchGate.h"
+#include "ClamdPool.h"
+#include <QtConcurrent>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMap>
 #include <QSettings>
 #include <QDebug>
 #include <QFile>
 #include <QTextStream>
 #include <QDateTime>
 
+// In-flight requests get this long to finish before RELOAD is sent anyway;
+// every scan worker waits at the gate meanwhile
+static const int DRAIN_TIMEOUT_MS = 2000;
+// How long clamd may take to load the new signatures, and how often to ask
+static const int RELOAD_TIMEOUT_MS = 120000;
+static const int RELOAD_POLL_MS = 250;
+
 Updater::Updater(QObject* parent)
     : QObject(parent)
     , m_process(nullptr)
     , m_isUpdating(false)
+    , m_dispatchGate(nullptr)
+    , m_reloadWatcher(new QFutureWatcher<ReloadResult>(this))
 {
+    connect(m_reloadWatcher, &QFutureWatcher<ReloadResult>::finished, this, &Updater::onReloadFinished);
+    
     // Try to read from freshclam.log
     QFile logFile("/var/log/clamav/freshclam.log");
     if (logFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -51,6 +70,15 @@ Updater::~Updater() {
         m_process->kill();
         m_process->deleteLater();
     }
+    
+    // The reload thread uses the gate; stop it before the scanner goes away
+    if (m_reloadToken) {
+        m_reloadToken->cancel();
+        m_reloadWatcher->waitForFinished();
+        if (m_dispatchGate) {
+            m_dispatchGate->release();
+        }
+    }
 }
 
 QDateTime Updater::getLastUpdateTime() const {
@@ -174,7 +202,8 @@ void Updater::onProcessFinished(int exitCode, QProcess::ExitStatus status) {
         QSettings settings("FastAV", "FastAV");
         settings.setValue("lastUpdateTime", m_lastUpdateTime);
         
-        emit updateCompleted(true);
+        // The update only counts once clamd serves the new signatures
+        reloadSignatures();
     } else {
         emit updateCompleted(false);
         emit updateError("Update failed with exit code: " + QString::number(exitCode));
@@ -185,3 +214,125 @@ void Updater::onProcessFinished(int exitCode, QProcess::ExitStatus status) {
         m_process = nullptr;
     }
 }
+
+void Updater::reloadSignatures() {
+    m_isUpdating = true;
+    emit updateProgress("Reloading clamd signatures...");
+    
+    QStringList endpoints = ClamdPool::split(m_clamdEndpoint.isEmpty() ? ClamdConfig::load().endpoint()
+                                                                       : m_clamdEndpoint);
+    DispatchGate* gate = m_dispatchGate;
+    CancellationTokenPtr token(new CancellationToken);
+    m_reloadToken = token;
+    m_reloadWatcher->setFuture(QtConcurrent::run([endpoints, gate, token]() {
+        return runReload(endpoints, gate, token);
+    }));
+}
+
+Updater::ReloadResult Updater::runReload(const QStringList& endpoints, DispatchGate* gate,
+                                         const CancellationTokenPtr& token) {
+    ReloadResult result;
+    QString expected = ClamdConfig::load().installedSignatureVersion();
+    QStringList errors;
+    
+    // Every daemon of a pool is reloaded; those already on the new version are left alone
+    QStringList stale;
+    QMap<QString, QString> before;
+    for (const QString& endpoint : endpoints) {
+        QString version = ClamdClient::signatureVersion(ClamdClient(endpoint).version());
+        if (version.isEmpty()) {
+            errors.append("clamd at " + endpoint + " is not reachable, not reloaded");
+        } else if (expected.isEmpty() || version != expected) {
+            stale.append(endpoint);
+            before.insert(endpoint, version);
+        } else if (result.version.isEmpty()) {
+            // freshclam's NotifyClamd or clamd's SelfCheck got there first
+            result.version = version;
+        }
+    }
+    if (stale.isEmpty()) {
+        // Nothing to reload, or no daemon (e.g. the in-process engine): the files on disk are what counts
+        if (result.version.isEmpty()) {
+            result.version = expected;
+        }
+        result.error = errors.join("; ");
+        return result;
+    }
+    
+    // Let requests already at clamd finish on the old signatures, start no new
+    // ones until RELOAD is acknowledged
+    QElapsedTimer heldTimer;
+    heldTimer.start();
+    if (gate) {
+        gate->hold();
+        if (!gate->waitIdle(DRAIN_TIMEOUT_MS)) {
+            qWarning() << gate->inFlight() << "scan request(s) still running, reloading clamd anyway";
+        }
+    }
+    
+    QStringList reloading;
+    for (const QString& endpoint : stale) {
+        ClamdClient client(endpoint);
+        QByteArray reply = client.command("RELOAD", 5000);
+        if (reply == "RELOADING") {
+            reloading.append(endpoint);
+        } else {
+            errors.append("clamd at " + endpoint + " did not accept RELOAD: "
+                          + (reply.isEmpty() ? client.errorString() : QString::fromUtf8(reply)));
+        }
+    }
+    
+    // clamd loads the new signatures on its own; scans go on meanwhile. Their
+    // verdicts keep the old version's stamp until the new one is confirmed
+    // below, so at worst a file is rescanned after the update, never skipped.
+    if (gate) {
+        gate->release();
+        qDebug() << "Scan requests held for" << heldTimer.elapsed() << "ms during RELOAD";
+    }
+    
+    // Older clamd stops answering while it loads; new ones answer with the old version
+    QElapsedTimer timer;
+    timer.start();
+    while (!reloading.isEmpty() && timer.elapsed() < RELOAD_TIMEOUT_MS && !token->isCancelled()) {
+        QThread::msleep(RELOAD_POLL_MS);
+        for (int i = reloading.size() - 1; i >= 0; --i) {
+            const QString& endpoint = reloading[i];
+            QString current = ClamdClient::signatureVersion(ClamdClient(endpoint).version());
+            if (!current.isEmpty() && (expected.isEmpty() ? current != before.value(endpoint) : current == expected)) {
+                if (result.version.isEmpty()) {
+                    result.version = current;
+                }
+                reloading.removeAt(i);
+            }
+        }
+    }
+    
+    for (const QString& endpoint : reloading) {
+        QString current = ClamdClient::signatureVersion(ClamdClient(endpoint).version());
+        errors.append(QString("clamd at %1 still serves signature version %2 after %3 s")
+            .arg(endpoint, current.isEmpty() ? before.value(endpoint) : current).arg(RELOAD_TIMEOUT_MS / 1000));
+    }
+    if (result.version.isEmpty()) {
+        result.version = before.value(stale.first());
+    }
+    result.error = errors.join("; ");
+    return result;
+}
+
+void Updater::onReloadFinished() {
+    ReloadResult result = m_reloadWatcher->result();
+    m_reloadToken.reset();
+    m_isUpdating = false;
+    
+    if (!result.error.isEmpty()) {
+        qWarning() << "Signature reload:" << result.error;
+        emit updateProgress(result.error);
+    }
+    
+    // Stamped only once clamd serves it; verdicts before keep the old stamp
+    if (!result.version.isEmpty()) {
+        qDebug() << "Signature version" << result.version << "is live";
+        emit signatureVersionChanged(result.version);
+    }
+    emit updateCompleted(true);
+}
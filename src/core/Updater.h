@@ -5,6 +5,10 @@
 #include <QProcess>
 #include <QDateTime>
 #include <QTimer>
+#include <QFutureWatcher>
+#include "CancellationToken.h"
+
+class DispatchGate;
 
 class Updater : public QObject {
     Q_OBJECT
@@ -17,21 +21,42 @@ public:
     QDateTime getLastUpdateTime() const;
     bool isUpdating() const { return m_isUpdating; }
     
+    // clamd to reload after an update, a comma separated list for several; empty uses clamd.conf
+    void setClamdEndpoint(const QString& endpoint) { m_clamdEndpoint = endpoint; }
+    // Held while RELOAD is sent, so no scan request races it; not owned
+    void setDispatchGate(DispatchGate* gate) { m_dispatchGate = gate; }
+    
 signals:
     void updateStarted();
     void updateProgress(const QString& message);
     void updateCompleted(bool success);
     void updateAvailable(const QString& version);
     void updateError(const QString& error);
+    // The daily signature version clamd serves after an update, e.g. "27101"
+    void signatureVersionChanged(const QString& version);
     
 private slots:
     void onProcessOutput();
     void onProcessFinished(int exitCode, QProcess::ExitStatus status);
+    void onReloadFinished();
     
 private:
+    struct ReloadResult {
+        QString version;    // live after the reload, or on disk if clamd is not running
+        QString error;
+    };
+    
+    void reloadSignatures();
+    static ReloadResult runReload(const QStringList& endpoints, DispatchGate* gate,
+                                  const CancellationTokenPtr& token);
+    
     QProcess* m_process;
     bool m_isUpdating;
     QDateTime m_lastUpdateTime;
+    QString m_clamdEndpoint;
+    DispatchGate* m_dispatchGate;
+    CancellationTokenPtr m_reloadToken;
+    QFutureWatcher<ReloadResult>* m_reloadWatcher;
 };
 
 #endif // UPDATER_H
@@ -1,5 +1,6 @@
 #include "HistoryViewer.h"
 #include "ThreatViewer.h"
+#include "ScanExportAction.h"
 #include "../utils/MaterialTheme.h"
 #include "../utils/FileScanner.h"
 #include <QVBoxLayout>
@@ -21,6 +22,11 @@ HistoryViewer::HistoryViewer(Database* database, QWidget* parent)
     // Connect double-click signal
     connect(m_historyTable, &QTableWidget::cellDoubleClicked,
             this, &HistoryViewer::onRowDoubleClicked);
+    
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(2000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &HistoryViewer::refreshRunning);
+    m_refreshTimer->start();
 }
 
 void HistoryViewer::setupUI() {
@@ -39,9 +45,9 @@ void HistoryViewer::setupUI() {
     
     // History table
     m_historyTable = new QTableWidget(this);
-    m_historyTable->setColumnCount(6);
+    m_historyTable->setColumnCount(7);
     m_historyTable->setHorizontalHeaderLabels({
-        "Date", "Scan Path", "Files", "Data Scanned", "Threats", "Duration"
+        "Date", "Scan Path", "Files", "Data Scanned", "Threats", "Duration", "Status"
     });
     
     m_historyTable->setStyleSheet(QString(R"(
@@ -96,6 +102,13 @@ void HistoryViewer::setupUI() {
     connect(deleteButton, &QPushButton::clicked, this, &HistoryViewer::onDeleteClicked);
     buttonLayout->addWidget(deleteButton);
     
+    m_exportButton = new QPushButton("Export Selected", this);
+    m_exportButton->setStyleSheet(MaterialTheme::getButtonStyle());
+    m_exportButton->setCursor(Qt::PointingHandCursor);
+    m_exportButton->setMinimumWidth(150);
+    connect(m_exportButton, &QPushButton::clicked, this, &HistoryViewer::onExportClicked);
+    buttonLayout->addWidget(m_exportButton);
+    
     m_closeButton = new QPushButton("Close", this);
     m_closeButton->setStyleSheet(MaterialTheme::getButtonStyle());
     m_closeButton->setCursor(Qt::PointingHandCursor);
@@ -122,37 +135,67 @@ void HistoryViewer::loadHistory() {
         // Scan path
         m_historyTable->setItem(i, 1, new QTableWidgetItem(entry.scanPath));
         
-        // Files scanned
-        m_historyTable->setItem(i, 2, new QTableWidgetItem(
-            QString::number(entry.filesScanned)
-        ));
-        
-        // Data scanned
-        m_historyTable->setItem(i, 3, new QTableWidgetItem(
-            FileScanner::formatFileSize(entry.bytesScanned)
-        ));
-        
-        // Threats found
-        QTableWidgetItem* threatsItem = new QTableWidgetItem(
-            QString::number(entry.threatsFound)
-        );
-        if (entry.threatsFound > 0) {
-            threatsItem->setForeground(QBrush(MaterialTheme::Error));
-            QFont boldFont;
-            boldFont.setBold(true);
-            threatsItem->setFont(boldFont);
-        }
-        m_historyTable->setItem(i, 4, threatsItem);
-        
-        // Duration
-        m_historyTable->setItem(i, 5, new QTableWidgetItem(
-            FileScanner::formatDuration(entry.scanDuration)
-        ));
+        fillProgress(i, entry);
     }
     
     m_historyTable->resizeColumnsToContents();
 }
 
+void HistoryViewer::fillProgress(int row, const ScanHistoryEntry& entry) {
+    // Files scanned, out of the total while the scan is unfinished
+    QString status = entry.status.isEmpty() ? QString("completed") : entry.status;
+    QString files = QString::number(entry.filesScanned);
+    if (status != "completed" && entry.filesTotal > 0) {
+        files += QString(" / %1").arg(entry.filesTotal);
+    }
+    m_historyTable->setItem(row, 2, new QTableWidgetItem(files));
+    
+    // Data scanned
+    m_historyTable->setItem(row, 3, new QTableWidgetItem(
+        FileScanner::formatFileSize(entry.bytesScanned)
+    ));
+    
+    // Threats found
+    QTableWidgetItem* threatsItem = new QTableWidgetItem(
+        QString::number(entry.threatsFound)
+    );
+    if (entry.threatsFound > 0) {
+        threatsItem->setForeground(QBrush(MaterialTheme::Error));
+        QFont boldFont;
+        boldFont.setBold(true);
+        threatsItem->setFont(boldFont);
+    }
+    m_historyTable->setItem(row, 4, threatsItem);
+    
+    // Duration
+    m_historyTable->setItem(row, 5, new QTableWidgetItem(
+        FileScanner::formatDuration(entry.scanDuration)
+    ));
+    
+    // Status - interrupted and cancelled scans can be resumed
+    QTableWidgetItem* statusItem = new QTableWidgetItem(status.left(1).toUpper() + status.mid(1));
+    if (status == "interrupted" || status == "cancelled") {
+        statusItem->setForeground(QBrush(MaterialTheme::Warning));
+        statusItem->setToolTip("Use \"Resume Scan\" on the main window to continue this scan");
+    }
+    m_historyTable->setItem(row, 6, statusItem);
+}
+
+void HistoryViewer::refreshRunning() {
+    // Rows are updated in place so the selection survives
+    for (int i = 0; i < m_historyData.size(); ++i) {
+        if (m_historyData[i].status != "running") {
+            continue;
+        }
+        
+        ScanHistoryEntry entry = m_database->getScan(m_historyData[i].id);
+        if (entry.id >= 0) {
+            m_historyData[i] = entry;
+            fillProgress(i, entry);
+        }
+    }
+}
+
 void HistoryViewer::onRowDoubleClicked(int row, int column) {
     Q_UNUSED(column);
     
@@ -169,6 +212,7 @@ void HistoryViewer::onRowDoubleClicked(int row, int column) {
     if (entry.threatsFound > 0) {
         // Show threat viewer for scans with threats
         ThreatViewer* viewer = new ThreatViewer(report, this);
+        viewer->setExportSource(m_database->path(), entry.id);
         viewer->setWindowTitle(QString("Scan Report - %1").arg(entry.scanDate.toString("yyyy-MM-dd hh:mm")));
         viewer->exec();
         viewer->deleteLater();
@@ -192,11 +236,23 @@ void HistoryViewer::onRowDoubleClicked(int row, int column) {
                 .arg(FileScanner::formatFileSize(entry.bytesScanned))
                 .arg(FileScanner::formatDuration(entry.scanDuration))
         );
+        // Skip reasons and the stage latency breakdown, for the curious
+        msgBox.setDetailedText(report.getSummary());
         msgBox.setStandardButtons(QMessageBox::Ok);
         msgBox.exec();
     }
 }
 
+void HistoryViewer::onExportClicked() {
+    int row = m_historyTable->currentRow();
+    if (row < 0 || row >= m_historyData.size()) {
+        QMessageBox::information(this, "No Selection", "Please select a scan to export.");
+        return;
+    }
+    
+    ScanExportAction::run(m_exportButton, m_database->path(), m_historyData[row].id);
+}
+
 void HistoryViewer::onDeleteClicked() {
     QList<QTableWidgetItem*> selectedItems = m_historyTable->selectedItems();
     if (selectedItems.isEmpty()) {
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QTableWidget>
 #include <QPushButton>
+#include <QTimer>
 #include "../core/Database.h"
 
 class HistoryViewer : public QDialog {
@@ -15,14 +16,19 @@ public:
 private slots:
     void onRowDoubleClicked(int row, int column);
     void onDeleteClicked();
+    void onExportClicked();
+    void refreshRunning();
     
 private:
     void setupUI();
     void loadHistory();
+    void fillProgress(int row, const ScanHistoryEntry& entry);
     
     Database* m_database;
     QTableWidget* m_historyTable;
+    QPushButton* m_exportButton;
     QPushButton* m_closeButton;
+    QTimer* m_refreshTimer;  // follows scans still running, e.g. a background rescan
     QVector<ScanHistoryEntry> m_historyData; // Store full history data
 };
 
@@ -8,12 +8,24 @@
 #include <QFrame>
 #include <QGridLayout>
 #include <QStatusBar>
+#include <QThreadPool>
+#include <QSettings>
+#include <QPointer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QDebug>
+#include "../core/ClamEngine.h"
+#include "../core/ClamdConfig.h"
+#include "../core/HashIndex.h"
+#include "../core/HashIndexBuilder.h"
+#include "../core/RiskRank.h"
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , m_database(new Database(this))
     , m_scanner(nullptr)
     , m_updater(new Updater(this))
+    , m_rescanRunning(false)
 {
     setWindowTitle("FastAV - Modern Antivirus Scanner");
     setMinimumSize(900, 700);
@@ -31,14 +43,68 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_updater, &Updater::updateCompleted, this, &MainWindow::onUpdateCompleted);
     connect(m_updater, &Updater::updateProgress, this, &MainWindow::onUpdateProgress);
     
+    // Scans pause at the gate while clamd reloads, then continue under the new version;
+    // the in-process engine reports its own version once it has reloaded
+    m_updater->setDispatchGate(m_scanner->dispatchGate());
+    connect(m_updater, &Updater::signatureVersionChanged, this, [this](const QString& version) {
+        if (m_scanner->backendName() != "libclamav") {
+            m_scanner->setSignatureVersion(version);
+        }
+    });
+    
+    // The rescan after an update has no dialog; it reports in the status bar
+    connect(m_scanner, &Scanner::scanProgress, this, [this](quint64 scanned, quint64 total) {
+        if (m_rescanRunning) {
+            statusBar()->showMessage(QString("Rescanning files checked with older signatures: %1 / %2")
+                                     .arg(scanned).arg(total));
+        }
+    });
+    connect(m_scanner, &Scanner::scanCompleted, this, [this](const ThreatReport& report) {
+        if (!m_rescanRunning) {
+            return;
+        }
+        m_rescanRunning = false;
+        statusBar()->showMessage(QString("Rescan after update finished: %1 files, %2 threats")
+                                 .arg(report.getTotalFilesScanned()).arg(report.getThreats().size()), 10000);
+        updateStats();
+        if (!report.getThreats().isEmpty()) {
+            QMessageBox::warning(this, "Threats Found",
+                QString("The rescan after the signature update found %1 threat(s) in files "
+                        "that were clean before.\n\nOpen the scan history for the details.")
+                    .arg(report.getThreats().size()));
+        }
+    });
+    // A cancelled scan drains and checkpoints before the next one may start
+    connect(m_scanner, &Scanner::scanStopping, this, [this]() {
+        m_newScanButton->setEnabled(false);
+        m_resumeButton->setEnabled(false);
+        statusBar()->showMessage("Stopping the scan...");
+    });
+    connect(m_scanner, &Scanner::scanCancelled, this, [this]() {
+        m_newScanButton->setEnabled(true);
+        m_resumeButton->setEnabled(true);
+        statusBar()->clearMessage();
+        updateStats();
+    });
+    connect(m_scanner, &Scanner::scanError, this, [this](const QString& error) {
+        if (m_rescanRunning) {
+            m_rescanRunning = false;
+            statusBar()->showMessage("Rescan after update failed: " + error, 10000);
+        }
+    });
+    
     setupUI();
     updateStats();
+    
+    // Picks up signatures freshclam fetched while FastAV was not running
+    rebuildHashIndex();
 }
 
 MainWindow::~MainWindow() {
     // CRITICAL: Stop scanner threads before database is destroyed
     if (m_scanner) {
         m_scanner->stopScan();
+        m_scanner->waitForStopped();
     }
 }
 
@@ -98,6 +164,16 @@ void MainWindow::createWelcomeScreen() {
     connect(m_newScanButton, &QPushButton::clicked, this, &MainWindow::onNewScanClicked);
     buttonLayout->addWidget(m_newScanButton);
     
+    // Only shown while an interrupted scan is waiting to be resumed
+    m_resumeButton = new QPushButton("Resume Scan", this);
+    m_resumeButton->setStyleSheet(MaterialTheme::getButtonStyle());
+    m_resumeButton->setMinimumSize(180, 60);
+    m_resumeButton->setCursor(Qt::PointingHandCursor);
+    m_resumeButton->setFont(buttonFont);
+    m_resumeButton->setVisible(false);
+    connect(m_resumeButton, &QPushButton::clicked, this, &MainWindow::onResumeScanClicked);
+    buttonLayout->addWidget(m_resumeButton);
+    
     buttonLayout->addStretch();
     m_mainLayout->addLayout(buttonLayout);
     
@@ -224,6 +300,8 @@ void MainWindow::updateStats() {
         m_lastScanLabel->setText("No previous scans");
     }
     
+    m_resumeButton->setVisible(!m_database->getResumableScans().isEmpty());
+    
     // Update last database update time
     QDateTime lastUpdate = m_updater->getLastUpdateTime();
     QString updateText = lastUpdate.isValid() ? 
@@ -252,10 +330,15 @@ void MainWindow::updateStats() {
 }
 
 void MainWindow::onNewScanClicked() {
+    if (m_scanner->isStopping()) {
+        return;
+    }
+    
     ScanDialog dialog(this);
     if (dialog.exec() == QDialog::Accepted) {
         QStringList paths = dialog.getSelectedPaths();
         if (!paths.isEmpty()) {
+            stopBackgroundRescan();
             ScanProgress progressDialog(m_scanner, m_database, paths, this);
             progressDialog.exec();
             updateStats();
@@ -263,9 +346,37 @@ void MainWindow::onNewScanClicked() {
     }
 }
 
+void MainWindow::onResumeScanClicked() {
+    if (m_scanner->isStopping()) {
+        return;
+    }
+    
+    QVector<ScanHistoryEntry> resumable = m_database->getResumableScans();
+    if (resumable.isEmpty()) {
+        m_resumeButton->setVisible(false);
+        return;
+    }
+    
+    // Most recent interrupted scan first
+    const ScanHistoryEntry& entry = resumable.first();
+    QString message = QString("Resume the scan of %1 started on %2?\n\n"
+                              "%3 files were already scanned.")
+        .arg(entry.scanPath)
+        .arg(entry.scanDate.toString("MMM dd, yyyy hh:mm"))
+        .arg(entry.filesScanned);
+    
+    if (QMessageBox::question(this, "Resume Scan", message) == QMessageBox::Yes) {
+        stopBackgroundRescan();
+        ScanProgress progressDialog(m_scanner, m_database, entry.id, this);
+        progressDialog.exec();
+        updateStats();
+    }
+}
+
 void MainWindow::onViewHistoryClicked() {
     HistoryViewer* viewer = new HistoryViewer(m_database, this);
     viewer->exec();
+    updateStats();
 }
 
 void MainWindow::onUpdateDatabaseClicked() {
@@ -282,11 +393,108 @@ void MainWindow::onAboutClicked() {
         "<p>Copyright © 2024</p>");
 }
 
+void MainWindow::rebuildHashIndex() {
+    if (!m_scanner->hashIndexEnabled()) {
+        return;
+    }
+    
+    // Only changed sources are parsed again; scans already running keep their mapping
+    QString databaseDirectory = ClamdConfig::load().databasePath();
+    QThreadPool::globalInstance()->start([databaseDirectory]() {
+        QString error;
+        if (!HashIndexBuilder::rebuild(databaseDirectory, HashIndex::defaultDirectory(), &error)) {
+            qWarning() << "Hash index not rebuilt:" << error;
+        }
+    });
+}
+
+void MainWindow::startRescanDelta() {
+    QSettings settings("FastAV", "FastAV");
+    if (!settings.value("scanner/rescanAfterUpdate", true).toBool()) {
+        return;
+    }
+    
+    // A user scan in progress already runs on the new signatures; the rest waits for the next update
+    if (m_scanner->isScanning()) {
+        qDebug() << "Scan in progress, rescan after update skipped";
+        return;
+    }
+    
+    quint64 version = m_scanner->signatureVersion().toULongLong();
+    if (version == 0) {
+        return;
+    }
+    
+    QStringList stale = m_database->getStaleCleanFiles(version);
+    if (stale.isEmpty()) {
+        return;
+    }
+    
+    // One stat() per file; done off the GUI thread for large caches
+    statusBar()->showMessage(QString("Ordering %1 files for rescan...").arg(stale.size()));
+    QFutureWatcher<QPair<QStringList, QStringList>>* watcher
+        = new QFutureWatcher<QPair<QStringList, QStringList>>(this);
+    connect(watcher, &QFutureWatcher<QPair<QStringList, QStringList>>::finished, this, [this, watcher, version]() {
+        QPair<QStringList, QStringList> result = watcher->result();
+        QStringList ordered = result.first;
+        watcher->deleteLater();
+        
+        m_database->forgetFileVerdicts(result.second);
+        if (ordered.isEmpty() || m_scanner->isScanning()) {
+            statusBar()->clearMessage();
+            return;
+        }
+        
+        m_rescanRunning = true;
+        m_scanner->startScan(ordered, QString("Rescan after signature update %1 (%2 files)")
+                                      .arg(version).arg(ordered.size()));
+    });
+    watcher->setFuture(QtConcurrent::run([stale]() {
+        QStringList missing;
+        QStringList ordered = RiskRank::order(stale, &missing);
+        return qMakePair(ordered, missing);
+    }));
+}
+
+void MainWindow::stopBackgroundRescan() {
+    if (!m_rescanRunning) {
+        return;
+    }
+    
+    // Left cancelled, so "Resume Scan" can finish it later
+    m_rescanRunning = false;
+    m_scanner->stopScan();
+    m_scanner->waitForStopped();
+    statusBar()->showMessage("Rescan after update paused", 5000);
+}
+
 void MainWindow::onUpdateCompleted(bool success) {
     m_updateButton->setEnabled(true);
     m_updateButton->setText("Update Database");
     
     if (success) {
+        // Swap the new signatures into the in-process engine; scans keep
+        // running on the old one until it is ready
+        if (m_scanner->backendName() == "libclamav" && ClamEngine::instance().isLoaded()) {
+            Scanner* scanner = m_scanner;
+            QPointer<MainWindow> window(this);
+            QThreadPool::globalInstance()->start([scanner, window]() {
+                QString error;
+                if (!ClamEngine::instance().reloadIfChanged(&error)) {
+                    qWarning() << "libclamav reload failed, keeping the previous signatures:" << error;
+                    return;
+                }
+                scanner->setSignatureVersion(ClamEngine::instance().signatureVersion());
+                if (window) {
+                    QMetaObject::invokeMethod(window, &MainWindow::startRescanDelta, Qt::QueuedConnection);
+                }
+            });
+        } else {
+            // clamd has already reloaded and the scanner carries its new version
+            startRescanDelta();
+        }
+        rebuildHashIndex();
+        
         QMessageBox::information(this, "Update Complete",
             "Virus database updated successfully!");
         updateStats();
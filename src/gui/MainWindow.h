@@ -17,26 +17,36 @@ public:
     explicit MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
     
+    Scanner* scanner() const { return m_scanner; }
+    Updater* updater() const { return m_updater; }
+    
 private slots:
     void onNewScanClicked();
+    void onResumeScanClicked();
     void onViewHistoryClicked();
     void onUpdateDatabaseClicked();
     void onAboutClicked();
     
     void onUpdateCompleted(bool success);
     void onUpdateProgress(const QString& message);
+    void startRescanDelta();
     
 private:
     void setupUI();
     void createWelcomeScreen();
     void createStatsCard();
     void updateStats();
+    void rebuildHashIndex();
+    void stopBackgroundRescan();
     
     // Core components - CRITICAL ORDER: destroyed in reverse!
     Database* m_database;   // Declared first = destroyed LAST
     Scanner* m_scanner;     // Declared second = destroyed FIRST (stops threads)
     Updater* m_updater;
     
+    // True while the scanner runs the rescan after an update, with no progress dialog
+    bool m_rescanRunning;
+    
     // UI components
     QWidget* m_centralWidget;
     QVBoxLayout* m_mainLayout;
@@ -46,6 +56,7 @@ private:
     QLabel* m_lastScanLabel;
     
     QPushButton* m_newScanButton;
+    QPushButton* m_resumeButton;
     QPushButton* m_historyButton;
     QPushButton* m_updateButton;
     QPushButton* m_aboutButton;
@@ -1,6 +1,7 @@
 #include "ScanDialog.h"
 #include "../utils/MaterialTheme.h"
 #include "../utils/FileScanner.h"
+#include "../core/ExclusionRules.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -15,7 +16,7 @@ ScanDialog::ScanDialog(QWidget* parent)
     : QDialog(parent)
 {
     setWindowTitle("Select Scan Type");
-    setMinimumSize(600, 500);
+    setMinimumSize(600, 620);
     setupUI();
 }
 
@@ -107,6 +108,33 @@ void ScanDialog::setupUI() {
     
     mainLayout->addWidget(customGroup);
     
+    // Exclusions - pruned during the directory walk
+    QGroupBox* exclusionsGroup = new QGroupBox("Exclusions", this);
+    exclusionsGroup->setStyleSheet(quickScanGroup->styleSheet());
+    
+    QVBoxLayout* exclusionsLayout = new QVBoxLayout(exclusionsGroup);
+    
+    ExclusionRules rules = ExclusionRules::fromSettings();
+    // One rule per line: a ';' or ',' may be part of a path or a regex
+    m_exclusionsEdit = new QPlainTextEdit(this);
+    m_exclusionsEdit->setPlainText(rules.rules().join('\n'));
+    m_exclusionsEdit->setPlaceholderText("/mnt/backup\nnode_modules\n*.iso\n**/.git/objects\nre:\\.cache/");
+    m_exclusionsEdit->setToolTip("One rule per line. Absolute paths exclude a whole subtree, "
+                                 "names and globs match entries, 're:' starts a regular expression.");
+    m_exclusionsEdit->setStyleSheet(m_customPathEdit->styleSheet().replace("QLineEdit", "QPlainTextEdit"));
+    m_exclusionsEdit->setFixedHeight(110);
+    exclusionsLayout->addWidget(m_exclusionsEdit);
+    
+    m_oneFileSystemCheck = new QCheckBox("Stay on the file system of each scanned folder", this);
+    m_oneFileSystemCheck->setChecked(rules.oneFileSystem());
+    exclusionsLayout->addWidget(m_oneFileSystemCheck);
+    
+    m_skipPseudoFsCheck = new QCheckBox("Skip pseudo file systems (proc, sysfs, cgroup, ...)", this);
+    m_skipPseudoFsCheck->setChecked(rules.skipPseudoFilesystems());
+    exclusionsLayout->addWidget(m_skipPseudoFsCheck);
+    
+    mainLayout->addWidget(exclusionsGroup);
+    
     // Buttons
     QHBoxLayout* buttonLayout = new QHBoxLayout();
     buttonLayout->addStretch();
@@ -203,5 +231,13 @@ void ScanDialog::onScanClicked() {
         m_selectedPaths << QDir::homePath();
     }
     
+    QStringList exclusions = m_exclusionsEdit->toPlainText().split('\n', Qt::SkipEmptyParts);
+    for (QString& rule : exclusions) {
+        rule = rule.trimmed();
+    }
+    exclusions.removeAll(QString());
+    ExclusionRules::saveToSettings(exclusions, m_oneFileSystemCheck->isChecked(),
+                                   m_skipPseudoFsCheck->isChecked());
+    
     accept();
 }
@@ -5,6 +5,8 @@
 #include <QListWidget>
 #include <QPushButton>
 #include <QLineEdit>
+#include <QCheckBox>
+#include <QPlainTextEdit>
 #include <QStringList>
 
 class ScanDialog : public QDialog {
@@ -28,6 +30,9 @@ private:
     QListWidget* m_locationList;
     QLineEdit* m_customPathEdit;
     QPushButton* m_browseButton;
+    QPlainTextEdit* m_exclusionsEdit;
+    QCheckBox* m_oneFileSystemCheck;
+    QCheckBox* m_skipPseudoFsCheck;
     QPushButton* m_scanButton;
     QPushButton* m_cancelButton;
     
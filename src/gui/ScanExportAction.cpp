@@ -0,0 +1,73 @@
+#include "ScanExportAction.h"
+#include "../core/ScanExporter.h"
+#include <QPushButton>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QDir>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+namespace {
+
+struct ExportResult {
+    bool ok;
+    QString error;
+    ScanExporter::Stats stats;
+    
+    ExportResult() : ok(false) {}
+};
+
+}
+
+void ScanExportAction::run(QPushButton* button, const QString& databasePath, int scanId) {
+    QWidget* window = button->window();
+    QString filter;
+    QString path = QFileDialog::getSaveFileName(window, "Export Scan",
+        QDir::home().filePath(QString("fastav-scan-%1.ndjson").arg(scanId)),
+        "NDJSON (*.ndjson);;CSV (*.csv);;SARIF (*.sarif)", &filter);
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    // The suffix wins over the filter, so "report.csv" is CSV whatever was picked
+    ScanExporter::Format format = ScanExporter::Format::Ndjson;
+    if (!ScanExporter::parseFormat(QFileInfo(path).suffix(), &format)) {
+        ScanExporter::parseFormat(filter.section(' ', 0, 0), &format);
+    }
+    
+    QString label = button->text();
+    button->setEnabled(false);
+    button->setText("Exporting...");
+    
+    CancellationTokenPtr token(new CancellationToken);
+    QObject::connect(button, &QObject::destroyed, [token]() {
+        token->cancel();
+    });
+    
+    QFutureWatcher<ExportResult>* watcher = new QFutureWatcher<ExportResult>(button);
+    QObject::connect(watcher, &QFutureWatcher<ExportResult>::finished, button,
+                     [button, watcher, label, path, window]() {
+        ExportResult result = watcher->result();
+        watcher->deleteLater();
+        button->setText(label);
+        button->setEnabled(true);
+        
+        if (result.ok) {
+            QMessageBox::information(window, "Export Finished",
+                QString("%1 threat(s) written to %2 in %3 s.")
+                    .arg(result.stats.threats)
+                    .arg(path)
+                    .arg(result.stats.elapsedMs / 1000.0, 0, 'f', 1));
+        } else {
+            QMessageBox::warning(window, "Export Failed", "Cannot export the scan: " + result.error);
+        }
+    });
+    
+    watcher->setFuture(QtConcurrent::run([databasePath, scanId, format, path, token]() {
+        ExportResult result;
+        ScanExporter exporter(databasePath);
+        result.ok = exporter.exportScan(scanId, format, path, token.data(), &result.error, &result.stats);
+        return result;
+    }));
+}
@@ -0,0 +1,16 @@
+#ifndef SCANEXPORTACTION_H
+#define SCANEXPORTACTION_H
+
+#include <QString>
+
+class QPushButton;
+
+// Asks where to export a scan and writes it with ScanExporter on a worker
+// thread. The button stays disabled until the export has finished; closing
+// its dialog cancels the export.
+class ScanExportAction {
+public:
+    static void run(QPushButton* button, const QString& databasePath, int scanId);
+};
+
+#endif // SCANEXPORTACTION_H
@@ -8,6 +8,7 @@
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QTimer>
+#include <QHeaderView>
 
 ScanProgress::ScanProgress(Scanner* scanner, Database* database,
                            const QStringList& paths, QWidget* parent)
@@ -15,8 +16,36 @@ ScanProgress::ScanProgress(Scanner* scanner, Database* database,
     , m_scanner(scanner)
     , m_database(database)
     , m_scanPaths(paths)
+    , m_filesAtStart(0)
     , m_scanCompleted(false)
+    , m_stopping(false)
 {
+    init();
+    
+    // Start scan
+    m_startTime = QDateTime::currentDateTime();
+    m_scanner->startScan(paths);
+}
+
+ScanProgress::ScanProgress(Scanner* scanner, Database* database, int resumeScanId,
+                           QWidget* parent)
+    : QDialog(parent)
+    , m_scanner(scanner)
+    , m_database(database)
+    , m_filesAtStart(0)
+    , m_scanCompleted(false)
+    , m_stopping(false)
+{
+    init();
+    
+    m_logText->append(QString("[INFO] Resuming interrupted scan #%1").arg(resumeScanId));
+    
+    // Resume scan
+    m_startTime = QDateTime::currentDateTime();
+    m_scanner->resumeScan(resumeScanId);
+}
+
+void ScanProgress::init() {
     setWindowTitle("Scanning in Progress");
     setMinimumSize(800, 600);
     setModal(true);
@@ -28,15 +57,13 @@ ScanProgress::ScanProgress(Scanner* scanner, Database* database,
     connect(m_scanner, &Scanner::scanProgress, this, &ScanProgress::onScanProgress);
     connect(m_scanner, &Scanner::fileScanned, this, &ScanProgress::onFileScanned);
     connect(m_scanner, &Scanner::scanCompleted, this, &ScanProgress::onScanCompleted);
+    connect(m_scanner, &Scanner::scanError, this, &ScanProgress::onScanError);
+    connect(m_scanner, &Scanner::scanCancelled, this, &ScanProgress::onScanCancelled);
     
     // Stats timer
     m_statsTimer = new QTimer(this);
     connect(m_statsTimer, &QTimer::timeout, this, &ScanProgress::updateStats);
     m_statsTimer->start(500);
-    
-    // Start scan
-    m_startTime = QDateTime::currentDateTime();
-    m_scanner->startScan(paths);
 }
 
 void ScanProgress::setupUI() {
@@ -109,9 +136,37 @@ void ScanProgress::setupUI() {
     statsLayout->addLayout(createStatRow("Files Scanned", &m_filesScannedLabel), 0, 0);
     statsLayout->addLayout(createStatRow("Threats Found", &m_threatsFoundLabel), 0, 1);
     statsLayout->addLayout(createStatRow("Scan Speed", &m_speedLabel), 1, 0);
+    statsLayout->addLayout(createStatRow("Timed Out", &m_timedOutLabel), 1, 1);
     
     mainLayout->addWidget(statsGroup);
     
+    // Per-stage latency, to see where the time per file goes
+    QGroupBox* perfGroup = new QGroupBox("Performance", this);
+    perfGroup->setStyleSheet(statsGroup->styleSheet());
+    QVBoxLayout* perfLayout = new QVBoxLayout(perfGroup);
+    
+    QStringList columns = {"Stage", "Samples", "p50 (ms)", "p90 (ms)", "p99 (ms)", "Max (ms)"};
+    m_stageTable = new QTableWidget(int(ScanStage::Count), columns.size(), perfGroup);
+    m_stageTable->setHorizontalHeaderLabels(columns);
+    m_stageTable->verticalHeader()->setVisible(false);
+    m_stageTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_stageTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_stageTable->setSelectionMode(QAbstractItemView::NoSelection);
+    m_stageTable->setStyleSheet("font-size: 11px; font-family: monospace;");
+    for (int i = 0; i < int(ScanStage::Count); ++i) {
+        m_stageTable->setItem(i, 0, new QTableWidgetItem(ScanMetrics::stageName(ScanStage(i))));
+        for (int column = 1; column < columns.size(); ++column) {
+            QTableWidgetItem* item = new QTableWidgetItem("-");
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_stageTable->setItem(i, column, item);
+        }
+    }
+    m_stageTable->setMaximumHeight(m_stageTable->horizontalHeader()->height()
+                                   + int(ScanStage::Count) * m_stageTable->verticalHeader()->defaultSectionSize() + 4);
+    perfLayout->addWidget(m_stageTable);
+    
+    mainLayout->addWidget(perfGroup);
+    
     // Current file
     QLabel* currentLabel = new QLabel("Current File:", this);
     currentLabel->setStyleSheet("color: #888888; font-size: 12px; margin-top: 10px;");
@@ -174,9 +229,21 @@ void ScanProgress::setupUI() {
 }
 
 void ScanProgress::onScanStarted(quint64 totalFiles) {
+    m_filesAtStart = m_scanner->getFilesScanned();
     m_progressBar->setMaximum(totalFiles);
+    m_progressBar->setValue(m_filesAtStart);
     m_statusLabel->setText(QString("Scanning %1 files...").arg(totalFiles));
     m_logText->append(QString("[INFO] Scan started - %1 files to scan").arg(totalFiles));
+    
+    FileWalker::Stats walkStats = m_scanner->getWalkStats();
+    if (walkStats.totalPruned() > 0) {
+        m_logText->append(QString("[INFO] Excluded %1 directories and %2 files, "
+                                  "skipped %3 other and %4 pseudo filesystems")
+            .arg(walkStats.directoriesPruned)
+            .arg(walkStats.filesPruned)
+            .arg(walkStats.otherFilesystems)
+            .arg(walkStats.pseudoFilesystems));
+    }
 }
 
 void ScanProgress::onScanProgress(quint64 scanned, quint64 total) {
@@ -225,6 +292,27 @@ void ScanProgress::onScanCompleted(const ThreatReport& report) {
         .arg(MaterialTheme::Success.name())
         .arg(summary));
     
+    if (report.getFilesTimedOut() > 0) {
+        m_logText->append(QString("<span style='color: %1;'>[TIMEOUT] %2 file(s) could not be "
+                                  "verified within their deadline, even after a retry</span>")
+            .arg(MaterialTheme::Warning.name())
+            .arg(report.getFilesTimedOut()));
+    }
+    
+    if (report.getFilesFailed() > 0) {
+        m_logText->append(QString("<span style='color: %1;'>[ERROR] %2 file(s) could not be "
+                                  "scanned by the backend and were not verified</span>")
+            .arg(MaterialTheme::Warning.name())
+            .arg(report.getFilesFailed()));
+    }
+    
+    QMap<QString, quint64> skipReasons = report.getSkipReasons();
+    for (auto it = skipReasons.constBegin(); it != skipReasons.constEnd(); ++it) {
+        m_logText->append(QString("[SKIPPED] %1 file(s) not sent to the backend: %2")
+            .arg(it.value())
+            .arg(it.key()));
+    }
+    
     // Show detailed results if threats found
     if (threatsFound > 0) {
         QMessageBox::information(this, "Scan Complete",
@@ -246,16 +334,59 @@ void ScanProgress::onScanCompleted(const ThreatReport& report) {
     }
 }
 
+void ScanProgress::onScanError(const QString& error) {
+    m_scanCompleted = true;
+    m_statsTimer->stop();
+    
+    m_statusLabel->setText(error);
+    m_cancelButton->setVisible(false);
+    m_closeButton->setVisible(true);
+    
+    m_logText->append(QString("<span style='color: %1;'>[ERROR] %2</span>")
+        .arg(MaterialTheme::Error.name())
+        .arg(error));
+}
+
 void ScanProgress::onCancelClicked() {
     if (QMessageBox::question(this, "Cancel Scan",
         "Are you sure you want to cancel the scan?") == QMessageBox::Yes) {
         m_scanner->stopScan();
-        m_logText->append(QString("<span style='color: %1;'>[CANCELLED] Scan cancelled by user</span>")
+        if (!m_scanner->isStopping()) {
+            // Nothing was running, so nothing to wait for
+            QDialog::reject();
+            return;
+        }
+        
+        // The dialog stays until the workers have drained and the checkpoint is written
+        m_stopping = true;
+        m_statsTimer->stop();
+        m_statusLabel->setText("Stopping…");
+        m_cancelButton->setEnabled(false);
+        m_logText->append(QString("<span style='color: %1;'>[CANCELLED] Stopping the scan and saving "
+                                  "a checkpoint...</span>")
             .arg(MaterialTheme::Warning.name()));
-        reject();
     }
 }
 
+void ScanProgress::onScanCancelled() {
+    if (!m_stopping) {
+        return;
+    }
+    m_stopping = false;
+    m_logText->append(QString("<span style='color: %1;'>[CANCELLED] Scan cancelled by user, "
+                              "it can be resumed later</span>")
+        .arg(MaterialTheme::Warning.name()));
+    QDialog::reject();
+}
+
+void ScanProgress::reject() {
+    // Escape or the window's close button while stopping would leave the drain unseen
+    if (m_stopping) {
+        return;
+    }
+    QDialog::reject();
+}
+
 void ScanProgress::updateStats() {
     if (!m_scanner) return;
     
@@ -265,10 +396,30 @@ void ScanProgress::updateStats() {
     
     m_filesScannedLabel->setText(QString::number(m_scanner->getFilesScanned()));
     m_threatsFoundLabel->setText(QString::number(m_scanner->getThreatsFound()));
+    m_timedOutLabel->setText(QString::number(m_scanner->getFilesTimedOut()));
     
     qint64 elapsed = m_startTime.secsTo(QDateTime::currentDateTime());
     if (elapsed > 0) {
-        double speed = m_scanner->getFilesScanned() / (double)elapsed;
+        double speed = (m_scanner->getFilesScanned() - m_filesAtStart) / (double)elapsed;
         m_speedLabel->setText(QString::number(speed, 'f', 1) + " files/s");
     }
+    
+    updateStageTable();
+}
+
+void ScanProgress::updateStageTable() {
+    QVector<StageLatency> stages = m_scanner->getStageLatencies();
+    
+    for (int i = 0; i < stages.size() && i < m_stageTable->rowCount(); ++i) {
+        const StageLatency& stage = stages[i];
+        m_stageTable->item(i, 1)->setText(QString::number(stage.count));
+        if (stage.count == 0) {
+            continue;
+        }
+        
+        const quint64 values[] = {stage.p50, stage.p90, stage.p99, stage.max};
+        for (int column = 0; column < 4; ++column) {
+            m_stageTable->item(i, column + 2)->setText(QString::number(values[column] / 1000.0, 'f', 2));
+        }
+    }
 }
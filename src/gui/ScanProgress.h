@@ -6,6 +6,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QTextEdit>
+#include <QTableWidget>
 #include <QTimer>
 #include "../core/Scanner.h"
 #include "../core/Database.h"
@@ -17,18 +18,27 @@ class ScanProgress : public QDialog {
 public:
     explicit ScanProgress(Scanner* scanner, Database* database, 
                          const QStringList& paths, QWidget* parent = nullptr);
+    ScanProgress(Scanner* scanner, Database* database, int resumeScanId,
+                 QWidget* parent = nullptr);
     
 private slots:
     void onScanStarted(quint64 totalFiles);
     void onScanProgress(quint64 scanned, quint64 total);
     void onFileScanned(const QString& path, bool infected, const QString& virusName);
     void onScanCompleted(const ThreatReport& report);
+    void onScanError(const QString& error);
     void onCancelClicked();
+    void onScanCancelled();
     void updateStats();
     
+protected:
+    void reject() override;
+    
 private:
     void setupUI();
+    void init();
     void showResults(const ThreatReport& report);
+    void updateStageTable();
     
     Scanner* m_scanner;
     Database* m_database;
@@ -39,14 +49,18 @@ private:
     QLabel* m_filesScannedLabel;
     QLabel* m_threatsFoundLabel;
     QLabel* m_speedLabel;
+    QLabel* m_timedOutLabel;
     QLabel* m_currentFileLabel;
     QTextEdit* m_logText;
+    QTableWidget* m_stageTable;
     QPushButton* m_cancelButton;
     QPushButton* m_closeButton;
     
     QTimer* m_statsTimer;
     QDateTime m_startTime;
+    quint64 m_filesAtStart;  // already scanned before a resume
     bool m_scanCompleted;
+    bool m_stopping;  // cancelled, waiting for scanCancelled() before closing
 };
 
 #endif // SCANPROGRESS_H
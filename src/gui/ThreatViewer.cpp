@@ -1,6 +1,7 @@
 #include "ThreatViewer.h"
 #include "../utils/MaterialTheme.h"
 #include "../utils/FileScanner.h"
+#include "ScanExportAction.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -9,6 +10,7 @@
 ThreatViewer::ThreatViewer(const ThreatReport& report, QWidget* parent)
     : QDialog(parent)
     , m_report(report)
+    , m_scanId(-1)
 {
     setWindowTitle("Threats Detected");
     setMinimumSize(900, 600);
@@ -98,6 +100,17 @@ void ThreatViewer::setupUI() {
     QHBoxLayout* buttonLayout = new QHBoxLayout();
     buttonLayout->addStretch();
     
+    // Streams the stored scan, so it works for reports too large for the table
+    m_exportButton = new QPushButton("Export...", this);
+    m_exportButton->setStyleSheet(MaterialTheme::getButtonStyle());
+    m_exportButton->setCursor(Qt::PointingHandCursor);
+    m_exportButton->setMinimumWidth(120);
+    m_exportButton->setVisible(false);
+    connect(m_exportButton, &QPushButton::clicked, this, [this]() {
+        ScanExportAction::run(m_exportButton, m_databasePath, m_scanId);
+    });
+    buttonLayout->addWidget(m_exportButton);
+    
     m_closeButton = new QPushButton("Close", this);
     m_closeButton->setStyleSheet(MaterialTheme::getButtonStyle());
     m_closeButton->setCursor(Qt::PointingHandCursor);
@@ -109,12 +122,19 @@ void ThreatViewer::setupUI() {
     mainLayout->addLayout(buttonLayout);
 }
 
+void ThreatViewer::setExportSource(const QString& databasePath, int scanId) {
+    m_databasePath = databasePath;
+    m_scanId = scanId;
+    m_exportButton->setVisible(!databasePath.isEmpty() && scanId >= 0);
+}
+
 void ThreatViewer::populateTable() {
-    const QVector<ThreatInfo>& threats = m_report.getThreats();
+    const ThreatStore& threats = m_report.getThreats();
     m_threatTable->setRowCount(threats.size());
     
-    for (int i = 0; i < threats.size(); ++i) {
-        const ThreatInfo& threat = threats[i];
+    for (ThreatStore::const_iterator it = threats.begin(); it != threats.end(); ++it) {
+        const ThreatInfo& threat = *it;
+        int i = it.index();
         
         // Virus name
         QTableWidgetItem* virusItem = new QTableWidgetItem(threat.virusName);
@@ -11,6 +11,8 @@ class ThreatViewer : public QDialog {
     
 public:
     explicit ThreatViewer(const ThreatReport& report, QWidget* parent = nullptr);
+    // Shows the Export button for a report that is stored in the database
+    void setExportSource(const QString& databasePath, int scanId);
     
 private:
     void setupUI();
@@ -18,7 +20,10 @@ private:
     
     ThreatReport m_report;
     QTableWidget* m_threatTable;
+    QPushButton* m_exportButton;
     QPushButton* m_closeButton;
+    QString m_databasePath;
+    int m_scanId;
 };
 
 #endif // THREATVIEWER_H
@@ -1,8 +1,19 @@
 #include "gui/MainWindow.h"
 #include "utils/MaterialTheme.h"
+#include "core/MetricsServer.h"
+#include "core/ScanTracer.h"
+#include "core/ScanBackend.h"
+#include "core/ArchiveExpander.h"
+#include "core/ScanExporter.h"
+#include "core/Database.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QScopedPointer>
 #include <QLocale>
 #include <QTranslator>
+#include <QTextStream>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
@@ -14,12 +25,172 @@ int main(int argc, char *argv[])
     QApplication::setOrganizationName("FastAV");
     QApplication::setOrganizationDomain("fastav.app");
     
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Modern high-performance antivirus scanner");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    
+    QCommandLineOption metricsOption("metrics",
+        "Serve Prometheus metrics on <endpoint>: tcp:port, tcp:127.0.0.1:port or unix:/path.",
+        "endpoint");
+    QCommandLineOption traceOption("trace",
+        "Write a Chrome trace (chrome://tracing, ui.perfetto.dev) of every scan to <file>.",
+        "file");
+    QCommandLineOption backendOption("backend",
+        "Scan with <name>: " + ScanBackend::names().join(", ") + ". Default: scanner/backend setting.",
+        "name");
+    QCommandLineOption endpointOption("clamd-endpoint",
+        "clamd socket(s) for the clamd backends (unix:/path or tcp:host:port, comma separated "
+        "to balance across several). Default: clamd.conf.",
+        "endpoint");
+    QCommandLineOption listBackendsOption("list-backends", "List scan backends and their capabilities.");
+    QCommandLineOption strictOption("strict",
+        "Scan every file, including unmodified files owned by the package manager.");
+    QCommandLineOption walkOrderOption("walk-order",
+        "Scan files in the order they are found instead of riskiest first.");
+    QCommandLineOption incrementalOption("incremental",
+        "Only list directories changed since the last incremental scan (new, renamed or replaced files).");
+    QCommandLineOption noIoUringOption("no-io-uring",
+        "Let every worker stat, open and read its own files instead of prefetching them with io_uring.");
+    QCommandLineOption exportOption("export",
+        "Export scan <id> (or 'last') from the history and exit, without opening the window.",
+        "id");
+    QCommandLineOption exportFormatOption("export-format",
+        "Export format: " + ScanExporter::formatNames().join(", ") + ". Default: ndjson.",
+        "format", "ndjson");
+    QCommandLineOption outputOption("output", "Write the export to <file> instead of stdout.", "file", "-");
+    parser.addOption(metricsOption);
+    parser.addOption(traceOption);
+    parser.addOption(backendOption);
+    parser.addOption(endpointOption);
+    parser.addOption(listBackendsOption);
+    parser.addOption(strictOption);
+    parser.addOption(walkOrderOption);
+    parser.addOption(incrementalOption);
+    parser.addOption(noIoUringOption);
+    parser.addOption(exportOption);
+    parser.addOption(exportFormatOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+    
+    if (parser.isSet(listBackendsOption)) {
+        QTextStream out(stdout);
+        for (const QString& name : ScanBackend::names()) {
+            out << name.leftJustified(14) << ScanBackend::describe(name);
+            QScopedPointer<ScanBackend> backend(ScanBackend::create(name, QString()));
+            if (backend) {
+                ScanBackend::Capabilities capabilities = backend->capabilities();
+                out << " [batch: " << (capabilities.batch ? "yes" : "no")
+                    << ", fd passing: " << (capabilities.fdPassing ? "yes" : "no")
+                    << ", streaming: " << (capabilities.streaming ? "yes" : "no")
+                    << ", in-process: " << (capabilities.inProcess ? "yes" : "no")
+                    << ", archive members: " << (capabilities.buffers && ArchiveExpander::isAvailable() ? "yes" : "no")
+                    << "]";
+            } else {
+                out << " [not in this build]";
+            }
+            out << Qt::endl;
+        }
+        return 0;
+    }
+    
+    if (parser.isSet(exportOption)) {
+        QTextStream err(stderr);
+        ScanExporter::Format format;
+        if (!ScanExporter::parseFormat(parser.value(exportFormatOption), &format)) {
+            err << "Unknown export format: " << parser.value(exportFormatOption) << Qt::endl;
+            return 2;
+        }
+        
+        // Read-only, so a running GUI and its scans are not disturbed
+        ScanExporter exporter(Database::defaultPath());
+        QString error;
+        bool isNumber = false;
+        int scanId = parser.value(exportOption).toInt(&isNumber);
+        if (parser.value(exportOption) == "last") {
+            scanId = exporter.latestScanId(&error);
+        } else if (!isNumber) {
+            err << "--export takes a scan ID or 'last'" << Qt::endl;
+            return 2;
+        }
+        
+        ScanExporter::Stats stats;
+        if (scanId < 0 || !exporter.exportScan(scanId, format, parser.value(outputOption), nullptr, &error, &stats)) {
+            err << "Export failed: " << error << Qt::endl;
+            return 1;
+        }
+        if (parser.value(outputOption) != "-") {
+            err << "Exported " << stats.threats << " threat(s) of scan " << scanId << " to "
+                << parser.value(outputOption) << Qt::endl;
+        }
+        return 0;
+    }
+    
+    QSettings settings("FastAV", "FastAV");
+    QString backendName = parser.isSet(backendOption) ? parser.value(backendOption) : ScanBackend::defaultName();
+    if (!ScanBackend::isAvailable(backendName)) {
+        qWarning() << "Scan backend" << backendName << "is not available, using clamdscan";
+        backendName = "clamdscan";
+    }
+    
     // Apply Material Design theme
     MaterialTheme::applyTheme();
     
+    // Outlives the window, whose scanner records into it until it is destroyed
+    QScopedPointer<ScanTracer> tracer;
+    if (parser.isSet(traceOption)) {
+        tracer.reset(new ScanTracer);
+    }
+    
     // Create and show main window
     MainWindow window;
     window.show();
     
+    window.scanner()->setBackend(backendName);
+    QString clamdEndpoint = parser.isSet(endpointOption)
+        ? parser.value(endpointOption) : settings.value("scanner/clamdEndpoint").toString();
+    window.scanner()->setClamdEndpoint(clamdEndpoint);
+    window.updater()->setClamdEndpoint(clamdEndpoint);
+    if (parser.isSet(strictOption)) {
+        window.scanner()->setStrictMode(true);
+    }
+    if (parser.isSet(walkOrderOption)) {
+        window.scanner()->setRiskOrder(false);
+    }
+    if (parser.isSet(incrementalOption)) {
+        window.scanner()->setIncremental(true);
+    }
+    if (parser.isSet(noIoUringOption)) {
+        window.scanner()->setIoUring(false);
+    }
+    
+    // The file holds every scan of the session and is rewritten after each one
+    if (tracer) {
+        QString tracePath = parser.value(traceOption);
+        ScanTracer* scanTracer = tracer.data();
+        auto writeTrace = [scanTracer, tracePath]() {
+            QString error;
+            if (!scanTracer->write(tracePath, &error)) {
+                qWarning() << "Cannot write trace to" << tracePath << "-" << error;
+            }
+        };
+        window.scanner()->setTracer(scanTracer);
+        QObject::connect(window.scanner(), &Scanner::scanCompleted, writeTrace);
+        QObject::connect(window.scanner(), &Scanner::scanCancelled, writeTrace);
+    }
+    
+    // Optional metrics endpoint; the command line wins over the saved setting
+    QString metricsEndpoint = parser.value(metricsOption);
+    if (metricsEndpoint.isEmpty()) {
+        metricsEndpoint = settings.value("metrics/endpoint").toString();
+    }
+    if (!metricsEndpoint.isEmpty()) {
+        MetricsServer* metrics = new MetricsServer(window.scanner(), window.scanner());
+        if (!metrics->listen(metricsEndpoint)) {
+            qWarning() << "Cannot serve metrics on" << metricsEndpoint << "-" << metrics->errorString();
+            delete metrics;
+        }
+    }
+    
     return app.exec();
 }
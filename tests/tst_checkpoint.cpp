@@ -0,0 +1,77 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "core/Database.h"
+
+// Resuming a scan: what the rollback keeps and the totals it restores
+class TestCheckpoint : public QObject {
+    Q_OBJECT
+
+private slots:
+    void rollbackKeepsCheckpointedArchiveMembers();
+    void checkpointRestoresTotals();
+};
+
+void TestCheckpoint::rollbackKeepsCheckpointedArchiveMembers() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Database db(dir.filePath("fastav.db"));
+    QVERIFY(db.initialize());
+
+    int scanId = db.createScan(QStringList() << "/data");
+    QVERIFY(scanId >= 0);
+    QVERIFY(db.addThreat(scanId, "/data/a.zip!evil.exe", "Eicar-Test", 68));
+    QVERIFY(db.addThreat(scanId, "/data/a.zip!inner.tar!nested.exe", "Eicar-Test", 68));
+    QVERIFY(db.addThreat(scanId, "/data/b.exe", "Eicar-Test", 68));
+    // After the checkpoint: found again on resume
+    QVERIFY(db.addThreat(scanId, "/data/c.exe", "Eicar-Test", 68));
+    QVERIFY(db.addThreat(scanId, "/data/c.zip!member.exe", "Eicar-Test", 68));
+    // Shares a prefix with a checkpointed archive, but is not one of its members
+    QVERIFY(db.addThreat(scanId, "/data/a.zip2!member.exe", "Eicar-Test", 68));
+
+    ScanCheckpoint totals;
+    totals.threatsFound = 3;
+    QVERIFY(db.saveCheckpoint(scanId, QStringList() << "/data/a.zip" << "/data/b.exe", totals));
+    QVERIFY(db.setScanStatus(scanId, "interrupted"));
+
+    QCOMPARE(db.rollbackToCheckpoint(scanId), 3);
+
+    QStringList kept;
+    for (const ThreatInfo& threat : db.getScanDetails(scanId).getThreats()) {
+        kept << threat.filePath;
+    }
+    kept.sort();
+    QCOMPARE(kept, QStringList() << "/data/a.zip!evil.exe" << "/data/a.zip!inner.tar!nested.exe"
+                                 << "/data/b.exe");
+    QCOMPARE(db.getCompletedFiles(scanId), QSet<QString>({"/data/a.zip", "/data/b.exe"}));
+}
+
+void TestCheckpoint::checkpointRestoresTotals() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Database db(dir.filePath("fastav.db"));
+    QVERIFY(db.initialize());
+
+    int scanId = db.createScan(QStringList() << "/data");
+    QVERIFY(scanId >= 0);
+
+    ScanCheckpoint totals;
+    totals.filesScanned = 120;
+    totals.bytesScanned = 5 * 1024 * 1024;
+    totals.threatsFound = 0;
+    totals.duration = 42;
+    totals.firstDetectionMs = 1500;
+    totals.bytesRead = 3 * 1024 * 1024;
+    totals.holeBytes = 2 * 1024 * 1024;
+    QVERIFY(db.saveCheckpoint(scanId, QStringList() << "/data/a" << "/data/b", totals));
+
+    ScanHistoryEntry entry = db.getScan(scanId);
+    QCOMPARE(entry.filesScanned, totals.filesScanned);
+    QCOMPARE(entry.bytesScanned, totals.bytesScanned);
+    QCOMPARE(entry.scanDuration, totals.duration);
+    QCOMPARE(entry.firstDetectionMs, totals.firstDetectionMs);
+    QCOMPARE(entry.bytesRead, totals.bytesRead);
+    QCOMPARE(entry.holeBytes, totals.holeBytes);
+}
+
+QTEST_GUILESS_MAIN(TestCheckpoint)
+#include "tst_checkpoint.moc"
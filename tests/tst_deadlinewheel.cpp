@@ -0,0 +1,90 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include "core/DeadlineWheel.h"
+
+// Deadlines cancel their token from the wheel's thread, within a tick of the deadline
+class TestDeadlineWheel : public QObject {
+    Q_OBJECT
+
+private slots:
+    void cancelsAfterDeadline();
+    void removePreventsCancel();
+    void longDeadlineWrapsTheWheel();
+    void stopDropsDeadlines();
+    void parentCancelsChild();
+};
+
+void TestDeadlineWheel::cancelsAfterDeadline() {
+    DeadlineWheel wheel(10, 64);
+    wheel.start();
+
+    CancellationTokenPtr token(new CancellationToken);
+    QElapsedTimer timer;
+    timer.start();
+    wheel.schedule(100, token);
+
+    QVERIFY(!token->isCancelled());
+    QTRY_VERIFY_WITH_TIMEOUT(token->isCancelled(), 5000);
+    QVERIFY(timer.elapsed() >= 80);
+    wheel.stop();
+}
+
+void TestDeadlineWheel::removePreventsCancel() {
+    DeadlineWheel wheel(10, 64);
+    wheel.start();
+
+    CancellationTokenPtr removed(new CancellationToken);
+    CancellationTokenPtr kept(new CancellationToken);
+    quint64 id = wheel.schedule(50, removed);
+    wheel.schedule(150, kept);
+    wheel.remove(id);
+
+    QTRY_VERIFY_WITH_TIMEOUT(kept->isCancelled(), 5000);
+    QVERIFY(!removed->isCancelled());
+
+    // Removing twice, or after the deadline fired, is harmless
+    wheel.remove(id);
+    wheel.stop();
+}
+
+void TestDeadlineWheel::longDeadlineWrapsTheWheel() {
+    // 8 slots of 10 ms: a 200 ms deadline goes round the wheel more than twice
+    DeadlineWheel wheel(10, 8);
+    wheel.start();
+
+    CancellationTokenPtr token(new CancellationToken);
+    QElapsedTimer timer;
+    timer.start();
+    wheel.schedule(200, token);
+
+    QTRY_VERIFY_WITH_TIMEOUT(token->isCancelled(), 5000);
+    QVERIFY(timer.elapsed() >= 180);
+    wheel.stop();
+}
+
+void TestDeadlineWheel::stopDropsDeadlines() {
+    DeadlineWheel wheel(10, 64);
+    wheel.start();
+
+    CancellationTokenPtr token(new CancellationToken);
+    wheel.schedule(100, token);
+    wheel.stop();
+
+    // A restarted wheel must not fire what the previous run left behind
+    wheel.start();
+    QTest::qWait(300);
+    QVERIFY(!token->isCancelled());
+    wheel.stop();
+}
+
+void TestDeadlineWheel::parentCancelsChild() {
+    CancellationTokenPtr scan(new CancellationToken);
+    CancellationTokenPtr file(new CancellationToken(scan));
+    QVERIFY(!file->isCancelled());
+
+    scan->cancel();
+    QVERIFY(file->isCancelled());
+}
+
+QTEST_GUILESS_MAIN(TestDeadlineWheel)
+#include "tst_deadlinewheel.moc"
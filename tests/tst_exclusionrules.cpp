@@ -0,0 +1,90 @@
+#include <QtTest>
+#include "core/ExclusionRules.h"
+
+// Glob rules compile to regular expressions; set contents must come through literally
+class TestExclusionRules : public QObject {
+    Q_OBJECT
+
+private slots:
+    void nameGlobs_data();
+    void nameGlobs();
+    void pathGlobs_data();
+    void pathGlobs();
+};
+
+void TestExclusionRules::nameGlobs_data() {
+    QTest::addColumn<QString>("rule");
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("star") << "*.iso" << "disk.iso" << true;
+    QTest::newRow("star anchored") << "*.iso" << "disk.isox" << false;
+    QTest::newRow("question mark") << "?.log" << "a.log" << true;
+    QTest::newRow("dot is literal") << "file.txt" << "fileXtxt" << false;
+    QTest::newRow("set") << "[abc].bin" << "b.bin" << true;
+    QTest::newRow("set miss") << "[abc].bin" << "d.bin" << false;
+    QTest::newRow("range") << "log[0-9]" << "log7" << true;
+    QTest::newRow("range miss") << "log[0-9]" << "logx" << false;
+    QTest::newRow("bang negates") << "[!.]*" << "visible" << true;
+    QTest::newRow("bang negates miss") << "[!.]*" << ".hidden" << false;
+    QTest::newRow("caret negates") << "[^a]b" << "cb" << true;
+    QTest::newRow("caret negates miss") << "[^a]b" << "ab" << false;
+    QTest::newRow("leading bracket literal") << "[]]z" << "]z" << true;
+    QTest::newRow("escaped bracket in set") << "[a\\]]x" << "]x" << true;
+    QTest::newRow("escaped bracket in set, other member") << "[a\\]]x" << "ax" << true;
+    QTest::newRow("escaped bracket in set miss") << "[a\\]]x" << "\\x" << false;
+    QTest::newRow("backslash in set") << "[\\\\]x" << "\\x" << true;
+    QTest::newRow("caret member") << "[x^]y" << "^y" << true;
+    QTest::newRow("dash at end") << "[a-]z" << "-z" << true;
+    QTest::newRow("regex class syntax literal") << "[[:alpha:]]" << "a" << false;
+    QTest::newRow("unterminated set") << "[ab" << "[ab" << true;
+    QTest::newRow("escaped star") << "a\\*" << "a*" << true;
+    QTest::newRow("escaped star miss") << "a\\*" << "ab" << false;
+}
+
+void TestExclusionRules::nameGlobs() {
+    QFETCH(QString, rule);
+    QFETCH(QString, name);
+    QFETCH(bool, matches);
+
+    ExclusionRules rules;
+    rules.addRule(rule);
+    rules.compile();
+    QCOMPARE(rules.matchesName(name), matches);
+}
+
+void TestExclusionRules::pathGlobs_data() {
+    QTest::addColumn<QString>("rule");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("double star") << "**/.git/objects" << "/home/u/repo/.git/objects" << true;
+    QTest::newRow("double star at root") << "**/.git/objects" << "/.git/objects" << true;
+    QTest::newRow("double star anchored") << "**/.git/objects" << "/home/u/.git/objectsx" << false;
+    QTest::newRow("double star whole component") << "**/.git/objects" << "/home/u/x.git/objects" << false;
+    QTest::newRow("double star prefix") << "**/cache" << "/srv/precache" << false;
+    QTest::newRow("double star middle") << "a/**/b" << "/a/x/y/b" << true;
+    QTest::newRow("double star middle, no directory") << "a/**/b" << "/a/b" << true;
+    QTest::newRow("double star middle, glued") << "a/**/b" << "/a/xb" << false;
+    QTest::newRow("double star at end") << "/srv/**" << "/srv/a/b" << true;
+    QTest::newRow("double star in a name") << "/srv/a**" << "/srv/ab/c" << false;
+    QTest::newRow("star stays in component") << "/srv/*/cache" << "/srv/a/cache" << true;
+    QTest::newRow("star stays in component miss") << "/srv/*/cache" << "/srv/a/b/cache" << false;
+    QTest::newRow("negated set stays in component") << "/d/[!x]/f" << "/d/y/f" << true;
+    QTest::newRow("negated set stays in component miss") << "/d/a[!x]b/f" << "/d/a/b/f" << false;
+    QTest::newRow("set in path") << "/var/log[12]/*" << "/var/log2/syslog" << true;
+}
+
+void TestExclusionRules::pathGlobs() {
+    QFETCH(QString, rule);
+    QFETCH(QString, path);
+    QFETCH(bool, matches);
+
+    ExclusionRules rules;
+    rules.addRule(rule);
+    rules.compile();
+    QCOMPARE(rules.matchesPath(path), matches);
+}
+
+QTEST_GUILESS_MAIN(TestExclusionRules)
+#include "tst_exclusionrules.moc"
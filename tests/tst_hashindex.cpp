@@ -0,0 +1,159 @@
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include "core/HashIndex.h"
+#include "core/HashIndexBuilder.h"
+
+// Builds an index from a loose .hdb/.fp pair and checks what it flags
+class TestHashIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void buildStats();
+    void sizes();
+    void matchesFiles();
+    void containsDigest();
+    void rebuildIsCached();
+    void rejectsGarbage();
+
+private:
+    static QByteArray hexDigest(const QByteArray& data, QCryptographicHash::Algorithm algorithm);
+    QString writeFile(const QString& name, const QByteArray& contents);
+
+    QTemporaryDir m_dir;
+    QString m_databaseDirectory;
+    QString m_indexDirectory;
+    HashIndexBuilder::Stats m_stats;
+};
+
+static const QByteArray Bad("definitely not a real virus, md5 signature");
+static const QByteArray BadSha256("another made up sample, sha256 signature");
+static const QByteArray FalsePositive("listed, then withdrawn by the .fp file");
+static const QByteArray Clean("nothing to see here, same length as Bad!!!");
+
+QByteArray TestHashIndex::hexDigest(const QByteArray& data, QCryptographicHash::Algorithm algorithm) {
+    return QCryptographicHash::hash(data, algorithm).toHex();
+}
+
+QString TestHashIndex::writeFile(const QString& name, const QByteArray& contents) {
+    QString path = m_dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void TestHashIndex::initTestCase() {
+    QVERIFY(m_dir.isValid());
+    QCOMPARE(Clean.size(), Bad.size());
+
+    m_databaseDirectory = m_dir.filePath("db");
+    m_indexDirectory = m_dir.filePath("index");
+    QVERIFY(QDir().mkpath(m_databaseDirectory));
+
+    QByteArray hdb;
+    hdb += "# comment lines are skipped\n";
+    hdb += hexDigest(Bad, QCryptographicHash::Md5) + ':' + QByteArray::number(Bad.size()) + ":Test.Md5-1\n";
+    hdb += hexDigest(FalsePositive, QCryptographicHash::Md5) + ':'
+        + QByteArray::number(FalsePositive.size()) + ":Test.Withdrawn-1\n";
+    hdb += hexDigest("any size", QCryptographicHash::Md5) + ":*:Test.Wildcard-1\n";
+    QVERIFY(!writeFile("db/test.hdb", hdb).isEmpty());
+
+    QByteArray hsb = hexDigest(BadSha256, QCryptographicHash::Sha256) + ':'
+        + QByteArray::number(BadSha256.size()) + ":Test.Sha256-1\n";
+    QVERIFY(!writeFile("db/test.hsb", hsb).isEmpty());
+
+    QByteArray fp = hexDigest(FalsePositive, QCryptographicHash::Md5) + ':'
+        + QByteArray::number(FalsePositive.size()) + ":Test.Withdrawn-1\n";
+    QVERIFY(!writeFile("db/test.fp", fp).isEmpty());
+
+    QString error;
+    QVERIFY2(HashIndexBuilder::rebuild(m_databaseDirectory, m_indexDirectory, &error, &m_stats),
+             qPrintable(error));
+}
+
+void TestHashIndex::buildStats() {
+    QCOMPARE(m_stats.sources, 3);
+    QCOMPARE(m_stats.wildcardSizes, quint64(1));
+    QVERIFY(m_stats.falsePositives >= 1);
+    QVERIFY(!m_stats.unchanged);
+
+    HashIndexPtr index = HashIndex::open(m_indexDirectory + "/index.bin");
+    QVERIFY(index);
+    QCOMPARE(index->signatureCount(), quint64(2));
+}
+
+void TestHashIndex::sizes() {
+    HashIndexPtr index = HashIndex::open(m_indexDirectory + "/index.bin");
+    QVERIFY(index);
+    QVERIFY(index->hasSize(quint64(Bad.size())));
+    QVERIFY(index->hasSize(quint64(BadSha256.size())));
+    QVERIFY(!index->hasSize(quint64(FalsePositive.size())));
+    QVERIFY(!index->hasSize(0));
+}
+
+void TestHashIndex::matchesFiles() {
+    HashIndexPtr index = HashIndex::open(m_indexDirectory + "/index.bin");
+    QVERIFY(index);
+
+    QString name;
+    QString bad = writeFile("bad.bin", Bad);
+    QVERIFY(index->matchFile(bad, quint64(Bad.size()), &name));
+    QCOMPARE(name, QString("Test.Md5-1"));
+
+    name.clear();
+    QString badSha256 = writeFile("bad256.bin", BadSha256);
+    QVERIFY(index->matchFile(badSha256, quint64(BadSha256.size()), &name));
+    QCOMPARE(name, QString("Test.Sha256-1"));
+
+    // Same size as a signature, different contents
+    QString clean = writeFile("clean.bin", Clean);
+    QVERIFY(!index->matchFile(clean, quint64(Clean.size()), &name));
+
+    // Already in memory: nothing is read from the path
+    QVERIFY(index->matchFile(m_dir.filePath("missing"), quint64(Bad.size()), &name, nullptr, &Bad));
+
+    QString withdrawn = writeFile("withdrawn.bin", FalsePositive);
+    QVERIFY(!index->matchFile(withdrawn, quint64(FalsePositive.size()), &name));
+}
+
+void TestHashIndex::containsDigest() {
+    HashIndexPtr index = HashIndex::open(m_indexDirectory + "/index.bin");
+    QVERIFY(index);
+
+    QByteArray md5 = QCryptographicHash::hash(Bad, QCryptographicHash::Md5);
+    QString name;
+    QVERIFY(index->contains(HashIndex::Md5, reinterpret_cast<const unsigned char*>(md5.constData()),
+                            quint64(Bad.size()), &name));
+    QCOMPARE(name, QString("Test.Md5-1"));
+
+    // The size is part of the key
+    QVERIFY(!index->contains(HashIndex::Md5, reinterpret_cast<const unsigned char*>(md5.constData()),
+                             quint64(Bad.size()) + 1));
+
+    QByteArray sha1 = QCryptographicHash::hash(Bad, QCryptographicHash::Sha1);
+    QVERIFY(!index->contains(HashIndex::Sha1, reinterpret_cast<const unsigned char*>(sha1.constData()),
+                             quint64(Bad.size())));
+}
+
+void TestHashIndex::rebuildIsCached() {
+    HashIndexBuilder::Stats stats;
+    QString error;
+    QVERIFY2(HashIndexBuilder::rebuild(m_databaseDirectory, m_indexDirectory, &error, &stats),
+             qPrintable(error));
+    QVERIFY(stats.unchanged);
+    QCOMPARE(stats.sourcesParsed, 0);
+}
+
+void TestHashIndex::rejectsGarbage() {
+    QString path = writeFile("garbage.bin", QByteArray(4096, 'x'));
+    QString error;
+    QVERIFY(!HashIndex::open(path, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!HashIndex::open(m_dir.filePath("does-not-exist")));
+}
+
+QTEST_GUILESS_MAIN(TestHashIndex)
+#include "tst_hashindex.moc"
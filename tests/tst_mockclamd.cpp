@@ -0,0 +1,174 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include "core/ClamdClient.h"
+#include "MockClamd.h"
+
+// The mock has to answer the real client the way clamd would, on both
+// transports, and apply the latency and failures it was configured with
+class TestMockClamd : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void pingAndVersion_data();
+    void pingAndVersion();
+    void scanPath();
+    void scanStream();
+    void session();
+    void streamLimit();
+    void injectedErrors();
+    void fixedLatency();
+
+private:
+    QString writeFile(const QString& name, const QByteArray& contents);
+
+    QTemporaryDir m_dir;
+    QString m_eicar;
+    QString m_clean;
+};
+
+static const QByteArray Eicar("X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*");
+
+QString TestMockClamd::writeFile(const QString& name, const QByteArray& contents) {
+    QString path = m_dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void TestMockClamd::initTestCase() {
+    QVERIFY(m_dir.isValid());
+    m_eicar = writeFile("eicar.com", Eicar);
+    m_clean = writeFile("clean.txt", QByteArray(4096, 'a'));
+    QVERIFY(!m_eicar.isEmpty() && !m_clean.isEmpty());
+}
+
+void TestMockClamd::pingAndVersion_data() {
+    QTest::addColumn<bool>("tcp");
+
+    QTest::newRow("unix") << false;
+    QTest::newRow("tcp") << true;
+}
+
+void TestMockClamd::pingAndVersion() {
+    QFETCH(bool, tcp);
+
+    MockClamd mock;
+    QVERIFY2(tcp ? mock.listenTcp() : mock.listenLocal(m_dir.filePath("ping.sock")), qPrintable(mock.errorString()));
+
+    ClamdClient client(mock.endpoint());
+    QVERIFY2(client.ping(), qPrintable(client.errorString()));
+    QCOMPARE(ClamdClient::signatureVersion(client.version()), QString("27000"));
+
+    QString version;
+    QStringList commands;
+    QVERIFY(client.versionCommands(&version, &commands));
+    QVERIFY(commands.contains("INSTREAM"));
+    QVERIFY(commands.contains("IDSESSION"));
+    QCOMPARE(mock.stats().requests, quint64(3));
+}
+
+void TestMockClamd::scanPath() {
+    MockClamd mock;
+    QVERIFY(mock.listenLocal(m_dir.filePath("scan.sock")));
+    ClamdClient client(mock.endpoint());
+
+    QByteArray reply = client.scanPath(m_eicar, nullptr);
+    QCOMPARE(reply, QFile::encodeName(m_eicar) + ": " + MockClamd::eicarSignatureName() + " FOUND");
+    QCOMPARE(client.scanPath(m_clean, nullptr), QFile::encodeName(m_clean) + ": OK");
+    QVERIFY(client.scanPath(m_dir.filePath("missing"), nullptr).endsWith("ERROR"));
+
+    MockClamd::Stats stats = mock.stats();
+    QCOMPARE(stats.detections, quint64(1));
+    QCOMPARE(stats.bytes, quint64(Eicar.size() + 4096));
+}
+
+void TestMockClamd::scanStream() {
+    MockClamd mock;
+    QVERIFY(mock.listenTcp());
+    ClamdClient client(mock.endpoint());
+
+    QCOMPARE(client.scanStream(m_eicar, nullptr),
+             QByteArray("stream: ") + MockClamd::eicarSignatureName() + " FOUND");
+    QCOMPARE(client.scanStream(m_clean, nullptr), QByteArray("stream: OK"));
+    QCOMPARE(client.streamRead().bytes, quint64(4096));
+}
+
+void TestMockClamd::session() {
+    // ClamdClient closes after each command, so the session is driven by hand
+    MockClamd mock;
+    QString socketPath = m_dir.filePath("session.sock");
+    QVERIFY(mock.listenLocal(socketPath));
+
+    QLocalSocket socket;
+    socket.connectToServer(socketPath);
+    QVERIFY(socket.waitForConnected(2000));
+    socket.write(QByteArray("zIDSESSION\0zPING\0zSCAN ", 23) + QFile::encodeName(m_eicar) + '\0');
+    QVERIFY(socket.waitForBytesWritten(2000));
+
+    QByteArray replies;
+    while (replies.count('\0') < 2 && socket.waitForReadyRead(2000)) {
+        replies += socket.readAll();
+    }
+    QList<QByteArray> lines = replies.split('\0');
+    QVERIFY(lines.size() >= 2);
+    QCOMPARE(lines[0], QByteArray("1: PONG"));
+    QCOMPARE(lines[1], "2: " + QFile::encodeName(m_eicar) + ": " + MockClamd::eicarSignatureName() + " FOUND");
+
+    socket.write(QByteArray("zEND\0", 5));
+    socket.waitForBytesWritten(2000);
+    QVERIFY(socket.state() == QLocalSocket::UnconnectedState || socket.waitForDisconnected(2000));
+}
+
+void TestMockClamd::streamLimit() {
+    MockClamd::Options options;
+    options.streamMaxLength = 1024;
+    MockClamd mock(options);
+    QVERIFY(mock.listenLocal(m_dir.filePath("limit.sock")));
+    ClamdClient client(mock.endpoint());
+
+    QCOMPARE(client.scanStream(m_clean, nullptr), QByteArray("INSTREAM size limit exceeded. ERROR"));
+}
+
+void TestMockClamd::injectedErrors() {
+    MockClamd::Options options;
+    options.errorRate = 1.0;
+    MockClamd mock(options);
+    QVERIFY(mock.listenLocal(m_dir.filePath("errors.sock")));
+    ClamdClient client(mock.endpoint());
+
+    // Only scans fail, the health checks keep answering
+    QVERIFY(client.ping());
+    QCOMPARE(client.scanPath(m_eicar, nullptr), QByteArray("Injected failure. ERROR"));
+    QCOMPARE(client.scanStream(m_clean, nullptr), QByteArray("Injected failure. ERROR"));
+
+    MockClamd::Stats stats = mock.stats();
+    QCOMPARE(stats.errorsInjected, quint64(2));
+    QCOMPARE(stats.detections, quint64(0));
+}
+
+void TestMockClamd::fixedLatency() {
+    MockClamd::Options options;
+    options.latencyModel = MockClamd::LatencyModel::Fixed;
+    options.latencyMs = 100;
+    MockClamd mock(options);
+    QVERIFY(mock.listenLocal(m_dir.filePath("latency.sock")));
+    ClamdClient client(mock.endpoint());
+
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(client.ping());
+    QVERIFY(timer.elapsed() >= 100);
+
+    MockClamd::LatencyModel model;
+    QVERIFY(MockClamd::parseLatencyModel("lognormal", &model));
+    QVERIFY(model == MockClamd::LatencyModel::LogNormal);
+    QVERIFY(!MockClamd::parseLatencyModel("gaussian", &model));
+}
+
+QTEST_GUILESS_MAIN(TestMockClamd)
+#include "tst_mockclamd.moc"
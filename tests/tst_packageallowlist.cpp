@@ -0,0 +1,208 @@
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstring>
+#include "core/PackageAllowlist.h"
+#include "core/PackageAllowlistBuilder.h"
+
+// A file is only trusted while its size, mtime and checksum still match the
+// package record; anything edited since install goes to the backend
+class TestPackageAllowlist : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void find();
+    void md5InstalledAt();
+    void sha256ExactMtime();
+    void contentsInMemory();
+    void rejectsGarbage();
+    void buildsFromSystemDatabase();
+
+private:
+    struct Entry {
+        QByteArray path;
+        PackageAllowlist::Record record;
+    };
+
+    static PackageAllowlist::Record record(quint32 flags, quint64 size, qint64 mtime, const QByteArray& digest);
+    static bool writeAllowlist(const QString& path, QVector<Entry> entries);
+    QString writeFile(const QString& name, const QByteArray& contents);
+
+    QTemporaryDir m_dir;
+    QString m_md5File;
+    QString m_sha256File;
+    PackageAllowlistPtr m_allowlist;
+};
+
+static const QByteArray Md5Contents("#!/bin/sh\necho installed by dpkg\n");
+static const QByteArray Sha256Contents("installed by pacman, size and mtime recorded\n");
+static const qint64 InstallTime = 1700000000;
+
+PackageAllowlist::Record TestPackageAllowlist::record(quint32 flags, quint64 size, qint64 mtime,
+                                                      const QByteArray& digest) {
+    PackageAllowlist::Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.flags = flags;
+    record.size = size;
+    record.mtime = mtime;
+    std::memcpy(record.digest, digest.constData(), size_t(qMin(digest.size(), 32)));
+    return record;
+}
+
+bool TestPackageAllowlist::writeAllowlist(const QString& path, QVector<Entry> entries) {
+    for (Entry& entry : entries) {
+        entry.record.pathHash = PackageAllowlist::hashPath(entry.path);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.record.pathHash < b.record.pathHash;
+    });
+
+    QByteArray paths;
+    QByteArray records;
+    for (Entry& entry : entries) {
+        entry.record.pathOffset = quint32(paths.size());
+        entry.record.pathLength = quint32(entry.path.size());
+        paths.append(entry.path);
+        records.append(reinterpret_cast<const char*>(&entry.record), sizeof(entry.record));
+    }
+
+    PackageAllowlist::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "FAVPKGA1", sizeof(header.magic));
+    header.version = 1;
+    header.recordSize = sizeof(PackageAllowlist::Record);
+    header.recordCount = quint64(entries.size());
+    header.recordOffset = (sizeof(header) + 7) & ~quint64(7);
+    header.pathsOffset = header.recordOffset + quint64(records.size());
+    header.pathsSize = quint64(paths.size());
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(QByteArray(int(header.recordOffset - sizeof(header)), '\0'));
+    file.write(records);
+    file.write(paths);
+    return true;
+}
+
+QString TestPackageAllowlist::writeFile(const QString& name, const QByteArray& contents) {
+    QString path = m_dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void TestPackageAllowlist::initTestCase() {
+    QVERIFY(m_dir.isValid());
+    m_md5File = writeFile("md5.sh", Md5Contents);
+    m_sha256File = writeFile("sha256.txt", Sha256Contents);
+    QVERIFY(!m_md5File.isEmpty() && !m_sha256File.isEmpty());
+
+    QVector<Entry> entries;
+    entries.append({m_md5File.toUtf8(),
+                    record(PackageAllowlist::DigestMd5 | PackageAllowlist::InstalledAt, PackageAllowlist::UnknownSize,
+                           InstallTime, QCryptographicHash::hash(Md5Contents, QCryptographicHash::Md5))});
+    entries.append({m_sha256File.toUtf8(),
+                    record(PackageAllowlist::DigestSha256 | PackageAllowlist::ExactMtime,
+                           quint64(Sha256Contents.size()), InstallTime,
+                           QCryptographicHash::hash(Sha256Contents, QCryptographicHash::Sha256))});
+    for (int i = 0; i < 100; ++i) {
+        entries.append({"/usr/share/doc/filler/" + QByteArray::number(i),
+                        record(PackageAllowlist::DigestMd5, PackageAllowlist::UnknownSize, 0, QByteArray(16, 'x'))});
+    }
+
+    QString path = m_dir.filePath("packages.bin");
+    QVERIFY(writeAllowlist(path, entries));
+    QString error;
+    m_allowlist = PackageAllowlist::open(path, &error);
+    QVERIFY2(m_allowlist, qPrintable(error));
+}
+
+void TestPackageAllowlist::find() {
+    QCOMPARE(m_allowlist->recordCount(), quint64(102));
+    QVERIFY(m_allowlist->find(m_md5File));
+    QVERIFY(m_allowlist->find("/usr/share/doc/filler/0"));
+    QVERIFY(m_allowlist->find("/usr/share/doc/filler/99"));
+    QVERIFY(!m_allowlist->find("/usr/share/doc/filler/100"));
+    QVERIFY(!m_allowlist->find("/usr/share/doc/filler"));
+}
+
+void TestPackageAllowlist::md5InstalledAt() {
+    quint64 size = quint64(Md5Contents.size());
+    QVERIFY(m_allowlist->verify(m_md5File, size, InstallTime));
+    QVERIFY(m_allowlist->verify(m_md5File, size, InstallTime - 3600));
+
+    // Touched after the install: scanned even if the checksum would still match
+    QVERIFY(!m_allowlist->verify(m_md5File, size, InstallTime + 1));
+
+    QVERIFY(!m_allowlist->verify(m_dir.filePath("unlisted"), size, InstallTime));
+}
+
+void TestPackageAllowlist::sha256ExactMtime() {
+    quint64 size = quint64(Sha256Contents.size());
+    QVERIFY(m_allowlist->verify(m_sha256File, size, InstallTime));
+    QVERIFY(!m_allowlist->verify(m_sha256File, size, InstallTime - 1));
+    QVERIFY(!m_allowlist->verify(m_sha256File, size + 1, InstallTime));
+
+    // Edited in place, same size and mtime put back
+    QFile file(m_sha256File);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.write("X") == 1);
+    file.close();
+    QVERIFY(!m_allowlist->verify(m_sha256File, size, InstallTime));
+
+    file.open(QIODevice::ReadWrite);
+    file.write(Sha256Contents.left(1));
+    file.close();
+    QVERIFY(m_allowlist->verify(m_sha256File, size, InstallTime));
+}
+
+void TestPackageAllowlist::contentsInMemory() {
+    QByteArray tampered = Md5Contents;
+    tampered[0] = 'X';
+    quint64 size = quint64(Md5Contents.size());
+
+    ReadCount read;
+    QVERIFY(m_allowlist->verify(m_md5File, size, InstallTime, nullptr, &Md5Contents, &read));
+    QVERIFY(!m_allowlist->verify(m_md5File, size, InstallTime, nullptr, &tampered, &read));
+    QCOMPARE(read.bytes, quint64(0));
+}
+
+void TestPackageAllowlist::rejectsGarbage() {
+    QString path = writeFile("garbage.bin", QByteArray(4096, 'x'));
+    QString error;
+    QVERIFY(!PackageAllowlist::open(path, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!PackageAllowlist::open(m_dir.filePath("does-not-exist")));
+}
+
+void TestPackageAllowlist::buildsFromSystemDatabase() {
+    if (PackageAllowlistBuilder::sourceFiles().isEmpty()) {
+        QSKIP("No dpkg or pacman database on this machine");
+    }
+
+    QString path = m_dir.filePath("system/packages.bin");
+    PackageAllowlistBuilder::Stats stats;
+    QString error;
+    QVERIFY2(PackageAllowlistBuilder::rebuild(path, &error, &stats), qPrintable(error));
+    QVERIFY(!stats.unchanged);
+
+    PackageAllowlistPtr allowlist = PackageAllowlist::open(path);
+    QVERIFY(allowlist);
+    QCOMPARE(allowlist->recordCount(), stats.records);
+
+    // Nothing was installed in between, so the allowlist is kept
+    PackageAllowlistBuilder::Stats again;
+    QVERIFY(PackageAllowlistBuilder::rebuild(path, &error, &again));
+    QVERIFY(again.unchanged);
+    QCOMPARE(again.records, stats.records);
+}
+
+QTEST_GUILESS_MAIN(TestPackageAllowlist)
+#include "tst_packageallowlist.moc"
@@ -0,0 +1,83 @@
+#include <QtTest>
+#include "core/PathArena.h"
+
+// Paths are rebuilt from parent links; the root carries its absolute path
+class TestPathArena : public QObject {
+    Q_OBJECT
+
+private slots:
+    void buildsPaths();
+    void rootWithTrailingSlash();
+    void filesystemRoot();
+    void nonUtf8Names();
+    void squeezeKeepsContents();
+};
+
+void TestPathArena::buildsPaths() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, "/home/user");
+    quint32 docs = arena.addDirectory(root, "docs");
+    quint32 deep = arena.addDirectory(docs, "a");
+    quint32 top = arena.addFile(root, ".bashrc");
+    quint32 report = arena.addFile(docs, "report.pdf");
+    quint32 leaf = arena.addFile(deep, "b.txt");
+
+    QCOMPARE(arena.directoryCount(), 3);
+    QCOMPARE(arena.fileCount(), 3);
+    QCOMPARE(arena.fileDirectory(report), docs);
+
+    QCOMPARE(arena.directoryPath(root), QString("/home/user"));
+    QCOMPARE(arena.directoryPath(deep), QString("/home/user/docs/a"));
+    QCOMPARE(arena.filePath(top), QString("/home/user/.bashrc"));
+    QCOMPARE(arena.filePath(report), QString("/home/user/docs/report.pdf"));
+    QCOMPARE(arena.encodedFilePath(leaf), QByteArray("/home/user/docs/a/b.txt"));
+}
+
+void TestPathArena::rootWithTrailingSlash() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, "/mnt/data/");
+    quint32 sub = arena.addDirectory(root, "x");
+    quint32 file = arena.addFile(sub, "y");
+
+    QCOMPARE(arena.filePath(file), QString("/mnt/data/x/y"));
+}
+
+void TestPathArena::filesystemRoot() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, "/");
+    quint32 etc = arena.addDirectory(root, "etc");
+    quint32 top = arena.addFile(root, "vmlinuz");
+    quint32 passwd = arena.addFile(etc, "passwd");
+
+    QCOMPARE(arena.directoryPath(root), QString("/"));
+    QCOMPARE(arena.filePath(top), QString("/vmlinuz"));
+    QCOMPARE(arena.filePath(passwd), QString("/etc/passwd"));
+}
+
+void TestPathArena::nonUtf8Names() {
+    // Names are kept as the filesystem gave them, so open() gets the same bytes
+    const QByteArray latin1("caf\xe9", 4);
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, "/tmp");
+    quint32 file = arena.addFile(root, latin1);
+
+    QCOMPARE(arena.encodedFilePath(file), QByteArray("/tmp/") + latin1);
+}
+
+void TestPathArena::squeezeKeepsContents() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, "/r");
+    QVector<quint32> files;
+    for (int i = 0; i < 1000; ++i) {
+        files.append(arena.addFile(root, QByteArray::number(i)));
+    }
+    arena.squeeze();
+
+    QCOMPARE(arena.fileCount(), 1000);
+    QCOMPARE(arena.filePath(files[0]), QString("/r/0"));
+    QCOMPARE(arena.filePath(files[999]), QString("/r/999"));
+    QVERIFY(arena.memoryUsage() > 0);
+}
+
+QTEST_GUILESS_MAIN(TestPathArena)
+#include "tst_patharena.moc"
@@ -0,0 +1,118 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "core/RiskRank.h"
+#include "core/PathArena.h"
+
+// Tiers come from the suffix, the mode bit and the first bytes; within a tier
+// the newest file goes first. Every file here shares one directory, so the
+// drop location check cannot tell them apart.
+class TestRiskRank : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void classify();
+    void orderPaths();
+    void orderArena();
+    void cancelledKeepsOrder();
+
+private:
+    QString writeFile(const QString& name, const QByteArray& contents, qint64 ageSecs, bool executable = false);
+
+    QTemporaryDir m_dir;
+    QStringList m_shuffled;
+    QStringList m_expected;
+    qint64 m_now;
+};
+
+QString TestRiskRank::writeFile(const QString& name, const QByteArray& contents, qint64 ageSecs, bool executable) {
+    QString path = m_dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size()) {
+        return QString();
+    }
+    // Written out first, or closing the file would bump the mtime again
+    file.flush();
+    if (executable) {
+        file.setPermissions(file.permissions() | QFileDevice::ExeOwner);
+    }
+    file.setFileTime(QDateTime::fromSecsSinceEpoch(m_now - ageSecs), QFileDevice::FileModificationTime);
+    return path;
+}
+
+void TestRiskRank::initTestCase() {
+    QVERIFY(m_dir.isValid());
+    m_now = QDateTime::currentSecsSinceEpoch();
+    const qint64 day = 24 * 3600;
+
+    QString old = writeFile("notes", "plain text", 90 * day);
+    QString fresh = writeFile("fresh", "plain text", 60);
+    QString document = writeFile("invoice.pdf", "%PDF-1.7", 2 * day);
+    QString script = writeFile("install.sh", "echo hi", 3 * day);
+    QString shebang = writeFile("runme", "#!/bin/sh\necho hi\n", 4 * day, true);
+    QString exe = writeFile("setup.EXE", "MZ\x90\0", 5 * day);
+    QString elf = writeFile("daemon", QByteArray("\x7f" "ELF\x02\x01\x01", 7), 6 * day, true);
+    for (const QString& path : {old, fresh, document, script, shebang, exe, elf}) {
+        QVERIFY(!path.isEmpty());
+    }
+
+    m_shuffled = {old, script, elf, fresh, document, exe, shebang};
+    // Executables, scripts, documents, then the rest newest first
+    m_expected = {exe, elf, script, shebang, document, fresh, old};
+}
+
+void TestRiskRank::classify() {
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("setup.EXE")), m_now) == RiskRank::Executable);
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("daemon")), m_now) == RiskRank::Executable);
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("install.sh")), m_now) == RiskRank::Script);
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("runme")), m_now) == RiskRank::Script);
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("invoice.pdf")), m_now) == RiskRank::Document);
+    QVERIFY(RiskRank::classify(QFileInfo(m_dir.filePath("notes")), m_now) == RiskRank::Other);
+}
+
+void TestRiskRank::orderPaths() {
+    QStringList paths = m_shuffled;
+    QString gone = m_dir.filePath("deleted.exe");
+    paths.insert(2, gone);
+
+    QStringList missing;
+    QCOMPARE(RiskRank::order(paths, &missing), m_expected);
+    QCOMPARE(missing, QStringList() << gone);
+}
+
+void TestRiskRank::orderArena() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, QFile::encodeName(m_dir.path()));
+    QVector<quint32> files;
+    for (const QString& path : m_shuffled) {
+        files.append(arena.addFile(root, QFile::encodeName(QFileInfo(path).fileName())));
+    }
+    // Kept, and ranked last, so the scan can report it
+    quint32 gone = arena.addFile(root, "deleted.exe");
+    files.prepend(gone);
+
+    QStringList ordered;
+    QVector<quint32> ranked = RiskRank::order(arena, files);
+    for (int i = 0; i < ranked.size() - 1; ++i) {
+        ordered.append(arena.filePath(ranked[i]));
+    }
+    QCOMPARE(ranked.size(), files.size());
+    QCOMPARE(ranked.last(), gone);
+    QCOMPARE(ordered, m_expected);
+}
+
+void TestRiskRank::cancelledKeepsOrder() {
+    PathArena arena;
+    quint32 root = arena.addDirectory(PathArena::NoDirectory, QFile::encodeName(m_dir.path()));
+    QVector<quint32> files;
+    for (const QString& path : m_shuffled) {
+        files.append(arena.addFile(root, QFile::encodeName(QFileInfo(path).fileName())));
+    }
+
+    CancellationToken token;
+    token.cancel();
+    QCOMPARE(RiskRank::order(arena, files, &token), files);
+}
+
+QTEST_GUILESS_MAIN(TestRiskRank)
+#include "tst_riskrank.moc"
@@ -0,0 +1,92 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QUrl>
+#include "core/Database.h"
+#include "core/ScanExporter.h"
+
+// Paths and virus names are free text; the exports must survive any of it
+class TestScanExporter : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void csvQuotesFields();
+    void sarifEscapesText();
+
+private:
+    QByteArray exportScan(ScanExporter::Format format);
+
+    QTemporaryDir m_dir;
+    int m_scanId = -1;
+};
+
+static const char AWKWARD_PATH[] = "/data/a,b \"quoted\"\nline #1.exe";
+static const char AWKWARD_VIRUS[] = "Win.Test\"Sig\\1,2";
+
+void TestScanExporter::initTestCase() {
+    QVERIFY(m_dir.isValid());
+    Database db(m_dir.filePath("fastav.db"));
+    QVERIFY(db.initialize());
+
+    m_scanId = db.createScan(QStringList() << "/data");
+    QVERIFY(m_scanId >= 0);
+    QVERIFY(db.addThreat(m_scanId, "/data/plain.exe", "Eicar-Test", 68, "27000"));
+    QVERIFY(db.addThreat(m_scanId, AWKWARD_PATH, AWKWARD_VIRUS, 1024, "27000"));
+}
+
+QByteArray TestScanExporter::exportScan(ScanExporter::Format format) {
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+
+    ScanExporter exporter(m_dir.filePath("fastav.db"));
+    QString error;
+    ScanExporter::Stats stats;
+    bool ok = exporter.exportScan(m_scanId, format, &buffer, nullptr, &error, &stats);
+    if (!ok) {
+        qWarning() << "Export failed:" << error;
+        return QByteArray();
+    }
+    if (stats.threats != 2) {
+        qWarning() << "Exported" << stats.threats << "threats";
+        return QByteArray();
+    }
+    return data;
+}
+
+void TestScanExporter::csvQuotesFields() {
+    QByteArray csv = exportScan(ScanExporter::Format::Csv);
+    QVERIFY(!csv.isEmpty());
+
+    QVERIFY(csv.startsWith("scan_id,file_path,virus_name,file_size,detection_time,signature_version\r\n"));
+    QVERIFY(csv.contains(QByteArray::number(m_scanId) + ",/data/plain.exe,Eicar-Test,68,"));
+    QVERIFY(csv.contains(QByteArray::number(m_scanId)
+                         + ",\"/data/a,b \"\"quoted\"\"\nline #1.exe\",\"Win.Test\"\"Sig\\1,2\",1024,"));
+}
+
+void TestScanExporter::sarifEscapesText() {
+    QByteArray sarif = exportScan(ScanExporter::Format::Sarif);
+    QVERIFY(!sarif.isEmpty());
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(sarif, &parseError);
+    QVERIFY2(parseError.error == QJsonParseError::NoError, qPrintable(parseError.errorString()));
+
+    QJsonObject run = document.object()["runs"].toArray().at(0).toObject();
+    QJsonArray results = run["results"].toArray();
+    QCOMPARE(results.size(), 2);
+
+    QJsonObject awkward = results.at(1).toObject();
+    QCOMPARE(awkward["ruleId"].toString(), QString(AWKWARD_VIRUS));
+    QString uri = awkward["locations"].toArray().at(0).toObject()["physicalLocation"].toObject()
+        ["artifactLocation"].toObject()["uri"].toString();
+    QVERIFY(!uri.contains(' ') && !uri.contains('"') && !uri.contains('\n') && !uri.contains('#'));
+    QCOMPARE(QUrl(uri).toLocalFile(), QString(AWKWARD_PATH));
+}
+
+QTEST_GUILESS_MAIN(TestScanExporter)
+#include "tst_scanexporter.moc"
@@ -0,0 +1,80 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "core/SparseFile.h"
+
+// Holes come back as zeros and are counted apart from the bytes read
+class TestSparseFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void holesReadAsZeros();
+    void denseFileCountsNoHoles();
+};
+
+static const qint64 HOLE_SIZE = 4 * 1024 * 1024;
+static const int DATA_SIZE = 64 * 1024;
+
+void TestSparseFile::holesReadAsZeros() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("sparse.img");
+
+    // Data, a hole, then data again
+    QByteArray head(DATA_SIZE, 'h');
+    QByteArray tail(DATA_SIZE, 't');
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(head), qint64(DATA_SIZE));
+        QVERIFY(file.resize(DATA_SIZE + HOLE_SIZE));
+        QVERIFY(file.seek(DATA_SIZE + HOLE_SIZE));
+        QCOMPARE(file.write(tail), qint64(DATA_SIZE));
+    }
+
+    SparseFile sparse(path);
+    QVERIFY(sparse.open(QIODevice::ReadOnly));
+    QCOMPARE(sparse.size(), qint64(2 * DATA_SIZE) + HOLE_SIZE);
+
+    // Odd-sized reads cross the extent boundaries
+    QByteArray contents;
+    QByteArray chunk(100003, Qt::Uninitialized);
+    qint64 n;
+    while ((n = sparse.read(chunk.data(), chunk.size())) > 0) {
+        contents.append(chunk.constData(), int(n));
+    }
+    QCOMPARE(n, qint64(0));
+    QCOMPARE(qint64(contents.size()), sparse.size());
+    QCOMPARE(contents.left(DATA_SIZE), head);
+    QCOMPARE(contents.mid(DATA_SIZE, int(HOLE_SIZE)), QByteArray(int(HOLE_SIZE), '\0'));
+    QCOMPARE(contents.right(DATA_SIZE), tail);
+
+    // Every logical byte is either read or a hole, never both
+    QCOMPARE(sparse.bytesRead() + sparse.holeBytes(), quint64(sparse.size()));
+    if (!sparse.isSparse()) {
+        QSKIP("The temporary directory's file system allocated the hole");
+    }
+    QVERIFY(sparse.holeBytes() >= quint64(HOLE_SIZE) / 2);
+    QVERIFY(sparse.bytesRead() >= quint64(2 * DATA_SIZE));
+}
+
+void TestSparseFile::denseFileCountsNoHoles() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("dense.bin");
+    QByteArray data(3 * DATA_SIZE + 17, 'd');
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(data), qint64(data.size()));
+    }
+
+    SparseFile dense(path);
+    QVERIFY(dense.open(QIODevice::ReadOnly));
+    QVERIFY(!dense.isSparse());
+    QCOMPARE(dense.readAll(), data);
+    QCOMPARE(dense.bytesRead(), quint64(data.size()));
+    QCOMPARE(dense.holeBytes(), quint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestSparseFile)
+#include "tst_sparsefile.moc"
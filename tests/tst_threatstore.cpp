@@ -0,0 +1,133 @@
+#include <QtTest>
+#include "core/ThreatStore.h"
+
+// Paths are front coded with a full path every RestartInterval entries; both
+// random access and iteration must give back exactly what was appended
+class TestThreatStore : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void sharedPrefixAcrossRestart();
+    void copyOnWrite();
+    void interning();
+    void clear();
+
+private:
+    static QStringList samplePaths(int count);
+};
+
+QStringList TestThreatStore::samplePaths(int count) {
+    QStringList paths;
+    for (int i = 0; i < count; ++i) {
+        // Mixed prefixes, some shorter than the one before, some non-ASCII
+        switch (i % 4) {
+        case 0:
+            paths << QString("/home/user/Downloads/file%1.exe").arg(i);
+            break;
+        case 1:
+            paths << QString("/home/user/Downloads/sub/dir/file%1.dll").arg(i);
+            break;
+        case 2:
+            paths << QString("/srv/%1").arg(i);
+            break;
+        default:
+            paths << QString::fromUtf8("/home/user/Documenti/perché/è%1.pdf").arg(i);
+            break;
+        }
+    }
+    return paths;
+}
+
+void TestThreatStore::roundTrip() {
+    const QStringList paths = samplePaths(3 * ThreatStore::RestartInterval + 5);
+    const QDateTime base = QDateTime::fromSecsSinceEpoch(1700000000);
+
+    ThreatStore store;
+    for (int i = 0; i < paths.size(); ++i) {
+        store.append(paths[i], QString("Virus.%1").arg(i % 3), quint64(i) * 1000,
+                     "daily-27000", base.addSecs(i));
+    }
+    QCOMPARE(store.size(), paths.size());
+
+    // Backwards, so every at() starts from a restart point
+    for (int i = paths.size() - 1; i >= 0; --i) {
+        ThreatInfo threat = store.at(i);
+        QCOMPARE(threat.filePath, paths[i]);
+        QCOMPARE(threat.virusName, QString("Virus.%1").arg(i % 3));
+        QCOMPARE(threat.fileSize, quint64(i) * 1000);
+        QCOMPARE(threat.signatureVersion, QString("daily-27000"));
+        QCOMPARE(threat.detectionTime, base.addSecs(i));
+        QCOMPARE(store.filePath(i), paths[i]);
+    }
+
+    int index = 0;
+    for (const ThreatInfo& threat : store) {
+        QCOMPARE(threat.filePath, paths[index]);
+        QCOMPARE(threat.fileSize, quint64(index) * 1000);
+        index++;
+    }
+    QCOMPARE(index, paths.size());
+}
+
+void TestThreatStore::sharedPrefixAcrossRestart() {
+    // The entry at the restart point must not borrow from the one before it
+    ThreatStore store;
+    for (int i = 0; i < ThreatStore::RestartInterval; ++i) {
+        store.append("/var/lib/same/prefix/a", "Virus", 1);
+    }
+    store.append("/var/lib/same/prefix/b", "Virus", 1);
+    store.append("/var/lib/same/prefix/bc", "Virus", 1);
+
+    QCOMPARE(store.filePath(ThreatStore::RestartInterval), QString("/var/lib/same/prefix/b"));
+    QCOMPARE(store.filePath(ThreatStore::RestartInterval + 1), QString("/var/lib/same/prefix/bc"));
+    QCOMPARE(store.filePath(ThreatStore::RestartInterval - 1), QString("/var/lib/same/prefix/a"));
+}
+
+void TestThreatStore::copyOnWrite() {
+    ThreatStore store;
+    store.append("/a/one", "Virus", 1);
+    store.append("/a/two", "Virus", 2);
+
+    ThreatStore copy = store;
+    copy.append("/a/three", "Other", 3);
+
+    QCOMPARE(store.size(), 2);
+    QCOMPARE(copy.size(), 3);
+    QCOMPARE(store.internedCount(), 2);
+    QCOMPARE(copy.filePath(2), QString("/a/three"));
+    QCOMPARE(store.filePath(1), QString("/a/two"));
+}
+
+void TestThreatStore::interning() {
+    ThreatStore store;
+    for (int i = 0; i < 100; ++i) {
+        store.append(QString("/x/%1").arg(i), i % 2 ? "Eicar" : "Trojan", 1, "main-62");
+    }
+    // The empty string, two names and one version
+    QCOMPARE(store.internedCount(), 4);
+    QCOMPARE(store.virusName(7), QString("Eicar"));
+    QCOMPARE(store.virusName(8), QString("Trojan"));
+    QCOMPARE(store.signatureVersion(9), QString("main-62"));
+
+    store.append("/x/unknown", "Eicar", 1);
+    QVERIFY(store.signatureVersion(100).isEmpty());
+}
+
+void TestThreatStore::clear() {
+    ThreatStore store;
+    store.append("/a/b", "Virus", 1);
+    ThreatStore copy = store;
+
+    store.clear();
+    QVERIFY(store.isEmpty());
+    QVERIFY(store.begin() == store.end());
+    QCOMPARE(copy.size(), 1);
+
+    store.append("/c/d", "Other", 2);
+    QCOMPARE(store.at(0).filePath, QString("/c/d"));
+    QCOMPARE(store.at(0).virusName, QString("Other"));
+}
+
+QTEST_GUILESS_MAIN(TestThreatStore)
+#include "tst_threatstore.moc"